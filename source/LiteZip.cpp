@@ -5,6 +5,11 @@
 #include <string.h>
 #include <tchar.h>
 #include "globaldata.h"
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>		// For __cpuid.
+#include <wmmintrin.h>	// For _mm_clmulepi64_si128.
+#define LITEZIP_CLMUL
+#endif
 #define IDS_OK        20
 #define IDS_UNKNOWN   21
 #define DIRSLASH_CHAR	'\\'
@@ -288,6 +293,21 @@ typedef struct
 #define TZIP_ARCCLOSEFH			0x0000002	// Set if we open the file handle in archiveOpen() and must close it later.
 #define TZIP_GZIP				0x0000004	// Set if a GZIP archive.
 #define TZIP_RAW				0x0000008	// Set if "raw" mode
+#define TZIP_NOINDEX			0x0000010	// Set if buildIndex() failed, so the Central Directory must be walked
+
+// ZIPINDEX maps entry names and numbers to their tables in the Central Directory, so that
+// findEntry() and setCurrentEntry() don't have to walk the Central Directory each time.
+// It is built by buildIndex() the first time it is needed, and freed by closeArchive().
+typedef struct
+{
+	ULONGLONG		*Pos;						// Position of each entry's table within the Central Directory, by entry number
+	DWORD			*NameOffset;				// Offset of each entry's name within Names, by entry number
+	DWORD			*Next;						// Next entry number in the same hash bucket, or -1
+	DWORD			*Buckets;					// First entry number in each hash bucket, or -1
+	char			*Names;						// Each entry's name (as stored in the archive), nul-terminated
+	DWORD			Mask;						// Number of hash buckets - 1
+	DWORD			HighBytes;					// Non-zero if some name has chars above 0x7F
+} ZIPINDEX;
 
 
 // TUNZIP holds information about the ZIP archive itself.
@@ -312,6 +332,7 @@ typedef struct
 	ZIPENTRYINFO	CurrentEntryInfo;			// Info about the currently selected entry (gotten from the Central Dir)
 	ZIPENTRYINFO64	CurrentEntryInfo64;			// Info about the currently selected entry (gotten from the Central Dir)
 	ENTRYREADVARS	EntryReadVars;				// Variables/buffers for decompressing the current entry
+	ZIPINDEX		*Index;						// Hashed index of the Central Directory, or 0 if not built yet
 	unsigned char	Rootdir[MAX_PATH];			// Root dir for unzipping entries. Includes a trailing slash. Must be the last field!!!
 } TUNZIP;
 
@@ -1968,7 +1989,117 @@ static int inflate_fast(uInt bl, uInt bd, const INFLATE_HUFT *tl, const INFLATE_
 
 
 
-/************************ ucrc32() ********************
+/********************* Crc_slice[] *******************
+* Crc_slice[k][n] is the CRC-32 of byte n followed by k
+* zero bytes, which lets crc32_fast() process 8 bytes
+* per step ("slicing-by-8").  Crc_slice[0] is Crc_table.
+* The tables are built once when the module is loaded,
+* before any thread can compute a CRC.
+*/
+
+static ULG Crc_slice[8][256];
+#ifdef LITEZIP_CLMUL
+static BOOL Crc_clmul;		// TRUE if the processor supports PCLMULQDQ and SSE2.
+#endif
+
+static struct CrcSliceInit
+{
+	CrcSliceInit()
+	{
+		for (int n = 0; n < 256; n++)
+		{
+			ULG crc = Crc_slice[0][n] = Crc_table[n];
+			for (int k = 1; k < 8; k++)
+				crc = Crc_slice[k][n] = Crc_table[crc & 0xff] ^ (crc >> 8);
+		}
+#ifdef LITEZIP_CLMUL
+		int info[4];
+		__cpuid(info, 1);
+		Crc_clmul = (info[2] & (1 << 1)) && (info[3] & (1 << 26)); // ECX.PCLMULQDQ, EDX.SSE2
+#endif
+	}
+} Crc_slice_init;
+
+
+
+
+#ifdef LITEZIP_CLMUL
+/********************* crc32_clmul() *******************
+* Computes the (pre- and post-inverted) CRC-32 of a buffer
+* whose length is a multiple of 16 and at least 64, by
+* folding 512 bits at a time with carry-less multiplies
+* and finishing with a Barrett reduction.  See "Fast CRC
+* Computation for Generic Polynomials Using PCLMULQDQ
+* Instruction", Gopal et al., Intel 2009.  The constants
+* are for the bit-reflected CRC-32 polynomial.
+*/
+
+static ULG crc32_clmul(ULG crc, const UCH *buf, DWORD len)
+{
+	const __m128i k1k2 = _mm_setr_epi32(0x54442bd4, 1, 0xc6e41596, 1);
+	const __m128i k3k4 = _mm_setr_epi32(0x751997d0, 1, 0xccaa009e, 0);
+	const __m128i k5k0 = _mm_setr_epi32(0x63cd6124, 1, 0, 0);
+	const __m128i poly = _mm_setr_epi32(0xdb710641, 1, 0xf7011641, 1);
+	const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf), _mm_cvtsi32_si128(crc));
+	x2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(buf + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(buf + 48));
+	buf += 64;
+	len -= 64;
+
+	// Fold four 128-bit lanes in parallel
+	for (; len >= 64; buf += 64, len -= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i *)buf));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i *)(buf + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i *)(buf + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i *)(buf + 48)));
+	}
+
+	// Fold the four lanes into one
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+	// Fold any remaining 128-bit blocks
+	for (; len >= 16; buf += 16, len -= 16)
+	{
+		x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i *)buf)), x5);
+	}
+
+	// Fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+
+	// Barrett reduction to 32 bits
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (ULG)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#endif
+
+
+
+
+/************************ crc32_fast() ********************
 * Computes the CRC-32 of the bytes in the specified
 * buffer.
 *
@@ -1978,33 +2109,49 @@ static int inflate_fast(uInt bl, uInt bd, const INFLATE_HUFT *tl, const INFLATE_
 *
 * RETURNS: The updated CRC-32.
 *
-* Copyright (C) 1995-1998 Mark Adler. For conditions of
-* distribution and use, see copyright notice in zlib.h
+* Uses PCLMULQDQ folding for large buffers if the processor
+* supports it, otherwise reads 8 bytes per step using the
+* Crc_slice tables.
 */
 
 #define CRC_DO1(buf) crc = Crc_table[((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8);
-#define CRC_DO2(buf)  CRC_DO1(buf); CRC_DO1(buf);
-#define CRC_DO4(buf)  CRC_DO2(buf); CRC_DO2(buf);
-#define CRC_DO8(buf)  CRC_DO4(buf); CRC_DO4(buf);
 
-static ULG ucrc32(ULG crc, const UCH *buf, DWORD len)
+static ULG crc32_fast(ULG crc, const UCH *buf, DWORD len)
 {
 	crc = crc ^ 0xffffffffL;
-	while (len >= 8)
+#ifdef LITEZIP_CLMUL
+	if (Crc_clmul && len >= 64)
 	{
-		CRC_DO8(buf);
-		len -= 8;
+		crc = crc32_clmul(crc, buf, len & ~15);
+		buf += len & ~15;
+		len &= 15;
 	}
-	if (len)
+#endif
+	// Align buf so that the loop below reads whole DWORDs
+	while (len && ((UINT_PTR)buf & 3))
 	{
-		do
-		{
-			CRC_DO1(buf);
-		} while (--len);
+		CRC_DO1(buf);
+		len--;
+	}
+	for (; len >= 8; buf += 8, len -= 8)
+	{
+		ULG one = *(const ULG *)buf ^ crc;
+		ULG two = *(const ULG *)(buf + 4);
+		crc = Crc_slice[7][one & 0xff] ^ Crc_slice[6][(one >> 8) & 0xff] ^ Crc_slice[5][(one >> 16) & 0xff] ^ Crc_slice[4][one >> 24]
+			^ Crc_slice[3][two & 0xff] ^ Crc_slice[2][(two >> 8) & 0xff] ^ Crc_slice[1][(two >> 16) & 0xff] ^ Crc_slice[0][two >> 24];
+	}
+	while (len--)
+	{
+		CRC_DO1(buf);
 	}
 	return(crc ^ 0xffffffffL);
 }
 
+DWORD WINAPI ZipCrc32(DWORD crc, const void *buf, DWORD len)
+{
+	return(buf ? crc32_fast(crc, (const UCH *)buf, len) : 0);
+}
+
 
 
 
@@ -3053,7 +3200,7 @@ ULONGLONG readEntry(register TUNZIP *tunzip, void *buf, ULONGLONG len)
 				uDoCopy = tunzip->EntryReadVars.stream.avail_in;
 			CopyMemory(tunzip->EntryReadVars.stream.next_out, tunzip->EntryReadVars.stream.next_in, (DWORD)uDoCopy & 0xFFFFFFFF);
 
-			tunzip->EntryReadVars.RunningCrc = ucrc32(tunzip->EntryReadVars.RunningCrc, tunzip->EntryReadVars.stream.next_out, (DWORD)uDoCopy & 0xFFFFFFFF);
+			tunzip->EntryReadVars.RunningCrc = crc32_fast(tunzip->EntryReadVars.RunningCrc, tunzip->EntryReadVars.stream.next_out, (DWORD)uDoCopy & 0xFFFFFFFF);
 			tunzip->EntryReadVars.RemainingUncompressed -= uDoCopy;
 			tunzip->EntryReadVars.stream.avail_in -= uDoCopy;
 			tunzip->EntryReadVars.stream.avail_out -= uDoCopy;
@@ -3084,7 +3231,7 @@ ULONGLONG readEntry(register TUNZIP *tunzip, void *buf, ULONGLONG len)
 			uTotalOutAfter = tunzip->EntryReadVars.stream.total_out;
 			uOutThis = uTotalOutAfter - uTotalOutBefore;
 
-			tunzip->EntryReadVars.RunningCrc = ucrc32(tunzip->EntryReadVars.RunningCrc, bufBefore, (DWORD)uOutThis);
+			tunzip->EntryReadVars.RunningCrc = crc32_fast(tunzip->EntryReadVars.RunningCrc, bufBefore, (DWORD)uOutThis);
 
 			tunzip->EntryReadVars.RemainingUncompressed -= uOutThis;
 			iRead += (uTotalOutAfter - uTotalOutBefore);
@@ -3163,6 +3310,155 @@ return((int)uReadThis);
 
 
 
+
+
+
+
+
+/************************ hashName() ***********************
+* Hashes an entry name for the ZIPINDEX. Only ASCII letters
+* (folded to lower case) and digits are hashed, so names that
+* lstrcmpiA() and lstrcmpA() consider equal land in the same
+* bucket. The caller must still compare the names.
+*/
+
+static DWORD hashName(register const unsigned char *name)
+{
+	register DWORD	hash;
+	register DWORD	chr;
+
+	hash = 2166136261;
+	while ((chr = *name++))
+	{
+		if (chr >= 'A' && chr <= 'Z') chr |= 0x20;
+		else if ((chr < 'a' || chr > 'z') && (chr < '0' || chr > '9')) continue;
+		hash = (hash ^ chr) * 16777619;
+	}
+	return(hash);
+}
+
+
+
+
+
+/************************ freeIndex() ***********************
+* Frees the ZIPINDEX made by buildIndex().
+*/
+
+static void freeIndex(register TUNZIP *tunzip)
+{
+	if (tunzip->Index)
+	{
+		if (tunzip->Index->Names) GlobalFree(tunzip->Index->Names);
+		GlobalFree(tunzip->Index);
+		tunzip->Index = 0;
+	}
+}
+
+
+
+
+
+/************************ buildIndex() ***********************
+* Walks the Central Directory once, and makes a ZIPINDEX of
+* each entry's position and name, so that findEntry() and
+* setCurrentEntry() can go directly to an entry.
+*
+* If the index can't be made, TZIP_NOINDEX is set so that we
+* don't try again, and callers walk the Central Directory as
+* before. TUNZIP->LastErr is left as 0 in either case.
+*
+* NOTE: Caller must cleanupEntry() first, and the current entry
+* is undefined afterward.
+*/
+
+static void buildIndex(register TUNZIP *tunzip)
+{
+	register ZIPINDEX	*index;
+	DWORD				count, buckets, i, size, used;
+	char				name[MAX_PATH];
+
+	tunzip->LastErr = 0;
+
+	// GZIP and raw archives have no Central Directory. Also refuse an absurd
+	// number of entries (rather than overflowing our allocation size)
+	if ((tunzip->Flags & (TZIP_GZIP|TZIP_RAW)) || !tunzip->TotalEntries || tunzip->TotalEntries > 0x01000000) goto none;
+
+	count = (DWORD)tunzip->TotalEntries;
+	buckets = 16;
+	while (buckets < count) buckets <<= 1;
+
+	if (!(index = (ZIPINDEX *)GlobalAlloc(GPTR, sizeof(ZIPINDEX) + (count * (sizeof(ULONGLONG) + sizeof(DWORD) + sizeof(DWORD))) + (buckets * sizeof(DWORD)))))
+		goto none;
+	index->Pos = (ULONGLONG *)(index + 1);
+	index->NameOffset = (DWORD *)(index->Pos + count);
+	index->Next = index->NameOffset + count;
+	index->Buckets = index->Next + count;
+	index->Mask = buckets - 1;
+	tunzip->Index = index;
+
+	// Allow an average of 32 chars per name to begin with
+	size = count * 32;
+	used = 0;
+	if (!(index->Names = (char *)GlobalAlloc(GMEM_FIXED, size))) goto bad;
+
+	// Read each entry's position and name
+	goToFirstEntry(tunzip);
+	for (i = 0; !tunzip->LastErr; )
+	{
+		register DWORD	len;
+
+		index->Pos[i] = tunzip->CurrEntryPosInCentralDir;
+		getEntryFN(tunzip, &name[0]);
+		if (tunzip->LastErr) goto bad;
+
+		len = lstrlenA(&name[0]) + 1;
+		if (used + len > size)
+		{
+			char	*names;
+
+			// A single name may be longer than the whole buffer, so grow until it fits
+			while (used + len > size) size *= 2;
+			if (!(names = (char *)GlobalAlloc(GMEM_FIXED, size))) goto bad;
+			CopyMemory(names, index->Names, used);
+			GlobalFree(index->Names);
+			index->Names = names;
+		}
+		CopyMemory(index->Names + used, &name[0], len);
+		index->NameOffset[i] = used;
+		used += len;
+
+		if (++i >= count) break;
+		goToNextEntry(tunzip);
+	}
+	if (tunzip->LastErr) goto bad;
+
+	// Chain each bucket's entries in ascending order, so that a duplicated name
+	// finds the first entry, same as a walk of the Central Directory would
+	for (i = 0; i < buckets; i++) index->Buckets[i] = (DWORD)-1;
+	i = count;
+	while (i--)
+	{
+		register const unsigned char	*ptr;
+		register DWORD					bucket;
+
+		ptr = (const unsigned char *)index->Names + index->NameOffset[i];
+		bucket = hashName(ptr) & index->Mask;
+		index->Next[i] = index->Buckets[bucket];
+		index->Buckets[bucket] = i;
+		while (*ptr) if (*ptr++ & 0x80) index->HighBytes = 1;
+	}
+
+	cleanupEntry(tunzip);
+	return;
+
+bad:
+	freeIndex(tunzip);
+none:
+	cleanupEntry(tunzip);
+	tunzip->Flags |= TZIP_NOINDEX;
+	tunzip->LastErr = 0;
+}
 
 
 
@@ -3207,6 +3503,40 @@ static DWORD findEntry(TUNZIP *tunzip, ZIPENTRY *ze, DWORD flags)
 	// If there's a currently selected entry, free it
 	cleanupEntry(tunzip);
 
+	// Look up the name in the index (making it if this is the first lookup)
+	if (!tunzip->Index && !(tunzip->Flags & TZIP_NOINDEX)) buildIndex(tunzip);
+	if (tunzip->Index)
+	{
+		register DWORD	i;
+		DWORD			highBytes;
+
+		for (i = tunzip->Index->Buckets[hashName((const unsigned char *)&name[0]) & tunzip->Index->Mask]; i != (DWORD)-1; i = tunzip->Index->Next[i])
+		{
+			register const char	*ptr;
+
+			ptr = tunzip->Index->Names + tunzip->Index->NameOffset[i];
+			if (!(flags & 0x01 ? lstrcmpiA(&name[0], ptr) : lstrcmpA(&name[0], ptr)))
+			{
+				// Read this entry's table from the Central Directory, and fill in caller's ZIPENTRY
+				tunzip->LastErr = 0;
+				tunzip->CurrEntryPosInCentralDir = tunzip->Index->Pos[i];
+				tunzip->CurrentEntryNum = i;
+				getEntryInfo(tunzip);
+				if (!tunzip->LastErr) getEntryFN(tunzip, (char *)&ze->Name[0]);
+				if (tunzip->LastErr) goto out;
+				ze->Index = i;
+				return(setCurrentEntry(tunzip, ze, (flags & UNZIP_UNICODE) | UNZIP_ALREADYINIT));
+			}
+		}
+
+		// Not found. But the Windows compare functions may consider some non-ASCII names
+		// equal to others (which hashName() doesn't account for), so if there are any of
+		// those, fall back to comparing every name
+		highBytes = tunzip->Index->HighBytes;
+		for (i = 0; name[i]; i++) highBytes |= (name[i] & 0x80);
+		if (!highBytes) return(ZR_NOTFOUND);
+	}
+
 	// No error yet
 	tunzip->LastErr = 0;
 
@@ -3247,6 +3577,7 @@ static DWORD findEntry(TUNZIP *tunzip, ZIPENTRY *ze, DWORD flags)
 		}
 	}
 
+out:
 	cleanupEntry(tunzip);
 	return(tunzip->LastErr);
 }
@@ -3296,9 +3627,20 @@ static DWORD setCurrentEntry(register TUNZIP *tunzip, ZIPENTRY *ze, DWORD flags)
 		cleanupEntry(tunzip);
 
 		// Seek to the point in the ZIP archive where this entry is found
-		// and fill in the TUNZIP->CurrentEntryNum
-		if (ze->Index < tunzip->CurrentEntryNum) goToFirstEntry(tunzip);
-		while (!tunzip->LastErr && tunzip->CurrentEntryNum < ze->Index) goToNextEntry(tunzip);
+		// and fill in the TUNZIP->CurrentEntryNum. If it's not the first entry,
+		// use the index (making it if need be) rather than walk the Central Dir
+		if (ze->Index && !tunzip->Index && !(tunzip->Flags & TZIP_NOINDEX)) buildIndex(tunzip);
+		if (tunzip->Index && ze->Index < tunzip->TotalEntries)
+		{
+			tunzip->CurrEntryPosInCentralDir = tunzip->Index->Pos[ze->Index];
+			tunzip->CurrentEntryNum = ze->Index;
+			getEntryInfo(tunzip);
+		}
+		else
+		{
+			if (ze->Index < tunzip->CurrentEntryNum) goToFirstEntry(tunzip);
+			while (!tunzip->LastErr && tunzip->CurrentEntryNum < ze->Index) goToNextEntry(tunzip);
+		}
 
 		if (tunzip->LastErr)
 		{
@@ -3856,6 +4198,7 @@ DWORD WINAPI UnzipFormatMessageW(DWORD code, WCHAR *buf, DWORD len)
 static void closeArchive(register TUNZIP *tunzip)
 {
 	cleanupEntry(tunzip);
+	freeIndex(tunzip);
 	if (tunzip->Flags & TZIP_ARCCLOSEFH)
 		CloseHandle(tunzip->ArchivePtr);
 	if (tunzip->Password){
@@ -4847,9 +5190,52 @@ typedef struct _TZIPFILEINFO {
 #define TZIP_SRCCANSEEK			0x0000020	// Set if source (that supplies the data to add to the ZIP file) is seekable
 #define TZIP_SRCCLOSEFH			0x0000040	// Set if we've opened the source file handle, and therefore need to close it
 #define TZIP_SRCMEMORY			0x0000080	// Set if TZIP->source is memory, instead of a file, handle
+#define TZIP_NOPOOL				0x0000100	// Set if we couldn't (or needn't) start worker threads for compression
 //#define TZIP_OPTION_ABORT		0x4000000	// Defined in LiteZip.h. Must not be used for another purpose
 //#define TZIP_OPTION_GZIP		0x8000000	// Defined in LiteZip.h. Must not be used for another purpose
 
+// Multi-threaded deflate. A source spanning at least 2 chunks is split into ZIP_CHUNK_SIZE
+// pieces which the worker threads compress independently, each one primed with the WSIZE
+// bytes preceding it as its dictionary. Every piece but the last ends with an empty stored
+// block, so the pieces' output can simply be appended to form a single deflate stream.
+// ZipAddDir() also hands each smaller file whole to a worker, so several entries are
+// compressed at once while earlier ones are written out in order.
+#define ZIP_CHUNK_SIZE			(128 * 1024)
+#define ZIP_MAX_THREADS			32
+#define ZIP_OUT_SIZE(len)		((len) + ((len) >> 3) + 8192)	// Worst case compressed size (static trees, with up to 9 bits per literal)
+
+// One piece of work for a worker thread
+typedef struct _TZIPJOB
+{
+	struct _TZIPJOB	*nxt;		// Next entry in TZIP->pending (ZipAddDir only)
+	struct _TZIPJOB	*qnxt;		// Next job waiting in the TZIPPOOL
+	const UCH		*in;		// The source bytes to compress
+	DWORD			len;
+	const UCH		*dict;		// The bytes preceding "in", which matches may refer back to
+	DWORD			dictlen;
+	char			*out;		// Where the worker writes the compressed data
+	DWORD			outlen, outsize;
+	ULG				crc;		// CRC of "in", set by the worker
+	USH				att, flg;	// File type and compression flags for the entry's TZIPFILEINFO, set by the worker
+	DWORD			lasterr;	// Error code, set by the worker
+	HANDLE			done;		// Manual-reset event, signalled when the worker is done with this job
+	char			*data;		// Buffer holding the dictionary and source bytes, if they had to be read in
+	HANDLE			source;		// For an entry queued by ZipAddDir(), the open file (for its timestamps and attributes)
+	DWORD			flags;		// ZIP_UNICODE if "name" is a WCHAR string, or 0
+	WCHAR			name[MAX_PATH];
+	unsigned char	last;		// Set if this is the last piece of the source
+} TZIPJOB;
+
+typedef struct
+{
+	CRITICAL_SECTION	lock;		// Guards head/tail
+	HANDLE				wake;		// Semaphore released once per queued job (and once per thread when stopping)
+	TZIPJOB				*head, *tail;	// Jobs waiting for a thread
+	volatile LONG		stop;
+	DWORD				count;		// How many threads[]
+	HANDLE				threads[ZIP_MAX_THREADS];
+} TZIPPOOL;
+
 typedef struct _TZIP
 {
 	DWORD		flags;
@@ -4886,6 +5272,13 @@ typedef struct _TZIP
 	DWORD		lenin, posin;		// These are for a memory buffer source
 	// and a variable for what we've done with the input: (i.e. compressed it!)
 	ULONGLONG	csize;				// Compressed size, set by the compression routines.
+	TZIPJOB		*job;				// If the source was already compressed by a worker thread (see queueSrc())
+
+	// ====================================================================
+	// Worker threads for compression, started upon the first source big enough to need them
+	TZIPPOOL	*pool;
+	TZIPJOB		*pending, *lastpending;	// Files queued by ZipAddDir(), not yet written to the ZIP
+	DWORD		npending;
 	TSTATE		*state;				// We allocate just one state object per zip, because it's big (500k), and store a ptr here. It is freed when the TZIP is freed
 	char		buf[16384];			// Used by some of the compression routines. This must be last!!
 } TZIP;
@@ -6395,11 +6788,16 @@ static void copy_block(register TSTATE *state, char *block, DWORD len, DWORD hea
 * sufficient to contain the whole input file plus MIN_LOOKAHEAD
 * bytes (to avoid referencing memory beyond the end
 * of window[] when looking for matches towards the end).
+*
+* dict =	If not 0, the dictlen bytes that preceded the
+*			source. They are entered in the hash chains so that
+*			matches can refer back into them (see pdeflate()).
 */
 
-static void lm_init(register TSTATE *state, DWORD pack_level, USH *flags)
+static void lm_init(register TSTATE *state, DWORD pack_level, USH *flags, const UCH *dict, DWORD dictlen)
 {
 	register unsigned j;
+	unsigned	match_head;
 
 	// Do not slide the window if the whole input is already in memory (window_size > 0)
 	//	state->ds.sliding = 0;
@@ -6425,19 +6823,30 @@ static void lm_init(register TSTATE *state, DWORD pack_level, USH *flags)
 	// ??? reduce max_chain_length for binary files
 
 
-	// Fill the state->ds.window[] buffer with source bytes
-	if (!(state->ds.lookahead = readFromSource(state->tzip, (char *)state->ds.window, WSIZE * 2))) return;
+	// Put any dictionary at the start of the window, and fill the rest of the
+	// state->ds.window[] buffer with source bytes
+	if (dict) CopyMemory(state->ds.window, dict, dictlen);
+	else dictlen = 0;
+	if (!(state->ds.lookahead = readFromSource(state->tzip, (char *)state->ds.window + dictlen, WSIZE * 2 - dictlen))) return;
 
-	// At start of input buffer, and haven't reached the end of the source yet
-	state->ds.strstart = state->ds.block_start = state->ds.eofile = 0;
+	// At start of the source (just past the dictionary), and haven't reached the end of the source yet
+	state->ds.strstart = state->ds.block_start = dictlen;
+	state->ds.eofile = 0;
 
 	// Make sure that we always have enough lookahead
 	if (state->ds.lookahead < MIN_LOOKAHEAD) fill_window(state);
 
+	// Hash the dictionary's strings
+	state->ds.ins_h = 0;
+	if (dictlen)
+	{
+		for (j = 0; j < MIN_MATCH - 1; j++) UPDATE_HASH(state->ds.ins_h, state->ds.window[j]);
+		for (j = 0; j + MIN_MATCH <= dictlen; j++) INSERT_STRING(j, match_head);
+	}
+
 	// If lookahead < MIN_MATCH, ins_h is garbage, but this is
 	// not important since only literal bytes will be emitted
-	state->ds.ins_h = 0;
-	for (j = 0; j < MIN_MATCH - 1; j++) UPDATE_HASH(state->ds.ins_h, state->ds.window[j]);
+	for (j = 0; j < MIN_MATCH - 1; j++) UPDATE_HASH(state->ds.ins_h, state->ds.window[dictlen + j]);
 }
 
 
@@ -6757,9 +7166,14 @@ static void deflate_fast(register TSTATE *state)
 * Same as above, but achieves better compression. We use a
 * lazy evaluation for matches: a match is finally adopted
 * only if there is no better match at the next window position.
+*
+* eof =	0 if more data follows this source in the same deflate
+*		stream (see pdeflate()). Rather than the final block, we
+*		then end with an empty stored block, which leaves the
+*		output on a byte boundary.
 */
 
-static void deflate(register TSTATE *state)
+static void deflate(register TSTATE *state, DWORD eof)
 {
 	unsigned			hash_head;				// head of hash chain
 	unsigned			prev_match;				// previous match
@@ -6879,8 +7293,13 @@ static void deflate(register TSTATE *state)
 
 	// EOF
 	flush_block(state, state->ds.block_start >= 0 ? (char *)&state->ds.window[(unsigned)state->ds.block_start] :
-		0, (long)state->ds.strstart - state->ds.block_start, 1);
+		0, (long)state->ds.strstart - state->ds.block_start, eof);
 
+	if (!eof && !state->tzip->lasterr)
+	{
+		send_bits(state, STORED_BLOCK << 1, 3);
+		copy_block(state, 0, 0, 1);
+	}
 }
 
 
@@ -7229,18 +7648,57 @@ static void addCentral(register TZIP *tzip)
 
 // ========================== Encryption ========================
 
-#define DO1(buf)  crc = CRC32(crc, *buf++)
-#define DO2(buf)  DO1(buf); DO1(buf)
-#define DO4(buf)  DO2(buf); DO2(buf)
-#define DO8(buf)  DO4(buf); DO4(buf)
-
 static ULG crc32(ULG crc, const UCH *buf, DWORD len)
 {
 	if (!buf) return(0);
-	crc = crc ^ 0xffffffffL;
-	while (len >= 8) { DO8(buf); len -= 8; }
-	if (len) do { DO1(buf); } while (--len);
-	return crc ^ 0xffffffffL;  // (instead of ~c for 64-bit machines)
+	return crc32_fast(crc, buf, len);
+}
+
+// Multiplies the 32x32 bit matrix "mat" (in GF(2)) by "vec"
+static ULG gf2_matrix_times(const ULG *mat, ULG vec)
+{
+	ULG sum = 0;
+	for (; vec; vec >>= 1, mat++) if (vec & 1) sum ^= *mat;
+	return sum;
+}
+
+static void gf2_matrix_square(ULG *square, const ULG *mat)
+{
+	for (int n = 0; n < 32; n++) square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+/********************* crc32_combine() *******************
+* Given crc1 of one block of data and crc2 of a block of
+* len2 bytes which follows it, returns the CRC of both.
+* (This is zlib's method of applying len2 zero bytes to
+* crc1 with a squared-matrix operator.)
+*/
+
+static ULG crc32_combine(ULG crc1, ULG crc2, DWORD len2)
+{
+	ULG even[32], odd[32], row;
+
+	if (!len2) return crc1;
+
+	// Operator for one zero bit
+	odd[0] = 0xedb88320L;
+	row = 1;
+	for (int n = 1; n < 32; n++, row <<= 1) odd[n] = row;
+
+	gf2_matrix_square(even, odd);	// two zero bits
+	gf2_matrix_square(odd, even);	// four zero bits
+
+	// Apply len2 zero bytes to crc1 (the first square gives the operator for one zero byte)
+	do
+	{
+		gf2_matrix_square(even, odd);
+		if (len2 & 1) crc1 = gf2_matrix_times(even, crc1);
+		if (!(len2 >>= 1)) break;
+		gf2_matrix_square(odd, even);
+		if (len2 & 1) crc1 = gf2_matrix_times(odd, crc1);
+	} while (len2 >>= 1);
+
+	return crc1 ^ crc2;
 }
 
 static void update_keys(unsigned long *keys, char c)
@@ -7591,12 +8049,15 @@ static DWORD closeSource(register TZIP *tzip)
 
 
 
-/********************* ideflate() *********************
-* Adds the current source to the ZIP file, using the
-* deflate method.
+/********************* initState() *********************
+* Gets the TZIP's TSTATE (allocating it upon first use),
+* and resets it for compressing a new source.
+*
+* RETURNS: The TSTATE, or 0 if it can't be allocated (in
+* which case tzip->lasterr = ZR_NOALLOC).
 */
 
-static void ideflate(TZIP *tzip, TZIPFILEINFO *zfi)
+static TSTATE * initState(register TZIP *tzip)
 {
 	register TSTATE		*state;
 
@@ -7641,24 +8102,372 @@ static void ideflate(TZIP *tzip, TZIPFILEINFO *zfi)
 #ifdef _DEBUG
 		state->bs.bits_sent = 0;
 #endif
+	}
+	else
+		tzip->lasterr = ZR_NOALLOC;
+
+	return(state);
+}
+
+
+
+
+
+// ======================= Worker threads ========================
+
+/********************* deflateJob() *********************
+* Compresses a TZIPJOB. Called by a worker thread, with
+* its own TZIP which stands in for the real one.
+*/
+
+static void deflateJob(register TZIP *tzip, register TZIPJOB *job)
+{
+	register TSTATE		*state;
+
+	// Read the source from memory, and write to the job's output buffer
+	tzip->flags = TZIP_SRCMEMORY | TZIP_DESTMEMORY;
+	tzip->source = (HANDLE)job->in;
+	tzip->lenin = job->len;
+	tzip->destination = (HANDLE)job->out;
+	tzip->mapsize = job->outsize;
+	tzip->posin = tzip->crc = tzip->lasterr = 0;
+	tzip->opos = tzip->totalRead = tzip->csize = 0;
+
+	// As for ideflate(), whose TZIPFILEINFO starts out zeroed
+	job->att = job->flg = 0;
+	if ((state = initState(tzip)))
+	{
+		ct_init(state, &job->att);
+		lm_init(state, state->level, &job->flg, job->dict, job->dictlen);
+		if (!tzip->lasterr) deflate(state, job->last);
+	}
+
+	job->outlen = (DWORD)tzip->opos;
+	job->crc = tzip->crc;
+	job->lasterr = tzip->lasterr;
+}
+
+static DWORD WINAPI zipWorker(LPVOID param)
+{
+	register TZIPPOOL	*pool;
+	register TZIPJOB	*job;
+	TZIP				*tzip;
+
+	pool = (TZIPPOOL *)param;
+	if ((tzip = (TZIP *)GlobalAlloc(GMEM_FIXED, sizeof(TZIP))))
+		ZeroMemory(tzip, sizeof(TZIP) - 16384);
+
+	for (;;)
+	{
+		WaitForSingleObject(pool->wake, INFINITE);
+		if (pool->stop) break;
+
+		EnterCriticalSection(&pool->lock);
+		if ((job = pool->head) && !(pool->head = job->qnxt)) pool->tail = 0;
+		LeaveCriticalSection(&pool->lock);
+
+		if (job)
+		{
+			if (tzip) deflateJob(tzip, job);
+			else job->lasterr = ZR_NOALLOC;
+			SetEvent(job->done);
+		}
+	}
+
+	if (tzip)
+	{
+		if (tzip->state) GlobalFree(tzip->state);
+		GlobalFree(tzip);
+	}
+	return(0);
+}
+
+/********************* freePool() *********************
+* Stops the worker threads and frees the TZIPPOOL. All
+* jobs must have been waited for.
+*/
+
+static void freePool(register TZIPPOOL *pool)
+{
+	register DWORD	i;
+
+	pool->stop = 1;
+	if (pool->count)
+	{
+		ReleaseSemaphore(pool->wake, pool->count, 0);
+		WaitForMultipleObjects(pool->count, pool->threads, TRUE, INFINITE);
+		for (i = 0; i < pool->count; i++) CloseHandle(pool->threads[i]);
+	}
+	CloseHandle(pool->wake);
+	DeleteCriticalSection(&pool->lock);
+	GlobalFree(pool);
+}
+
+/********************* getPool() *********************
+* Gets the TZIP's worker threads, starting them upon first
+* use (one per processor).
+*
+* RETURNS: The TZIPPOOL, or 0 if there's only one processor
+* or the threads can't be started.
+*/
+
+static TZIPPOOL * getPool(register TZIP *tzip)
+{
+	register TZIPPOOL	*pool;
+	SYSTEM_INFO			si;
+	DWORD				count, id;
+
+	if ((pool = tzip->pool) || (tzip->flags & TZIP_NOPOOL)) return(pool);
+
+	GetSystemInfo(&si);
+	if ((count = si.dwNumberOfProcessors) > ZIP_MAX_THREADS) count = ZIP_MAX_THREADS;
+	if (count > 1 && (pool = (TZIPPOOL *)GlobalAlloc(GPTR, sizeof(TZIPPOOL))))
+	{
+		if (!(pool->wake = CreateSemaphore(0, 0, 0x7FFFFFFF, 0)))
+			GlobalFree(pool);
+		else
+		{
+			InitializeCriticalSection(&pool->lock);
+			while (pool->count < count && (pool->threads[pool->count] = CreateThread(0, 0, zipWorker, pool, 0, &id)))
+				++pool->count;
+			if (pool->count > 1) return(tzip->pool = pool);
+			freePool(pool);
+		}
+	}
+
+	// Don't try again for this TZIP
+	tzip->flags |= TZIP_NOPOOL;
+	return(0);
+}
+
+/********************* submitJob() *********************
+* Queues a job for the next free worker thread.
+*/
+
+static void submitJob(register TZIPPOOL *pool, register TZIPJOB *job)
+{
+	job->qnxt = 0;
+	EnterCriticalSection(&pool->lock);
+	if (pool->tail) pool->tail->qnxt = job;
+	else pool->head = job;
+	pool->tail = job;
+	LeaveCriticalSection(&pool->lock);
+	ReleaseSemaphore(pool->wake, 1, 0);
+}
+
+
+
+
+
+/********************* readChunk() *********************
+* Sets up a job for the next ZIP_CHUNK_SIZE bytes of the
+* source, with the tail end of the previous chunk (if any)
+* as its dictionary. A memory source is used in place, but
+* other sources are read into job->data.
+*/
+
+static void readChunk(register TZIP *tzip, register TZIPJOB *job, TZIPJOB *prev)
+{
+	DWORD	bytes;
+
+	job->dictlen = 0;
+	if (prev) job->dictlen = prev->len < WSIZE ? prev->len : WSIZE;
+
+	if (tzip->flags & TZIP_SRCMEMORY)
+	{
+		job->dict = prev ? prev->in + prev->len - job->dictlen : 0;
+		job->in = (const UCH *)tzip->source + tzip->posin;
+		if ((job->len = tzip->lenin - tzip->posin) > ZIP_CHUNK_SIZE) job->len = ZIP_CHUNK_SIZE;
+		tzip->posin += job->len;
+	}
+	else
+	{
+		// The previous chunk is only read by its worker, so we can copy from it even if it's underway
+		job->dict = (const UCH *)job->data + WSIZE - job->dictlen;
+		if (prev) CopyMemory(job->data + WSIZE - job->dictlen, prev->in + prev->len - job->dictlen, job->dictlen);
+		job->in = (const UCH *)job->data + WSIZE;
+
+		// A pipe may give us less than we ask for, so keep reading until the chunk is full
+		job->len = 0;
+		if (tzip->flags & TZIP_OPTION_ABORT) tzip->lasterr = ZR_ABORT;
+		else while (job->len < ZIP_CHUNK_SIZE)
+		{
+			if (!ReadFile(tzip->source, job->data + WSIZE + job->len, ZIP_CHUNK_SIZE - job->len, &bytes, 0))
+			{
+				tzip->lasterr = ZR_READ;
+				break;
+			}
+			if (!bytes) break;
+			job->len += bytes;
+		}
+	}
+	if (!job->dictlen) job->dict = 0;
+}
+
+/********************* writeJob() *********************
+* Waits for a worker to finish a chunk of the current
+* source, and writes out its compressed data.
+*/
+
+static void writeJob(register TZIP *tzip, register TZIPJOB *job, TZIPFILEINFO *zfi)
+{
+	WaitForSingleObject(job->done, INFINITE);
+	ResetEvent(job->done);
+	if (job->lasterr && !tzip->lasterr) tzip->lasterr = job->lasterr;
+
+	writeDestination(tzip, job->out, job->outlen);
+	tzip->csize += job->outlen;
+	tzip->crc = crc32_combine(tzip->crc, job->crc, job->len);
+
+	// The first chunk determines the file type, as the first block does for ideflate()
+	if (!tzip->totalRead) zfi->att = job->att;
+	zfi->flg |= job->flg;
+	tzip->totalRead += job->len;
+}
+
+static void freeJobs(TZIPJOB *jobs, DWORD count)
+{
+	register DWORD	i;
+
+	for (i = 0; i < count; i++)
+	{
+		if (jobs[i].done) CloseHandle(jobs[i].done);
+		if (jobs[i].out) GlobalFree(jobs[i].out);
+	}
+	GlobalFree(jobs);
+}
+
+/********************* pdeflate() *********************
+* Compresses the current source to the ZIP file using all
+* worker threads, a chunk at a time. The chunks' output is
+* written out in order as they finish, while we read ahead.
+*
+* RETURNS: 0 if the source is too small to be worth it (or
+* the threads/memory aren't available), and nothing was done.
+*/
+
+static BOOL pdeflate(register TZIP *tzip, TZIPFILEINFO *zfi)
+{
+	register TZIPJOB	*job;
+	TZIPJOB				*jobs, *next;
+	TZIPPOOL			*pool;
+	DWORD				count, first, used, size;
+
+	// A pipe's size is unknown (-1), so assume it's big enough
+	if (tzip->isize < 2 * ZIP_CHUNK_SIZE || !(pool = getPool(tzip))) return(0);
+
+	// Enough jobs to keep every thread busy while we read ahead and write out the finished ones
+	count = pool->count * 2 + 2;
+	size = ZIP_OUT_SIZE(ZIP_CHUNK_SIZE);
+	if (!(tzip->flags & TZIP_SRCMEMORY)) size += WSIZE + ZIP_CHUNK_SIZE;
+	if (!(jobs = (TZIPJOB *)GlobalAlloc(GPTR, count * sizeof(TZIPJOB)))) return(0);
+	for (used = 0; used < count; used++)
+	{
+		job = &jobs[used];
+		if (!(job->out = (char *)GlobalAlloc(GMEM_FIXED, size)) || !(job->done = CreateEvent(0, TRUE, FALSE, 0)))
+		{
+			freeJobs(jobs, count);
+			return(0);
+		}
+		job->outsize = ZIP_OUT_SIZE(ZIP_CHUNK_SIZE);
+		job->data = job->out + job->outsize;
+	}
+
+	// If the source turns out to be empty, let ideflate() handle it
+	job = &jobs[0];
+	readChunk(tzip, job, 0);
+	if (!job->len && !tzip->lasterr)
+	{
+		freeJobs(jobs, count);
+		return(0);
+	}
+
+	first = used = 0;
+	if (job->len) for (;;)
+	{
+		// Make room to read the chunk after this one, writing out the oldest job if need be
+		if (used + 2 > count)
+		{
+			writeJob(tzip, &jobs[first], zfi);
+			if (++first == count) first = 0;
+			--used;
+		}
+		next = &jobs[(first + used + 1) % count];
+
+		// We know that this chunk ends the deflate stream only once we've tried reading the next
+		readChunk(tzip, next, job);
+		job->last = (unsigned char)(!next->len || tzip->lasterr);
+		submitJob(pool, job);
+		++used;
+		if (job->last) break;
+		job = next;
+	}
+
+	// Write out the remaining chunks
+	while (used--)
+	{
+		writeJob(tzip, &jobs[first], zfi);
+		if (++first == count) first = 0;
+	}
+
+	freeJobs(jobs, count);
+	return(1);
+}
+
+
+
+
+
+/********************* ideflate() *********************
+* Adds the current source to the ZIP file, using the
+* deflate method.
+*/
+
+static void ideflate(TZIP *tzip, TZIPFILEINFO *zfi)
+{
+	register TSTATE		*state;
+
+	// Split a big source among the worker threads
+	if (pdeflate(tzip, zfi)) return;
+
+	if ((state = initState(tzip)))
+	{
 		ct_init(state, &zfi->att);
 
-		lm_init(state, state->level, &zfi->flg);
+		lm_init(state, state->level, &zfi->flg, 0, 0);
 		if (!tzip->lasterr)
 		{
 			// Compress the source into the zip
 			//			if (state->level <= 3) deflate_fast(state);
-			deflate(state);
+			deflate(state, 1);
 		}
 	}
-	else
-		tzip->lasterr = ZR_NOALLOC;
 }
 
 
 
 
 
+/********************** icopy() *********************
+* Adds the current source to the ZIP file by copying the
+* data that a worker thread already deflated (see queueSrc()).
+*/
+
+static void icopy(register TZIP *tzip, TZIPFILEINFO *zfi)
+{
+	writeDestination(tzip, tzip->job->out, tzip->job->outlen);
+	tzip->csize = tzip->job->outlen;
+	tzip->crc = tzip->job->crc;
+	tzip->totalRead = tzip->job->len;
+	zfi->att = tzip->job->att;
+	zfi->flg |= tzip->job->flg;
+}
+
+
+
+
+
+
 /********************** istore() *********************
 * Adds the current source to the ZIP file, using the
 * store method.
@@ -7730,6 +8539,7 @@ static BOOL checkSuffix(const char *fn)
 #define ZIP_FOLDER		0x00000008
 #define ZIP_UNICODE		0x00000010
 #define ZIP_RAW			0x00000020
+#define ZIP_JOB			0x00000040	// Internal. See queueSrc()
 
 /******************** hasExtension() *******************
 * Returns 1 if there's an extension on a filename, or
@@ -7806,6 +8616,7 @@ static DWORD addSrc(register TZIP *tzip, const void *destname, const void *src,
 	// Re-init some stuff potentially left over from a previous addSrc()
 	tzip->ooffset = tzip->totalRead = tzip->csize = 0;
 	tzip->crc = 0;
+	tzip->job = 0;
 	tzip->flags &= ~(TZIP_SRCCANSEEK | TZIP_SRCCLOSEFH | TZIP_SRCMEMORY | TZIP_ENCRYPT);
 
 	// ==================== Get the source (to compress to the ZIP) ===================
@@ -7849,6 +8660,21 @@ static DWORD addSrc(register TZIP *tzip, const void *destname, const void *src,
 		break;
 	}
 
+	// Zipping a file that a worker thread has already compressed?
+	case ZIP_JOB:
+	{
+		tzip->job = (TZIPJOB *)src;
+		tzip->source = tzip->job->source;
+		tzip->job->source = 0;
+		if ((passex = srcHandleInfo(tzip, 0, &times)) == ZR_OK)
+		{
+			tzip->flags |= TZIP_SRCCLOSEFH;
+			goto chktime;
+		}
+		CloseHandle(tzip->source);
+		goto badopen;
+	}
+
 	// Zipping a folder name?
 	case ZIP_FOLDER:
 	{
@@ -8073,7 +8899,9 @@ compress:
 	// Compress the source contents to the zip file
 	if (tzip->source)
 	{
-		if (method == DEFLATE)
+		if (tzip->job)
+			icopy(tzip, zfi);
+		else if (method == DEFLATE)
 			ideflate(tzip, zfi);
 		else
 			istore(tzip);
@@ -8181,6 +9009,133 @@ compress:
 
 
 
+/*********************** flushSrc() *********************
+* Writes out the files queued by queueSrc(), oldest first,
+* until no more than "keep" remain queued.
+*
+* RETURNS: ZR_OK if success, or the first error. After an
+* error, the rest of the files are still waited for, but
+* then discarded.
+*/
+
+static DWORD flushSrc(register TZIP *tzip, DWORD keep)
+{
+	register TZIPJOB	*job;
+	DWORD				result, err;
+
+	result = ZR_OK;
+	while (tzip->npending > keep)
+	{
+		job = tzip->pending;
+		if (!(tzip->pending = job->nxt)) tzip->lastpending = 0;
+		--tzip->npending;
+
+		WaitForSingleObject(job->done, INFINITE);
+		if (!(err = job->lasterr) && !result)
+			err = addSrc(tzip, job->name, job, 0, ZIP_JOB | job->flags);
+		if (!result) result = err;
+
+		// addSrc() takes over the source handle, but not if we skipped it
+		if (job->source) CloseHandle(job->source);
+		CloseHandle(job->done);
+		GlobalFree(job);
+
+		// After an error, discard the rest
+		if (result) keep = 0;
+	}
+	return(result);
+}
+
+/*********************** queueSrc() *********************
+* Adds a file (for ZipAddDir()). If it's small enough, it's
+* read into memory and queued for a worker thread to
+* compress in its entirety, while we go on to read more
+* files. The queued files are written out to the ZIP
+* archive, in order, by flushSrc(). Otherwise, the file is
+* added by addSrc() (after the queued files).
+*
+* flags = ZIP_FILENAME, and perhaps ZIP_UNICODE.
+*/
+
+static DWORD queueSrc(register TZIP *tzip, const void *destname, const void *src, DWORD flags)
+{
+	register TZIPJOB	*job;
+	TZIPPOOL			*pool;
+	HANDLE				fh;
+	DWORD				size, high, read;
+	char				name[MAX_PATH];
+
+	// GZIP format allows only one file, so don't bother
+	if ((tzip->flags & (TZIP_OPTION_GZIP | TZIP_DONECENTRALDIR)) || !(pool = getPool(tzip))) goto add;
+
+	// A name that's too long, or of an already compressed file, must be left to addSrc()
+	if (flags & ZIP_UNICODE)
+	{
+		if (lstrlenW((const WCHAR *)destname) >= MAX_PATH ||
+			!WideCharToMultiByte(CP_UTF8, 0, (const WCHAR *)destname, -1, name, MAX_PATH, 0, 0)) goto add;
+	}
+	else if (lstrlenA((const char *)destname) >= MAX_PATH) goto add;
+	else lstrcpyA(name, (const char *)destname);
+	if (checkSuffix(name)) goto add;
+
+	if (flags & ZIP_UNICODE)
+		fh = CreateFileW((const WCHAR *)src, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+	else
+		fh = CreateFileA((const char *)src, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+	if (fh == INVALID_HANDLE_VALUE) goto add;
+
+	// A bigger file is split among the threads by ideflate(), and an empty one needs no compressing
+	size = GetFileSize(fh, &high);
+	if (size == INVALID_FILE_SIZE || high || !size || size >= 2 * ZIP_CHUNK_SIZE ||
+		!(job = (TZIPJOB *)GlobalAlloc(GPTR, sizeof(TZIPJOB) + size + ZIP_OUT_SIZE(size))))
+		goto close;
+	if (!(job->done = CreateEvent(0, TRUE, FALSE, 0)))
+	{
+		GlobalFree(job);
+		goto close;
+	}
+
+	// Read the whole file, right after the TZIPJOB, and put the compressed output after that
+	job->data = (char *)(job + 1);
+	if (!ReadFile(fh, job->data, size, &read, 0) || read != size)
+	{
+		CloseHandle(job->done);
+		GlobalFree(job);
+	close:
+		CloseHandle(fh);
+	add:
+		// Keep the files in order
+		if ((read = flushSrc(tzip, 0))) return(read);
+		return(addSrc(tzip, destname, src, 0, flags));
+	}
+	// srcHandleInfo() expects the file to be at its start
+	SetFilePointer(fh, 0, 0, FILE_BEGIN);
+	job->in = (const UCH *)job->data;
+	job->len = size;
+	job->out = job->data + size;
+	job->outsize = ZIP_OUT_SIZE(size);
+	job->last = 1;
+	job->source = fh;
+	job->flags = flags & ZIP_UNICODE;
+	if (flags & ZIP_UNICODE)
+		lstrcpyW(job->name, (const WCHAR *)destname);
+	else
+		lstrcpyA((char *)job->name, (const char *)destname);
+
+	submitJob(pool, job);
+	if (tzip->lastpending) tzip->lastpending->nxt = job;
+	else tzip->pending = job;
+	tzip->lastpending = job;
+	++tzip->npending;
+
+	// Enough to keep every thread busy, without holding too many files in memory
+	return(flushSrc(tzip, pool->count * 2));
+}
+
+
+
+
+
 /*********************** searchDirW() *********************
 * This recursively searches for files to add.
 *
@@ -8195,14 +9150,18 @@ compress:
 * offset = WCHAR offset to the part of "path" that is skipped when
 *			saving the name to the ZIP archive.
 *
+* prefix = If not 0, this is prepended to the name saved to the
+*			ZIP archive.
+*
 * RETURNS: 1 if continue or 0 to abort.
 *
 * NOTE: "path" may be altered upon return.
 */
 
-static DWORD searchDirW(TZIP *tzip, WCHAR *path, unsigned long size, unsigned long offset, WIN32_FIND_DATAW *data)
+static DWORD searchDirW(TZIP *tzip, WCHAR *path, unsigned long size, unsigned long offset, WIN32_FIND_DATAW *data, const WCHAR *prefix)
 {
 	register HANDLE			fh;
+	WCHAR					name[MAX_PATH];
 
 	// Append "\*.*" to PathNameBuffer[]. We search all items in this one directory
 	lstrcpyW(&path[size], &AllFilesStrW[0]);
@@ -8226,14 +9185,20 @@ static DWORD searchDirW(TZIP *tzip, WCHAR *path, unsigned long size, unsigned lo
 				if (data->cFileName[0] != '.' || (data->cFileName[1] && data->cFileName[1] != '.'))
 				{
 					// Search this one subdir (and *its* subdirs recursively)
-					if ((data->nFileSizeHigh = searchDirW(tzip, path, len + size + 1, offset, data)))
+					if ((data->nFileSizeHigh = searchDirW(tzip, path, len + size + 1, offset, data, prefix)))
 					bad:					return(data->nFileSizeHigh);
 				}
 			}
 			else
 			{
 				// Zip this file
-				if ((data->nFileSizeHigh = addSrc(tzip, (path + offset), path, 0, ZIP_FILENAME | ZIP_UNICODE))) goto bad;
+				if (prefix)
+				{
+					len = lstrlenW(prefix);
+					lstrcpynW(name, prefix, MAX_PATH);
+					lstrcpynW(name + len, path + offset, MAX_PATH - len);
+				}
+				if ((data->nFileSizeHigh = queueSrc(tzip, prefix ? name : (path + offset), path, ZIP_FILENAME | ZIP_UNICODE))) goto bad;
 			}
 
 			// Another file or subdir?
@@ -8260,14 +9225,18 @@ static DWORD searchDirW(TZIP *tzip, WCHAR *path, unsigned long size, unsigned lo
 * offset = Char offset to the part of "path" that is skipped when
 *			saving the name to the ZIP archive.
 *
+* prefix = If not 0, this is prepended to the name saved to the
+*			ZIP archive.
+*
 * RETURNS: 1 if continue or 0 to abort.
 *
 * NOTE: "path" may be altered upon return.
 */
 
-static DWORD searchDirA(TZIP *tzip, char *path, unsigned long size, unsigned long offset, WIN32_FIND_DATAA *data)
+static DWORD searchDirA(TZIP *tzip, char *path, unsigned long size, unsigned long offset, WIN32_FIND_DATAA *data, const char *prefix)
 {
 	register HANDLE			fh;
+	char					name[MAX_PATH];
 
 	// Append "\*.*" to PathNameBuffer[]. We search all items in this one directory
 	lstrcpyA(&path[size], &AllFilesStrA[0]);
@@ -8291,14 +9260,20 @@ static DWORD searchDirA(TZIP *tzip, char *path, unsigned long size, unsigned lon
 				if (data->cFileName[0] != '.' || (data->cFileName[1] && data->cFileName[1] != '.'))
 				{
 					// Search this one subdir (and *its* subdirs recursively)
-					if ((data->nFileSizeHigh = searchDirA(tzip, path, len + size + 1, offset, data)))
+					if ((data->nFileSizeHigh = searchDirA(tzip, path, len + size + 1, offset, data, prefix)))
 					bad:					return(data->nFileSizeHigh);
 				}
 			}
 			else
 			{
 				// Zip this file
-				if ((data->nFileSizeHigh = addSrc(tzip, (path + offset), path, 0, ZIP_FILENAME))) goto bad;
+				if (prefix)
+				{
+					len = lstrlenA(prefix);
+					lstrcpynA(name, prefix, MAX_PATH);
+					lstrcpynA(name + len, path + offset, MAX_PATH - len);
+				}
+				if ((data->nFileSizeHigh = queueSrc(tzip, prefix ? name : (path + offset), path, ZIP_FILENAME))) goto bad;
 			}
 
 			// Another file or subdir?
@@ -8393,6 +9368,15 @@ DWORD WINAPI ZipAddFolderW(HZIP tzip, const WCHAR *destname)
 	return(addSrc((TZIP *)tzip, (void *)destname, 0, 0, ZIP_FOLDER | ZIP_UNICODE));
 }
 
+// Writes out any files still queued by searchDir*(). RETURNS: "result", or else the error from that
+static DWORD endDir(TZIP *tzip, DWORD result)
+{
+	DWORD	err;
+
+	err = flushSrc(tzip, 0);
+	return(result ? result : err);
+}
+
 static unsigned int replace_slashesA(char *to, const char *from)
 {
 	register char	chr;
@@ -8434,7 +9418,7 @@ DWORD WINAPI ZipAddDirA(HZIP tzip, const char *destname, DWORD offset)
 	if ((data.nFileSizeHigh = replace_slashesA(&buffer[0], destname)) &&
 		buffer[data.nFileSizeHigh - 1] == '\\') buffer[--data.nFileSizeHigh] = 0;
 	if (offset == (DWORD)-1) offset = data.nFileSizeHigh + 1;
-	return(searchDirA((TZIP *)tzip, (char *)&buffer[0], data.nFileSizeHigh, offset, &data));
+	return(endDir((TZIP *)tzip, searchDirA((TZIP *)tzip, (char *)&buffer[0], data.nFileSizeHigh, offset, &data, 0)));
 }
 
 DWORD WINAPI ZipAddDirW(HZIP tzip, const WCHAR *destname, DWORD offset)
@@ -8447,7 +9431,61 @@ DWORD WINAPI ZipAddDirW(HZIP tzip, const WCHAR *destname, DWORD offset)
 	if ((data.nFileSizeHigh = replace_slashesW((short*)&buffer[0], (const short*)destname)) &&
 		buffer[data.nFileSizeHigh - 1] == '\\') buffer[--data.nFileSizeHigh] = 0;
 	if (offset == (DWORD)-1) offset = data.nFileSizeHigh + 1;
-	return(searchDirW((TZIP *)tzip, (WCHAR *)&buffer[0], data.nFileSizeHigh, offset, &data));
+	return(endDir((TZIP *)tzip, searchDirW((TZIP *)tzip, (WCHAR *)&buffer[0], data.nFileSizeHigh, offset, &data, 0)));
+}
+
+/*********************** ZipAddTree() *********************
+* Adds a folder entry named "destname" (if not empty), and
+* then all files in "dir" and its sub-directories, with
+* their names relative to "dir" stored under "destname".
+*/
+
+DWORD WINAPI ZipAddTreeA(HZIP tzip, const char *destname, const char *dir)
+{
+	WIN32_FIND_DATAA	data;
+	char				buffer[MAX_PATH];
+	char				prefix[MAX_PATH];
+	DWORD				len;
+
+	if (IsBadReadPtr(tzip, 1) || !dir || !*dir || lstrlenA(dir) >= MAX_PATH) return(ZR_ARGS);
+
+	len = 0;
+	if (destname && *destname)
+	{
+		if ((len = lstrlenA(destname)) >= MAX_PATH - 1) return(ZR_ARGS);
+		if ((data.nFileSizeHigh = addSrc((TZIP *)tzip, (void *)destname, 0, 0, ZIP_FOLDER))) return(data.nFileSizeHigh);
+		lstrcpyA(prefix, destname);
+		if (prefix[len - 1] != '/' && prefix[len - 1] != '\\') prefix[len++] = '/';
+		prefix[len] = 0;
+	}
+
+	if ((data.nFileSizeHigh = replace_slashesA(&buffer[0], dir)) &&
+		buffer[data.nFileSizeHigh - 1] == '\\') buffer[--data.nFileSizeHigh] = 0;
+	return(endDir((TZIP *)tzip, searchDirA((TZIP *)tzip, (char *)&buffer[0], data.nFileSizeHigh, data.nFileSizeHigh + 1, &data, len ? prefix : 0)));
+}
+
+DWORD WINAPI ZipAddTreeW(HZIP tzip, const WCHAR *destname, const WCHAR *dir)
+{
+	WIN32_FIND_DATAW	data;
+	WCHAR				buffer[MAX_PATH];
+	WCHAR				prefix[MAX_PATH];
+	DWORD				len;
+
+	if (IsBadReadPtr(tzip, 1) || !dir || !*dir || lstrlenW(dir) >= MAX_PATH) return(ZR_ARGS);
+
+	len = 0;
+	if (destname && *destname)
+	{
+		if ((len = lstrlenW(destname)) >= MAX_PATH - 1) return(ZR_ARGS);
+		if ((data.nFileSizeHigh = addSrc((TZIP *)tzip, (void *)destname, 0, 0, ZIP_FOLDER | ZIP_UNICODE))) return(data.nFileSizeHigh);
+		lstrcpyW(prefix, destname);
+		if (prefix[len - 1] != '/' && prefix[len - 1] != '\\') prefix[len++] = '/';
+		prefix[len] = 0;
+	}
+
+	if ((data.nFileSizeHigh = replace_slashesW((short*)&buffer[0], (const short*)dir)) &&
+		buffer[data.nFileSizeHigh - 1] == '\\') buffer[--data.nFileSizeHigh] = 0;
+	return(endDir((TZIP *)tzip, searchDirW((TZIP *)tzip, (WCHAR *)&buffer[0], data.nFileSizeHigh, data.nFileSizeHigh + 1, &data, len ? prefix : 0)));
 }
 
 
@@ -8506,6 +9544,9 @@ out:
 
 static void free_tzip(TZIP *tzip)
 {
+	// Stop the worker threads
+	if (tzip->pool) freePool(tzip->pool);
+
 	// Free various buffers
 	if (tzip->state) GlobalFree(tzip->state);
 	if (tzip->encbuf) GlobalFree(tzip->encbuf);
@@ -420,6 +420,19 @@ extern "C" {
 	typedef DWORD WINAPI ZipAddFolderPtr(HZIP, const char *);
 #endif
 
+	// Function for adding a folder entry and all files in a directory (recursively) beneath it
+	DWORD WINAPI ZipAddTreeW(HZIP, const WCHAR *, const WCHAR *);
+	DWORD WINAPI ZipAddTreeA(HZIP, const char *, const char *);
+#ifdef UNICODE
+#define ZipAddTree ZipAddTreeW
+#define ZIPADDTREENAME "ZipAddTreeW"
+	typedef DWORD WINAPI ZipAddTreePtr(HZIP, const WCHAR *, const WCHAR *);
+#else
+#define ZipAddTree ZipAddTreeA
+#define ZIPADDTREENAME "ZipAddTreeA"
+	typedef DWORD WINAPI ZipAddTreePtr(HZIP, const char *, const char *);
+#endif
+
 	// Function to get a pointer to the ZIP archive created in memory by ZipCreateBuffer(0, len)
 	DWORD WINAPI ZipGetMemory(HZIP, void **, unsigned long *, HANDLE *);
 #define ZIPGETMEMORYNAME "ZipGetMemory"
@@ -443,6 +456,12 @@ extern "C" {
 #define TZIP_OPTION_GZIP	0x80000000
 #define TZIP_OPTION_ABORT	0x40000000
 
+	// Function to compute the CRC-32 of a buffer, as stored in ZIP archives. Pass 0 to begin,
+	// or the result of a previous call to continue the checksum over consecutive buffers.
+	DWORD WINAPI ZipCrc32(DWORD, const void *, DWORD);
+#define ZIPCRC32NAME "ZipCrc32"
+	typedef DWORD WINAPI ZipCrc32Ptr(DWORD, const void *, DWORD);
+
 	// Function to get an appropriate error message for a given error code return by Zip functions
 	DWORD WINAPI ZipFormatMessageW(DWORD, WCHAR *, DWORD);
 	DWORD WINAPI ZipFormatMessageA(DWORD, char *, DWORD);
@@ -4,21 +4,227 @@
 #include "util.h"
 
 #ifdef _WIN32
-LPCWSTR StringUTF8ToWChar(LPCSTR sUTF8, CStringW &sWChar, int iChars/* = -1*/)
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#define STRINGCONV_SSE2
+#ifdef _M_X64
+#define HasSSE2() true // All x64 processors support SSE2.
+#else
+static bool HasSSE2()
 {
-	if (!sUTF8)
-		return NULL;
+	static int sHasSSE2 = -1; // Races are harmless since every thread computes the same value.
+	if (sHasSSE2 == -1)
+		sHasSSE2 = IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE) ? 1 : 0;
+	return sHasSSE2 != 0;
+}
+#endif
+#endif
 
-	sWChar.Empty();
-	int iLen = MultiByteToWideChar(CP_UTF8, 0, sUTF8, iChars, NULL, 0);
-	if (iLen > 0) {
-		LPWSTR sBuf = sWChar.GetBufferSetLength(iLen);
-		iLen = MultiByteToWideChar(CP_UTF8, 0, sUTF8, iChars, sBuf, iLen);
-		sWChar.ReleaseBufferSetLength(sBuf[iLen - 1] ? iLen : iLen - 1);
-		return (iLen > 0) ? sWChar.GetString() : NULL;
+size_t WidenASCII(LPWSTR aDst, LPCSTR aSrc, size_t aLen, bool aStopAtEOL/* = false*/)
+// aDst may be NULL to only count the characters.
+{
+	size_t i = 0;
+#ifdef STRINGCONV_SSE2
+	if (HasSSE2())
+	{
+		const __m128i zero = _mm_setzero_si128(), cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+		for ( ; i + 16 <= aLen; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(aSrc + i));
+			int stop = _mm_movemask_epi8(v); // Bit n is set if byte n has its high bit set, i.e. is non-ASCII.
+			if (aStopAtEOL)
+				stop |= _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+			if (stop)
+				break; // Let the loop below copy the part of this block which precedes the stop char.
+			if (aDst)
+			{
+				_mm_storeu_si128((__m128i *)(aDst + i), _mm_unpacklo_epi8(v, zero));
+				_mm_storeu_si128((__m128i *)(aDst + i + 8), _mm_unpackhi_epi8(v, zero));
+			}
+		}
+	}
+#endif
+	for ( ; i < aLen; ++i)
+	{
+		BYTE ch = (BYTE)aSrc[i];
+		if ((ch & 0x80) || aStopAtEOL && (ch == '\r' || ch == '\n'))
+			break;
+		if (aDst)
+			aDst[i] = ch;
+	}
+	return i;
+}
+
+size_t NarrowASCII(LPSTR aDst, LPCWSTR aSrc, size_t aLen, bool aStopAtEOL/* = false*/)
+// aDst may be NULL to only count the characters.
+{
+	size_t i = 0;
+#ifdef STRINGCONV_SSE2
+	if (HasSSE2())
+	{
+		const __m128i zero = _mm_setzero_si128(), non_ascii = _mm_set1_epi16((short)0xFF80)
+			, cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+		for ( ; i + 16 <= aLen; i += 16)
+		{
+			__m128i lo = _mm_loadu_si128((const __m128i *)(aSrc + i));
+			__m128i hi = _mm_loadu_si128((const __m128i *)(aSrc + i + 8));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(lo, hi), non_ascii), zero)) != 0xFFFF)
+				break;
+			__m128i v = _mm_packus_epi16(lo, hi); // Since all values are below 0x80, this just narrows them.
+			if (aStopAtEOL && _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf))))
+				break;
+			if (aDst)
+				_mm_storeu_si128((__m128i *)(aDst + i), v);
+		}
+	}
+#endif
+	for ( ; i < aLen; ++i)
+	{
+		WCHAR ch = aSrc[i];
+		if ((ch & ~0x7F) || aStopAtEOL && (ch == '\r' || ch == '\n'))
+			break;
+		if (aDst)
+			aDst[i] = (CHAR)ch;
+	}
+	return i;
+}
+
+size_t CopyToEOL(LPWSTR aDst, LPCWSTR aSrc, size_t aLen)
+{
+	size_t i = 0;
+#ifdef STRINGCONV_SSE2
+	if (HasSSE2())
+	{
+		const __m128i cr = _mm_set1_epi16('\r'), lf = _mm_set1_epi16('\n');
+		for ( ; i + 8 <= aLen; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *)(aSrc + i));
+			if (_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi16(v, cr), _mm_cmpeq_epi16(v, lf))))
+				break;
+			_mm_storeu_si128((__m128i *)(aDst + i), v);
+		}
 	}
+#endif
+	for ( ; i < aLen && aSrc[i] != '\r' && aSrc[i] != '\n'; ++i)
+		aDst[i] = aSrc[i];
+	return i;
+}
+
+static bool IsASCIISuperset(UINT aCodePage)
+// Returns true if bytes below 0x80 always stand for the corresponding ASCII characters, even when
+// they follow other bytes.  Text in such a code page can be split before any ASCII character.
+{
+	if (aCodePage == CP_UTF8 || aCodePage == 20127 // US-ASCII
+		|| aCodePage >= 1250 && aCodePage <= 1258 // Windows ANSI code pages other than the DBCS ones.
+		|| aCodePage >= 28591 && aCodePage <= 28605) // ISO 8859.
+		return true;
+	if (aCodePage == CP_ACP)
+	{
+		static int sSingleByteACP = -1;
+		if (sSingleByteACP == -1)
+		{
+			CPINFO info;
+			sSingleByteACP = GetCPInfo(CP_ACP, &info) && info.MaxCharSize == 1;
+		}
+		return sSingleByteACP != 0;
+	}
+	return false;
+}
 
-	return *sUTF8 != 0 ? sWChar.GetString() : NULL;
+// Runs of ASCII shorter than this are left in the surrounding run of non-ASCII text, so that text
+// with a few non-ASCII characters on every line doesn't result in many short calls to the API.
+#define MIN_ASCII_RUN 32
+
+template<typename CHAR_T, typename UCHAR_T>
+static size_t NonASCIIRunEnd(const CHAR_T *aSrc, size_t aPos, size_t aLen)
+// Caller has ensured aSrc[aPos] is non-ASCII.  Returns the position of the next run of ASCII
+// which is at least MIN_ASCII_RUN characters long, or aLen.
+{
+	size_t ascii_run = 0;
+	for (size_t end = aPos + 1; end < aLen; ++end)
+	{
+		if ((UCHAR_T)aSrc[end] >= 0x80)
+			ascii_run = 0;
+		else if (++ascii_run == MIN_ASCII_RUN)
+			return end + 1 - MIN_ASCII_RUN;
+	}
+	return aLen;
+}
+
+int FastMultiByteToWideChar(UINT aCodePage, DWORD aFlags, LPCSTR aSrc, int aSrcLen, LPWSTR aDst, int aDstLen)
+{
+	if (!aSrc || !aSrcLen || aDstLen < 0 || !IsASCIISuperset(aCodePage))
+		return MultiByteToWideChar(aCodePage, aFlags, aSrc, aSrcLen, aDst, aDstLen);
+	size_t src_len = aSrcLen < 0 ? strlen(aSrc) + 1 : (size_t)aSrcLen; // As with the API, -1 includes the null-terminator.
+	size_t pos = 0, dst_len = 0;
+	for (;;)
+	{
+		// If aDstLen is 0, the caller only wants the required size.
+		size_t room = aDstLen ? aDstLen - dst_len : src_len - pos;
+		size_t ascii = WidenASCII(aDstLen ? aDst + dst_len : NULL, aSrc + pos, min(src_len - pos, room));
+		pos += ascii;
+		dst_len += ascii;
+		if (pos == src_len)
+			return (int)dst_len;
+		if (aDstLen && (dst_len == (size_t)aDstLen || !(aSrc[pos] & 0x80)))
+		{
+			SetLastError(ERROR_INSUFFICIENT_BUFFER);
+			return 0;
+		}
+		size_t end = NonASCIIRunEnd<CHAR, BYTE>(aSrc, pos, src_len);
+		int converted = MultiByteToWideChar(aCodePage, aFlags, aSrc + pos, (int)(end - pos)
+			, aDstLen ? aDst + dst_len : NULL, aDstLen ? aDstLen - (int)dst_len : 0);
+		if (!converted)
+			return 0;
+		pos = end;
+		dst_len += converted;
+		if (pos == src_len)
+			return (int)dst_len;
+	}
+}
+
+int FastWideCharToMultiByte(UINT aCodePage, DWORD aFlags, LPCWSTR aSrc, int aSrcLen, LPSTR aDst, int aDstLen, LPCSTR aDefaultChar/* = NULL*/, LPBOOL aUsedDefaultChar/* = NULL*/)
+{
+	if (!aSrc || !aSrcLen || aDstLen < 0 || !IsASCIISuperset(aCodePage))
+		return WideCharToMultiByte(aCodePage, aFlags, aSrc, aSrcLen, aDst, aDstLen, aDefaultChar, aUsedDefaultChar);
+	if (aUsedDefaultChar)
+		*aUsedDefaultChar = FALSE;
+	size_t src_len = aSrcLen < 0 ? wcslen(aSrc) + 1 : (size_t)aSrcLen; // As with the API, -1 includes the null-terminator.
+	size_t pos = 0, dst_len = 0;
+	for (;;)
+	{
+		// If aDstLen is 0, the caller only wants the required size.
+		size_t room = aDstLen ? aDstLen - dst_len : src_len - pos;
+		size_t ascii = NarrowASCII(aDstLen ? aDst + dst_len : NULL, aSrc + pos, min(src_len - pos, room));
+		pos += ascii;
+		dst_len += ascii;
+		if (pos == src_len)
+			return (int)dst_len;
+		if (aDstLen && (dst_len == (size_t)aDstLen || !(aSrc[pos] & ~0x7F)))
+		{
+			SetLastError(ERROR_INSUFFICIENT_BUFFER);
+			return 0;
+		}
+		// Splitting before an ASCII char never separates a surrogate pair.
+		size_t end = NonASCIIRunEnd<WCHAR, WCHAR>(aSrc, pos, src_len);
+		BOOL used_default_char = FALSE;
+		int converted = WideCharToMultiByte(aCodePage, aFlags, aSrc + pos, (int)(end - pos)
+			, aDstLen ? aDst + dst_len : NULL, aDstLen ? aDstLen - (int)dst_len : 0
+			, aDefaultChar, aUsedDefaultChar ? &used_default_char : NULL);
+		if (!converted)
+			return 0;
+		if (used_default_char)
+			*aUsedDefaultChar = TRUE;
+		pos = end;
+		dst_len += converted;
+		if (pos == src_len)
+			return (int)dst_len;
+	}
+}
+
+LPCWSTR StringUTF8ToWChar(LPCSTR sUTF8, CStringW &sWChar, int iChars/* = -1*/)
+{
+	return StringCharToWChar(sUTF8, sWChar, iChars, CP_UTF8);
 }
 
 LPCWSTR StringCharToWChar(LPCSTR sChar, CStringW &sWChar, int iChars/* = -1*/, UINT codepage/* = CP_ACP*/)
@@ -27,10 +233,26 @@ LPCWSTR StringCharToWChar(LPCSTR sChar, CStringW &sWChar, int iChars/* = -1*/, U
 		return NULL;
 
 	sWChar.Empty();
-	int iLen = MultiByteToWideChar(codepage, 0, sChar, iChars, NULL, 0);
+	// No byte sequence converts to more UTF-16 code units than it has bytes, so try converting in
+	// a single pass rather than calling the API once to measure the result and again to convert.
+	int iMax = (iChars < 0) ? (int)strlen(sChar) + 1 : iChars;
+	if (iMax > 0) {
+		LPWSTR sBuf = sWChar.GetBufferSetLength(iMax);
+		int iLen = FastMultiByteToWideChar(codepage, 0, sChar, iChars, sBuf, iMax);
+		if (iLen > 0) {
+			sWChar.ReleaseBufferSetLength(sBuf[iLen - 1] ? iLen : iLen - 1);
+			return sWChar.GetString();
+		}
+		DWORD error = GetLastError(); // Before ReleaseBufferSetLength, which might change it.
+		sWChar.ReleaseBufferSetLength(0);
+		if (error != ERROR_INSUFFICIENT_BUFFER)
+			return (*sChar != 0) ? sWChar.GetString() : NULL;
+	}
+
+	int iLen = FastMultiByteToWideChar(codepage, 0, sChar, iChars, NULL, 0);
 	if (iLen > 0) {
 		LPWSTR sBuf = sWChar.GetBufferSetLength(iLen);
-		MultiByteToWideChar(codepage, 0, sChar, iChars, sBuf, iLen);
+		FastMultiByteToWideChar(codepage, 0, sChar, iChars, sBuf, iLen);
 		sWChar.ReleaseBufferSetLength(sBuf[iLen - 1] ? iLen : iLen - 1);
 		return (iLen > 0) ? sWChar.GetString() : NULL;
 	}
@@ -44,10 +266,10 @@ LPCSTR StringWCharToUTF8(LPCWSTR sWChar, CStringA &sUTF8, int iChars/* = -1*/)
 		return NULL;
 
 	sUTF8.Empty();
-	int iLen = WideCharToMultiByte(CP_UTF8, 0, sWChar, iChars, NULL, 0, NULL, NULL);
+	int iLen = FastWideCharToMultiByte(CP_UTF8, 0, sWChar, iChars, NULL, 0);
 	if (iLen > 0) {
 		LPSTR sBuf = sUTF8.GetBufferSetLength(iLen);
-		WideCharToMultiByte(CP_UTF8, 0, sWChar, iChars, sBuf, iLen, NULL, NULL);
+		FastWideCharToMultiByte(CP_UTF8, 0, sWChar, iChars, sBuf, iLen);
 		sUTF8.ReleaseBufferSetLength(sBuf[iLen - 1] ? iLen : iLen - 1);
 		return (iLen > 0) ? sUTF8.GetString() : NULL;
 	}
@@ -66,10 +288,10 @@ LPCSTR StringWCharToChar(LPCWSTR sWChar, CStringA &sChar, int iChars/* = -1*/, c
 		return NULL;
 
 	sChar.Empty();
-	int iLen = WideCharToMultiByte(codepage, WC_NO_BEST_FIT_CHARS, sWChar, iChars, NULL, 0, &chDef, NULL);
+	int iLen = FastWideCharToMultiByte(codepage, WC_NO_BEST_FIT_CHARS, sWChar, iChars, NULL, 0, &chDef, NULL);
 	if (iLen > 0) {
 		LPSTR sBuf = sChar.GetBufferSetLength(iLen);
-		WideCharToMultiByte(codepage, WC_NO_BEST_FIT_CHARS, sWChar, iChars, sBuf, iLen, &chDef, NULL);
+		FastWideCharToMultiByte(codepage, WC_NO_BEST_FIT_CHARS, sWChar, iChars, sBuf, iLen, &chDef, NULL);
 		sChar.ReleaseBufferSetLength(sBuf[iLen - 1] ? iLen : iLen - 1);
 		return (iLen > 0) ? sChar.GetString() : NULL;
 	}
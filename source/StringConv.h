@@ -12,6 +12,21 @@ LPCSTR StringCharToUTF8(LPCSTR sChar, CStringA &sUTF8, int iChars = -1, UINT cod
 LPCSTR StringWCharToChar(LPCWSTR sWChar, CStringA &sChar, int iChars = -1, char chDef = '?', UINT codepage = CP_ACP);
 LPCSTR StringUTF8ToChar(LPCSTR sUTF8, CStringA &sChar, int iChars = -1, char chDef = '?', UINT codepage = CP_ACP);
 
+// Drop-in replacements for MultiByteToWideChar and WideCharToMultiByte.  For UTF-8 and single-byte
+// code pages, runs of ASCII characters are converted directly (16 at a time where SSE2 is available)
+// and only the runs in between are passed to the API, so the result is the same as the API's.
+// Other code pages are passed straight to the API.
+int FastMultiByteToWideChar(UINT aCodePage, DWORD aFlags, LPCSTR aSrc, int aSrcLen, LPWSTR aDst, int aDstLen);
+int FastWideCharToMultiByte(UINT aCodePage, DWORD aFlags, LPCWSTR aSrc, int aSrcLen, LPSTR aDst, int aDstLen, LPCSTR aDefaultChar = NULL, LPBOOL aUsedDefaultChar = NULL);
+
+// Each of these copies leading ASCII characters from aSrc to aDst, stopping at the first non-ASCII
+// character (or \r or \n if aStopAtEOL is true), and returns the number of characters copied.
+// aDst may be NULL to only count them.
+size_t WidenASCII(LPWSTR aDst, LPCSTR aSrc, size_t aLen, bool aStopAtEOL = false);
+size_t NarrowASCII(LPSTR aDst, LPCWSTR aSrc, size_t aLen, bool aStopAtEOL = false);
+// Copies characters up to the first \r or \n and returns the number copied.
+size_t CopyToEOL(LPWSTR aDst, LPCWSTR aSrc, size_t aLen);
+
 LPCWSTR _StringDummyConvW(LPCWSTR sSrc, CStringW &sDest, int iChars = -1);
 LPCSTR _StringDummyConvA(LPCSTR sSrc, CStringA &sDest, int iChars = -1);
 
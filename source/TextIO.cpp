@@ -145,8 +145,56 @@ DWORD TextStream::Read(LPTSTR aBuf, DWORD aBufLen, int aNumLines)
 			}
 		}
 
+#ifdef UNICODE
+		LPBYTE utf8_bulk_end = NULL; // See below.
+#endif
 		for ( ; src < src_end && target_used < aBufLen; src += src_size)
 		{
+#ifdef UNICODE
+			// Copy or decode runs of characters which don't need EOL translation in bulk.  Anything
+			// else, including \r and \n, is handled one character at a time further below.
+			size_t room = aBufLen - target_used, run;
+			if (codepage == CP_UTF16)
+				run = CopyToEOL(aBuf + target_used, (LPCWSTR)src, min((size_t)(src_end - src) / sizeof(WCHAR), room));
+			else
+				run = WidenASCII(aBuf + target_used, (LPCSTR)src, min((size_t)(src_end - src), room), true);
+			if (run)
+			{
+				target_used += (DWORD)run;
+				src += run * chr_size;
+				src_size = 0; // src has already been advanced.
+				continue;
+			}
+			if (codepage == CP_UTF8 && *src >= 0x80 && src >= utf8_bulk_end)
+			{
+				// Decode the run of non-ASCII characters which starts here.  Since each byte produces at
+				// most one code unit, limiting the run to the remaining room ensures the result fits.
+				LPBYTE end = src + 1, limit = src + min((size_t)(src_end - src), room);
+				while (end < limit && *end >= 0x80)
+					++end;
+				if (end == limit)
+				{
+					// Don't let the run end partway through a character.
+					LPBYTE lead = end - 1;
+					for (int i = 0; i < 3 && lead > src && (*lead & 0xC0) == 0x80; ++i)
+						--lead;
+					int lead_size = (*lead & 0xE0) == 0xC0 ? 2 : (*lead & 0xF0) == 0xE0 ? 3 : (*lead & 0xF8) == 0xF0 ? 4 : 1;
+					if (lead + lead_size > end)
+						end = lead;
+				}
+				int decoded = (end > src) ? MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, (LPCSTR)src, (int)(end - src), aBuf + target_used, (int)room) : 0;
+				if (decoded)
+				{
+					target_used += decoded;
+					src = end;
+					src_size = 0; // src has already been advanced.
+					continue;
+				}
+				// The run is invalid or incomplete, so let the section below handle it one character
+				// at a time, without retrying the run for each character.
+				utf8_bulk_end = (end > src) ? end : src + 1;
+			}
+#endif
 			if (codepage == CP_UTF16)
 			{
 				src_size = sizeof(WCHAR); // Set default (currently never overridden).
@@ -455,7 +503,7 @@ DWORD TextStream::Write(LPCTSTR aBuf, DWORD aBufLen)
 	//	a 4-byte UTF-8 sequence
 	//	a UTF-16 surrogate pair
 	//	a carriage-return/newline pair
-	LPBYTE dst_end = mBuffer + TEXT_IO_BLOCK - 4;
+	LPBYTE dst_end = mBuffer + mBufferSize - 4;
 
 	for (src = aBuf, src_end = aBuf + aBufLen; ; )
 	{
@@ -470,6 +518,16 @@ DWORD TextStream::Write(LPCTSTR aBuf, DWORD aBufLen)
 		{
 			for ( ; src < src_end && !(*src & ~0x7F) && dst < dst_end; ++src)
 			{
+#ifdef UNICODE
+				// Narrow runs of ASCII other than \r and \n in bulk.
+				if (size_t run = NarrowASCII(dstA, src, min((size_t)(src_end - src), (size_t)(dst_end - dst)), true))
+				{
+					src += run;
+					dstA += run;
+					if (src == src_end || (*src & ~0x7F) || dst >= dst_end)
+						break;
+				}
+#endif
 				if (*src == '\n' && (mFlags & EOL_CRLF) && ((src == aBuf) ? mLastWriteChar : src[-1]) != '\r')
 					*dstA++ = '\r';
 				*dstA++ = (CHAR)*src;
@@ -479,14 +537,27 @@ DWORD TextStream::Write(LPCTSTR aBuf, DWORD aBufLen)
 		{
 #ifdef UNICODE
 			for ( ; src < src_end && dst < dst_end; ++src)
+			{
+				// Copy runs of characters other than \r and \n in bulk.
+				if (size_t run = CopyToEOL(dstW, src, min((size_t)(src_end - src), (size_t)(dst_end - dst) / sizeof(WCHAR))))
+				{
+					src += run;
+					dstW += run;
+					if (src == src_end || dst >= dst_end)
+						break;
+				}
+				if (*src == '\n' && (mFlags & EOL_CRLF) && ((src == aBuf) ? mLastWriteChar : src[-1]) != '\r')
+					*dstW++ = '\r';
+				*dstW++ = *src;
+			}
 #else
 			for ( ; src < src_end && !(*src & ~0x7F) && dst < dst_end; ++src) // No conversion needed for ASCII chars.
-#endif
 			{
 				if (*src == '\n' && (mFlags & EOL_CRLF) && ((src == aBuf) ? mLastWriteChar : src[-1]) != '\r')
 					*dstW++ = '\r';
 				*dstW++ = (WCHAR)*src;
 			}
+#endif
 		}
 
 		if (dst >= dst_end)
@@ -531,8 +602,17 @@ DWORD TextStream::Write(LPCTSTR aBuf, DWORD aBufLen)
 
 #ifdef UNICODE
 		ASSERT(mCodePage != CP_UTF16); // An optimization above already handled UTF-16.
-		dstA += WideCharToMultiByte(mCodePage, 0, src, src_size, dstA, 4, NULL, NULL);
-		src += src_size;
+		// Encode the run of non-ASCII characters which starts here in one call.  The run is limited
+		// so that the result fits even at 4 bytes per code unit (the maximum, for GB18030).
+		size_t room = (mBuffer + mBufferSize - dst) / 4; // At least 1, since dst < dst_end.
+		LPCTSTR end = src + src_size;
+		while (end < src_end && (size_t)(end - src) < room && (*end & ~0x7F))
+			++end;
+		if (end < src_end && end - src > src_size
+			&& end[-1] >= 0xD800 && end[-1] <= 0xDBFF && *end >= 0xDC00 && *end <= 0xDFFF)
+			--end; // Keep the surrogate pair together for the next iteration.
+		dstA += WideCharToMultiByte(mCodePage, 0, src, (int)(end - src), dstA, (int)(mBuffer + mBufferSize - dst), NULL, NULL);
+		src = end;
 #else
 		if (mCodePage == g_ACP)
 		{
@@ -569,7 +649,7 @@ DWORD TextStream::Write(LPCVOID aBuf, DWORD aBufLen)
 	if (!PrepareToWrite())
 		return 0;
 
-	if (aBufLen < TEXT_IO_BLOCK - mLength) // There would be room for at least 1 byte after appending data.
+	if (aBufLen < mBufferSize - mLength) // There would be room for at least 1 byte after appending data.
 	{
 		// Buffer the data.
 		memcpy(mBuffer + mLength, aBuf, aBufLen);
@@ -709,8 +789,18 @@ __int64 TextFile::_Length() const
 // FileObject: exports TextFile interfaces to the scripts.
 class FileObject : public ObjectBase // fincs: No longer allowing the script to manipulate File objects
 {
-	FileObject() {}
-	~FileObject() {}
+	FileObject(TextFile *aFile) : mFile(aFile), mAsyncHead(NULL), mAsyncTail(NULL), mAsyncIdle(NULL)
+	{
+		InitializeCriticalSection(&mAsyncLock);
+	}
+	~FileObject()
+	{
+		// There are no pending async operations since each batch holds a reference to this object.
+		DeleteCriticalSection(&mAsyncLock);
+		if (mAsyncIdle)
+			CloseHandle(mAsyncIdle);
+		delete mFile;
+	}
 
 	enum MemberID {
 		INVALID = 0,
@@ -741,6 +831,14 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 		LPTSTR name = TokenToString(*aParam[0]); // Name of method or property.
 		MemberID member = INVALID;
 
+		size_t name_length = _tcslen(name);
+		if (name_length > 5 && !_tcsicmp(name + name_length - 5, _T("Async")))
+		{
+			if (!IS_INVOKE_CALL)
+				return OK; // Method requires parentheses().
+			return InvokeAsync(aResultToken, name, name_length - 5, aParam, aParamCount);
+		}
+
 		// Read' and Write' must be handled differently to support ReadUInt(), WriteShort(), etc.
 		if (!_tcsnicmp(name, _T("Read"), 4))
 		{
@@ -778,6 +876,9 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 		if (member == INVALID)
 			return INVOKE_NOT_HANDLED;
 
+		// Async operations use mFile on another thread, so wait for them to finish:
+		WaitAsync();
+
 		// Syntax validation:
 		if (!IS_INVOKE_CALL)
 		{
@@ -842,7 +943,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				if (reading)
 				{
 					buf.i8 = 0;
-					if ( !mFile.Read(&buf, size) )
+					if ( !mFile->Read(&buf, size) )
 						break; // Return "" or throw.
 
 					if (is_float)
@@ -889,7 +990,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 							buf.i8 = TokenToInt64(token_to_write);
 					}
 					
-					DWORD bytes_written = mFile.Write(&buf, size);
+					DWORD bytes_written = mFile->Write(&buf, size);
 					if (!bytes_written && g->InTryBlock)
 						break; // Throw an exception.
 					// Otherwise, we should return bytes_written even if it is 0:
@@ -906,10 +1007,10 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				if (aParamCount)
 					length = (DWORD)TokenToInt64(*aParam[1]);
 				else
-					length = (DWORD)(mFile.Length() - mFile.Tell()); // We don't know the actual number of characters these bytes will translate to, but this should be sufficient.
+					length = (DWORD)(mFile->Length() - mFile->Tell()); // We don't know the actual number of characters these bytes will translate to, but this should be sufficient.
 				if (length == -1 || !TokenSetResult(aResultToken, NULL, length)) // Relies on short-circuit order. TokenSetResult requires non-NULL aResult if aResultLength == -1.
 					break; // Return "" or throw.
-				length = mFile.Read(aResultToken.marker, length);
+				length = mFile->Read(aResultToken.marker, length);
 				aResultToken.symbol = SYM_STRING;
 				aResultToken.marker[length] = '\0';
 				aResultToken.marker_length = length; // Update marker_length to the actual number of characters read. Only strictly necessary in some cases; see TokenSetResult.
@@ -922,7 +1023,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 			{	// See above for comments.
 				if (!TokenSetResult(aResultToken, NULL, READ_FILE_LINE_SIZE))
 					break; // Return "" or throw.
-				DWORD length = mFile.ReadLine(aResultToken.marker, READ_FILE_LINE_SIZE - 1);
+				DWORD length = mFile->ReadLine(aResultToken.marker, READ_FILE_LINE_SIZE - 1);
 				aResultToken.symbol = SYM_STRING;
 				aResultToken.marker[length] = '\0';
 				aResultToken.buf = (LPTSTR)(size_t) length;
@@ -939,12 +1040,12 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				{
 					LPTSTR param1 = TokenToString(*aParam[1], aResultToken.buf);
 					chars_to_write = (DWORD)EXPR_TOKEN_LENGTH(aParam[1], param1);
-					bytes_written = mFile.Write(param1, chars_to_write);
+					bytes_written = mFile->Write(param1, chars_to_write);
 				}
 				if (member == WriteLine && (bytes_written || !chars_to_write)) // i.e. don't attempt it if above failed.
 				{
 					chars_to_write += 1;
-					bytes_written += mFile.Write(_T("\n"), 1);
+					bytes_written += mFile->Write(_T("\n"), 1);
 				}
 				// If no data was written and some should have been, consider it a failure:
 				if (!bytes_written && chars_to_write && g->InTryBlock)
@@ -958,15 +1059,36 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 			break;
 
 		case RawReadWrite:
-			if (aParamCount == 2)
+			if (aParamCount == 2 || aParamCount == 1 && TokenToBuffer(*aParam[1]))
 			{
 				bool reading = (name[3] == 'R' || name[3] == 'r');
 
 				LPVOID target;
 				ExprTokenType &target_token = *aParam[1];
-				DWORD size = (DWORD)TokenToInt64(*aParam[2]);
+				BufferObject *target_buf = TokenToBuffer(target_token);
+				DWORD size = aParamCount == 2 ? (DWORD)TokenToInt64(*aParam[2]) : (DWORD)target_buf->Size(); // Bytes defaults to the size of the Buffer.
+				if (aParamCount == 1 && target_buf->Size() > MAXDWORD) // Too large to read or write in one call.
+				{
+					if (g->InTryBlock)
+						break; // Throw an exception.
+					aResultToken.value_int64 = 0;
+					return OK;
+				}
 
-				if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
+				if (target_buf)
+				{
+					// As for a variable, the Buffer is expanded if reading and it is too small.
+					if ( size > target_buf->Size()
+						&& (!reading || !target_buf->Resize(size)) )
+					{
+						if (g->InTryBlock)
+							break; // Throw an exception.
+						aResultToken.value_int64 = 0;
+						return OK;
+					}
+					target = target_buf->Data();
+				}
+				else if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
 				{
 					// Check if the user requested a size larger than the variable.
 					if ( size > target_token.var->ByteCapacity()
@@ -987,9 +1109,9 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				if (target < (LPVOID)65536) // Basic sanity check to catch incoming raw addresses that are zero or blank.
 					result = 0;
 				else if (reading)
-					result = mFile.Read(target, size);
+					result = mFile->Read(target, size);
 				else
-					result = mFile.Write(target, size);
+					result = mFile->Write(target, size);
 				if (!result && size && g->InTryBlock)
 					break; // Throw an exception.
 				// Otherwise, it was a complete or partial success, or no TRY block is active.
@@ -1001,7 +1123,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 		case Position:
 			if (aParamCount == 0)
 			{
-				aResultToken.value_int64 = mFile.Tell();
+				aResultToken.value_int64 = mFile->Tell();
 				return OK;
 			}
 			else if (aParamCount <= 2)
@@ -1013,7 +1135,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				else // Defaulting to SEEK_END when distance is negative seems more useful than allowing it to be interpreted as an unsigned value (> 9.e18 bytes).
 					origin = (distance < 0) ? SEEK_END : SEEK_SET;
 
-				if (!mFile.Seek(distance, origin))
+				if (!mFile->Seek(distance, origin))
 				{
 					if (g->InTryBlock)
 						break; // Throw an exception.
@@ -1028,12 +1150,12 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 		case Length:
 			if (aParamCount == 0)
 			{
-				aResultToken.value_int64 = mFile.Length();
+				aResultToken.value_int64 = mFile->Length();
 				return OK;
 			}
 			else if (aParamCount == 1)
 			{
-				if (-1 != (aResultToken.value_int64 = mFile.Length(TokenToInt64(*aParam[1]))))
+				if (-1 != (aResultToken.value_int64 = mFile->Length(TokenToInt64(*aParam[1]))))
 					return OK;
 				else // Empty string seems like a more suitable failure indicator than -1.
 					aResultToken.marker = _T("");
@@ -1043,12 +1165,12 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 
 		case AtEOF:
 			if (aParamCount == 0)
-				aResultToken.value_int64 = mFile.AtEOF();
+				aResultToken.value_int64 = mFile->AtEOF();
 			return OK;
 		
 		case Handle:
 			if (aParamCount == 0)
-				aResultToken.value_int64 = (UINT_PTR) mFile.Handle();
+				aResultToken.value_int64 = (UINT_PTR) mFile->Handle();
 			return OK;
 
 		case Encoding:
@@ -1068,11 +1190,11 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 				else
 					codepage = Line::ConvertFileEncoding(TokenToString(*aParam[1]));
 				if (codepage != -1)
-					mFile.SetCodePage(codepage & ~CP_AHKNOBOM); // Ignore "-RAW" by removing the CP_AHKNOBOM flag; see comments above.
+					mFile->SetCodePage(codepage & ~CP_AHKNOBOM); // Ignore "-RAW" by removing the CP_AHKNOBOM flag; see comments above.
 				// Now fall through to below and return the actual codepage.
 			}
 			LPTSTR name;
-			codepage = mFile.GetCodePage();
+			codepage = mFile->GetCodePage();
 			// There's no need to check for the CP_AHKNOBOM flag here because it's stripped out when the file is opened.
 			switch (codepage)
 			{
@@ -1096,7 +1218,7 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 
 		case Close:
 			if (aParamCount == 0)
-				mFile.Close();
+				mFile->Close();
 			aResultToken.symbol = SYM_STRING;
 			aResultToken.marker = _T("");
 			return OK;
@@ -1113,17 +1235,351 @@ class FileObject : public ObjectBase // fincs: No longer allowing the script to
 
 	IObject_Type_Impl("File")
 
-	TextFile mFile;
+	TextFile *mFile; // TextFile, or a subclass such as TextUnzip.
+
+	// Async operations: queued by the script's thread and performed in order on a thread pool thread.
+	struct AsyncOp
+	{
+		AsyncOp *mNext;
+		MemberID mMember; // Read, ReadLine, Write, WriteLine or RawReadWrite.
+		bool mReading; // For RawReadWrite.
+		DWORD mLength; // Chars or bytes, depending on mMember.  -1 means the rest of the file for Read.
+		LPVOID mData; // Owned string to write for Write/WriteLine, otherwise the caller's memory for RawReadWrite.
+		bool mOwnsData; // For RawReadWrite: mData is a copy of a variable's contents.
+		BufferObject *mBuffer; // For RawReadWrite: the Buffer containing mData, kept alive until the operation completes.
+		AsyncResult *mResult;
+	};
+	#define FILE_ASYNC_CHUNK (256 * 1024) // Units per read or write, so that cancellation takes effect reasonably quickly.
+	CRITICAL_SECTION mAsyncLock; // Protects the queue.
+	AsyncOp *mAsyncHead, *mAsyncTail; // mAsyncHead is the operation in progress, if any.
+	HANDLE mAsyncIdle; // Manual-reset event, set while the queue is empty.  Created on first use.
+
+	void WaitAsync()
+	{
+		if (!mAsyncIdle)
+			return;
+		DWORD start_time = GetTickCount();
+		while (WaitForSingleObject(mAsyncIdle, 0) != WAIT_OBJECT_0)
+			MsgWaitForEvent(mAsyncIdle, start_time, -1);
+	}
+
+	ResultType InvokeAsync(ExprTokenType &aResultToken, LPTSTR aName, size_t aNameLength, ExprTokenType *aParam[], int aParamCount)
+	// ReadAsync([Chars, Callback]), ReadLineAsync([Callback]), WriteAsync(String [, Callback]),
+	// WriteLineAsync([String, Callback]), RawReadAsync(Buffer|Address, Bytes [, Callback]),
+	// RawWriteAsync(Buffer|VarOrAddress, Bytes [, Callback]):
+	// Queue the operation and return an AsyncResult whose value is what the synchronous method would
+	// return.  Callback, if specified, is called with the AsyncResult once the operation completes.
+	// Operations on the same file are performed in order, and other methods wait for them to finish.
+	{
+		MemberID member;
+		int param_count; // Not counting Callback.
+		#define ASYNC_NAME_IS(s) (aNameLength == _countof(_T(s)) - 1 && !_tcsnicmp(aName, _T(s), aNameLength))
+		if (ASYNC_NAME_IS("Read"))
+			member = Read, param_count = 1;
+		else if (ASYNC_NAME_IS("ReadLine"))
+			member = ReadLine, param_count = 0;
+		else if (ASYNC_NAME_IS("Write"))
+			member = Write, param_count = 1;
+		else if (ASYNC_NAME_IS("WriteLine"))
+			member = WriteLine, param_count = 1;
+		else if (ASYNC_NAME_IS("RawRead") || ASYNC_NAME_IS("RawWrite"))
+			member = RawReadWrite, param_count = 2;
+		else
+			return INVOKE_NOT_HANDLED;
+		#undef ASYNC_NAME_IS
+		if (aParamCount > param_count + 1 || member == Write && aParamCount < 1
+			|| member == RawReadWrite && (aParamCount < 2 && !(aParamCount && TokenToBuffer(*aParam[1]))))
+			return OK; // Invalid number of parameters; return "".
+
+		IObject *callback = NULL;
+		if (aParamCount > param_count && aParam[param_count + 1]->symbol != SYM_MISSING)
+		{
+			ExprTokenType &callback_token = *aParam[param_count + 1];
+			if (  !(callback = TokenToObject(callback_token)) && !(callback = TokenToFunc(callback_token))  )
+				return g_script.ScriptError(ERR_INVALID_VALUE, TokenToString(callback_token, aResultToken.buf));
+		}
+
+		AsyncOp *op = new AsyncOp;
+		op->mNext = NULL;
+		op->mMember = member;
+		op->mReading = (ctoupper(aName[3]) == 'R'); // RawRead vs. RawWrite.
+		op->mLength = 0;
+		op->mData = NULL;
+		op->mOwnsData = false;
+		op->mBuffer = NULL;
+		switch (member)
+		{
+		case Read:
+			op->mLength = (aParamCount && aParam[1]->symbol != SYM_MISSING) ? (DWORD)TokenToInt64(*aParam[1]) : -1;
+			break;
+		case Write:
+		case WriteLine:
+			if (aParamCount && aParam[1]->symbol != SYM_MISSING)
+			{
+				LPTSTR text = TokenToString(*aParam[1], aResultToken.buf);
+				op->mLength = (DWORD)EXPR_TOKEN_LENGTH(aParam[1], text);
+				if (  !(op->mData = tmalloc(op->mLength + 1))  )
+				{
+					delete op;
+					return g_script.ScriptError(ERR_OUTOFMEM);
+				}
+				tmemcpy((LPTSTR)op->mData, text, op->mLength + 1);
+			}
+			break;
+		case RawReadWrite:
+			{
+				// See the synchronous RawRead/RawWrite for comments.  The script must not modify or free
+				// the memory of a Buffer or address until the operation completes.
+				ExprTokenType &target_token = *aParam[1];
+				BufferObject *target_buf = TokenToBuffer(target_token);
+				bool bytes_omitted = !(aParamCount > 1 && aParam[2]->symbol != SYM_MISSING);
+				if (bytes_omitted && target_buf && target_buf->Size() > MAXDWORD) // Too large to read or write in one call.
+				{
+					delete op;
+					return g_script.ScriptError(ERR_PARAM1_INVALID);
+				}
+				op->mLength = !bytes_omitted ? (DWORD)TokenToInt64(*aParam[2])
+					: target_buf ? (DWORD)target_buf->Size() : 0;
+				if (target_buf)
+				{
+					if (op->mLength > target_buf->Size()
+						&& (!op->mReading || !target_buf->Resize(op->mLength)))
+						op->mLength = 0;
+					op->mData = target_buf->Data();
+					// Hold a reference so that the memory remains valid even if the script releases the Buffer,
+					// and pin it so that the script can't resize it while the operation is pending.
+					op->mBuffer = target_buf;
+					target_buf->AddRef();
+					target_buf->Pin();
+				}
+				else if (target_token.symbol == SYM_VAR)
+				{
+					// The variable's memory may be moved or freed by the script while the operation is pending.
+					if (op->mReading)
+					{
+						delete op;
+						return g_script.ScriptError(_T("RawReadAsync requires a Buffer or an address."));
+					}
+					// Write a copy of the data, like WriteAsync.
+					if (op->mLength > target_token.var->ByteCapacity())
+						op->mLength = 0;
+					if (op->mLength)
+					{
+						if (  !(op->mData = malloc(op->mLength))  )
+						{
+							delete op;
+							return g_script.ScriptError(ERR_OUTOFMEM);
+						}
+						memcpy(op->mData, target_token.var->Contents(), op->mLength);
+						op->mOwnsData = true;
+					}
+				}
+				else
+					op->mData = (LPVOID)TokenToInt64(target_token);
+				if (op->mData < (LPVOID)65536)
+					op->mLength = 0;
+			}
+			break;
+		}
+
+		if (  !(op->mResult = AsyncResult::Create())  )
+		{
+			FreeAsyncOp(op);
+			return g_script.ScriptError(ERR_OUTOFMEM);
+		}
+		AsyncResult *result = op->mResult;
+		result->AddRef(); // One reference for the script and one for the operation.
+		if (callback)
+			result->SetScriptCallback(callback);
+		if (!QueueAsync(op))
+		{
+			result->Fail(_T("Could not queue the operation."));
+			FreeAsyncOp(op);
+		}
+		aResultToken.symbol = SYM_OBJECT;
+		aResultToken.object = result;
+		return OK;
+	}
+
+	bool QueueAsync(AsyncOp *aOp)
+	{
+		if (!mAsyncIdle && !(mAsyncIdle = CreateEvent(NULL, TRUE, TRUE, NULL)))
+			return false;
+		EnterCriticalSection(&mAsyncLock);
+		bool start = !mAsyncHead;
+		if (mAsyncTail)
+			mAsyncTail->mNext = aOp;
+		else
+			mAsyncHead = aOp;
+		mAsyncTail = aOp;
+		if (start)
+		{
+			ResetEvent(mAsyncIdle);
+			// The thread is started while the lock is held so that the queue can be reset on failure
+			// without racing with a previous thread which is about to see it empty.
+			AddRef(); // Keep this object alive until the queue is empty.  Released by AsyncProc.
+			if (!QueueUserWorkItem(AsyncProc, this, WT_EXECUTELONGFUNCTION))
+			{
+				// Since this was the only operation and no thread is running, the queue can simply be reset.
+				mAsyncHead = mAsyncTail = NULL;
+				SetEvent(mAsyncIdle);
+				LeaveCriticalSection(&mAsyncLock);
+				Release();
+				return false;
+			}
+		}
+		LeaveCriticalSection(&mAsyncLock);
+		return true;
+	}
+
+	static void FreeAsyncOp(AsyncOp *aOp)
+	{
+		if (aOp->mMember == Write || aOp->mMember == WriteLine || aOp->mOwnsData)
+			free(aOp->mData);
+		if (aOp->mBuffer)
+		{
+			aOp->mBuffer->Unpin();
+			aOp->mBuffer->Release();
+		}
+		if (aOp->mResult)
+			aOp->mResult->Release();
+		delete aOp;
+	}
+
+	static DWORD WINAPI AsyncProc(LPVOID aParam)
+	{
+		FileObject &file = *(FileObject *)aParam;
+		// QueueAsync starts this thread only when the queue becomes non-empty, and only this thread
+		// removes operations, so there is always at least one.
+		AsyncOp *op = file.mAsyncHead, *next;
+		do
+		{
+			if (!op->mResult->IsDone()) // i.e. it wasn't cancelled before it started.
+				file.PerformAsync(*op);
+			// Once the queue is seen to be empty, this thread must not touch it again: QueueAsync may
+			// start another thread as soon as the lock is released.
+			EnterCriticalSection(&file.mAsyncLock);
+			if (  !(file.mAsyncHead = next = op->mNext)  )
+			{
+				file.mAsyncTail = NULL;
+				SetEvent(file.mAsyncIdle);
+			}
+			LeaveCriticalSection(&file.mAsyncLock);
+			FreeAsyncOp(op);
+			op = next;
+		} while (op);
+		file.Release(); // Balances the AddRef in QueueAsync.
+		return 0;
+	}
+
+	void PerformAsync(AsyncOp &aOp)
+	// Called on a thread pool thread.  Checks for cancellation between chunks.
+	{
+		AsyncResult &result = *aOp.mResult;
+		DWORD done = 0;
+		switch (aOp.mMember)
+		{
+		case ReadLine:
+			{
+				// Unlike ReadLine, which returns at most READ_FILE_LINE_SIZE - 1 chars per call and leaves
+				// the rest of a longer line for the next call, read until the end of the line or file.
+				DWORD size = READ_FILE_LINE_SIZE;
+				LPTSTR buf = tmalloc(size);
+				for (;;)
+				{
+					if (!buf)
+					{
+						result.Fail(ERR_OUTOFMEM);
+						return;
+					}
+					done += mFile->ReadLine(buf + done, size - 1 - done);
+					if (done < size - 1 || buf[done - 1] == '\n') // End of line or file.
+						break;
+					if (result.IsDone() // Cancelled.
+						|| size > MAXDWORD / 2 / sizeof(TCHAR)) // Line too long to hold.
+					{
+						free(buf);
+						if (!result.IsDone())
+							result.Fail(ERR_OUTOFMEM);
+						return;
+					}
+					LPTSTR new_buf = (LPTSTR)realloc(buf, (size *= 2) * sizeof(TCHAR));
+					if (!new_buf)
+						free(buf);
+					buf = new_buf;
+				}
+				buf[done] = '\0';
+				result.CompleteOwned(buf);
+				return;
+			}
+		case Read:
+			{
+				DWORD length = aOp.mLength != -1 ? aOp.mLength
+					: (DWORD)(mFile->Length() - mFile->Tell()); // See Read for comments.
+				LPTSTR buf = tmalloc(length + 1);
+				if (!buf)
+				{
+					result.Fail(ERR_OUTOFMEM);
+					return;
+				}
+				while (done < length)
+				{
+					DWORD chunk = min(length - done, FILE_ASYNC_CHUNK);
+					DWORD chars_read = mFile->Read(buf + done, chunk);
+					done += chars_read;
+					if (chars_read < chunk) // End of file.
+						break;
+					if (result.IsDone()) // Cancelled.
+					{
+						free(buf);
+						return;
+					}
+				}
+				buf[done] = '\0';
+				result.CompleteOwned(buf);
+				return;
+			}
+		case Write:
+		case WriteLine:
+			if (aOp.mLength)
+				done = mFile->Write((LPTSTR)aOp.mData, aOp.mLength);
+			if (aOp.mMember == WriteLine && (done || !aOp.mLength))
+				done += mFile->Write(_T("\n"), 1);
+			break;
+		case RawReadWrite:
+			while (done < aOp.mLength && !result.IsDone())
+			{
+				DWORD chunk = min(aOp.mLength - done, FILE_ASYNC_CHUNK);
+				DWORD bytes = aOp.mReading ? mFile->Read((LPBYTE)aOp.mData + done, chunk)
+					: mFile->Write((LPBYTE)aOp.mData + done, chunk);
+				done += bytes;
+				if (bytes < chunk)
+					break;
+			}
+			break;
+		}
+		ExprTokenType value;
+		value.symbol = SYM_INTEGER;
+		value.value_int64 = done;
+		result.Complete(value); // Has no effect if cancelled.
+	}
 	
 public:
-	static inline FileObject *Open(LPCTSTR aFileSpec, DWORD aFlags, UINT aCodePage)
+	static inline FileObject *Open(LPCTSTR aFileSpec, DWORD aFlags, UINT aCodePage, TextFile *aFile = NULL)
+	// aFile, if specified, is an unopened TextFile subclass which the object takes ownership of.
 	{
-		FileObject *fileObj = new FileObject();
-		if (fileObj && fileObj->mFile.Open(aFileSpec, aFlags, aCodePage))
+		FileObject *fileObj = new FileObject(aFile ? aFile : new TextFile);
+		if (fileObj && fileObj->mFile->Open(aFileSpec, aFlags, aCodePage))
 			return fileObj;
 		fileObj->Release();
 		return NULL;
 	}
+
+	static inline FileObject *Attach(TextFile *aFile)
+	// Returns an object which takes ownership of aFile, which the caller has already opened.
+	{
+		return new FileObject(aFile);
+	}
 };
 
 BIF_DECL(BIF_FileOpen)
@@ -1131,6 +1587,8 @@ BIF_DECL(BIF_FileOpen)
 	DWORD aFlags;
 	UINT aEncoding;
 
+	CLOSE_FILE_APPEND_CACHE // In case the script opens a file it has appended to.
+
 	if (TokenIsPureNumeric(*aParam[1]))
 	{
 		aFlags = (DWORD) TokenToInt64(*aParam[1]);
@@ -1246,6 +1704,22 @@ invalid_param:
 		Script::ThrowRuntimeException(ERR_PARAM2_INVALID, _T("FileOpen"));
 }
 
+IObject *UnzipFileObject(void *aArchive, ULONGLONG aIndex, BufferObject *aSource, UINT aCodePage, DWORD &aError)
+// Returns a read-only File object which decompresses entry aIndex of aArchive as it is read,
+// or NULL with aError set to the LiteZip error code (ZR_*) if the entry can't be opened.
+// The object takes ownership of aArchive in all cases.  aSource, if non-NULL, contains the
+// archive data and is kept alive until the object is closed.
+{
+	TextUnzip *entry = new TextUnzip;
+	if (!entry->Open(TextUnzip::Entry(aArchive, aIndex, aSource), TextStream::READ, aCodePage))
+	{
+		aError = entry->LastError();
+		delete entry; // This also closes aArchive.
+		return NULL;
+	}
+	return FileObject::Attach(entry);
+}
+
 
 //
 // TextMem
@@ -1301,3 +1775,153 @@ __int64 TextMem::_Length() const
 {
 	return mData.mLength;
 }
+
+
+
+//
+// TextUnzip
+//
+bool TextUnzip::_Open(LPCTSTR aFileSpec, DWORD &aFlags)
+{
+	Entry &spec = *(Entry *)aFileSpec;
+	_Close();
+	mArchive = spec.mArchive;
+	if (mSource = spec.mSource)
+	{
+		mSource->AddRef();
+		mSource->Pin(); // Resizing it would invalidate the archive data being decompressed.
+	}
+	mEntry.Index = spec.mIndex;
+	if ((aFlags & ACCESS_MODE_MASK) != TextStream::READ) // Only read mode is supported.
+		return false;
+	mPos = NULL; // Discard temp buffer contents, if any.
+	mLength = 0;
+	return Rewind();
+}
+
+void TextUnzip::_Close()
+{
+	if (mArchive)
+	{
+		UnzipClose(mArchive);
+		mArchive = NULL;
+	}
+	if (mSource)
+	{
+		mSource->Unpin();
+		mSource->Release();
+		mSource = NULL;
+	}
+	free(mUnread);
+	mUnread = NULL;
+	DiscardUnread();
+	mError = ZR_ARGS;
+}
+
+bool TextUnzip::Rewind()
+// Selects the entry again, which discards any partially decompressed data.
+{
+	mOffset = 0;
+	DiscardUnread();
+	if (!mArchive)
+		return false;
+	mError = UnzipGetItem(mArchive, &mEntry);
+	if (mError != ZR_OK)
+		return false;
+	mError = ZR_MORE; // Nothing has been decompressed yet.
+	return true;
+}
+
+void TextUnzip::RollbackFilePointer()
+// Rather than seeking backward (which would restart decompression), give the data which was read ahead
+// into the buffer back to _Read().  This makes Seek() and mixed text and raw reads linear rather than
+// quadratic in the size of the entry.
+{
+	if (!mPos)
+		return;
+	DWORD unread = (DWORD)(mBuffer + mLength - mPos);
+	DWORD remainder = mUnreadLength - mUnreadPos; // Data given back previously, which follows mPos.
+	if (unread)
+	{
+		LPBYTE new_buf = (LPBYTE)malloc(unread + remainder);
+		if (new_buf)
+		{
+			memcpy(new_buf, mPos, unread);
+			memcpy(new_buf + unread, mUnread + mUnreadPos, remainder);
+			free(mUnread);
+			mUnread = new_buf;
+			mUnreadPos = 0;
+			mUnreadLength = unread + remainder;
+		}
+		else
+			TextFile::RollbackFilePointer(); // Fall back to restarting decompression.
+	}
+	mPos = NULL;
+	mLength = 0;
+}
+
+DWORD TextUnzip::_Read(LPVOID aBuffer, DWORD aBufSize)
+{
+	DWORD unread = 0;
+	if (mUnreadPos < mUnreadLength)
+	{
+		// Return the data given back by RollbackFilePointer() first.
+		unread = min(aBufSize, mUnreadLength - mUnreadPos);
+		memcpy(aBuffer, mUnread + mUnreadPos, unread);
+		mUnreadPos += unread;
+		aBuffer = (LPBYTE)aBuffer + unread;
+		aBufSize -= unread;
+	}
+	if (mError != ZR_MORE || !aBufSize)
+		return unread;
+	// UnzipItemToBuffer returns ZR_MORE once the buffer is full, leaving the entry selected so that
+	// the next call resumes decompression where this one stopped.  On return, CompressedSize holds
+	// the number of bytes which were actually decompressed into aBuffer.
+	mError = UnzipItemToBuffer(mArchive, aBuffer, aBufSize, &mEntry);
+	if (mError != ZR_MORE && mError != ZR_OK)
+		return unread;
+	DWORD bytes_read = (DWORD)mEntry.CompressedSize;
+	mOffset += bytes_read;
+	return unread + bytes_read;
+}
+
+DWORD TextUnzip::_Write(LPCVOID aBuffer, DWORD aBufSize)
+{
+	return 0;
+}
+
+bool TextUnzip::_Seek(__int64 aDistance, int aOrigin)
+{
+	switch (aOrigin)
+	{
+	case SEEK_CUR: aDistance += _Tell(); break;
+	case SEEK_END: aDistance += _Length(); break;
+	}
+	if (aDistance < 0)
+		return false;
+	__int64 pos = _Tell();
+	if (aDistance >= pos && aDistance <= mOffset) // Within the data given back by RollbackFilePointer().
+	{
+		mUnreadPos += (DWORD)(aDistance - pos);
+		return true;
+	}
+	DiscardUnread();
+	if (aDistance < mOffset && !Rewind()) // There's no way to decompress backward, so start over.
+		return false;
+	// Decompress and discard data up to the target position.
+	BYTE buf[TEXT_IO_BLOCK];
+	while (mOffset < aDistance)
+		if (!_Read(buf, (DWORD)min(aDistance - mOffset, (__int64)sizeof(buf))))
+			return false;
+	return true;
+}
+
+__int64 TextUnzip::_Tell() const
+{
+	return mOffset - (mUnreadLength - mUnreadPos);
+}
+
+__int64 TextUnzip::_Length() const
+{
+	return mArchive ? (__int64)mEntry.UncompressedSize : 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #define TEXT_IO_BLOCK	8192
+#define TEXT_IO_BLOCK_MAX	(1024 * 1024) // The read buffer grows up to this size while a file is read sequentially.
 
 #ifndef CP_UTF16
 #define CP_UTF16		1200 // the codepage of UTF-16LE
@@ -15,6 +16,9 @@
 #define TEOF ((TCHAR)EOF)
 
 #include <locale.h> // For _locale_t, _create_locale and _free_locale.
+#include "LiteZip.h" // For TextUnzip.
+
+class BufferObject; // For TextUnzip.
 
 extern UINT g_ACP;
 
@@ -51,7 +55,7 @@ public:
 	};
 
 	TextStream()
-		: mFlags(0), mCodePage(-1), mLength(0), mBuffer(NULL), mPos(NULL), mLastRead(0)
+		: mFlags(0), mCodePage(-1), mLength(0), mBufferSize(TEXT_IO_BLOCK), mBuffer(NULL), mPos(NULL), mLastRead(0)
 	{
 		SetCodePage(CP_ACP);
 	}
@@ -59,7 +63,7 @@ public:
 	{
 		if (mBuffer)
 		{
-			g_memset(mBuffer, 0, TEXT_IO_BLOCK);
+			g_memset(mBuffer, 0, mBufferSize);
 			free(mBuffer);
 		}
 		//if (mLocale)
@@ -77,6 +81,30 @@ public:
 	DWORD Write(LPCTSTR aBuf, DWORD aBufLen = 0);
 	DWORD Write(LPCVOID aBuf, DWORD aBufLen);
 	DWORD Read(LPTSTR aBuf, DWORD aBufLen, int aNumLines = 0);
+
+	bool Flush()
+	// Returns false if the buffered data could not be written in full.
+	{
+		return FlushWriteBuffer();
+	}
+
+	bool SetWriteBufferSize(DWORD aSize)
+	// Sets how much data is buffered before it is written to file.  Intended for use before
+	// anything is read, since it would otherwise discard the read buffer.
+	{
+		if (mPos || aSize < TEXT_IO_BLOCK)
+			return false;
+		FlushWriteBuffer();
+		if (mBuffer)
+		{
+			LPBYTE new_buf = (LPBYTE)realloc(mBuffer, aSize);
+			if (!new_buf)
+				return false;
+			mBuffer = new_buf;
+		}
+		mBufferSize = aSize;
+		return true;
+	}
 	DWORD Read(LPVOID aBuf, DWORD aBufLen);
 
 	DWORD ReadLine(LPTSTR aBuf, DWORD aBufLen)
@@ -139,7 +167,7 @@ protected:
 	virtual __int64	_Tell() const = 0;
 	virtual __int64 _Length() const = 0;
 	
-	void RollbackFilePointer()
+	virtual void RollbackFilePointer()
 	{
 		if (mPos) // Buffered reading was used.
 		{
@@ -154,21 +182,23 @@ protected:
 		}
 	}
 	
-	void FlushWriteBuffer()
+	bool FlushWriteBuffer()
 	{
+		bool result = true;
 		if (mLength && !mPos)
 		{
 			// Flush write buffer.
-			_Write(mBuffer, mLength);
+			result = _Write(mBuffer, mLength) == mLength;
 			mLength = 0;
 		}
 		mLastWriteChar = 0;
+		return result;
 	}
 
 	bool PrepareToWrite()
 	{
 		if (!mBuffer)
-			mBuffer = (BYTE *) malloc(TEXT_IO_BLOCK);
+			mBuffer = (BYTE *) malloc(mBufferSize);
 		else if (mPos) // Buffered reading was used.
 			RollbackFilePointer();
 		return mBuffer != NULL;
@@ -188,12 +218,12 @@ protected:
 	{
 		ASSERT(aReadSize);
 		if (!mBuffer) {
-			mBuffer = (BYTE *) malloc(TEXT_IO_BLOCK);
+			mBuffer = (BYTE *) malloc(mBufferSize);
 			if (!mBuffer)
 				return 0;
 		}
-		if (mLength + aReadSize > TEXT_IO_BLOCK)
-			aReadSize = TEXT_IO_BLOCK - mLength;
+		if (mLength + aReadSize > mBufferSize)
+			aReadSize = mBufferSize - mLength;
 		DWORD dwRead = _Read(mBuffer + mLength, aReadSize);
 		if (dwRead)
 			mLength += dwRead;
@@ -201,13 +231,16 @@ protected:
 	}
 	bool ReadAtLeast(DWORD aReadSize)
 	{
-		if (!mPos)
-			Read(TEXT_IO_BLOCK);
+		if (!mPos) {
+			GrowReadBuffer();
+			Read(mBufferSize);
+		}
 		else if (mPos > mBuffer + mLength - aReadSize) {
 			ASSERT( (DWORD)(mPos - mBuffer) <= mLength );
 			mLength -= (DWORD)(mPos - mBuffer);
 			memmove(mBuffer, mPos, mLength);
-			Read(TEXT_IO_BLOCK);
+			GrowReadBuffer();
+			Read(mBufferSize);
 		}
 		else
 			return true;
@@ -215,6 +248,21 @@ protected:
 		return (mLength >= aReadSize);
 	}
 
+	void GrowReadBuffer()
+	// Called before refilling the buffer.  If the previous read filled at least half of the buffer,
+	// the data is probably coming from a large file rather than a pipe or console, so double the
+	// buffer to reduce the number of reads.  Caller resets mPos.
+	{
+		if (mBuffer && mLastRead >= mBufferSize / 2 && mBufferSize < TEXT_IO_BLOCK_MAX)
+		{
+			if (LPBYTE new_buf = (LPBYTE)realloc(mBuffer, mBufferSize * 2))
+			{
+				mBuffer = new_buf;
+				mBufferSize *= 2;
+			}
+		}
+	}
+
 	__declspec(noinline) bool IsLeadByte(BYTE b) // noinline benchmarks slightly faster.
 	{
 		for (int i = 0; i < _countof(mCodePageInfo.LeadByte) && mCodePageInfo.LeadByte[i]; i += 2)
@@ -225,6 +273,7 @@ protected:
 
 	DWORD mFlags;
 	DWORD mLength;		// The length of available data in the buffer, in bytes.
+	DWORD mBufferSize;	// The capacity of the buffer, in bytes; at least TEXT_IO_BLOCK.  Writes are buffered up to this size.
 	DWORD mLastRead;
 	UINT  mCodePage;
 	CPINFO mCodePageInfo;
@@ -290,6 +339,8 @@ public:
 		// have already been written after the new end-of-file, but has been buffered.
 		// Calculating how much data should be discarded doesn't seem worthwhile, so
 		// just flush the buffer:
+		if (mFile == INVALID_HANDLE_VALUE) // Closed, or a subclass such as TextUnzip which has no file to truncate.
+			return -1;
 		RollbackFilePointer();
 		FlushWriteBuffer();
 		// Since the buffer was just flushed, Tell() vs _Tell() doesn't matter here.
@@ -318,6 +369,61 @@ private:
 
 
 
+// TextUnzip reads a single entry of a zip archive, decompressing it as it is read so that memory use
+// is bounded by the read buffer regardless of the size of the entry.  It derives from TextFile only so
+// that FileObject can expose it to scripts: it has no file handle, can't be written to, and seeking
+// backward restarts decompression from the beginning of the entry.  Data which was read ahead into
+// the buffer is kept when the buffer is discarded, so that seeking within it doesn't restart.
+class TextUnzip : public TextFile
+{
+public:
+	// TextUnzip tunzip;
+	// tunzip.Open(TextUnzip::Entry(huz, ze.Index), TextStream::READ, CP_UTF8);
+	struct Entry
+	{
+		Entry(HUNZIP aArchive, ULONGLONG aIndex, BufferObject *aSource = NULL)
+			: mArchive(aArchive), mIndex(aIndex), mSource(aSource)
+		{}
+		operator LPCTSTR() const { return (LPCTSTR) this; }
+		HUNZIP mArchive;	// Closed by _Close(), even if _Open() fails.
+		ULONGLONG mIndex;
+		BufferObject *mSource;	// Optional Buffer containing the archive data; referenced and pinned while open.
+	};
+
+	TextUnzip() : mArchive(NULL), mSource(NULL), mOffset(0), mError(ZR_ARGS)
+		, mUnread(NULL), mUnreadPos(0), mUnreadLength(0) {}
+	virtual ~TextUnzip() { _Close(); }
+
+	// Returns ZR_MORE while there is data left to decompress, ZR_OK after the entry was read
+	// completely, or the LiteZip error code which stopped decompression (e.g. ZR_PASSWORD).
+	DWORD LastError() const { return mError; }
+protected:
+	virtual bool    _Open(LPCTSTR aFileSpec, DWORD &aFlags);
+	virtual void    _Close();
+	virtual DWORD   _Read(LPVOID aBuffer, DWORD aBufSize);
+	virtual DWORD   _Write(LPCVOID aBuffer, DWORD aBufSize);
+	virtual bool    _Seek(__int64 aDistance, int aOrigin);
+	virtual __int64	_Tell() const;
+	virtual __int64 _Length() const;
+	virtual void    RollbackFilePointer();
+
+private:
+	bool Rewind();
+	void DiscardUnread() { mUnreadPos = mUnreadLength = 0; }
+
+	HUNZIP mArchive;
+	BufferObject *mSource;
+	ZIPENTRY mEntry;
+	__int64 mOffset;	// The number of bytes decompressed so far.
+	DWORD mError;
+	// Data which was decompressed but given back by RollbackFilePointer(), to be returned by _Read()
+	// before anything more is decompressed.  The logical position is mOffset minus the remainder.
+	LPBYTE mUnread;
+	DWORD mUnreadPos, mUnreadLength;
+};
+
+
+
 // TextMem is intended to attach a memory block, which provides code pages and end-of-line conversions (CRLF <-> LF).
 // It is used for reading the script data in compiled script.
 // Note that TextMem doesn't have any ability to write and seek.
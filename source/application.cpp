@@ -740,6 +740,10 @@ bool MsgSleep(int aSleepDuration, MessageMode aMode)
 			// will still get the msg.
 			if (msg.hwnd && msg.hwnd != g_hWnd) // v1.0.44: It's wasn't sent by our code; perhaps by a common control's code.
 				break; // Dispatch it vs. discarding it, in case it's for a control.
+#ifndef MINIDLL
+			if (msg.message != AHK_CLIPBOARD_CHANGE)
+				HookEventReceived(msg.message, msg.wParam); // For HookStats().
+#endif
 			//ELSE FALL THROUGH:
 #ifndef MINIDLL
 		case AHK_GUI_ACTION:   // The user pressed a button on a GUI window, or some other actionable event. Listed before the below for performance.
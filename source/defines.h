@@ -705,7 +705,17 @@ struct HotkeyCriterion
 	};
 	HotkeyCriterion *NextCriterion;
 
-	ResultType Eval(LPTSTR aHotkeyName); // For HOT_IF_EXPR and HOT_IF_CALLBACK.
+	// For window criteria whose result can be cached by the hook (see HotCriterionAllowsFiring):
+	bool Cacheable; // Set if there's no WinText and no ahk_group, so only the windows events which are watched affect the result.
+	UCHAR CachedSettings; // The relevant g_default settings at the time CachedHwnd was found.
+	UINT CachedGeneration; // Zero if nothing is cached.
+	HWND CachedHwnd, CachedForeground;
+
+	// For #IfSpeculate (HOT_IF_EXPR only), as set by the main thread:
+	volatile DWORD SpeculatedResult; // The tick count when evaluated, with the low bit set to the result. Zero if never.
+	HWND SpeculatedLFW;
+
+	ResultType Eval(LPTSTR aHotkeyName, bool aSpeculative = false); // For HOT_IF_EXPR and HOT_IF_CALLBACK.
 };
 
 
@@ -713,6 +723,7 @@ struct HotkeyCriterion
 // a new thread typically saves the old thread's struct values on its stack so that they can later
 // be copied back into the g struct when the thread is resumed:
 class Func;                 // Forward declarations
+class AsyncResult;
 
 struct FuncAndToken {
 	ExprTokenType mToken ;
@@ -723,6 +734,7 @@ struct FuncAndToken {
 	ExprTokenType params[10];
 	LPTSTR buf;
 	BYTE mParamCount;
+	AsyncResult *mAsync; // Non-NULL for ahkPostFunctionAsync, in which case this struct is allocated for the call.
 };
 
 class Label;                //
@@ -111,6 +111,8 @@ switch(fwdReason)
 		 {
 			 free(g_input.match);
 		 }
+		 free(g_input.MatchTrie);
+		 g_input.MatchTrie = NULL;
 		 if (g_script.mTrayMenu)
 			 g_script.ScriptDeleteMenu(g_script.mTrayMenu);
 		 free(g_KeyHistory);
@@ -397,6 +397,240 @@ EXPORT int ahkPostFunction(LPTSTR func, LPTSTR param1, LPTSTR param2, LPTSTR par
 		return -1;
 }
 
+// Unlike aFuncAndTokenToReturn, which is reused after 10 calls, each asynchronous call gets its own
+// FuncAndToken so that any number of calls can be pending.  It is freed once the call has completed,
+// while the caller's handle (the AsyncResult) remains valid until ahkAsyncFree.
+static void FreeAsyncCall(FuncAndToken *aCall)
+{
+	for (int i = 0; i < aCall->mParamCount; ++i)
+		free(aCall->params[i].marker);
+	free(aCall->param);
+	free(aCall->buf);
+	aCall->mAsync->Release();
+	free(aCall);
+}
+
+static FuncAndToken *NewAsyncCall(Func *aFunc, LPTSTR *aParam[], int aParamCount)
+{
+	FuncAndToken *call = (FuncAndToken *)calloc(1, sizeof(FuncAndToken));
+	if (!call)
+		return NULL;
+	call->mFunc = aFunc;
+	if (   !(call->mAsync = AsyncResult::Create())
+		|| aParamCount && !(call->param = (ExprTokenType **)malloc(aParamCount * sizeof(ExprTokenType *)))   )
+	{
+		if (call->mAsync)
+			call->mAsync->Release();
+		free(call);
+		return NULL;
+	}
+	for (; call->mParamCount < aParamCount; ++call->mParamCount)
+	{
+		LPTSTR value = _tcsdup(*aParam[call->mParamCount]);
+		if (!value)
+		{
+			FreeAsyncCall(call);
+			return NULL;
+		}
+		call->param[call->mParamCount] = &call->params[call->mParamCount];
+		call->params[call->mParamCount].SetValue(value);
+	}
+	return call;
+}
+
+static void CompleteAsyncCall(FuncAndToken &aCall, bool aReturned)
+// Stores the result of the function, or the message of any exception it threw.  The exception is
+// cleared so that it is reported to the host rather than displayed.
+{
+	ExprTokenType &token = aCall.mToken;
+	if (g->ThrownToken)
+	{
+		TCHAR buf[MAX_NUMBER_SIZE];
+		ExprTokenType message;
+		Object *obj = dynamic_cast<Object *>(TokenToObject(*g->ThrownToken));
+		if (!obj || !obj->GetItem(message, _T("Message")))
+			message = *g->ThrownToken;
+		aCall.mAsync->Fail(TokenToString(message, buf));
+		g_script.FreeExceptionToken(g->ThrownToken);
+	}
+	else if (aReturned)
+		aCall.mAsync->Complete(token);
+	else
+		aCall.mAsync->Fail(_T("The thread exited."));
+	if (aReturned)
+	{
+		if (token.symbol == SYM_OBJECT)
+			token.object->Release();
+		else if (token.mem_to_free)
+			free(token.mem_to_free);
+	}
+}
+
+EXPORT UINT_PTR ahkPostFunctionAsync(LPTSTR func, LPTSTR param1, LPTSTR param2, LPTSTR param3, LPTSTR param4, LPTSTR param5, LPTSTR param6, LPTSTR param7, LPTSTR param8, LPTSTR param9, LPTSTR param10)
+// Same as ahkPostFunction, but returns a handle for use with the ahkAsync functions below,
+// or 0 if the function doesn't exist.  The handle must be freed with ahkAsyncFree.
+{
+	if (!g_script.mIsReadyToExecute)
+		return 0; // AutoHotkey needs to be running at this point //
+	Func *aFunc = g_script.FindFunc(func);
+	if (!aFunc)
+		return 0;
+	int aParamsCount = 0;
+	LPTSTR *params[10] = {&param1,&param2,&param3,&param4,&param5,&param6,&param7,&param8,&param9,&param10};
+	for (;aParamsCount < 10;aParamsCount++)
+		if (!*params[aParamsCount])
+			break;
+	if (aParamsCount < aFunc->mMinParams)
+	{
+		g_script.ScriptError(ERR_TOO_FEW_PARAMS, func);
+		return 0;
+	}
+	if (aFunc->mParamCount < aParamsCount && (aFunc->mIsBuiltIn || !aFunc->mIsVariadic))
+		aParamsCount = aFunc->mParamCount;
+	FuncAndToken *call = NewAsyncCall(aFunc, params, aParamsCount);
+	if (!call)
+	{
+		g_script.ScriptError(ERR_OUTOFMEM, func);
+		return 0;
+	}
+	AsyncResult *result = call->mAsync;
+	result->AddRef(); // One reference for the caller, one for the call.
+	if (aFunc->mIsBuiltIn)
+	{
+		// As with ahkPostFunction, built-in functions are called on this thread.
+		ResultType aResult = OK;
+		if (  !(call->buf = (LPTSTR)malloc(MAX_NUMBER_SIZE * sizeof(TCHAR)))  )
+			result->Fail(ERR_OUTOFMEM);
+		else
+		{
+			EnterCriticalSection(&g_CriticalAhkFunction);
+			call->mToken.symbol = SYM_INTEGER;
+			call->mToken.buf = call->buf;
+			call->mToken.marker = aFunc->mName;
+			call->mToken.mem_to_free = NULL;
+			aFunc->mBIF(aResult, call->mToken, call->param, call->mParamCount);
+			result->Complete(call->mToken);
+			if (call->mToken.symbol == SYM_OBJECT)
+				call->mToken.object->Release();
+			else if (call->mToken.mem_to_free)
+				free(call->mToken.mem_to_free);
+			LeaveCriticalSection(&g_CriticalAhkFunction);
+		}
+		FreeAsyncCall(call);
+	}
+	else if (!PostMessage(g_hWnd, AHK_EXECUTE_FUNCTION_DLL, (WPARAM)call, NULL))
+	{
+		result->Fail(_T("Could not post the call."));
+		FreeAsyncCall(call);
+	}
+	return (UINT_PTR)result;
+}
+
+EXPORT int ahkAsyncReady(UINT_PTR aHandle)
+{
+	return ((AsyncResult *)aHandle)->IsDone();
+}
+
+EXPORT int ahkAsyncWait(UINT_PTR aHandle, int aTimeout)
+// Returns 1 once the call has completed or 0 if aTimeout (in milliseconds; -1 = forever) elapses first.
+// If called on the script's own thread, messages are processed while waiting.
+{
+	return ((AsyncResult *)aHandle)->Wait(aTimeout);
+}
+
+EXPORT int ahkAsyncWaitMany(UINT_PTR *aHandle, int aCount, int aWaitAll, int aTimeout)
+// Waits for all of the calls to complete if aWaitAll is non-zero, otherwise any one of them.
+// Returns aCount if all have completed, the index of a completed call, or -1 on timeout.
+{
+	DWORD start_time = GetTickCount();
+	if (aWaitAll)
+	{
+		for (int i = 0; i < aCount; ++i)
+		{
+			int remaining = aTimeout;
+			if (aTimeout >= 0 && (remaining = aTimeout - (int)(GetTickCount() - start_time)) < 0)
+				remaining = 0;
+			if (!((AsyncResult *)aHandle[i])->Wait(remaining))
+				return -1;
+		}
+		return aCount;
+	}
+	HANDLE event[MAXIMUM_WAIT_OBJECTS];
+	for (;;)
+	{
+		// Check in batches of up to MAXIMUM_WAIT_OBJECTS.  If there is more than one batch, each wait is
+		// kept short so that none of the batches are neglected.
+		for (int first = 0; first < aCount; first += MAXIMUM_WAIT_OBJECTS)
+		{
+			int count = min(aCount - first, MAXIMUM_WAIT_OBJECTS);
+			for (int i = 0; i < count; ++i)
+			{
+				if (((AsyncResult *)aHandle[first + i])->IsDone())
+					return first + i;
+				event[i] = ((AsyncResult *)aHandle[first + i])->DoneEvent();
+			}
+			DWORD wait = aCount > MAXIMUM_WAIT_OBJECTS ? 10 : INFINITE;
+			if (aTimeout >= 0)
+			{
+				DWORD elapsed = GetTickCount() - start_time;
+				if (elapsed >= (DWORD)aTimeout)
+					return -1;
+				if (wait > aTimeout - elapsed)
+					wait = aTimeout - elapsed;
+			}
+			DWORD r = WaitForMultipleObjects(count, event, FALSE, wait);
+			if (r < WAIT_OBJECT_0 + count)
+				return first + (r - WAIT_OBJECT_0);
+		}
+	}
+}
+
+EXPORT int ahkAsyncResult(UINT_PTR aHandle, VARIANT *aResult)
+// Returns 1 and stores the result in aResult (VT_I8, VT_R8 or VT_BSTR) if the call has completed,
+// -1 and stores the exception message (VT_BSTR) if the function threw an exception or could not be
+// called, or 0 if the call has not completed.  The caller must free aResult with VariantClear.
+{
+	AsyncResult &result = *(AsyncResult *)aHandle;
+	if (!result.IsDone())
+		return 0;
+	if (result.Failed())
+	{
+		aResult->vt = VT_BSTR;
+		aResult->bstrVal = SysAllocString(CStringWCharFromTCharIfNeeded(result.GetError()));
+		return -1;
+	}
+	ExprTokenType token;
+	result.PeekValue(token);
+	switch (token.symbol)
+	{
+	case SYM_INTEGER:
+		aResult->vt = VT_I8;
+		aResult->llVal = token.value_int64;
+		break;
+	case SYM_FLOAT:
+		aResult->vt = VT_R8;
+		aResult->dblVal = token.value_double;
+		break;
+	default:
+		aResult->vt = VT_BSTR;
+		aResult->bstrVal = SysAllocString(CStringWCharFromTCharIfNeeded(token.marker));
+	}
+	return 1;
+}
+
+EXPORT int ahkAsyncCallback(UINT_PTR aHandle, AsyncCallbackType aCallback, void *aParam)
+// Calls aCallback(aHandle, aParam) once the call completes: on the script's thread, or immediately on
+// this thread if it has already completed.  The callback must not free the handle.
+{
+	((AsyncResult *)aHandle)->SetCallback(aCallback, aParam);
+	return 1;
+}
+
+EXPORT void ahkAsyncFree(UINT_PTR aHandle)
+{
+	((AsyncResult *)aHandle)->Release();
+}
+
 #ifndef AUTOHOTKEYSC
 // Naveen: v6 addFile()
 // Todo: support for #Directives, and proper treatment of mIsReadytoExecute
@@ -826,15 +1060,21 @@ void callFuncDll(FuncAndToken *aFuncAndToken)
  	Func &func =  *(aFuncAndToken->mFunc); 
 	ExprTokenType & aResultToken = aFuncAndToken->mToken ;
 	// Func &func = *(Func *)g_script.mTempFunc ;
-	if (!INTERRUPTIBLE_IN_EMERGENCY)
-		return;
-	if (g_nThreads >= g_MaxThreadsTotal)
+	if (!INTERRUPTIBLE_IN_EMERGENCY
+		|| g_nThreads >= g_MaxThreadsTotal
 		// Below: Only a subset of ACT_IS_ALWAYS_ALLOWED is done here because:
 		// 1) The omitted action types seem too obscure to grant always-run permission for msg-monitor events.
 		// 2) Reduction in code size.
-		if (g_nThreads >= MAX_THREADS_EMERGENCY // To avoid array overflow, this limit must by obeyed except where otherwise documented.
-			|| func.mJumpToLine->mActionType != ACT_EXITAPP && func.mJumpToLine->mActionType != ACT_RELOAD)
-			return;
+		&& (g_nThreads >= MAX_THREADS_EMERGENCY // To avoid array overflow, this limit must by obeyed except where otherwise documented.
+			|| func.mJumpToLine->mActionType != ACT_EXITAPP && func.mJumpToLine->mActionType != ACT_RELOAD))
+	{
+		if (aFuncAndToken->mAsync)
+		{
+			aFuncAndToken->mAsync->Fail(_T("The thread could not be started."));
+			FreeAsyncCall(aFuncAndToken);
+		}
+		return;
+	}
 
 	// Need to check if backup is needed in case script explicitly called the function rather than using
 	// it solely as a callback.  UPDATE: And now that max_instances is supported, also need it for that.
@@ -868,9 +1108,18 @@ void callFuncDll(FuncAndToken *aFuncAndToken)
 	ResultType aResult;
 	FuncCallData func_call;
 	// ExprTokenType &aResultToken = aResultToken_to_return ;
+	if (aFuncAndToken->mAsync)
+		aResultToken.mem_to_free = NULL;
 	bool result = func.Call(func_call,aResult,aResultToken,aFuncAndToken->param,(int) aFuncAndToken->mParamCount,false); // Call the UDF.
 
 	DEBUGGER_STACK_POP()
+	if (aFuncAndToken->mAsync)
+	{
+		CompleteAsyncCall(*aFuncAndToken, result);
+		ResumeUnderlyingThread(ErrorLevel_saved);
+		FreeAsyncCall(aFuncAndToken);
+		return;
+	}
 	LPTSTR new_buf;
 	if (result)
 	{
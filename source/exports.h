@@ -13,6 +13,13 @@ EXPORT int ahkLabel(LPTSTR aLabelName, unsigned int nowait = 0);
 EXPORT UINT_PTR ahkFindFunc(LPTSTR funcname) ;
 EXPORT LPTSTR ahkFunction(LPTSTR func, LPTSTR param1 = _T(""), LPTSTR param2 = _T(""), LPTSTR param3 = _T(""), LPTSTR param4 = _T(""), LPTSTR param5 = _T(""), LPTSTR param6 = _T(""), LPTSTR param7 = _T(""), LPTSTR param8 = _T(""), LPTSTR param9 = _T(""), LPTSTR param10 = _T(""));
 EXPORT int ahkPostFunction(LPTSTR func, LPTSTR param1 = _T(""), LPTSTR param2 = _T(""), LPTSTR param3 = _T(""), LPTSTR param4 = _T(""), LPTSTR param5 = _T(""), LPTSTR param6 = _T(""), LPTSTR param7 = _T(""), LPTSTR param8 = _T(""), LPTSTR param9 = _T(""), LPTSTR param10 = _T(""));
+EXPORT UINT_PTR ahkPostFunctionAsync(LPTSTR func, LPTSTR param1 = NULL, LPTSTR param2 = NULL, LPTSTR param3 = NULL, LPTSTR param4 = NULL, LPTSTR param5 = NULL, LPTSTR param6 = NULL, LPTSTR param7 = NULL, LPTSTR param8 = NULL, LPTSTR param9 = NULL, LPTSTR param10 = NULL);
+EXPORT int ahkAsyncReady(UINT_PTR aHandle);
+EXPORT int ahkAsyncWait(UINT_PTR aHandle, int aTimeout = -1);
+EXPORT int ahkAsyncWaitMany(UINT_PTR *aHandle, int aCount, int aWaitAll, int aTimeout = -1);
+EXPORT int ahkAsyncResult(UINT_PTR aHandle, VARIANT *aResult);
+EXPORT int ahkAsyncCallback(UINT_PTR aHandle, void (CALLBACK *aCallback)(UINT_PTR aHandle, void *aParam), void *aParam);
+EXPORT void ahkAsyncFree(UINT_PTR aHandle);
 
 #ifndef AUTOHOTKEYSC
 EXPORT UINT_PTR addFile(LPTSTR fileName, int waitexecute = 0);
@@ -51,6 +51,7 @@ HANDLE g_hThread = 0;
 HANDLE g_hThread = OpenThread(THREAD_ALL_ACCESS, FALSE, g_MainThreadID);
 #endif
 DWORD g_HookThreadID; // Not initialized by design because 0 itself might be a valid thread ID.
+bool g_HookReplay = false; // True while the hook thread is processing events for HookReplay().
 ATOM g_ClassRegistered = 0;
 ATOM g_ClassSplashRegistered = 0;
 CRITICAL_SECTION g_CriticalRegExCache;
@@ -127,6 +128,11 @@ bool g_AutoExecTimerExists = false;
 bool g_InputTimerExists = false;
 #endif
 bool g_DerefTimerExists = false;
+bool g_FileAppendTimerExists = false;
+DWORD g_FileAppendCacheInterval = 0; // Zero means FileAppend opens and closes the file each time.
+DWORD g_FileAppendCacheSize = FILE_APPEND_CACHE_BUF_SIZE;
+int g_FileAppendCacheCount = 0;
+DWORD g_FileAppendCacheError = 0; // Error code from the last failed write of cached data, reported by the next FileAppend.
 bool g_SoundWasPlayed = false;
 #ifndef MINIDLL
 bool g_IsSuspended = false;  // Make this separate from g_AllowInterruption since that is frequently turned off & on.
@@ -165,6 +171,7 @@ HotkeyCriterion *g_FirstHotCriterion = NULL, *g_LastHotCriterion = NULL;
 
 // Global variables for #if (expression).
 UINT g_HotExprTimeout = 1000; // Timeout for #if (expression) evaluation, in milliseconds.
+UINT g_HotExprSpeculate = 0; // Max age of a speculative #if (expression) result, in milliseconds. 0 means don't speculate.
 HWND g_HotExprLFW = NULL; // Last Found Window of last #if expression.
 HotkeyCriterion *g_FirstHotExpr = NULL, *g_LastHotExpr = NULL;
 
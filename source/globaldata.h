@@ -43,6 +43,7 @@ extern HMODULE g_hMemoryModule;
 extern DWORD g_MainThreadID;
 extern HANDLE g_hThread;
 extern DWORD g_HookThreadID;
+extern bool g_HookReplay;
 extern ATOM g_ClassRegistered;
 extern ATOM g_ClassSplashRegistered;
 extern CRITICAL_SECTION g_CriticalRegExCache;
@@ -122,6 +123,11 @@ extern bool g_AutoExecTimerExists;
 extern bool g_InputTimerExists;
 #endif
 extern bool g_DerefTimerExists;
+extern bool g_FileAppendTimerExists;
+extern DWORD g_FileAppendCacheInterval;
+extern DWORD g_FileAppendCacheSize;
+extern int g_FileAppendCacheCount;
+extern DWORD g_FileAppendCacheError;
 extern bool g_SoundWasPlayed;
 #ifndef MINIDLL
 extern bool g_IsSuspended;
@@ -154,6 +160,7 @@ extern HotkeyCriterion *g_FirstHotCriterion, *g_LastHotCriterion;
 
 // Global variables for #if (expression). See globaldata.cpp for comments.
 extern UINT g_HotExprTimeout;
+extern UINT g_HotExprSpeculate;
 extern HWND g_HotExprLFW;
 extern HotkeyCriterion *g_FirstHotExpr, *g_LastHotExpr;
 
@@ -295,7 +302,8 @@ extern MyCryptDecrypt g_CryptDecrypt;
 
 enum OurTimers {TIMER_ID_MAIN = MAX_MSGBOXES + 2 // The first timers in the series are used by the MessageBoxes.  Start at +2 to give an extra margin of safety.
 	, TIMER_ID_UNINTERRUPTIBLE // Obsolete but kept as a a placeholder for backward compatibility, so that this and the other the timer-ID's stay the same, and so that obsolete IDs aren't reused for new things (in case anyone is interfacing these OnMessage() or with external applications).
-	, TIMER_ID_AUTOEXEC, TIMER_ID_INPUT, TIMER_ID_DEREF, TIMER_ID_REFRESH_INTERRUPTIBILITY};
+	, TIMER_ID_AUTOEXEC, TIMER_ID_INPUT, TIMER_ID_DEREF, TIMER_ID_REFRESH_INTERRUPTIBILITY
+	, TIMER_ID_FILE_APPEND, TIMER_ID_ASYNC_CALLBACK};
 
 // MUST MAKE main timer and uninterruptible timers associated with our main window so that
 // MainWindowProc() will be able to process them when it is called by the DispatchMessage()
@@ -361,6 +369,8 @@ if (!g_InputTimerExists)\
 // the timer will fire even when a msg pump other than our own is running, such as that of a MsgBox.
 #define SET_DEREF_TIMER(aTimeoutValue) g_DerefTimerExists = SetTimer(g_hWnd, TIMER_ID_DEREF, aTimeoutValue, DerefTimeout);
 #define LARGE_DEREF_BUF_SIZE (4*1024*1024)
+// Like SET_DEREF_TIMER, this resets the timer unconditionally so that a new interval takes effect.
+#define SET_FILE_APPEND_TIMER g_FileAppendTimerExists = SetTimer(g_hWnd, TIMER_ID_FILE_APPEND, g_FileAppendCacheInterval, FileAppendCacheTimeout);
 
 #define KILL_MAIN_TIMER \
 if (g_MainTimerExists && KillTimer(g_hWnd, TIMER_ID_MAIN))\
@@ -380,5 +390,8 @@ if (g_InputTimerExists && KillTimer(g_hWnd, TIMER_ID_INPUT))\
 #define KILL_DEREF_TIMER \
 if (g_DerefTimerExists && KillTimer(g_hWnd, TIMER_ID_DEREF))\
 	g_DerefTimerExists = false;
+#define KILL_FILE_APPEND_TIMER \
+if (g_FileAppendTimerExists && KillTimer(g_hWnd, TIMER_ID_FILE_APPEND))\
+	g_FileAppendTimerExists = false;
 
 #endif
@@ -22,6 +22,7 @@ GNU General Public License for more details.
 #include "application.h" // For MsgSleep().
 
 // Declare static variables (global to only this file/module, i.e. no external linkage):
+static HANDLE sThreadHandle = NULL; // The hook thread, if it exists.  Only the main thread uses this.
 static HANDLE sKeybdMutex = NULL;
 static HANDLE sMouseMutex = NULL;
 #define KEYBD_MUTEX_NAME _T("AHK Keybd")
@@ -129,6 +130,54 @@ enum DualNumpadKeys	{PAD_DECIMAL, PAD_NUMPAD0, PAD_NUMPAD1, PAD_NUMPAD2, PAD_NUM
 , PAD_RIGHT, PAD_HOME, PAD_UP, PAD_PRIOR, PAD_TOTAL_COUNT};
 static bool sPadState[PAD_TOTAL_COUNT];  // Initialized by ChangeHookState()
 
+// Timing of hotkey and hotstring events, for HookStats().  sHookEventRing is written only by the hook thread
+// (at sHookEventHead) and read only by the main thread (at sHookEventTail), so no locking is needed.
+// The indices are volatile, which with MSVC gives reads acquire and writes release semantics; that ensures
+// an item is complete before the main thread sees the new head, and not reused before it has been read.
+static HookEventTiming sHookEventRing[HOOK_EVENT_RING_SIZE];
+static volatile LONG sHookEventHead = 0, sHookEventTail = 0;
+static HookEventTiming sHookEventHistory[HOOK_EVENT_RING_SIZE]; // Received events, for the main thread only.
+static LONG sHookEventHistoryNext = 0;
+// Counters updated only by the hook thread.  Seq is odd while they are being updated, so that the main thread
+// can detect and retry a torn read (a 64-bit value can't be read atomically by 32-bit code).
+static struct
+{
+	volatile LONG Seq;
+	volatile __int64 Calls, Time, TimeMax, Posted, Dropped;
+} sHookCallStats;
+static volatile bool sHookCallStatsReset = false; // Set by the main thread; the hook thread resets the counters.
+static __int64 sHookCallTime; // When the current hook callback began.
+// Counters updated only by the main thread:
+static __int64 sHookEventReceived, sHookEventQueueTime, sHookEventQueueTimeMax, sHookEventUnmatched;
+
+static HookReplayParams *sHookReplay = NULL; // Non-NULL while HookReplay() is in progress.  See also g_HookReplay.
+
+struct HookCallTimer
+// Times a hook callback from construction until it returns.
+{
+	HookCallTimer() { QueryPerformanceCounter((LARGE_INTEGER *)&sHookCallTime); }
+	~HookCallTimer()
+	{
+		if (g_HookReplay) // HookReplay() times these itself.
+			return;
+		__int64 now;
+		QueryPerformanceCounter((LARGE_INTEGER *)&now);
+		++sHookCallStats.Seq;
+		if (sHookCallStatsReset)
+		{
+			sHookCallStats.Calls = sHookCallStats.Time = sHookCallStats.TimeMax = 0;
+			sHookCallStats.Posted = sHookCallStats.Dropped = 0;
+			sHookCallStatsReset = false;
+		}
+		__int64 elapsed = now - sHookCallTime;
+		++sHookCallStats.Calls;
+		sHookCallStats.Time += elapsed;
+		if (sHookCallStats.TimeMax < elapsed)
+			sHookCallStats.TimeMax = elapsed;
+		++sHookCallStats.Seq;
+	}
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////
 
 /*
@@ -157,9 +206,12 @@ inline bool IsIgnored(ULONG_PTR aExtraInfo)
 
 LRESULT CALLBACK LowLevelKeybdProc(int aCode, WPARAM wParam, LPARAM lParam)
 {
-	if (aCode != HC_ACTION)  // MSDN docs specify that both LL keybd & mouse hook should return in this case.
+	if (aCode != HC_ACTION  // MSDN docs specify that both LL keybd & mouse hook should return in this case.
+		|| sHookReplay && !g_HookReplay) // Real input bypasses the hook while HookReplay() is in progress.
 		return CallNextHookEx(g_KeybdHook, aCode, wParam, lParam);
 
+	HookCallTimer timer;
+
 	KBDLLHOOKSTRUCT &event = *(PKBDLLHOOKSTRUCT)lParam;  // For convenience, maintainability, and possibly performance.
 
 	// Change the event to be physical if that is indicated in its dwExtraInfo attribute.
@@ -293,9 +345,12 @@ LRESULT CALLBACK LowLevelMouseProc(int aCode, WPARAM wParam, LPARAM lParam)
 	// code != HC_ACTION should be evaluated PRIOR to considering the values
 	// of wParam and lParam, because those values may be invalid or untrustworthy
 	// whenever code < 0.
-	if (aCode != HC_ACTION)
+	if (aCode != HC_ACTION
+		|| sHookReplay && !g_HookReplay) // Real input bypasses the hook while HookReplay() is in progress.
 		return CallNextHookEx(g_MouseHook, aCode, wParam, lParam);
 
+	HookCallTimer timer;
+
 	MSLLHOOKSTRUCT &event = *(PMSLLHOOKSTRUCT)lParam;  // For convenience, maintainability, and possibly performance.
 
 	// Make all mouse events physical to try to simulate mouse clicks in games that normally ignore
@@ -2231,6 +2286,41 @@ LRESULT LowLevelCommon(const HHOOK aHook, int aCode, WPARAM wParam, LPARAM lPara
 
 
 
+static void PostHookEvent(UINT aMessage, WPARAM aWParam, LPARAM aLParam)
+// Posts a hotkey or hotstring message to the main thread and adds its timing to sHookEventRing.
+{
+	if (g_HookReplay) // Just count it, since the event being replayed didn't really happen.
+	{
+		if (aMessage == AHK_HOTSTRING)
+			++sHookReplay->hotstrings;
+		else
+			++sHookReplay->hotkeys;
+		return;
+	}
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER *)&now);
+	LONG head = sHookEventHead;
+	bool ring_is_full = (head - sHookEventTail >= HOOK_EVENT_RING_SIZE);
+	if (!ring_is_full)
+	{
+		// This is done before posting, in case the main thread receives the message right away.
+		HookEventTiming &item = sHookEventRing[head & (HOOK_EVENT_RING_SIZE - 1)];
+		item.message = aMessage;
+		item.wParam = aWParam;
+		item.hook_time = sHookCallTime;
+		item.post_time = now;
+		sHookEventHead = head + 1;
+	}
+	PostMessage(g_hWnd, aMessage, aWParam, aLParam);
+	++sHookCallStats.Seq;
+	++sHookCallStats.Posted;
+	if (ring_is_full) // The main thread isn't keeping up, or isn't receiving the messages.
+		++sHookCallStats.Dropped;
+	++sHookCallStats.Seq;
+}
+
+
+
 LRESULT SuppressThisKeyFunc(const HHOOK aHook, LPARAM lParam, const vk_type aVK, const sc_type aSC, bool aKeyUp
 	, KeyHistoryItem *pKeyHistoryCurr, WPARAM aHotkeyIDToPost, WPARAM aHSwParamToPost, LPARAM aHSlParamToPost)
 // Always use the parameter vk rather than event.vkCode because the caller or caller's caller
@@ -2294,16 +2384,16 @@ LRESULT SuppressThisKeyFunc(const HHOOK aHook, LPARAM lParam, const vk_type aVK,
 	// system settings of the same ilk as "favor background processes").
 	if (aHotkeyIDToPost != HOTKEY_ID_INVALID)
 	{
-		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, aHotkeyIDToPost, pKeyHistoryCurr->sc); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
+		PostHookEvent(AHK_HOOK_HOTKEY, aHotkeyIDToPost, pKeyHistoryCurr->sc); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
 		if (aKeyUp && hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK] != HOTKEY_ID_INVALID)
 		{
 			// This is a key-down hotkey being triggered by releasing a prefix key.
 			// There's also a corresponding key-up hotkey, so fire it too:
-    		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], pKeyHistoryCurr->sc);
+    		PostHookEvent(AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], pKeyHistoryCurr->sc);
 		}
 	}
 	if (aHSwParamToPost != HOTSTRING_INDEX_INVALID)
-		PostMessage(g_hWnd, AHK_HOTSTRING, aHSwParamToPost, aHSlParamToPost);
+		PostHookEvent(AHK_HOTSTRING, aHSwParamToPost, aHSlParamToPost);
 	return 1;
 }
 
@@ -2531,19 +2621,19 @@ LRESULT AllowIt(const HHOOK aHook, int aCode, WPARAM wParam, LPARAM lParam, cons
 	// call it before posting the messages.  This solves conditions in which the main thread is
 	// able to launch a script subroutine before the hook thread can finish updating its key state.
 	// Search on AHK_HOOK_HOTKEY in this file for more comments.
-	LRESULT result_to_return = CallNextHookEx(aHook, aCode, wParam, lParam);
+	LRESULT result_to_return = g_HookReplay ? 0 : CallNextHookEx(aHook, aCode, wParam, lParam);
 	if (aHotkeyIDToPost != HOTKEY_ID_INVALID)
 	{
-		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, aHotkeyIDToPost, pKeyHistoryCurr->sc); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
+		PostHookEvent(AHK_HOOK_HOTKEY, aHotkeyIDToPost, pKeyHistoryCurr->sc); // v1.0.43.03: sc is posted currently only to support the number of wheel turns (to store in A_EventInfo).
 		if (aKeyUp && hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK] != HOTKEY_ID_INVALID)
 		{
 			// This is a key-down hotkey being triggered by releasing a prefix key.
 			// There's also a corresponding key-up hotkey, so fire it too:
-    		PostMessage(g_hWnd, AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], pKeyHistoryCurr->sc);
+    		PostHookEvent(AHK_HOOK_HOTKEY, hotkey_up[aHotkeyIDToPost & HOTKEY_ID_MASK], pKeyHistoryCurr->sc);
 		}
 	}
 	if (hs_wparam_to_post != HOTSTRING_INDEX_INVALID)
-		PostMessage(g_hWnd, AHK_HOTSTRING, hs_wparam_to_post, hs_lparam_to_post);
+		PostHookEvent(AHK_HOTSTRING, hs_wparam_to_post, hs_lparam_to_post);
 	return result_to_return;
 }
 
@@ -2689,7 +2779,10 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 		// INPUT_TERMINATED_BY_ENDKEY above:
 		if (do_input && g_input.status == INPUT_IN_PROGRESS && g_input.BackspaceIsUndo) // Backspace is being used as an Undo key.
 			if (g_input.BufferLength)
+			{
 				g_input.buffer[--g_input.BufferLength] = '\0';
+				g_input.MatchState = g_input.MatchStateLength = 0; // Find the state from scratch upon the next char.
+			}
 		if (do_monitor_hotstring && g_HSBufLength)
 			g_HSBuf[--g_HSBufLength] = '\0';
 		if (sPendingDeadKeyVK) // Doing this produces the expected behavior when a backspace occurs immediately after a dead key.
@@ -2860,54 +2953,29 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 
 		if (g_HSBufLength)
 		{
-			TCHAR *cphs, *cpbuf, *cpcase_start, *cpcase_end;
+			TCHAR *cpbuf, *cpcase_start, *cpcase_end;
 			int case_capable_characters;
 			bool first_char_with_case_is_upper, first_char_with_case_has_gone_by;
 			CaseConformModes case_conform_mode;
 
 			// Searching through the hot strings in the original, physical order is the documented
 			// way in which precedence is determined, i.e. the first match is the only one that will
-			// be triggered.
-			for (HotstringIDType u = 0; u < Hotstring::sHotstringCount; ++u)
+			// be triggered.  HotstringMatcher yields only those whose abbreviation matches the end
+			// of the buffer (taking into account the end-char and case-sensitive options), in that
+			// order, so the cost per keystroke depends on the length of the buffer rather than how
+			// many hotstrings there are.
+			HotstringMatcher matcher;
+			for (HotstringIDType u; matcher.Next(u, cpbuf);)
 			{
 				Hotstring &hs = *shs[u];  // For performance and convenience.
 				if (hs.mSuspended)
 					continue;
-				if (hs.mEndCharRequired)
-				{
-					if (g_HSBufLength <= hs.mStringLength) // Ensure the string is long enough for loop below.
-						continue;
-					if (!_tcschr(g_EndChars, g_HSBuf[g_HSBufLength - 1])) // It's not an end-char, so no match.
-						continue;
-					cpbuf = g_HSBuf + g_HSBufLength - 2; // Init once for both loops. -2 to omit end-char.
-				}
-				else // No ending char required.
-				{
-					if (g_HSBufLength < hs.mStringLength) // Ensure the string is long enough for loop below.
-						continue;
-					cpbuf = g_HSBuf + g_HSBufLength - 1; // Init once for both loops.
-				}
-				cphs = hs.mString + hs.mStringLength - 1; // Init once for both loops.
-				// Check if this item is a match:
-				if (hs.mCaseSensitive)
-				{
-					for (; cphs >= hs.mString; --cpbuf, --cphs)
-						if (*cpbuf != *cphs)
-							break;
-				}
-				else // case insensitive
-					// v1.0.43.03: Using CharLower vs. tolower seems the best default behavior (even though slower)
-					// so that languages in which the higher ANSI characters are common will see "Ä" == "ä", etc.
-					for (; cphs >= hs.mString; --cpbuf, --cphs)
-						if (ltolower(*cpbuf) != ltolower(*cphs)) // v1.0.43.04: Fixed crash by properly casting to UCHAR (via macro).
-							break;
 
-				// Check if one of the loops above found a matching hotstring (relies heavily on
+				// Check if this matching hotstring is eligible to fire (relies heavily on
 				// short-circuit boolean order):
-				if (   cphs >= hs.mString // One of the loops above stopped early due discovering "no match"...
-					// ... or it did but the "?" option is not present to protect from the fact that
-					// what lies to the left of this hotstring abbreviation is an alphanumeric character:
-					|| !hs.mDetectWhenInsideWord && cpbuf >= g_HSBuf && IsHotstringWordChar(*cpbuf)
+				if (   // The "?" option is not present to protect from the fact that what lies to
+					// the left of this hotstring abbreviation is an alphanumeric character:
+					!hs.mDetectWhenInsideWord && cpbuf >= g_HSBuf && IsHotstringWordChar(*cpbuf)
 					// ... v1.0.41: Or it's a perfect match but the right window isn't active or doesn't exist.
 					// In that case, continue searching for other matches in case the script contains
 					// hotstrings that would trigger simultaneously were it not for the "only one" rule.
@@ -3154,68 +3222,149 @@ bool CollectInput(KBDLLHOOKSTRUCT &aEvent, const vk_type aVK, const sc_type aSC,
 		g_input.buffer[g_input.BufferLength] = '\0';
 	}
 
-	// Check if the buffer now matches any of the key phrases, if there are any:
-	if (g_input.FindAnywhere)
+	// Check if the buffer now matches any of the key phrases, if there are any.  Only the chars added since
+	// the last check need to be fed to the trie, except after a backspace or if the buffer was pre-filled.
+	if (g_input.MatchTrie)
 	{
-		if (g_input.CaseSensitive)
+		InputMatchTrie &trie = *g_input.MatchTrie;
+		while (g_input.MatchStateLength < g_input.BufferLength)
 		{
-			for (UINT i = 0; i < g_input.MatchCount; ++i)
+			g_input.MatchState = trie.Next(g_input.MatchState, g_input.buffer[g_input.MatchStateLength++]);
+			if (trie.mFindAnywhere && trie.IsMatch(g_input.MatchState)) // A phrase ends at this char.
 			{
-				if (_tcsstr(g_input.buffer, g_input.match[i]))
-				{
-					g_input.status = INPUT_TERMINATED_BY_MATCH;
-					return treat_as_visible;
-				}
+				g_input.status = INPUT_TERMINATED_BY_MATCH;
+				return treat_as_visible;
 			}
 		}
-		else // Not case sensitive.
+		if (trie.IsMatch(g_input.MatchState)) // The whole buffer is a phrase.
 		{
-			for (UINT i = 0; i < g_input.MatchCount; ++i)
-			{
-				// v1.0.43.03: Changed lstrcasestr to strcasestr because it seems unlikely to break any existing
-				// scripts and is also more useful given that Input with match-list is pretty rarely used,
-				// and even when it is used, match lists are usually short (so performance isn't impacted much
-				// by this change).
-				if (lstrcasestr(g_input.buffer, g_input.match[i]))
-				{
-					g_input.status = INPUT_TERMINATED_BY_MATCH;
-					return treat_as_visible;
-				}
-			}
+			g_input.status = INPUT_TERMINATED_BY_MATCH;
+			return treat_as_visible;
 		}
 	}
-	else // Exact match is required
+
+	// Otherwise, no match found.
+	if (g_input.BufferLength >= g_input.BufferLengthMax)
+		g_input.status = INPUT_LIMIT_REACHED;
+	return treat_as_visible;
+#undef shs  // To avoid naming conflicts
+}
+
+
+
+InputMatchTrie *InputMatchTrie::Create(LPTSTR *aMatch, UINT aMatchCount, bool aCaseSensitive, bool aFindAnywhere)
+{
+	#define INPUT_TRIE_NONE UINT_MAX
+	// As in HotstringTrie::Create(), children are kept in sorted lists while building, then the nodes are
+	// flattened breadth-first so that each node's children are contiguous.  Breadth-first order also ensures
+	// each node's fail link is known before those of its children, which are derived from it.
+	struct BuildNode
 	{
-		if (g_input.CaseSensitive)
+		TCHAR ch;
+		bool is_match;
+		UINT child, sibling;
+	};
+	UINT max_nodes = 1, node_count = 1, i, j;
+	for (i = 0; i < aMatchCount; ++i)
+		max_nodes += (UINT)_tcslen(aMatch[i]);
+
+	BuildNode *temp = (BuildNode *)malloc(max_nodes * (sizeof(BuildNode) + sizeof(UINT)));
+	if (!temp)
+		return NULL;
+	UINT *order = (UINT *)(temp + max_nodes); // The nodes in breadth-first order.
+	temp[0].ch = 0;
+	temp[0].is_match = false;
+	temp[0].child = temp[0].sibling = INPUT_TRIE_NONE;
+
+	for (i = 0; i < aMatchCount; ++i)
+	{
+		UINT n = 0;
+		for (LPTSTR cp = aMatch[i]; *cp; ++cp)
 		{
-			for (UINT i = 0; i < g_input.MatchCount; ++i)
+			TCHAR ch = aCaseSensitive ? *cp : ltolower(*cp);
+			UINT *link;
+			for (link = &temp[n].child; *link != INPUT_TRIE_NONE && (TBYTE)temp[*link].ch < (TBYTE)ch; link = &temp[*link].sibling);
+			if (*link == INPUT_TRIE_NONE || temp[*link].ch != ch)
 			{
-				if (!_tcscmp(g_input.buffer, g_input.match[i]))
-				{
-					g_input.status = INPUT_TERMINATED_BY_MATCH;
-					return treat_as_visible;
-				}
+				BuildNode &node = temp[node_count];
+				node.ch = ch;
+				node.is_match = false;
+				node.child = INPUT_TRIE_NONE;
+				node.sibling = *link;
+				*link = node_count++;
 			}
+			n = *link;
 		}
-		else // Not case sensitive.
+		temp[n].is_match = true;
+	}
+
+	InputMatchTrie *trie = (InputMatchTrie *)malloc(sizeof(InputMatchTrie) + node_count * sizeof(InputMatchNode));
+	if (!trie)
+	{
+		free(temp);
+		return NULL;
+	}
+	trie->mNode = (InputMatchNode *)(trie + 1);
+	trie->mCaseSensitive = aCaseSensitive;
+	trie->mFindAnywhere = aFindAnywhere;
+
+	UINT tail = 1;
+	order[0] = 0;
+	for (i = 0; i < node_count; ++i)
+	{
+		BuildNode &from = temp[order[i]];
+		InputMatchNode &node = trie->mNode[i];
+		node.mChar = from.ch;
+		node.mIsMatch = from.is_match;
+		node.mFirstChild = tail;
+		for (j = from.child; j != INPUT_TRIE_NONE; j = temp[j].sibling)
+			order[tail++] = j;
+		node.mChildCount = tail - node.mFirstChild;
+		node.mFail = 0;
+	}
+	free(temp);
+
+	if (aFindAnywhere)
+	{
+		// The fail link of a root's child is the root.  For deeper nodes, it's found by following the parent's
+		// fail links until one has a child with the same char.  Any phrase which ends at the fail node is also
+		// a suffix of this node's prefix, so is found here too.
+		for (i = 0; i < node_count; ++i)
 		{
-			for (UINT i = 0; i < g_input.MatchCount; ++i)
+			InputMatchNode &parent = trie->mNode[i];
+			for (j = parent.mFirstChild; j < parent.mFirstChild + parent.mChildCount; ++j)
 			{
-				// v1.0.43.03: Changed to locale-insensitive search.  See similar v1.0.43.03 comment above for more details.
-				if (!lstrcmpi(g_input.buffer, g_input.match[i]))
-				{
-					g_input.status = INPUT_TERMINATED_BY_MATCH;
-					return treat_as_visible;
-				}
+				InputMatchNode &node = trie->mNode[j];
+				node.mFail = i ? trie->Next(parent.mFail, node.mChar) : 0;
+				if (trie->mNode[node.mFail].mIsMatch)
+					node.mIsMatch = true;
 			}
 		}
 	}
+	return trie;
+	#undef INPUT_TRIE_NONE
+}
 
-	// Otherwise, no match found.
-	if (g_input.BufferLength >= g_input.BufferLengthMax)
-		g_input.status = INPUT_LIMIT_REACHED;
-	return treat_as_visible;
-#undef shs  // To avoid naming conflicts
+
+
+UINT InputMatchTrie::Next(UINT aState, TCHAR aChar)
+// Returns the state after aChar.  With FindAnywhere, this is amortized O(1): each char moves at most one
+// level deeper, so the fail links followed over the whole input can't outnumber the chars.
+{
+	if (!mCaseSensitive)
+		aChar = ltolower(aChar);
+	if (!mFindAnywhere)
+	{
+		UINT child;
+		return (aState != INPUT_MATCH_DEAD && (child = FindChild(aState, aChar))) ? child : INPUT_MATCH_DEAD;
+	}
+	for (;;)
+	{
+		UINT child = FindChild(aState, aChar);
+		if (child || !aState)
+			return child;
+		aState = mNode[aState].mFail;
+	}
 }
 
 
@@ -4181,10 +4330,9 @@ void AddRemoveHooks(HookType aHooksToBeActive, bool aChangeIsTemporary)
 	if (aHooksToBeActive == hooks_active_orig) // It's already in the right state.
 		return;
 
-	// It's done the following way because:
+	// sThreadHandle is used rather than g_HookThreadID to tell whether the thread exists because:
 	// It's unclear that zero is always an invalid thread ID (not even GetWindowThreadProcessId's
 	// documentation gives any hint), so its safer to assume that a thread ID can be zero and yet still valid.
-	static HANDLE sThreadHandle = NULL;
 
 	if (!hooks_active_orig) // Neither hook is active now but at least one will be or the above would have returned.
 	{
@@ -4431,6 +4579,53 @@ bool SystemHasAnotherMouseHook()
 
 
 #ifndef MINIDLL
+static void HookReplayChunk(HookReplayParams &aReplay)
+// Passes the next few events of a HookReplay() to the hook, timing each one.  Events are replayed in short
+// chunks so that the OS doesn't consider the hook unresponsive.  Real input which arrives between chunks
+// bypasses the hook (see LowLevelKeybdProc).
+{
+	HookType active_hooks = GetActiveHooks();
+	if (!sHookReplay) // First chunk.
+	{
+		sHookReplay = &aReplay;
+		ResetHook(false, active_hooks, true); // Start from a known state so that results are repeatable.
+	}
+	DWORD start_time = GetTickCount();
+	g_HookReplay = true;
+	do
+	{
+		HookReplayEvent event = aReplay.events[aReplay.next_event]; // Copy it, since the hook may alter it.
+		__int64 before, after;
+		QueryPerformanceCounter((LARGE_INTEGER *)&before);
+		if (event.is_mouse)
+		{
+			event.mouse.time = GetTickCount();
+			LowLevelMouseProc(HC_ACTION, event.message, (LPARAM)&event.mouse);
+		}
+		else
+		{
+			event.keybd.time = GetTickCount();
+			LowLevelKeybdProc(HC_ACTION, event.message, (LPARAM)&event.keybd);
+		}
+		QueryPerformanceCounter((LARGE_INTEGER *)&after);
+		aReplay.event_time[aReplay.next_event] = after - before;
+	} while (++aReplay.next_event < aReplay.event_count && GetTickCount() - start_time < 20);
+	g_HookReplay = false;
+	if (aReplay.next_event < aReplay.event_count)
+	{
+		if (PostThreadMessage(g_HookThreadID, AHK_HOOK_REPLAY, 0, (LPARAM)&aReplay)) // Continue after any pending input.
+			return;
+		// Otherwise, stop here rather than leaving the caller waiting.  Only the replayed events are reported.
+		aReplay.event_count = aReplay.next_event;
+	}
+	// Discard the state built up by the replayed events, as though the hook had been reinstalled.
+	ResetHook(false, active_hooks, true);
+	sHookReplay = NULL;
+	SetEvent(aReplay.done);
+}
+
+
+
 DWORD WINAPI HookThreadProc(LPVOID aUnused)
 // The creator of this thread relies on the fact that this function always exits its thread
 // when both hooks are deactivated.
@@ -4503,11 +4698,27 @@ DWORD WINAPI HookThreadProc(LPVOID aUnused)
 			// If caller passes true for msg.lParam, it wants a permanent change to hook state; so in that case, terminate this
 			// thread whenever neither hook is no longer present.
 			if (msg.lParam && !(g_KeybdHook || g_MouseHook)) // Both hooks are inactive (for whatever reason).
+			{
+				HotCriterionUnwatch(); // Must be done by this thread, which installed the window event hooks.
+				sHookReplay = NULL; // Any replay in progress is abandoned; HookReplay() sees this thread exit.
+				while (PeekMessage(&msg, NULL, AHK_HOOK_FREE, AHK_HOOK_FREE, PM_REMOVE)) // Don't leak these.
+					free((void *)msg.lParam);
 				return 0; // Thread is no longer needed. The "return" automatically calls ExitThread().
 				// 1) Due to this thread's non-GUI nature, there doesn't seem to be any need to call
 				// the somewhat mysterious PostQuitMessage() here.
 				// 2) For thread safety and maintainability, it seems best to have the caller take
 				// full responsibility for freeing the hook's memory.
+			}
+			break;
+
+		case AHK_HOOK_REPLAY:
+			HookReplayChunk(*(HookReplayParams *)msg.lParam);
+			break;
+
+		case AHK_HOOK_FREE:
+			// This message is retrieved only by the GetMessage() above, so no hook procedure (or replayed
+			// event) is in progress and none can still be using this memory.
+			free((void *)msg.lParam);
 			break;
 
 		} // switch (msg.message)
@@ -4654,6 +4865,21 @@ void FreeHookMem()
 
 
 
+void HookThreadFree(void *aMem)
+// Frees aMem, which the hook procedures might be using right now (such as a structure the hook
+// reads without locking, which the main thread has just replaced).  Rather than guessing when the
+// hook is done with it, hand it to the hook thread to free between events.
+// Caller must be the main thread, since it alone maintains sThreadHandle.
+{
+	DWORD exit_code;
+	if (aMem && sThreadHandle && GetExitCodeThread(sThreadHandle, &exit_code) && exit_code == STILL_ACTIVE
+		&& PostThreadMessage(g_HookThreadID, AHK_HOOK_FREE, 0, (LPARAM)aMem))
+		return; // The hook thread will free it, even if it exits first (see HookThreadProc).
+	free(aMem); // There's no hook thread, so nothing else can be using it.
+}
+
+
+
 void ResetKeyTypeState(key_type &key)
 {
 	key.is_down = false;
@@ -4739,4 +4965,94 @@ void GetHookStatus(LPTSTR aBuf, int aBufSize)
 		}
 	}
 }
+
+
+
+void HookEventReceived(UINT aMessage, WPARAM aWParam)
+// Called by the main thread upon receiving AHK_HOOK_HOTKEY or AHK_HOTSTRING, to complete the event's timing.
+{
+	__int64 now;
+	QueryPerformanceCounter((LARGE_INTEGER *)&now);
+	LONG head = sHookEventHead, tail = sHookEventTail;
+	// Normally the first item matches.  Any before the matching item are for messages which were never
+	// received, such as those discarded by an OnMessage function.
+	LONG i;
+	for (i = tail; i != head; ++i)
+	{
+		HookEventTiming &item = sHookEventRing[i & (HOOK_EVENT_RING_SIZE - 1)];
+		if (item.message == aMessage && item.wParam == aWParam)
+			break;
+	}
+	if (i == head) // No match, so the message probably wasn't posted by the hook.
+	{
+		if (head - tail >= HOOK_EVENT_RING_SIZE) // None of these messages will be received, so make room for new items.
+		{
+			sHookEventUnmatched += head - tail;
+			sHookEventTail = head;
+		}
+		return;
+	}
+	HookEventTiming &item = sHookEventHistory[sHookEventHistoryNext++ & (HOOK_EVENT_RING_SIZE - 1)];
+	item = sHookEventRing[i & (HOOK_EVENT_RING_SIZE - 1)];
+	sHookEventTail = i + 1; // Must be done after the above since it allows the hook thread to reuse the item.
+	item.receive_time = now;
+	__int64 queue_time = now - item.post_time;
+	sHookEventUnmatched += i - tail;
+	++sHookEventReceived;
+	sHookEventQueueTime += queue_time;
+	if (sHookEventQueueTimeMax < queue_time)
+		sHookEventQueueTimeMax = queue_time;
+}
+
+
+
+void GetHookEventStats(HookEventStats &aStats)
+{
+	if (sHookCallStatsReset) // The hook hasn't been called since the reset.
+	{
+		aStats.HookCalls = aStats.HookTime = aStats.HookTimeMax = 0;
+		aStats.Posted = aStats.Dropped = 0;
+	}
+	else
+	{
+		LONG seq;
+		do
+		{
+			while ((seq = sHookCallStats.Seq) & 1)
+				YieldProcessor(); // The hook thread is updating the counters.
+			aStats.HookCalls = sHookCallStats.Calls;
+			aStats.HookTime = sHookCallStats.Time;
+			aStats.HookTimeMax = sHookCallStats.TimeMax;
+			aStats.Posted = sHookCallStats.Posted;
+			aStats.Dropped = sHookCallStats.Dropped;
+		} while (seq != sHookCallStats.Seq);
+	}
+	aStats.Received = sHookEventReceived;
+	aStats.QueueTime = sHookEventQueueTime;
+	aStats.QueueTimeMax = sHookEventQueueTimeMax;
+	aStats.Unmatched = sHookEventUnmatched;
+	QueryPerformanceFrequency((LARGE_INTEGER *)&aStats.Frequency);
+}
+
+
+
+void ResetHookEventStats()
+{
+	sHookCallStatsReset = true; // The hook thread resets its own counters when it is next called.
+	sHookEventReceived = sHookEventQueueTime = sHookEventQueueTimeMax = sHookEventUnmatched = 0;
+	sHookEventHistoryNext = 0;
+}
+
+
+
+int GetHookEventHistory(HookEventTiming *aBuf)
+// Copies the timing of the most recently received events into aBuf, oldest first.
+// aBuf must have room for HOOK_EVENT_RING_SIZE items.  Returns the number of items copied.
+{
+	int count = 0;
+	LONG i = sHookEventHistoryNext > HOOK_EVENT_RING_SIZE ? sHookEventHistoryNext - HOOK_EVENT_RING_SIZE : 0;
+	for (; i < sHookEventHistoryNext; ++i)
+		aBuf[count++] = sHookEventHistory[i & (HOOK_EVENT_RING_SIZE - 1)];
+	return count;
+}
 #endif // MINIDLL
\ No newline at end of file
@@ -46,6 +46,10 @@ enum UserMessages {AHK_HOOK_HOTKEY = WM_USER, AHK_HOTSTRING, AHK_USER_MENU, AHK_
 	, AHK_EXECUTE_FUNCTION_VARIANT
 	, AHK_EXECUTE_LABEL
 	, AHK_EXECUTE_FUNCTION_DLL // HotkeyIt for ahkFunction
+	, AHK_ASYNC_CALLBACK // wParam is an AsyncResult whose script callback is due to be called.
+	, AHK_HOT_IF_SPECULATE // The hook requests that #if expressions be evaluated ahead of time (see #IfSpeculate).
+	, AHK_HOOK_REPLAY // Sent to the hook thread by HookReplay(). lParam is a HookReplayParams.
+	, AHK_HOOK_FREE // Sent to the hook thread by HookThreadFree(). lParam is the memory to free().
 };
 // NOTE: TRY NEVER TO CHANGE the specific numbers of the above messages, since some users might be
 // using the Post/SendMessage commands to automate AutoHotkey itself.  Here is the original order
@@ -190,6 +194,43 @@ enum InputStatusType {INPUT_OFF, INPUT_IN_PROGRESS, INPUT_TIMED_OUT, INPUT_TERMI
 #define END_KEY_WITH_SHIFT 0x02
 #define END_KEY_WITHOUT_SHIFT 0x04
 
+struct InputMatchNode
+{
+	TCHAR mChar; // The char leading to this node from its parent (lowercase unless case-sensitive).
+	bool mIsMatch; // A match phrase ends here or, if FindAnywhere, at any node in the mFail chain.
+	UINT mFirstChild, mChildCount; // A node's children are contiguous and sorted by mChar.
+	UINT mFail; // If FindAnywhere, the node for the longest proper suffix of this node's phrase prefix.
+};
+
+class InputMatchTrie
+// The Input command's MatchList, compiled so that the hook can advance through it one char at a time rather
+// than comparing the buffer with every phrase after each keystroke.  If FindAnywhere, the mFail links make it
+// an Aho-Corasick automaton which finds phrases anywhere in the buffer.
+{
+public:
+	InputMatchNode *mNode; // mNode[0] is the root.
+	bool mCaseSensitive, mFindAnywhere;
+	#define INPUT_MATCH_DEAD UINT_MAX // The state after a char which no phrase has at that position (exact matching only).
+
+	static InputMatchTrie *Create(LPTSTR *aMatch, UINT aMatchCount, bool aCaseSensitive, bool aFindAnywhere); // Caller must free() the result.
+	UINT FindChild(UINT aNode, TCHAR aChar)
+	// Returns 0 (the root, which is never a child) if there is no such child.
+	{
+		UINT lo = mNode[aNode].mFirstChild, hi = lo + mNode[aNode].mChildCount, end = hi, mid;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			if ((TBYTE)mNode[mid].mChar < (TBYTE)aChar)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return (lo < end && mNode[lo].mChar == aChar) ? lo : 0;
+	}
+	UINT Next(UINT aState, TCHAR aChar);
+	bool IsMatch(UINT aState) { return aState != INPUT_MATCH_DEAD && mNode[aState].mIsMatch; }
+};
+
 struct input_type
 {
 	InputStatusType status;
@@ -207,6 +248,9 @@ struct input_type
 	#define INPUT_ARRAY_BLOCK_SIZE 1024  // The increment by which the above array expands.
 	LPTSTR MatchBuf; // The is the buffer whose contents are pointed to by the match array.
 	UINT MatchBufSize; // The capacity of the above buffer.
+	InputMatchTrie *MatchTrie; // The match array compiled for the hook, or NULL if there's no MatchList.
+	UINT MatchState; // The state of MatchTrie after the first MatchStateLength chars of buffer.
+	int MatchStateLength;
 	bool BackspaceIsUndo;
 	bool CaseSensitive;
 	bool IgnoreAHKInput; // Whether input from any AHK script is ignored for the purpose of finding a match.
@@ -217,7 +261,7 @@ struct input_type
 	int BufferLength; // The current length of what the user entered.
 	int BufferLengthMax; // The maximum allowed length of the input.
 	input_type::input_type() // A simple constructor to initialize the fields that need it.
-		: status(INPUT_OFF), match(NULL), MatchBuf(NULL), MatchBufSize(0), buffer(NULL)
+		: status(INPUT_OFF), match(NULL), MatchBuf(NULL), MatchBufSize(0), MatchTrie(NULL), buffer(NULL)
 	{}
 };
 
@@ -244,6 +288,53 @@ struct KeyHistoryItem
 };
 
 
+//-------------------------------------------
+
+// Timing of a hotkey or hotstring event which the hook posted to the main thread.  Times are
+// QueryPerformanceCounter() values.  The hook thread adds these to a single-producer/single-consumer
+// ring, from which the main thread removes them as it receives the corresponding messages.
+struct HookEventTiming
+{
+	UINT message; // AHK_HOOK_HOTKEY or AHK_HOTSTRING.
+	WPARAM wParam; // The hotkey or hotstring ID.
+	__int64 hook_time;    // When the hook was called for the keyboard or mouse event.
+	__int64 post_time;    // When the message was posted.
+	__int64 receive_time; // When the main thread received the message.
+};
+#define HOOK_EVENT_RING_SIZE 256 // Must be a power of 2.
+
+struct HookEventStats // A snapshot of the counters, as returned by GetHookEventStats().
+{
+	__int64 HookCalls, HookTime, HookTimeMax; // Time spent in the keyboard and mouse hook callbacks.
+	__int64 Posted, Dropped; // Dropped is the number of events not timed because the ring was full.
+	__int64 Received, QueueTime, QueueTimeMax; // Time between posting and receiving each event.
+	__int64 Unmatched; // Timed events whose message was never received (e.g. it was discarded by OnMessage).
+	__int64 Frequency; // For converting the above times to seconds.
+};
+
+// A keyboard or mouse event to be passed to the hook by HookReplay(), as though it came from the OS.
+struct HookReplayEvent
+{
+	bool is_mouse;
+	WPARAM message; // The hook's wParam: WM_KEYDOWN, WM_LBUTTONUP, etc.
+	union
+	{
+		KBDLLHOOKSTRUCT keybd;
+		MSLLHOOKSTRUCT mouse;
+	};
+};
+
+struct HookReplayParams
+{
+	HookReplayEvent *events;
+	int event_count;
+	int next_event; // Used by the hook thread to resume after giving real input a turn.
+	__int64 *event_time; // Receives the QueryPerformanceCounter() time taken by the hook for each event.
+	int hotkeys, hotstrings; // The number of hotkey and hotstring messages the hook would have posted.
+	HANDLE done; // Signalled by the hook thread when all events have been replayed.
+};
+
+
 //-------------------------------------------
 
 
@@ -283,7 +374,12 @@ void ResetHook(bool aAllModifiersUp = false, HookType aWhichHook = (HOOK_KEYBD |
 	, bool aResetKVKandKSC = false);
 HookType GetActiveHooks();
 void FreeHookMem();
+void HookThreadFree(void *aMem);
 void ResetKeyTypeState(key_type &key);
 void GetHookStatus(LPTSTR aBuf, int aBufSize);
+void HookEventReceived(UINT aMessage, WPARAM aWParam);
+void GetHookEventStats(HookEventStats &aStats);
+void ResetHookEventStats();
+int GetHookEventHistory(HookEventTiming *aBuf);
 #endif // MINIDLL
 #endif
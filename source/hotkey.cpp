@@ -34,6 +34,104 @@ DWORD Hotkey::sJoyHotkeyCount = 0;
 
 
 
+// Window criteria are cached by the hook thread until one of the window events below is seen.
+// sHotCriterionGeneration is bumped by each such event; zero means the events aren't being watched.
+static UINT sHotCriterionGeneration = 0;
+static bool sHotCriterionWatchFailed = false;
+static HWINEVENTHOOK sHotCriterionEventHook[3] = {NULL};
+static volatile LONG sHotExprSpeculatePending = FALSE;
+
+static void RequestHotExprSpeculation()
+// Called by the hook thread to have the main thread evaluate all #if expressions ahead of time.
+{
+	if (!InterlockedExchange(&sHotExprSpeculatePending, TRUE))
+		PostMessage(g_hWnd, AHK_HOT_IF_SPECULATE, 0, 0);
+}
+
+static void CALLBACK HotCriterionWinEventProc(HWINEVENTHOOK aHook, DWORD aEvent, HWND aHwnd, LONG aObjectID
+	, LONG aChildID, DWORD aEventThread, DWORD aEventTime)
+{
+	if (aObjectID != OBJID_WINDOW || aChildID != CHILDID_SELF)
+		return;
+	// Changes to controls can't affect the result, except that a control's text is its window's WinText,
+	// which disqualifies the criterion from caching anyway.  EVENT_OBJECT_DESTROY is let through since
+	// the window's style can't be reliably retrieved at that point.
+	if (aEvent != EVENT_OBJECT_DESTROY && (GetWindowLong(aHwnd, GWL_STYLE) & WS_CHILD))
+		return;
+	if (!++sHotCriterionGeneration) // Skip zero since it means "not watching".
+		sHotCriterionGeneration = 1;
+	if (aEvent == EVENT_SYSTEM_FOREGROUND && g_HotExprSpeculate && g_FirstHotExpr)
+		RequestHotExprSpeculation();
+}
+
+static bool HotCriterionWatch()
+// Installs the window event hooks which invalidate cached criteria.  Must be called on the hook thread,
+// since out-of-context events are delivered to the thread which installed the hook.
+{
+	if (sHotCriterionGeneration)
+		return true;
+	if (sHotCriterionWatchFailed)
+		return false;
+	// These events are delivered to the hook thread, so keep them to the minimum needed: CREATE and
+	// REORDER fire far more often than the others (and creation only matters for hidden windows, which
+	// aren't cached; see below).
+	static const DWORD sEventRange[][2] = {
+		{EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND},
+		{EVENT_OBJECT_DESTROY, EVENT_OBJECT_HIDE}, // Includes SHOW.
+		{EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE}
+	};
+	for (int i = 0; i < _countof(sHotCriterionEventHook); ++i)
+	{
+		if (  !(sHotCriterionEventHook[i] = SetWinEventHook(sEventRange[i][0], sEventRange[i][1], NULL
+			, HotCriterionWinEventProc, 0, 0, WINEVENT_OUTOFCONTEXT))  )
+		{
+			HotCriterionUnwatch();
+			sHotCriterionWatchFailed = true; // Don't retry on every keystroke; just evaluate each time.
+			return false;
+		}
+	}
+	sHotCriterionGeneration = 1;
+	return true;
+}
+
+void HotCriterionUnwatch()
+// Called by the hook thread just before it exits.
+{
+	for (int i = 0; i < _countof(sHotCriterionEventHook); ++i)
+		if (sHotCriterionEventHook[i])
+		{
+			UnhookWinEvent(sHotCriterionEventHook[i]);
+			sHotCriterionEventHook[i] = NULL;
+		}
+	sHotCriterionGeneration = 0;
+	sHotCriterionWatchFailed = false;
+	// Cached results become invalid since the generation will restart at 1 when the hook thread is recreated:
+	for (HotkeyCriterion *cp = g_FirstHotCriterion; cp; cp = cp->NextCriterion)
+		cp->CachedGeneration = 0;
+}
+
+
+
+void SpeculateHotCriteria()
+// Called by the main thread when the hook posts AHK_HOT_IF_SPECULATE.  Evaluates each #if expression so that
+// the hook can use the result without waiting for the main thread (see #IfSpeculate).  Callbacks aren't
+// evaluated since they receive the hotkey name, which isn't known in advance.
+{
+	InterlockedExchange(&sHotExprSpeculatePending, FALSE); // Do this first so that any change after this point triggers another update.
+	for (HotkeyCriterion *cp = g_FirstHotExpr; cp; cp = cp->NextCriterion)
+	{
+		if (cp->Type != HOT_IF_EXPR)
+			continue;
+		if (g_nThreads >= g_MaxThreadsTotal)
+			return; // Leave the old results to expire rather than recording a false negative.
+		ResultType result = cp->Eval(_T(""), true);
+		DWORD tick = GetTickCount() & ~1;
+		cp->SpeculatedResult = (tick ? tick : 2) | (result == CONDITION_TRUE);
+	}
+}
+
+
+
 HWND HotCriterionAllowsFiring(HotkeyCriterion *aCriterion, LPTSTR aHotkeyName)
 // This is a global function because it's used by both hotkeys and hotstrings.
 // In addition to being called by the hook thread, this can now be called by the main thread.
@@ -44,18 +142,64 @@ HWND HotCriterionAllowsFiring(HotkeyCriterion *aCriterion, LPTSTR aHotkeyName)
 	HWND found_hwnd;
 	if (!aCriterion)
 		return (HWND)1; // Always allow hotkey to fire.
+	bool use_cache = false;
+	UCHAR settings = 0;
 	switch(aCriterion->Type)
 	{
 	case HOT_IF_ACTIVE:
 	case HOT_IF_NOT_ACTIVE:
-		found_hwnd = WinActive(g_default, aCriterion->WinTitle, aCriterion->WinText, _T(""), _T(""), false); // Thread-safe.
-		break;
 	case HOT_IF_EXIST:
 	case HOT_IF_NOT_EXIST:
-		found_hwnd = WinExist(g_default, aCriterion->WinTitle, aCriterion->WinText, _T(""), _T(""), false, false); // Thread-safe.
+		// Only the hook thread caches results, since only it receives the events which invalidate them.
+		// Window events are delivered asynchronously, so a result could be stale for the short time
+		// between a change and the hook thread processing the event.  The foreground window is checked
+		// directly since it's cheap and is the most likely thing to change right before a keystroke.
+		// Since window creation isn't watched, results which could depend on hidden windows aren't cached.
+		if (aCriterion->Cacheable && !g_default.DetectHiddenWindows
+			&& GetCurrentThreadId() == g_HookThreadID && HotCriterionWatch())
+		{
+			use_cache = true;
+			settings = (UCHAR)(g_default.TitleMatchMode << 1 | g_default.DetectHiddenWindows);
+			HWND fore_win = (aCriterion->Type == HOT_IF_ACTIVE || aCriterion->Type == HOT_IF_NOT_ACTIVE) ? GetForegroundWindow() : NULL;
+			if (aCriterion->CachedGeneration == sHotCriterionGeneration && aCriterion->CachedSettings == settings
+				&& aCriterion->CachedForeground == fore_win)
+			{
+				found_hwnd = aCriterion->CachedHwnd;
+				break;
+			}
+			aCriterion->CachedForeground = fore_win;
+		}
+		// The criteria aren't kept in a prebuilt WindowSearch: one is about 70 KB due to its candidate
+		// buffers, and SetCriteria only scans WinTitle, which is cheap compared to fetching each window's
+		// title, class and process.  The cache above avoids the latter.
+		if (aCriterion->Type == HOT_IF_ACTIVE || aCriterion->Type == HOT_IF_NOT_ACTIVE)
+			found_hwnd = WinActive(g_default, aCriterion->WinTitle, aCriterion->WinText, _T(""), _T(""), false); // Thread-safe.
+		else
+			found_hwnd = WinExist(g_default, aCriterion->WinTitle, aCriterion->WinText, _T(""), _T(""), false, false); // Thread-safe.
+		if (use_cache)
+		{
+			aCriterion->CachedHwnd = found_hwnd;
+			aCriterion->CachedSettings = settings;
+			aCriterion->CachedGeneration = sHotCriterionGeneration;
+		}
 		break;
 	// L4: Handling of #if (expression) hotkey variants.
 	case HOT_IF_EXPR:
+		if (g_HotExprSpeculate)
+		{
+			// Use the result of the most recent speculative evaluation if it is recent enough.  Either way,
+			// request another evaluation so that the result is fresh for the next keystroke.
+			DWORD speculated = aCriterion->SpeculatedResult;
+			RequestHotExprSpeculation();
+			if (speculated && GetTickCount() - (speculated & ~1) <= g_HotExprSpeculate)
+			{
+				if (!(speculated & 1))
+					return NULL;
+				g_HotExprLFW = aCriterion->SpeculatedLFW;
+				return (HWND)1;
+			}
+		}
+		// Otherwise, evaluate it now:
 	case HOT_IF_CALLBACK:
 		// Expression evaluation must be done in the main thread. If the message times out, the hotkey/hotstring is not allowed to fire.
 		DWORD_PTR res;
@@ -97,6 +241,11 @@ ResultType SetHotkeyCriterion(HotCriterionType aType, LPTSTR aWinTitle, LPTSTR a
 	cp->Type = aType;
 	cp->ExprLine = NULL;
 	cp->NextCriterion = NULL;
+	// Without WinText or ahk_group, the result depends only on the windows which exist (or the active
+	// window) and their titles, classes, etc., so the hook can cache it until a window event is seen.
+	cp->Cacheable = !*aWinText && !tcscasestr(aWinTitle, _T("ahk_group"));
+	cp->CachedGeneration = 0;
+	cp->SpeculatedResult = 0;
 	if (*aWinTitle)
 	{
 		if (   !(cp->WinTitle = SimpleHeap::Malloc(aWinTitle))   )
@@ -134,6 +283,9 @@ HotkeyCriterion *AddHotkeyIfExpr()
 	if (   !(cp = (HotkeyCriterion *)SimpleHeap::Malloc(sizeof(HotkeyCriterion)))   )
 		return NULL;
 	cp->NextCriterion = NULL;
+	cp->Cacheable = false;
+	cp->CachedGeneration = 0;
+	cp->SpeculatedResult = 0;
 	if (g_LastHotExpr)
 		g_LastHotExpr->NextCriterion = cp;
 	else
@@ -431,6 +583,9 @@ void Hotkey::ManifestAllHotkeysHotstringsHooks()
 	if (g_BlockMouseMove || (g_HSResetUponMouseClick && Hotstring::mAtLeastOneEnabled))
 		sWhichHookNeeded |= HOOK_MOUSE;
 
+	// Rebuild the hook's index of hotstrings if any have been added.
+	Hotstring::UpdateTrie();
+
 	// Install or deinstall either or both hooks, if necessary, based on these param values.
 	ChangeHookState(shk, sHotkeyCount, sWhichHookNeeded, sWhichHookAlways);
 
@@ -2423,6 +2578,7 @@ Hotstring **Hotstring::shs = NULL;
 HotstringIDType Hotstring::sHotstringCount = 0;
 HotstringIDType Hotstring::sHotstringCountMax = 0;
 bool Hotstring::mAtLeastOneEnabled = false;
+HotstringTrie *Hotstring::sTrie = NULL;
 
 
 void Hotstring::AllDestruct()
@@ -2440,6 +2596,223 @@ void Hotstring::AllDestruct()
 	shs = NULL;
 	sHotstringCount = 0;
 	sHotstringCountMax = 0;
+	HookThreadFree(sTrie); // The hooks have normally been removed by now, in which case it's freed immediately.
+	sTrie = NULL;
+}
+
+
+
+void Hotstring::UpdateTrie()
+// Called by ManifestAllHotkeysHotstringsHooks().  Hotstrings are only ever appended (or all destroyed),
+// so the trie needs rebuilding only if the count has changed.  Options such as suspension and #If
+// criteria aren't part of the trie since the hook checks them for each match.
+{
+	if (sTrie ? sTrie->mHotstringCount == sHotstringCount : !sHotstringCount)
+		return;
+	HotstringTrie *trie = sHotstringCount ? HotstringTrie::Create() : NULL; // If it fails, the hook compares every hotstring.
+	// The hook thread might be in the middle of using the old trie, so have it free the old one
+	// once it's between events.  HotstringMatcher reads sTrie only once per event.
+	HotstringTrie *old_trie = sTrie;
+	sTrie = trie;
+	HookThreadFree(old_trie);
+}
+
+
+
+HotstringTrie *HotstringTrie::Create()
+{
+	#define HS_TRIE_NONE UINT_MAX
+	// While building, each node's children are kept in a list sorted by char, and each node's hotstrings
+	// in a list in order of definition.  These are then flattened breadth-first into the final array so
+	// that each node's children are contiguous (and still sorted).
+	struct BuildNode
+	{
+		TCHAR ch;
+		UINT child, sibling, first_id, last_id, id_count;
+	};
+	HotstringIDType hs_count = Hotstring::sHotstringCount, u;
+	UINT max_nodes = HS_TRIE_ROOTS, node_count, id_pos, i, j;
+	for (u = 0; u < hs_count; ++u)
+		max_nodes += Hotstring::shs[u]->mStringLength;
+
+	BuildNode *temp = (BuildNode *)malloc(max_nodes * (sizeof(BuildNode) + sizeof(UINT)) + hs_count * sizeof(UINT));
+	if (!temp)
+		return NULL;
+	UINT *order = (UINT *)(temp + max_nodes); // The nodes in breadth-first order.
+	UINT *next_id = order + max_nodes; // The next hotstring in the same node's list.
+
+	for (node_count = 0; node_count < HS_TRIE_ROOTS; ++node_count)
+	{
+		BuildNode &root = temp[node_count];
+		root.ch = 0;
+		root.child = root.sibling = root.first_id = root.last_id = HS_TRIE_NONE;
+		root.id_count = 0;
+	}
+
+	for (u = 0; u < hs_count; ++u)
+	{
+		Hotstring &hs = *Hotstring::shs[u];
+		i = HS_TRIE_ROOT(hs.mCaseSensitive, hs.mEndCharRequired);
+		for (LPTSTR cp = hs.mString + hs.mStringLength - 1; cp >= hs.mString; --cp)
+		{
+			TCHAR ch = hs.mCaseSensitive ? *cp : ltolower(*cp); // Same comparison as the hook would otherwise do.
+			UINT *link;
+			for (link = &temp[i].child; *link != HS_TRIE_NONE && (TBYTE)temp[*link].ch < (TBYTE)ch; link = &temp[*link].sibling);
+			if (*link == HS_TRIE_NONE || temp[*link].ch != ch)
+			{
+				BuildNode &node = temp[node_count];
+				node.ch = ch;
+				node.child = node.first_id = node.last_id = HS_TRIE_NONE;
+				node.sibling = *link;
+				node.id_count = 0;
+				*link = node_count++;
+			}
+			i = *link;
+		}
+		next_id[u] = HS_TRIE_NONE;
+		if (temp[i].last_id == HS_TRIE_NONE)
+			temp[i].first_id = u;
+		else
+			next_id[temp[i].last_id] = u;
+		temp[i].last_id = u;
+		++temp[i].id_count;
+	}
+
+	HotstringTrie *trie = (HotstringTrie *)malloc(sizeof(HotstringTrie) + node_count * sizeof(HotstringTrieNode) + hs_count * sizeof(HotstringIDType));
+	if (!trie)
+	{
+		free(temp);
+		return NULL;
+	}
+	trie->mNode = (HotstringTrieNode *)(trie + 1);
+	trie->mID = (HotstringIDType *)(trie->mNode + node_count);
+	trie->mHotstringCount = hs_count;
+
+	UINT tail = HS_TRIE_ROOTS;
+	for (i = 0; i < HS_TRIE_ROOTS; ++i)
+		order[i] = i;
+	for (i = 0, id_pos = 0; i < node_count; ++i)
+	{
+		BuildNode &from = temp[order[i]];
+		HotstringTrieNode &node = trie->mNode[i];
+		node.mChar = from.ch;
+		node.mFirstChild = tail;
+		for (j = from.child; j != HS_TRIE_NONE; j = temp[j].sibling)
+			order[tail++] = j;
+		node.mChildCount = tail - node.mFirstChild;
+		node.mFirstID = id_pos;
+		node.mIDCount = from.id_count;
+		for (j = from.first_id; j != HS_TRIE_NONE; j = next_id[j])
+			trie->mID[id_pos++] = j;
+	}
+
+	free(temp);
+	return trie;
+	#undef HS_TRIE_NONE
+}
+
+
+
+HotstringMatcher::HotstringMatcher()
+	: mRangeCount(0), mTrie(Hotstring::sTrie)
+// Caller has ensured g_HSBufLength > 0.
+{
+	// Any hotstrings added since the trie was built (such as by addScript) are compared the old way,
+	// after those in the trie since their IDs are higher.
+	mLinearID = mTrie ? mTrie->mHotstringCount : 0;
+	if (!mTrie)
+		return;
+	LPTSTR last = g_HSBuf + g_HSBufLength - 1;
+	Walk(HS_TRIE_ROOT(false, false), last, false);
+	Walk(HS_TRIE_ROOT(true, false), last, true);
+	if (_tcschr(g_EndChars, *last)) // Otherwise, no hotstring which requires an end-char can match.
+	{
+		Walk(HS_TRIE_ROOT(false, true), last - 1, false); // -1 to omit end-char.
+		Walk(HS_TRIE_ROOT(true, true), last - 1, true);
+	}
+}
+
+
+
+void HotstringMatcher::Walk(UINT aRoot, LPTSTR aEnd, bool aCaseSensitive)
+// Follows the chars of g_HSBuf from aEnd leftward, noting the hotstrings at each node reached.
+// Since the trie is no deeper than MAX_HOTSTRING_LENGTH, this notes at most that many + 1 ranges.
+{
+	UINT node = aRoot;
+	for (LPTSTR cp = aEnd; ; --cp)
+	{
+		HotstringTrieNode &n = mTrie->mNode[node];
+		if (n.mIDCount)
+		{
+			Range &range = mRange[mRangeCount++];
+			range.mNext = mTrie->mID + n.mFirstID;
+			range.mEnd = range.mNext + n.mIDCount;
+			range.mBefore = cp;
+		}
+		if (cp < g_HSBuf || !(node = mTrie->FindChild(node, aCaseSensitive ? *cp : ltolower(*cp))))
+			break;
+	}
+}
+
+
+
+bool HotstringMatcher::Next(HotstringIDType &aID, LPTSTR &aBefore)
+// Sets aID to the next matching hotstring and aBefore to the char to the left of its abbreviation
+// (which is before g_HSBuf if there is none).  Returns false when there are no more.
+{
+	// Each range is already in order, so take whichever has the lowest ID next.
+	Range *best = NULL;
+	for (int i = 0; i < mRangeCount; ++i)
+		if (mRange[i].mNext < mRange[i].mEnd && (!best || *mRange[i].mNext < *best->mNext))
+			best = mRange + i;
+	if (!best)
+		return NextLinear(aID, aBefore);
+	aID = *best->mNext++;
+	aBefore = best->mBefore;
+	return aID < Hotstring::sHotstringCount;
+}
+
+
+
+bool HotstringMatcher::NextLinear(HotstringIDType &aID, LPTSTR &aBefore)
+{
+	TCHAR *cphs, *cpbuf;
+	while (mLinearID < Hotstring::sHotstringCount)
+	{
+		Hotstring &hs = *Hotstring::shs[mLinearID++];
+		if (hs.mEndCharRequired)
+		{
+			if (g_HSBufLength <= hs.mStringLength) // Ensure the string is long enough for loop below.
+				continue;
+			if (!_tcschr(g_EndChars, g_HSBuf[g_HSBufLength - 1])) // It's not an end-char, so no match.
+				continue;
+			cpbuf = g_HSBuf + g_HSBufLength - 2; // Init once for both loops. -2 to omit end-char.
+		}
+		else // No ending char required.
+		{
+			if (g_HSBufLength < hs.mStringLength) // Ensure the string is long enough for loop below.
+				continue;
+			cpbuf = g_HSBuf + g_HSBufLength - 1; // Init once for both loops.
+		}
+		cphs = hs.mString + hs.mStringLength - 1; // Init once for both loops.
+		if (hs.mCaseSensitive)
+		{
+			for (; cphs >= hs.mString; --cpbuf, --cphs)
+				if (*cpbuf != *cphs)
+					break;
+		}
+		else // case insensitive
+			for (; cphs >= hs.mString; --cpbuf, --cphs)
+				if (ltolower(*cpbuf) != ltolower(*cphs))
+					break;
+		if (cphs < hs.mString) // The loop above didn't stop early, so it's a match.
+		{
+			aID = mLinearID - 1;
+			aBefore = cpbuf;
+			return true;
+		}
+	}
+	return false;
 }
 
 
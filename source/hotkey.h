@@ -62,6 +62,8 @@ bool HotInputLevelAllowsFiring(SendLevelType inputLevel, ULONG_PTR aEventExtraIn
 ResultType SetHotkeyCriterion(HotCriterionType aType, LPTSTR aWinTitle, LPTSTR aWinText);
 HotkeyCriterion *AddHotkeyIfExpr();
 HotkeyCriterion *FindHotkeyIfExpr(LPTSTR aExpr);
+void HotCriterionUnwatch(); // Called by the hook thread before it exits.
+void SpeculateHotCriteria(); // Called by the main thread for AHK_HOT_IF_SPECULATE.
 
 
 
@@ -325,6 +327,44 @@ typedef UINT HotstringIDType;
 
 enum CaseConformModes {CASE_CONFORM_NONE, CASE_CONFORM_ALL_CAPS, CASE_CONFORM_FIRST_CAP};
 
+// The trie has a separate root for each combination of these options, since they decide
+// how the abbreviation is compared with g_HSBuf and where in g_HSBuf it must end.
+#define HS_TRIE_ROOTS 4
+#define HS_TRIE_ROOT(aCaseSensitive, aEndCharRequired) (((aCaseSensitive) ? 1 : 0) | ((aEndCharRequired) ? 2 : 0))
+
+struct HotstringTrieNode
+{
+	TCHAR mChar; // The char leading to this node from its parent (lowercase under a case-insensitive root).
+	UINT mFirstChild, mChildCount; // A node's children are contiguous and sorted by mChar.
+	UINT mFirstID, mIDCount; // Range within mID of the hotstrings whose abbreviation ends here, in order of definition.
+};
+
+class HotstringTrie
+// Each hotstring abbreviation, reversed, so that the hook can find all hotstrings which match the
+// end of g_HSBuf by walking back through it once, rather than comparing it with every hotstring.
+{
+public:
+	HotstringTrieNode *mNode; // mNode[0..HS_TRIE_ROOTS-1] are the roots.
+	HotstringIDType *mID;
+	HotstringIDType mHotstringCount; // The value of sHotstringCount when the trie was built.
+
+	static HotstringTrie *Create(); // Caller must free() the result.
+	UINT FindChild(UINT aNode, TCHAR aChar)
+	// Returns 0 (which is a root, so never a child) if there is no such child.
+	{
+		UINT lo = mNode[aNode].mFirstChild, hi = lo + mNode[aNode].mChildCount, end = hi, mid;
+		while (lo < hi)
+		{
+			mid = (lo + hi) / 2;
+			if ((TBYTE)mNode[mid].mChar < (TBYTE)aChar)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return (lo < end && mNode[lo].mChar == aChar) ? lo : 0;
+	}
+};
+
 
 class Hotstring
 {
@@ -333,6 +373,7 @@ public:
 	static HotstringIDType sHotstringCount;
 	static HotstringIDType sHotstringCountMax;
 	static bool mAtLeastOneEnabled; // v1.0.44.08: For performance, such as avoiding calling ToAsciiEx() in the hook.
+	static HotstringTrie *sTrie; // Replaced (never modified) by UpdateTrie(), since the hook reads it without locking.
 
 	Label *mJumpToLabel;
 	LPTSTR mString, mReplacement;
@@ -350,6 +391,7 @@ public:
 
 	static void SuspendAll(bool aSuspend);
 	static void AllDestruct(); // HotKeyIt H1 destroy all HotStrings
+	static void UpdateTrie();
 	ResultType PerformInNewThreadMadeByCaller();
 	void DoReplace(LPARAM alParam);
 	static ResultType AddHotstring(Label *aJumpToLabel, LPTSTR aOptions, LPTSTR aHotstring, LPTSTR aReplacement
@@ -369,5 +411,27 @@ public:
 };
 
 
+class HotstringMatcher
+// Finds the hotstrings whose abbreviations match the end of g_HSBuf, in order of definition (which is
+// the documented order of precedence).  Used by the hook; falls back to comparing each hotstring which
+// isn't in the trie (or every hotstring if the trie couldn't be allocated).
+{
+	struct Range
+	{
+		const HotstringIDType *mNext, *mEnd;
+		LPTSTR mBefore; // The char in g_HSBuf to the left of these hotstrings' abbreviation.
+	};
+	Range mRange[HS_TRIE_ROOTS * (MAX_HOTSTRING_LENGTH + 1)];
+	int mRangeCount;
+	HotstringTrie *mTrie;
+	HotstringIDType mLinearID; // The next hotstring to compare, if it isn't in the trie.
+	void Walk(UINT aRoot, LPTSTR aEnd, bool aCaseSensitive);
+	bool NextLinear(HotstringIDType &aID, LPTSTR &aBefore);
+public:
+	HotstringMatcher();
+	bool Next(HotstringIDType &aID, LPTSTR &aBefore);
+};
+
+
 #endif
 #endif
\ No newline at end of file
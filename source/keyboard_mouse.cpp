@@ -1580,6 +1580,8 @@ void KeyEvent(KeyEventTypes aEventType, vk_type aVK, sc_type aSC, HWND aTargetWi
 	// Since calls from the hook thread could come in even while the SendInput array is being constructed,
 	// don't let those events get interspersed with the script's explicit use of SendInput.
 	bool caller_is_keybd_hook = (GetCurrentThreadId() == g_HookThreadID);
+	if (caller_is_keybd_hook && g_HookReplay) // The event being replayed by HookReplay() didn't really happen, so neither should the hook's response to it.
+		return;
 	bool put_event_into_array = sSendMode && !caller_is_keybd_hook;
 	if (sSendMode == SM_INPUT || caller_is_keybd_hook) // First check is necessary but second is just for maintainability.
 		aDoKeyDelay = false;
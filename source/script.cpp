@@ -24,6 +24,7 @@ GNU General Public License for more details.
 #include "exports.h" // Naveen v8
 #include "TextIO.h"
 #include "LiteZip.h"
+#include "script_com.h"
 #include "MemoryModule.h"
 
 // Globals that are for only this module:
@@ -526,6 +527,10 @@ void Script::Destroy()
 	//reset count for OnMessage
 	if (g_MsgMonitor.Count())
 		g_MsgMonitor.RemoveAll();
+
+	// Write out anything FileAppend has buffered and stop caching:
+	FileAppendCacheReset();
+	AsyncResult::FreePendingCallbacks();
 	
 	// free Meta Object
 	g_MetaObject.Free();
@@ -749,6 +754,7 @@ void Script::Destroy()
 	g_InputTimerExists = false;
 #endif
 	g_DerefTimerExists = false;
+	g_FileAppendTimerExists = false;
 	g_SoundWasPlayed = false;
 #ifndef MINIDLL
 	g_IsSuspended = false;  // Make this separate from g_AllowInterruption since that is frequently turned off & on.
@@ -770,6 +776,7 @@ void Script::Destroy()
 	g_FirstHotCriterion = NULL;
 	g_LastHotCriterion = NULL;
 	g_HotExprTimeout = 1000; // Timeout for #if (expression) evaluation, in milliseconds.
+	g_HotExprSpeculate = 0;
 	g_HotExprLFW = NULL; // Last Found Window of last #if expression.
 	g_MenuIsVisible = MENU_TYPE_NONE;
 	g_guiCount = 0;
@@ -889,7 +896,11 @@ void Script::Destroy()
 	//free(g_Debugger.mStack.mBottom);
 #ifndef MINIDLL
 	free(g_input.match);
+	free(g_input.MatchTrie);
+	g_input.MatchTrie = NULL;
 #endif
+	Struct::FreeLayoutCache();
+	ComDispIdCache::ReleaseShared();
 	Line::sLogNext = 0;
 	g_memset(Line::sLog,NULL,sizeof(Line*) * LINE_LOG_SIZE);
 	SimpleHeap::DeleteAll();
@@ -1742,6 +1753,8 @@ void Script::TerminateApp(ExitReasons aExitReason, int aExitCode)
 // Note that g_script's destructor takes care of most other cleanup work, such as destroying
 // tray icons, menus, and unowned windows such as ToolTip.
 {
+	// Write out anything FileAppend has buffered, even if this is a critical error:
+	FileAppendCacheClose();
 #ifdef _USRDLL
 	terminateDll(aExitCode);
 #else
@@ -5685,6 +5698,15 @@ inline ResultType Script::IsDirective(LPTSTR aBuf)
 		return CONDITION_TRUE;
 	}
 
+	// Allow #if expressions to be evaluated ahead of time by the main thread, so that the hook can use
+	// a result up to this many milliseconds old rather than wait for the main thread to evaluate it.
+	// Only suitable for expressions which don't depend on A_ThisHotkey or have side-effects.
+	if (IS_DIRECTIVE_MATCH(_T("#IfSpeculate")))
+	{
+		g_HotExprSpeculate = parameter ? ATOU(parameter) : 0;
+		return CONDITION_TRUE;
+	}
+
 	if (!_tcsnicmp(aBuf, _T("#IfWin"), 6))
 	{
 		HotCriterionType hot_criterion;
@@ -11281,6 +11303,33 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 		min_params = 0;
 		max_params = 2;
 	}
+	else if (!_tcsicmp(func_name, _T("SnapshotSlot")))
+	{
+		bif = BIF_SnapshotSlot;
+		min_params = 0;
+	}
+	else if (!_tcsicmp(func_name, _T("SharedQueue")))
+	{
+		bif = BIF_SharedQueue;
+		min_params = 0;
+	}
+	else if (!_tcsicmp(func_name, _T("Buffer")))
+	{
+		bif = BIF_Buffer;
+		min_params = 0;
+		max_params = 2;
+	}
+	else if (!_tcsicmp(func_name, _T("NumView")))
+	{
+		bif = BIF_NumView;
+		min_params = 2;
+		max_params = 4;
+	}
+	else if (!_tcsicmp(func_name, _T("InstancePool")))
+	{
+		bif = BIF_InstancePool;
+		max_params = 3;
+	}
 	else if (!_tcsicmp(func_name, _T("FindFunc")))  // addFile() Naveen v8.
 	{
 		bif = BIF_FindFunc;
@@ -11407,7 +11456,7 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 	{
 		bif = BIF_ZipAddFolder;
 		min_params = 2;
-		max_params = 2;
+		max_params = 3;
 	}
 	else if (!_tcsicmp(func_name, _T("ZipAddBuffer")))  // lowlevel() Naveen v9.
 	{
@@ -11438,6 +11487,17 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 		min_params = 2;
 		max_params = 5;
 	}
+	else if (!_tcsicmp(func_name, _T("UnZipStream")))
+	{
+		bif = BIF_UnZipStream;
+		min_params = 2;
+		max_params = 6;
+	}
+	else if (!_tcsicmp(func_name, _T("CRC32")))
+	{
+		bif = BIF_CRC32;
+		max_params = 3;
+	}
 	else if (!_tcsicmp(func_name, _T("VarSetCapacity")))
 	{
 		bif = BIF_VarSetCapacity;
@@ -11445,6 +11505,16 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 	}
 	else if (!_tcsicmp(func_name, _T("FileExist")))
 		bif = BIF_FileExist;
+	else if (!_tcsicmp(func_name, _T("FileAppendCache")))
+	{
+		bif = BIF_FileAppendCache;
+		max_params = 2;
+	}
+	else if (!_tcsicmp(func_name, _T("FileFlush")))
+	{
+		bif = BIF_FileFlush;
+		min_params = 0;
+	}
 	else if (!_tcsicmp(func_name, _T("WinExist")) || !_tcsicmp(func_name, _T("WinActive")))
 	{
 		bif = BIF_WinExistActive;
@@ -11564,6 +11634,8 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 			bif = BIF_ObjDump;
 			max_params = 4;
 		}
+		else if (!_tcsicmp(suffix, _T("Freeze")))
+			bif = BIF_ObjFreeze;
 		else return NULL;
 	}
 	else if (!_tcsicmp(func_name, _T("Array")))
@@ -11653,6 +11725,16 @@ Func *Script::FindFunc(LPCTSTR aFuncName, size_t aFuncNameLength, int *apInsertP
 		bif = BIF_LoadPicture;
 		max_params = 3;
 	}
+	else if (!_tcsicmp(func_name, _T("HookStats")))
+	{
+		bif = BIF_HookStats;
+		min_params = 0;
+	}
+	else if (!_tcsicmp(func_name, _T("HookReplay")))
+	{
+		bif = BIF_HookReplay;
+		max_params = 2;
+	}
 #endif
 	else
 		return NULL; // Maint: There may be other lines above that also return NULL.
@@ -13217,6 +13299,74 @@ Line *Script::PreparseCommands(Line *aStartingLine)
 
 
 
+#ifdef ENABLE_DLLCALL
+static DllCallSite *DllCallSiteFromInfix(ExprTokenType *aInfix)
+// Caller has passed the infix token which ends DllCall's first param.  The remaining params haven't been
+// processed yet, so they are scanned here to find out whether every type param is a single literal string
+// (such as "Ptr"), in which case they are parsed now.  Returns NULL if not.
+{
+	if (aInfix->symbol != SYM_COMMA) // No params other than the function.
+		return NULL;
+	ExprTokenType *this_infix;
+	int param_count = 2, depth = 0;
+	for (this_infix = aInfix + 1; ; ++this_infix)
+	{
+		if (this_infix->symbol == SYM_INVALID) // The end of the infix array; probably a syntax error which will be reported by the caller.
+			return NULL;
+		if (IS_OPAREN_LIKE(this_infix->symbol))
+			++depth;
+		else if (IS_CPAREN_LIKE(this_infix->symbol))
+		{
+			if (!depth)
+				break;
+			--depth;
+		}
+		else if (this_infix->symbol == SYM_COMMA && !depth)
+			++param_count;
+		else if (this_infix->symbol == SYM_MULTIPLY && !depth && this_infix[1].symbol == SYM_CPAREN)
+			return NULL; // DllCall(params*): The caller hasn't seen the '*' yet, so it can't exclude this case.
+	}
+	if (this_infix->symbol != SYM_CPAREN)
+		return NULL;
+
+	// Each odd-numbered param is a type: the arg types, followed by the return type if param_count is even.
+	int arg_count = (param_count - 1) / 2;
+	LPTSTR *arg_type = (LPTSTR *)_alloca(arg_count * sizeof(LPTSTR));
+	LPTSTR return_type = NULL;
+	int param_index = 1, token_count = 0;
+	ExprTokenType *param_token = NULL;
+	for (depth = 0, this_infix = aInfix + 1; ; ++this_infix)
+	{
+		if (!depth && (this_infix->symbol == SYM_COMMA || this_infix->symbol == SYM_CPAREN)) // End of a param.
+		{
+			if (param_index % 2)
+			{
+				if (token_count != 1 || param_token->symbol != SYM_STRING)
+					return NULL;
+				if (param_index / 2 < arg_count)
+					arg_type[param_index / 2] = param_token->marker;
+				else
+					return_type = param_token->marker;
+			}
+			if (this_infix->symbol == SYM_CPAREN)
+				break;
+			++param_index;
+			token_count = 0;
+			continue;
+		}
+		if (IS_OPAREN_LIKE(this_infix->symbol))
+			++depth;
+		else if (IS_CPAREN_LIKE(this_infix->symbol))
+			--depth;
+		param_token = this_infix;
+		++token_count;
+	}
+	return CreateDllCallSite(arg_type, arg_count, return_type);
+}
+#endif
+
+
+
 ResultType Line::ExpressionToPostfix(ArgStruct &aArg)
 // Returns OK or FAIL.
 {
@@ -14191,7 +14341,8 @@ double_deref: // Caller has set cp to be start and op_end to be the character af
 			// been completed in postfix, we have extra work to do:
 			//  a) Maintain and validate the parameter count.
 			//  b) Where possible, allow empty parameters by inserting the parameter's default value.
-			//  c) Optimize DllCalls by pre-resolving common function names.
+			//  c) Optimize DllCalls by pre-resolving common function names and literal types, and likewise
+			//     the literal types of NumGet/NumPut.
 			if (in_param_list && IS_OPAREN_LIKE(stack_symbol))
 			{
 				Func *func = in_param_list->func; // Can be NULL, e.g. for dynamic function calls.
@@ -14255,9 +14406,27 @@ double_deref: // Caller has set cp to be start and op_end to be the character af
 							//     absence of certain functions (e.g. IsWow64Process) may have some meaning to
 							//     the script; or the function may be non-essential.
 						}
+						// If the types are all literal strings, parse them now rather than on every call.
+						// This isn't done for variadic calls since the number of params isn't known;
+						// DllCallSiteFromInfix checks for that since the '*' hasn't been reached yet.
+						if (DllCallSite *site = DllCallSiteFromInfix(this_infix))
+							if (ExprOpFunc *site_func = new ExprOpFunc(BIF_DllCallSite, (INT_PTR)site, func->mMinParams, func->mParamCount))
+								in_param_list->func = site_func;
 					}
 					#endif
 
+					// Optimise NumGet/NumPut by parsing a literal Type at load-time.  This is done only when
+					// every param is present, since otherwise Type might be confused with Offset.
+					if (func && (func->mBIF == &BIF_NumGet && in_param_list->param_count == 2
+							|| func->mBIF == &BIF_NumPut && in_param_list->param_count == 3)
+						&& infix_symbol == SYM_CPAREN && in_param_list->is_function != DEREF_VARIADIC
+						&& this_infix[-1].symbol == SYM_STRING && this_infix[-2].symbol == SYM_COMMA) // i.e. the param is a single literal string and nothing else.
+					{
+						if (ExprOpFunc *type_func = new ExprOpFunc(func->mBIF == &BIF_NumGet ? BIF_NumGetType : BIF_NumPutType
+								, ConvertNumType(this_infix[-1].marker), func->mMinParams, func->mParamCount))
+							in_param_list->func = type_func;
+					}
+
 					// This is SYM_COMMA or SYM_CPAREN/BRACKET/BRACE at the end of a parameter.
 					++in_param_list->param_count;
 
@@ -15416,6 +15585,7 @@ ResultType Line::ExecUntil(ExecUntilMode aMode, ExprTokenType *aResultToken, Lin
 			case (size_t)ATTR_LOOP_READ_FILE:
 				{
 					TextFile tfile;
+					CLOSE_FILE_APPEND_CACHE
 					if (*ARG2 && tfile.Open(ARG2, DEFAULT_READ_FLAGS, g.Encoding & CP_AHKCP)) // v1.0.47: Added check for "" to avoid debug-assertion failure while in debug mode (maybe it's bad to to open file "" in release mode too).
 					{
 						result = line->PerformLoopReadFile(aResultToken, continue_main_loop, jump_to_line, until
@@ -16236,7 +16406,7 @@ ResultType Line::EvaluateHotCriterionExpression()
 
 // Evaluate an #If expression or callback function.
 // This is called by MainWindowProc when it receives an AHK_HOT_IF_EVAL message.
-ResultType HotkeyCriterion::Eval(LPTSTR aHotkeyName)
+ResultType HotkeyCriterion::Eval(LPTSTR aHotkeyName, bool aSpeculative)
 {
 	// Initialize a new quasi-thread to evaluate the expression. This may not be necessary for simple
 	// expressions, but expressions which call user-defined functions may otherwise interfere with
@@ -16286,7 +16456,11 @@ ResultType HotkeyCriterion::Eval(LPTSTR aHotkeyName)
 	// There may be some rare cases where the wrong hotkey gets this HWND (perhaps
 	// if there are multiple hotkey messages in the queue), but there doesn't seem
 	// to be any easy way around that.
-	g_HotExprLFW = g->hWndLastUsed; // Even if above failed, for simplicity.
+	// If evaluated ahead of time, the hook passes this on only if it uses the result.
+	if (aSpeculative)
+		SpeculatedLFW = g->hWndLastUsed;
+	else
+		g_HotExprLFW = g->hWndLastUsed; // Even if above failed, for simplicity.
 
 	// A_ThisHotkey must be restored else A_PriorHotkey will get an incorrect value later.
 	g_script.mThisHotkeyName = prior_hotkey_name[0];
@@ -17290,26 +17464,95 @@ ResultType Line::PerformLoopParseCSV(ExprTokenType *aResultToken, bool &aContinu
 
 
 
+LPTSTR LoopReadFileStruct::ReadLine()
+// Returns the next line (without its newline), terminated in place within mBuffer, or NULL at EOF.
+// The returned pointer is valid only until the next call.
+{
+	DWORD scan_pos = mLineStart; // Avoids rescanning a partial line after more text is read.
+	for (;;)
+	{
+		if (scan_pos < mDataEnd)
+		{
+			LPTSTR eol = tmemchr(mBuffer + scan_pos, '\n', mDataEnd - scan_pos);
+			if (eol)
+			{
+				LPTSTR line = mBuffer + mLineStart;
+				*eol = '\0';
+				mLineStart = (DWORD)(eol - mBuffer) + 1;
+				return line;
+			}
+			scan_pos = mDataEnd;
+		}
+		if (mAtEOF)
+		{
+			if (mLineStart == mDataEnd)
+				return NULL;
+			// Final line has no newline.  There is always room for the terminator (see below).
+			LPTSTR line = mBuffer + mLineStart;
+			mBuffer[mDataEnd] = '\0';
+			mLineStart = mDataEnd;
+			return line;
+		}
+		if (mLineStart)
+		{
+			// Move the partial line to the front of the buffer to make room for more text.
+			mDataEnd -= mLineStart;
+			tmemmove(mBuffer, mBuffer + mLineStart, mDataEnd);
+			mLineStart = 0;
+			scan_pos = mDataEnd;
+		}
+		if (mBufferSize - mDataEnd < mBufferSize / 2 || !mBuffer)
+		{
+			// Less than half the buffer is free, so the line is long.  Double the buffer to keep
+			// the number of moves and reads per line low.
+			DWORD new_size = mBuffer ? mBufferSize * 2 : READ_FILE_LINE_SIZE;
+			LPTSTR new_buf = trealloc(mBuffer, new_size);
+			if (new_buf)
+			{
+				mBuffer = new_buf;
+				mBufferSize = new_size;
+			}
+			else if (!mBuffer)
+				return NULL;
+			else if (mDataEnd == mBufferSize - 1)
+			{
+				// Out of memory and the buffer is full: return what we have as a line, like
+				// the old fixed-size buffer did for lines which were too long.
+				mBuffer[mDataEnd] = '\0';
+				mLineStart = mDataEnd = 0;
+				return mBuffer;
+			}
+		}
+		// Read as much as will fit, leaving room for a null-terminator.  Since TextStream decodes
+		// and translates CRLF to LF, the buffer contains the same text ReadLine() would produce.
+		DWORD chars_read = mReadFile->Read(mBuffer + mDataEnd, mBufferSize - mDataEnd - 1);
+		if (chars_read)
+			mDataEnd += chars_read;
+		else
+			mAtEOF = true;
+	}
+}
+
+
+
 ResultType Line::PerformLoopReadFile(ExprTokenType *aResultToken, bool &aContinueMainLoop, Line *&aJumpToLine, Line *aUntil
 	, TextStream *aReadFile, LPTSTR aWriteFileName)
 {
 	LoopReadFileStruct loop_info(aReadFile, aWriteFileName);
-	size_t line_length;
+	LPTSTR line;
 	ResultType result;
 	Line *jump_to_line;
 	global_struct &g = *::g; // Primarily for performance in this case.
 
 	for (;; ++g.mLoopIteration)
 	{ 
-		if (  !(line_length = loop_info.mReadFile->ReadLine(loop_info.mCurrentLine, _countof(loop_info.mCurrentLine) - 1))  ) // -1 to ensure there's room for a null-terminator.
+		if (  !(line = loop_info.ReadLine())  )
 		{
 			// We want to return OK except in some specific cases handled below (see "break").
 			result = OK;
 			break;
 		}
-		if (loop_info.mCurrentLine[line_length - 1] == '\n') // Remove newlines like FileReadLine does.
-			--line_length;
-		loop_info.mCurrentLine[line_length] = '\0';
+		loop_info.mCurrentLine = line;
 		g.mLoopReadFile = &loop_info;
 		if (mNextLine->mActionType == ACT_BLOCK_BEGIN) // See PerformLoop() for comments about this section.
 			do
@@ -17917,6 +18160,7 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 
 	case ACT_RUN:
 	{
+		CLOSE_FILE_APPEND_CACHE // In case the program reads a file the script has been appending to.
 		bool use_el = tcscasestr(ARG3, _T("UseErrorLevel"));
 		result = g_script.ActionExec(ARG1, NULL, ARG2, !use_el, ARG3, NULL, use_el, true, ARGVAR4); // Be sure to pass NULL for 2nd param.
 		if (use_el)
@@ -17928,6 +18172,8 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 	}
 
 	case ACT_RUNWAIT:
+		CLOSE_FILE_APPEND_CACHE
+		return PerformWait();
 	case ACT_CLIPWAIT:
 	case ACT_KEYWAIT:
 	case ACT_WINWAIT:
@@ -18297,15 +18543,19 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 		return FileAppend(ARG2, ARG1, (mArgc < 2) ? g.mLoopReadFile : NULL);
 
 	case ACT_FILEREAD:
+		CLOSE_FILE_APPEND_CACHE
 		return FileRead(ARG2);
 
 	case ACT_FILEREADLINE:
+		CLOSE_FILE_APPEND_CACHE
 		return FileReadLine(ARG2, ARG3);
 
 	case ACT_FILEDELETE:
+		CLOSE_FILE_APPEND_CACHE
 		return FileDelete(ARG1);
 
 	case ACT_FILERECYCLE:
+		CLOSE_FILE_APPEND_CACHE
 		return FileRecycle(ARG1);
 
 	case ACT_FILERECYCLEEMPTY:
@@ -18316,16 +18566,20 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 #endif
 	case ACT_FILECOPY:
 	{
+		CLOSE_FILE_APPEND_CACHE
 		int error_count = Util_CopyFile(ARG1, ARG2, ArgToInt(3) == 1, false, g.LastError);
 		if (!error_count)
 			return g_ErrorLevel->Assign(ERRORLEVEL_NONE);
 		return SetErrorLevelOrThrowInt(error_count);
 	}
 	case ACT_FILEMOVE:
+		CLOSE_FILE_APPEND_CACHE
 		return SetErrorLevelOrThrowInt(Util_CopyFile(ARG1, ARG2, ArgToInt(3) == 1, true, g.LastError));
 	case ACT_FILECOPYDIR:
+		CLOSE_FILE_APPEND_CACHE
 		return SetErrorLevelOrThrowBool(!Util_CopyDir(ARG1, ARG2, ArgToInt(3) == 1));
 	case ACT_FILEMOVEDIR:
+		CLOSE_FILE_APPEND_CACHE
 		if (ctoupper(*ARG3) == 'R')
 		{
 			// Perform a simple rename instead, which prevents the operation from being only partially
@@ -18340,6 +18594,7 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 	case ACT_FILECREATEDIR:
 		return FileCreateDir(ARG1);
 	case ACT_FILEREMOVEDIR:
+		CLOSE_FILE_APPEND_CACHE
 		return SetErrorLevelOrThrowBool(!*ARG1 // Consider an attempt to create or remove a blank dir to be an error.
 			|| !Util_RemoveDir(ARG1, ArgToInt(2) == 1)); // Relies on short-circuit evaluation.
 
@@ -18348,14 +18603,17 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 		#define USE_FILE_LOOP_FILE_IF_ARG_BLANK(arg) (*arg ? arg : (g.mLoopFile ? g.mLoopFile->cFileName : _T("")))
 		return FileGetAttrib(USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2));
 	case ACT_FILESETATTRIB:
+		CLOSE_FILE_APPEND_CACHE
 		FileSetAttrib(ARG1, USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2), ConvertLoopMode(ARG3), ArgToInt(4) == 1);
 		return !g.ThrownToken ? OK : FAIL;
 	case ACT_FILEGETTIME:
 		return FileGetTime(USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2), *ARG3);
 	case ACT_FILESETTIME:
+		CLOSE_FILE_APPEND_CACHE // Otherwise a later flush would change the modification time again.
 		FileSetTime(ARG1, USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2), *ARG3, ConvertLoopMode(ARG4), ArgToInt(5) == 1);
 		return !g.ThrownToken ? OK : FAIL;
 	case ACT_FILEGETSIZE:
+		CLOSE_FILE_APPEND_CACHE
 		return FileGetSize(USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2), ARG3);
 	case ACT_FILEGETVERSION:
 		return FileGetVersion(USE_FILE_LOOP_FILE_IF_ARG_BLANK(ARG2));
@@ -18778,10 +19036,13 @@ __forceinline ResultType Line::Perform() // As of 2/9/2009, __forceinline() redu
 	}
 
 	case ACT_INIREAD:
+		CLOSE_FILE_APPEND_CACHE
 		return IniRead(ARG2, ARG3, ARG4, ARG5);
 	case ACT_INIWRITE:
+		CLOSE_FILE_APPEND_CACHE
 		return IniWrite(FOUR_ARGS);
 	case ACT_INIDELETE:
+		CLOSE_FILE_APPEND_CACHE
 		// To preserve maximum compatibility with existing scripts, only send NULL if ARG3
 		// was explicitly omitted.  This is because some older scripts might rely on the
 		// fact that a blank ARG3 does not delete the entire section, but rather does
@@ -220,6 +220,8 @@ enum CommandIDs {CONTROL_ID_FIRST = IDCANCEL + 1
 #define ERR_BAD_JUMP_INSIDE_FINALLY _T("Jumps cannot exit a FINALLY block.")
 #define ERR_BAD_JUMP_OUT_OF_FUNCTION _T("Cannot jump from inside a function to outside.")
 #define ERR_EXPECTED_BLOCK_OR_ACTION _T("Expected \"{\" or single-line action.")
+#define ERR_BUFFER_NOT_RESIZABLE _T("This Buffer can't be resized.")
+#define ERR_INDEX_OUT_OF_RANGE _T("Index out of range.")
 #define ERR_OUTOFMEM _T("Out of memory.")  // Used by RegEx too, so don't change it without also changing RegEx to keep the former string.
 #define ERR_EXPR_TOO_LONG _T("Expression too long")
 #define ERR_MEM_LIMIT_REACHED _T("Memory limit reached (see #MaxMem in the help file).")
@@ -245,8 +247,11 @@ enum CommandIDs {CONTROL_ID_FIRST = IDCANCEL + 1
 #define ERR_INVALID_STRUCT _T("Invalid structure definition.")
 #define ERR_INVALID_STRUCT_IN_FUNC _T("Variable was not found in function.")
 #define ERR_INVALID_STRUCT_BIT_POINTER _T("Bit field must not be a pointer")
+#define ERR_STRUCT_ITEMS_ARE_POINTERS _T("Items of this structure are pointers.")
+#define ERR_STRUCT_FIELD_NOT_NUMERIC _T("Field must be a number and not a character, pointer, array, structure or bit field.")
 #define ERR_EXCEPTION _T("An exception was thrown.")
 #define ERR_MUST_INIT_STRUCT _T("Empty pointer, dynamic Structure fields must be initialized manually first.")
+#define ERR_OBJECT_FROZEN _T("This object is frozen and cannot be modified.")
 
 #define WARNING_USE_UNSET_VARIABLE _T("This variable has not been assigned a value.")
 #define WARNING_LOCAL_SAME_AS_GLOBAL _T("This local variable has the same name as a global variable.")
@@ -364,6 +369,11 @@ INT_PTR CALLBACK InputBoxProc(HWND hWndDlg, UINT uMsg, WPARAM wParam, LPARAM lPa
 VOID CALLBACK InputBoxTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
 #endif
 VOID CALLBACK DerefTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+VOID CALLBACK FileAppendCacheTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+int FileAppendCacheClose(LPCTSTR aFilespec = NULL);
+void FileAppendCacheReset();
+// Files kept open by FileAppend must be closed before commands which might read, move or delete them:
+#define CLOSE_FILE_APPEND_CACHE if (g_FileAppendCacheCount) FileAppendCacheClose();
 BOOL CALLBACK EnumChildFindSeqNum(HWND aWnd, LPARAM lParam);
 BOOL CALLBACK EnumChildFindPoint(HWND aWnd, LPARAM lParam);
 BOOL CALLBACK EnumChildGetControlList(HWND aWnd, LPARAM lParam);
@@ -479,20 +489,47 @@ struct RegItemStruct
 };
 
 class TextStream; // TextIO
+class TextFile;
 struct LoopReadFileStruct
 {
 	TextStream *mReadFile, *mWriteFile;
 	TCHAR mWriteFileName[MAX_PATH];
-	#define READ_FILE_LINE_SIZE (64 * 1024)  // This is also used by FileReadLine().
-	TCHAR mCurrentLine[READ_FILE_LINE_SIZE];
+	#define READ_FILE_LINE_SIZE (64 * 1024)  // This is used by FileReadLine() and as the initial size of mBuffer.
+	// Text is read into mBuffer in large blocks and mCurrentLine points to the current line within it
+	// (terminated in place), so a line is only copied if A_LoopReadLine is referenced.  mBuffer grows
+	// as needed to hold the longest line.
+	LPTSTR mCurrentLine;
+	LPTSTR mBuffer;
+	DWORD mBufferSize; // In characters.
+	DWORD mLineStart; // Offset of the next line in mBuffer.
+	DWORD mDataEnd; // Offset of the end of the text in mBuffer.
+	bool mAtEOF;
 	LoopReadFileStruct(TextStream *aReadFile, LPTSTR aWriteFileName)
 		: mReadFile(aReadFile), mWriteFile(NULL) // mWriteFile is opened by FileAppend() only upon first use.
+		, mCurrentLine(_T("")), mBuffer(NULL), mBufferSize(0), mLineStart(0), mDataEnd(0), mAtEOF(false)
 	{
 		// Use our own buffer because caller's is volatile due to possibly being in the deref buffer:
 		tcslcpy(mWriteFileName, aWriteFileName, _countof(mWriteFileName));
-		*mCurrentLine = '\0';
 	}
+	~LoopReadFileStruct()
+	{
+		free(mBuffer);
+	}
+	LPTSTR ReadLine();
+};
+
+#define FILE_APPEND_CACHE_MAX 8 // Max number of files FileAppend keeps open when caching is enabled.
+#define FILE_APPEND_CACHE_BUF_SIZE (64 * 1024) // Default write buffer size for each cached file.
+struct FileAppendCacheItem
+{
+	TCHAR path[MAX_PATH]; // Full path, for case-insensitive comparison.
+	DWORD flags; // TextStream flags the file was opened with.
+	UINT codepage;
+	TextFile *file;
+	DWORD last_used; // Tick count of the last FileAppend.
 };
+FileAppendCacheItem *FileAppendCacheFind(LPCTSTR aFilespec, DWORD aFlags, UINT aCodePage);
+void FileAppendCacheRemove(FileAppendCacheItem *aItem);
 
 // TextStream flags for LoadIncludedFile (script files), file-reading loops and FileReadLine.
 // Do not lock read/write: older versions used fopen(), which is implicitly permissive.
@@ -2279,6 +2316,20 @@ struct DYNAPARM
 };
 
 void ConvertDllArgType(LPTSTR aBuf[], DYNAPARM &aDynaParam);
+
+struct DllCallSite
+// The arg and return types of a DllCall() whose type params are all literal strings, which
+// ExpressionToPostfix() parses once rather than leaving DllCall() to parse them on every call.
+// The call site's function is replaced with an ExprOpFunc whose mName points to this struct.
+{
+	TCHAR name[8]; // "DllCall", so that mName is still meaningful.  Must be first; see above.
+	DYNAPARM return_attrib;
+	int dll_call_mode;
+	int arg_count;
+	DYNAPARM arg[1]; // Actually arg_count items.  Only type, passed_by_address and is_unsigned are set.
+};
+
+DllCallSite *CreateDllCallSite(LPTSTR aArgType[], int aArgCount, LPTSTR aReturnType);
 #endif
 
 enum FuncParamDefaults {PARAM_DEFAULT_NONE, PARAM_DEFAULT_STR, PARAM_DEFAULT_INT, PARAM_DEFAULT_FLOAT};
@@ -2435,7 +2486,7 @@ public:
 class ExprOpFunc : public Func
 {	// ExprOpFunc: Used in combination with SYM_FUNC to implement certain operations in expressions.
 	// These are not inserted into the script's function list, so mName is used only to pass a simple
-	// identifier to mBIF (currently only BIF_ObjInvoke).
+	// identifier to mBIF (BIF_ObjInvoke) or a DllCallSite (BIF_DllCallSite).
 public:
 	ExprOpFunc(BuiltInFunctionType aBIF, INT_PTR aID, int aMinParams = 1, int aParamCount = 1000)
 		: Func((LPTSTR)aID, true)
@@ -3396,6 +3447,7 @@ BIV_DECL_R (BIV_ScreenDPI);
 bool IsDllArgTypeName(LPTSTR name);
 void *GetDllProcAddress(LPCTSTR aDllFileFunc, HMODULE *hmodule_to_free = NULL);
 BIF_DECL(BIF_DllCall);
+BIF_DECL(BIF_DllCallSite);
 BIF_DECL(BIF_DllImport);
 BIF_DECL(BIF_DynaCall);
 #endif
@@ -3432,6 +3484,8 @@ BIF_DECL(BIF_ZipOptions);
 BIF_DECL(BIF_ZipInfo);
 BIF_DECL(BIF_UnZip);
 BIF_DECL(BIF_UnZipBuffer);
+BIF_DECL(BIF_UnZipStream);
+BIF_DECL(BIF_CRC32);
 
 BIF_DECL(BIF_StrLen);
 BIF_DECL(BIF_SubStr);
@@ -3442,8 +3496,20 @@ BIF_DECL(BIF_RegEx);
 BIF_DECL(BIF_Ord);
 BIF_DECL(BIF_Chr);
 BIF_DECL(BIF_Format);
+// Attributes of a NumGet/NumPut type name such as "UInt" or "Double", as returned by ConvertNumType().
+#define NUMTYPE_SIZE_MASK	0x0F // The size in bytes.
+#define NUMTYPE_FLOAT		0x10
+#define NUMTYPE_UNSIGNED	0x20 // The name has the "U" prefix.
+#define NUMTYPE_PTR			0x40 // "Ptr" or "UPtr".
+#define NUMTYPE_UNKNOWN		0x80 // Not a valid type name.  NumGet and NumPut treat it as Ptr-sized.
+#define NUMTYPE_DEFAULT		(sizeof(DWORD_PTR) | NUMTYPE_UNSIGNED | NUMTYPE_PTR) // The type was omitted.
+int ConvertNumType(LPTSTR aType);
+void ReadNum(int aNumType, void *aSource, ExprTokenType &aResultToken);
+void WriteNum(int aNumType, void *aTarget, ExprTokenType &aValue);
 BIF_DECL(BIF_NumGet);
+BIF_DECL(BIF_NumGetType);
 BIF_DECL(BIF_NumPut);
+BIF_DECL(BIF_NumPutType);
 BIF_DECL(BIF_StrGetPut);
 BIF_DECL(BIF_IsLabel);
 BIF_DECL(BIF_IsFunc);
@@ -3453,6 +3519,8 @@ BIF_DECL(BIF_GetKeyState);
 BIF_DECL(BIF_GetKeyName);
 BIF_DECL(BIF_VarSetCapacity);
 BIF_DECL(BIF_FileExist);
+BIF_DECL(BIF_FileAppendCache);
+BIF_DECL(BIF_FileFlush);
 BIF_DECL(BIF_WinExistActive);
 BIF_DECL(BIF_Round);
 BIF_DECL(BIF_FloorCeil);
@@ -3475,6 +3543,8 @@ BIF_DECL(BIF_RegisterCallback);
 
 #ifndef MINIDLL
 BIF_DECL(BIF_MenuGet);
+BIF_DECL(BIF_HookStats);
+BIF_DECL(BIF_HookReplay);
 
 BIF_DECL(BIF_StatusBar);
 
@@ -3502,6 +3572,12 @@ BIF_DECL(BIF_IsObject);
 BIF_DECL(BIF_ObjCreate);
 BIF_DECL(BIF_ObjArray);
 BIF_DECL(BIF_CriticalObject);
+BIF_DECL(BIF_ObjFreeze);
+BIF_DECL(BIF_SnapshotSlot);
+BIF_DECL(BIF_SharedQueue);
+BIF_DECL(BIF_Buffer);
+BIF_DECL(BIF_NumView);
+BIF_DECL(BIF_InstancePool);
 BIF_DECL(BIF_sizeof);
 BIF_DECL(BIF_Struct);
 BIF_DECL(BIF_ObjLoad);
@@ -3535,6 +3611,7 @@ BIF_DECL(BIF_ObjClone);
 
 // Advanced file IO interfaces
 BIF_DECL(BIF_FileOpen);
+IObject *UnzipFileObject(void *aArchive, ULONGLONG aIndex, BufferObject *aSource, UINT aCodePage, DWORD &aError); // Used by BIF_UnZipStream.
 BIF_DECL(BIF_ComObjActive);
 BIF_DECL(BIF_ComObjCreate);
 BIF_DECL(BIF_ComObjGet);
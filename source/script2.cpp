@@ -1746,6 +1746,16 @@ ResultType Line::Input()
 			++g_input.MatchCount;
 	}
 
+	// Compile the match list so that the hook needn't compare the buffer with every phrase after each
+	// keystroke.  This is safe because the hook ignores g_input while status is INPUT_OFF.
+	free(g_input.MatchTrie);
+	g_input.MatchTrie = NULL;
+	if (g_input.MatchCount)
+		if (   !(g_input.MatchTrie = InputMatchTrie::Create(g_input.match, g_input.MatchCount
+			, g_input.CaseSensitive, g_input.FindAnywhere))   )
+			return LineError(ERR_OUTOFMEM);
+	g_input.MatchState = g_input.MatchStateLength = 0;
+
 	// Notes about the below macro:
 	// In case the Input timer has already put a WM_TIMER msg in our queue before we killed it,
 	// clean out the queue now to avoid any chance that such a WM_TIMER message will take effect
@@ -5675,6 +5685,9 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT iMsg, WPARAM wParam, LPARAM lPar
 			if ((WPARAM)cp == wParam)
 				return cp->Eval((LPTSTR)lParam);
 		return 0;
+	case AHK_HOT_IF_SPECULATE:
+		SpeculateHotCriteria();
+		return 0;
 #endif
 	case AHK_EXECUTE:   // sent from dll host # Naveen N9 
 		 g_script.mTempLine = (Line *)wParam ;
@@ -5695,6 +5708,9 @@ LRESULT CALLBACK MainWindowProc(HWND hWnd, UINT iMsg, WPARAM wParam, LPARAM lPar
 	case AHK_EXECUTE_FUNCTION_DLL: 
 		callFuncDll((FuncAndToken *) wParam);
 		return 0;
+	case AHK_ASYNC_CALLBACK:
+		((AsyncResult *)wParam)->CallScriptCallback();
+		return 0;
 #ifndef MINIDLL
 	case WM_MEASUREITEM: // L17: Measure menu icon. Not used on Windows Vista or later.
 		if (hWnd == g_hWnd && wParam == 0 && !g_os.IsWinVistaOrLater())
@@ -9738,6 +9754,135 @@ ResultType Line::FileCreateDir(LPTSTR aDirSpec)
 
 
 
+#ifdef UNICODE
+#define FILE_READ_MAP_THRESHOLD	(64 * 1024) // Files at least this size are mapped rather than read into a temporary buffer.
+#define FILE_READ_DECODE_BLOCK	(64 * 1024) // Bytes decoded at a time, small enough that translating CRLF afterward hits the cache.
+
+static DWORD TranslateCRLF(LPWSTR aDst, DWORD aDstLength, LPCWSTR aSrc, DWORD aSrcLength)
+// Appends aSrc to the aDstLength characters in aDst, translating CRLF to LF (including a CR at the end
+// of aDst followed by LF at the start of aSrc).  aSrc may be aDst + aDstLength, for in-place translation.
+// Returns the new length of aDst.
+{
+	LPWSTR dst = aDst + aDstLength;
+	for (LPCWSTR src = aSrc, src_end = aSrc + aSrcLength; src < src_end; ++src)
+	{
+		if (*src == '\n' && dst > aDst && dst[-1] == '\r')
+			dst[-1] = '\n';
+		else
+			*dst++ = *src;
+	}
+	return (DWORD)(dst - aDst);
+}
+
+static DWORD FileReadDecode(LPBYTE aSrc, DWORD aSize, UINT aCodePage, bool aTranslateCRLF, LPWSTR aDst, DWORD aDstCapacity)
+// Decodes the raw contents of a file into aDst, translating CRLF to LF in the same pass if requested.
+// If aDst is NULL, returns the maximum number of characters which will be written.  Returns (DWORD)-1
+// on failure, including when aSrc is a mapped view of a file which was truncated by another process.
+{
+	__try
+	{
+		if (aSize >= 3 && aSrc[0] == 0xEF && aSrc[1] == 0xBB && aSrc[2] == 0xBF) // UTF-8 BOM
+		{
+			aSrc += 3;
+			aSize -= 3;
+			aCodePage = CP_UTF8;
+		}
+		else if (aSize >= 2 && aSrc[0] == 0xFF && aSrc[1] == 0xFE) // UTF-16LE BOM
+		{
+			aSrc += 2;
+			aSize -= 2;
+			aCodePage = CP_UTF16;
+		}
+		if (aCodePage == CP_UTF16) // Covers FileEncoding UTF-16 and FileEncoding UTF-16-RAW.
+		{
+			DWORD length = aSize / sizeof(WCHAR);
+			if (!aDst)
+				return length;
+			if (aTranslateCRLF)
+				return TranslateCRLF(aDst, 0, (LPCWSTR)aSrc, length);
+			wmemcpy(aDst, (LPCWSTR)aSrc, length);
+			return length;
+		}
+		if (!aDst)
+			return FastMultiByteToWideChar(aCodePage, 0, (LPCSTR)aSrc, aSize, NULL, 0);
+		// Decode in blocks so that the CRLF translation of each block is done while it is still in the
+		// cache.  Blocks must not split a character, so for multi-byte code pages other than UTF-8
+		// (where the end of a character can't be found by looking backward) decode everything at once.
+		CPINFO info;
+		DWORD block = (aCodePage == CP_UTF8 || GetCPInfo(aCodePage, &info) && info.MaxCharSize == 1)
+			? FILE_READ_DECODE_BLOCK : aSize;
+		DWORD length = 0;
+		for (DWORD pos = 0, end; pos < aSize; pos = end)
+		{
+			end = (aSize - pos > block) ? pos + block : aSize;
+			if (end < aSize && aCodePage == CP_UTF8)
+				for (int i = 0; i < 3 && (aSrc[end] & 0xC0) == 0x80; ++i) // Continuation byte.
+					--end;
+			int decoded = FastMultiByteToWideChar(aCodePage, 0, (LPCSTR)aSrc + pos, end - pos, aDst + length, aDstCapacity - length);
+			if (!decoded)
+				return (DWORD)-1;
+			length = aTranslateCRLF ? TranslateCRLF(aDst, length, aDst + length, decoded) : length + decoded;
+		}
+		return length;
+	}
+	__except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+	{
+		SetLastError(ERROR_READ_FAULT);
+		return (DWORD)-1;
+	}
+}
+
+static int FileReadText(Var &aOutputVar, HANDLE aFile, DWORD aSize, UINT aCodePage, bool aTranslateCRLF)
+// Reads and decodes a text file directly into aOutputVar.  Large files are mapped rather than read,
+// so the only copy of the data made is the decoded text itself.  Returns 1 on success, 0 on failure
+// (see GetLastError), or -1 if out of memory.
+{
+	HANDLE mapping = NULL;
+	LPBYTE data = NULL, buf = NULL;
+	if (aSize >= FILE_READ_MAP_THRESHOLD && (mapping = CreateFileMapping(aFile, NULL, PAGE_READONLY, 0, 0, NULL)))
+		data = (LPBYTE)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, aSize);
+	if (!data) // Small file, or one which can't be mapped.
+	{
+		if (  !(data = buf = (LPBYTE)malloc(aSize))  )
+		{
+			if (mapping)
+				CloseHandle(mapping);
+			return -1;
+		}
+		DWORD bytes_read;
+		if (!ReadFile(aFile, buf, aSize, &bytes_read, NULL))
+			bytes_read = (DWORD)-1;
+		aSize = bytes_read;
+	}
+
+	int result = 0;
+	DWORD length = (aSize == (DWORD)-1) ? aSize : FileReadDecode(data, aSize, aCodePage, aTranslateCRLF, NULL, 0);
+	if (length == (DWORD)-1)
+		result = 0;
+	else if (!length)
+		result = aOutputVar.Assign() ? 1 : 0; // Empty file or one containing only a BOM.
+	else if (aOutputVar.AssignString(NULL, length, true, false)) // See AssignStringW for why aObeyMaxMem is false.
+	{
+		LPWSTR dst = aOutputVar.Contents(TRUE, TRUE);
+		length = FileReadDecode(data, aSize, aCodePage, aTranslateCRLF, dst, length);
+		if (length == (DWORD)-1)
+			length = 0;
+		else
+			result = 1;
+		dst[length] = '\0';
+		aOutputVar.SetCharLength(length);
+	}
+
+	if (buf)
+		free(buf);
+	else
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	return result;
+}
+#endif
+
 ResultType Line::FileRead(LPTSTR aFilespec)
 // Returns OK or FAIL.  Will almost always return OK because if an error occurs,
 // the script's ErrorLevel variable will be set accordingly.  However, if some
@@ -9857,6 +10002,20 @@ ResultType Line::FileRead(LPTSTR aFilespec)
 		return SetErrorsOrThrow(false, 0); // Indicate success (a zero-length file results in empty output_var).
 	}
 
+#ifdef UNICODE
+	if (!is_binary_clipboard)
+	{
+		int read_result = FileReadText(output_var, hfile, (DWORD)bytes_to_read, codepage, translate_crlf_to_lf);
+		g->LastError = GetLastError();
+		CloseHandle(hfile);
+		if (read_result < 0)
+			return LineError(ERR_OUTOFMEM);
+		if (!output_var.Close())
+			return FAIL;
+		return SetErrorLevelOrThrowBool(!read_result);
+	}
+#endif
+
 	LPBYTE output_buf;
 	bool output_buf_is_var = is_binary_clipboard && output_var.Type() != VAR_CLIPBOARD;
 	if (output_buf_is_var) 
@@ -10072,6 +10231,7 @@ ResultType Line::FileAppend(LPTSTR aFilespec, LPTSTR aBuf, LoopReadFileStruct *a
 
 	TextStream *ts = aCurrentReadFile ? aCurrentReadFile->mWriteFile : NULL;
 	bool file_was_already_open = ts;
+	FileAppendCacheItem *cache_item = NULL;
 	BOOL result;
 
 	bool open_as_binary = (*aFilespec == '*');
@@ -10150,29 +10310,279 @@ ResultType Line::FileAppend(LPTSTR aFilespec, LPTSTR aBuf, LoopReadFileStruct *a
 		else if (codepage == CP_UTF16)
 			flags |= TextStream::BOM_UTF16;
 
-		// Open the output file (if one was specified).  Unlike the input file, this is not
-		// a critical error if it fails.  We want it to be non-critical so that FileAppend
-		// commands in the body of the loop will set ErrorLevel to indicate the problem:
-		if (  !(ts = new TextFile)  ) // ts was alredy verified NULL via !file_was_already_open.
-			return LineError(ERR_OUTOFMEM);
-		if ( !ts->Open(aFilespec, flags, codepage & CP_AHKCP) )
+		if (g_FileAppendCacheInterval && !aCurrentReadFile)
+			cache_item = FileAppendCacheFind(aFilespec, flags, codepage & CP_AHKCP); // NULL if this file isn't to be cached.
+		if (cache_item && cache_item->file)
+			ts = cache_item->file;
+		else
 		{
-			delete ts; // Must be deleted explicitly!
-			return SetErrorsOrThrow(true);
+			// Open the output file (if one was specified).  Unlike the input file, this is not
+			// a critical error if it fails.  We want it to be non-critical so that FileAppend
+			// commands in the body of the loop will set ErrorLevel to indicate the problem:
+			if (  !(ts = new TextFile)  ) // ts was alredy verified NULL via !file_was_already_open.
+			{
+				if (cache_item)
+					FileAppendCacheRemove(cache_item);
+				return LineError(ERR_OUTOFMEM);
+			}
+			// Cached files allow other processes to read them (e.g. to monitor a log file) since
+			// they are kept open between calls:
+			if ( !ts->Open(aFilespec, cache_item ? flags | TextStream::SHARE_READ : flags, codepage & CP_AHKCP) )
+			{
+				delete ts; // Must be deleted explicitly!
+				if (cache_item)
+					FileAppendCacheRemove(cache_item);
+				return SetErrorsOrThrow(true);
+			}
+			if (aCurrentReadFile)
+				aCurrentReadFile->mWriteFile = ts;
+			else if (cache_item)
+			{
+				ts->SetWriteBufferSize(g_FileAppendCacheSize); // Failure is harmless: it just means smaller writes.
+				cache_item->file = (TextFile *)ts; // It was created as a TextFile above.
+			}
 		}
-		if (aCurrentReadFile)
-			aCurrentReadFile->mWriteFile = ts;
 	}
 
 	// Write to the file:
 	DWORD length = (DWORD)_tcslen(aBuf);
 	result = length && ts->Write(aBuf, length) == 0; // Relies on short-circuit boolean evaluation.  If buf is empty, we've already succeeded in creating the file and have nothing further to do.
+	DWORD last_error = -1; // Use GetLastError().
+	if (!result && g_FileAppendCacheError)
+	{
+		// Data buffered by an earlier call couldn't be written by the timer or when the file was closed,
+		// so report it now.  Since it may have been for a different file, it isn't reported again.
+		result = TRUE;
+		last_error = g_FileAppendCacheError;
+	}
+	g_FileAppendCacheError = 0;
 
-	if (!aCurrentReadFile)
+	if (cache_item)
+	{
+		// Leave the file open.  Buffered data is written when the buffer fills up, by the timer,
+		// or when the file is closed by FileFlush(), another file command or the script exiting.
+		cache_item->last_used = GetTickCount();
+		if (!g_FileAppendTimerExists)
+			SET_FILE_APPEND_TIMER
+	}
+	else if (!aCurrentReadFile)
 		delete ts;
 	// else it's the caller's responsibility, or it's caller's, to close it.
 
-	return SetErrorsOrThrow(result);
+	return SetErrorsOrThrow(result, last_error);
+}
+
+
+
+// FileAppend's write-behind cache.  When enabled by FileAppendCache(), recently appended files are kept
+// open with a large write buffer so that logging in a loop doesn't cost an open and close per call.
+static FileAppendCacheItem sFileAppendCache[FILE_APPEND_CACHE_MAX]; // g_FileAppendCacheCount items are in use.
+static LPTSTR *sFileAppendNoCache = NULL; // Full paths of files which must not be cached.
+static int sFileAppendNoCacheCount = 0;
+
+static bool FileAppendCacheGetFullPath(LPCTSTR aFilespec, LPTSTR aBuf)
+// aBuf must have room for MAX_PATH chars.  Returns false if the path is too long to be cached.
+{
+	DWORD length = GetFullPathName(aFilespec, MAX_PATH, aBuf, NULL);
+	return length && length < MAX_PATH;
+}
+
+static int FileAppendNoCacheIndex(LPCTSTR aFullPath)
+{
+	for (int i = 0; i < sFileAppendNoCacheCount; ++i)
+		if (!_tcsicmp(sFileAppendNoCache[i], aFullPath))
+			return i;
+	return -1;
+}
+
+static void FileAppendCacheFlush(TextFile *aFile)
+// Writes aFile's buffered data, remembering any failure so that the next FileAppend can report it.
+{
+	if (aFile && !aFile->Flush())
+		g_FileAppendCacheError = GetLastError() ? GetLastError() : ERROR_WRITE_FAULT;
+}
+
+FileAppendCacheItem *FileAppendCacheFind(LPCTSTR aFilespec, DWORD aFlags, UINT aCodePage)
+// Returns the cache item for aFilespec, creating one if needed (its file is NULL in that case, and
+// the caller is expected to open it or call FileAppendCacheRemove).  Returns NULL if aFilespec must
+// not be cached.
+{
+	TCHAR full_path[MAX_PATH];
+	if (*aFilespec == '*' // Stdout or stderr, which are never cached.
+		|| !FileAppendCacheGetFullPath(aFilespec, full_path)
+		|| FileAppendNoCacheIndex(full_path) != -1)
+		return NULL;
+	FileAppendCacheItem *item, *lru = NULL;
+	int i;
+	for (i = 0; i < g_FileAppendCacheCount; ++i)
+	{
+		item = sFileAppendCache + i;
+		if (!_tcsicmp(item->path, full_path))
+		{
+			if (item->flags == aFlags && item->codepage == aCodePage)
+				return item;
+			// The file is being appended to in a different mode or encoding, so reopen it.
+			FileAppendCacheFlush(item->file);
+			delete item->file;
+			item->file = NULL;
+			item->flags = aFlags;
+			item->codepage = aCodePage;
+			return item;
+		}
+		if (!lru || (int)(item->last_used - lru->last_used) < 0)
+			lru = item;
+	}
+	if (g_FileAppendCacheCount < FILE_APPEND_CACHE_MAX)
+		item = sFileAppendCache + g_FileAppendCacheCount++;
+	else
+	{
+		// Make room by closing the least recently used file.
+		item = lru;
+		FileAppendCacheFlush(item->file);
+		delete item->file;
+	}
+	_tcscpy(item->path, full_path);
+	item->file = NULL;
+	item->flags = aFlags;
+	item->codepage = aCodePage;
+	item->last_used = GetTickCount();
+	return item;
+}
+
+void FileAppendCacheRemove(FileAppendCacheItem *aItem)
+// Closes aItem's file, if open, and removes it from the cache.
+{
+	FileAppendCacheFlush(aItem->file);
+	delete aItem->file;
+	FileAppendCacheItem *last = sFileAppendCache + --g_FileAppendCacheCount;
+	if (aItem != last)
+		*aItem = *last;
+	if (!g_FileAppendCacheCount)
+		KILL_FILE_APPEND_TIMER
+}
+
+int FileAppendCacheClose(LPCTSTR aFilespec)
+// Writes any buffered data to aFilespec (or if NULL, all cached files) and closes it.
+// Returns the number of files closed.
+{
+	TCHAR full_path[MAX_PATH];
+	if (aFilespec && !FileAppendCacheGetFullPath(aFilespec, full_path))
+		return 0;
+	int closed = 0;
+	for (int i = g_FileAppendCacheCount - 1; i >= 0; --i) // Backward because items are removed by moving the last item.
+	{
+		if (aFilespec && _tcsicmp(sFileAppendCache[i].path, full_path))
+			continue;
+		FileAppendCacheRemove(sFileAppendCache + i);
+		++closed;
+	}
+	return closed;
+}
+
+VOID CALLBACK FileAppendCacheTimeout(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+// Writes buffered data to disk, and closes files which haven't been appended to since the last time.
+{
+	DWORD now = GetTickCount();
+	for (int i = g_FileAppendCacheCount - 1; i >= 0; --i)
+	{
+		FileAppendCacheItem &item = sFileAppendCache[i];
+		if (now - item.last_used >= g_FileAppendCacheInterval)
+			FileAppendCacheRemove(&item); // Also kills the timer if this was the last item.
+		else
+			FileAppendCacheFlush(item.file);
+	}
+}
+
+
+
+BIF_DECL(BIF_FileAppendCache)
+// FileAppendCache(Interval [, BufferSize]): Sets how often (in milliseconds) FileAppend's buffered data
+// is written to disk, or disables caching if Interval is 0.  Returns the previous interval.
+// FileAppendCache(Filename, Enable): Controls whether FileAppend may cache a specific file, such as
+// one which must be written immediately in case the script or system crashes.
+{
+	if (TokenIsPureNumeric(*aParam[0]))
+	{
+		aResultToken.value_int64 = g_FileAppendCacheInterval;
+		__int64 interval = ParamIndexToInt64(0);
+		if (interval <= 0)
+		{
+			FileAppendCacheClose();
+			g_FileAppendCacheInterval = 0;
+		}
+		else
+		{
+			g_FileAppendCacheInterval = (DWORD)min(interval, (__int64)USER_TIMER_MAXIMUM);
+			if (g_FileAppendTimerExists)
+				SET_FILE_APPEND_TIMER // Apply the new interval.
+		}
+		if (!ParamIndexIsOmittedOrEmpty(1))
+		{
+			// Applies to files opened from now on.  Limit it to something reasonable since each
+			// cached file has its own buffer:
+			__int64 size = ParamIndexToInt64(1);
+			g_FileAppendCacheSize = (DWORD)(size < TEXT_IO_BLOCK ? TEXT_IO_BLOCK : min(size, (__int64)16 * 1024 * 1024));
+		}
+		return;
+	}
+	TCHAR full_path[MAX_PATH];
+	LPTSTR filespec = ParamIndexToString(0, aResultToken.buf);
+	if (!*filespec || !FileAppendCacheGetFullPath(filespec, full_path))
+	{
+		aResult = g_script.ScriptError(ERR_PARAM1_INVALID, filespec);
+		return;
+	}
+	bool enable = ParamIndexIsOmitted(1) || ParamIndexToInt64(1);
+	int index = FileAppendNoCacheIndex(full_path);
+	aResultToken.value_int64 = (index == -1); // Return whether caching was previously enabled for this file.
+	if (enable)
+	{
+		if (index != -1)
+		{
+			free(sFileAppendNoCache[index]);
+			sFileAppendNoCache[index] = sFileAppendNoCache[--sFileAppendNoCacheCount];
+		}
+		return;
+	}
+	FileAppendCacheClose(full_path);
+	if (index != -1)
+		return;
+	LPTSTR *new_list = (LPTSTR *)realloc(sFileAppendNoCache, (sFileAppendNoCacheCount + 1) * sizeof(LPTSTR));
+	LPTSTR path = _tcsdup(full_path);
+	if (!new_list || !path)
+	{
+		free(path);
+		if (new_list)
+			sFileAppendNoCache = new_list;
+		aResult = g_script.ScriptError(ERR_OUTOFMEM);
+		return;
+	}
+	sFileAppendNoCache = new_list;
+	sFileAppendNoCache[sFileAppendNoCacheCount++] = path;
+}
+
+void FileAppendCacheReset()
+// Closes all cached files and restores the default settings, such as when the script is destroyed.
+{
+	FileAppendCacheClose();
+	g_FileAppendCacheInterval = 0;
+	g_FileAppendCacheSize = FILE_APPEND_CACHE_BUF_SIZE;
+	g_FileAppendCacheError = 0;
+	for (int i = 0; i < sFileAppendNoCacheCount; ++i)
+		free(sFileAppendNoCache[i]);
+	free(sFileAppendNoCache);
+	sFileAppendNoCache = NULL;
+	sFileAppendNoCacheCount = 0;
+}
+
+
+
+BIF_DECL(BIF_FileFlush)
+// FileFlush([Filename]): Writes data buffered by FileAppend to the given file (or all files if omitted)
+// and closes it.  Returns the number of files which were flushed.
+{
+	LPTSTR filespec = ParamIndexToOptionalString(0, aResultToken.buf);
+	aResultToken.value_int64 = FileAppendCacheClose(*filespec ? filespec : NULL);
 }
 
 
@@ -13210,6 +13620,66 @@ bool IsDllArgTypeName(LPTSTR name)
 
 
 
+DllCallSite *CreateDllCallSite(LPTSTR aArgType[], int aArgCount, LPTSTR aReturnType)
+// Parses the literal type strings of a DllCall() call site for BIF_DllCallSite.  aReturnType is NULL if
+// the return type was omitted.  Returns NULL if any type is invalid (leaving DllCall() to report it at
+// runtime, as before) or if out of memory.
+{
+	DllCallSite *site = (DllCallSite *)SimpleHeap::Malloc(sizeof(DllCallSite) + aArgCount * sizeof(DYNAPARM));
+	if (!site)
+		return NULL;
+	_tcscpy(site->name, _T("DllCall"));
+	site->arg_count = aArgCount;
+	g_memset(&site->return_attrib, 0, sizeof(DYNAPARM));
+#ifdef WIN32_PLATFORM
+	site->dll_call_mode = DC_CALL_STD;
+#endif
+	LPTSTR type_string[2] = { NULL, NULL };
+	if (!aReturnType)
+		site->return_attrib.type = DLL_ARG_INT;
+	else
+	{
+		// This mirrors the return type section of BIF_DllCall for the SYM_STRING case.
+		bool naked_cdecl = false;
+		if (!_tcsnicmp(aReturnType, _T("CDecl"), 5))
+		{
+#ifdef WIN32_PLATFORM
+			site->dll_call_mode = DC_CALL_CDECL;
+#endif
+			aReturnType = omit_leading_whitespace(aReturnType + 5);
+			naked_cdecl = !*aReturnType;
+		}
+		if (naked_cdecl) // This means "Int", as in BIF_DllCall.
+			site->return_attrib.type = DLL_ARG_INT;
+		else // A blank type without CDecl is invalid, so ConvertDllArgType leaves it to DllCall() to report.
+		{
+			type_string[0] = aReturnType;
+			ConvertDllArgType(type_string, site->return_attrib);
+			if (site->return_attrib.type == DLL_ARG_INVALID)
+				return NULL;
+		}
+#ifdef WIN32_PLATFORM
+		if (!site->return_attrib.passed_by_address)
+		{
+			if (site->return_attrib.type == DLL_ARG_DOUBLE)
+				site->dll_call_mode |= DC_RETVAL_MATH8;
+			else if (site->return_attrib.type == DLL_ARG_FLOAT)
+				site->dll_call_mode |= DC_RETVAL_MATH4;
+		}
+#endif
+	}
+	for (int i = 0; i < aArgCount; ++i)
+	{
+		type_string[0] = aArgType[i];
+		ConvertDllArgType(type_string, site->arg[i]);
+		if (site->arg[i].type == DLL_ARG_INVALID)
+			return NULL;
+	}
+	return site;
+}
+
+
+
 void *GetDllProcAddress(LPCTSTR aDllFileFunc, HMODULE *hmodule_to_free) // L31: Contains code extracted from BIF_DllCall for reuse in ExpressionToPostfix.
 {
 	int i;
@@ -13853,6 +14323,8 @@ ResultType STDMETHODCALLTYPE DynaToken::Invoke(
 				// LLONG_MAX (return values can be written out as unsigned since the script can specify
 				// signed to avoid this, since they don't need the incoming detection for ATOU()).
 				this_dyna_param.value_int64 = (__int64)ATOU64(TokenToString(this_param)); // Cast should not prevent called function from seeing it as an undamaged unsigned number.
+			else if (BufferObject *buf = TokenToBuffer(this_param)) // Ptr args may be given a Buffer rather than its address.
+				this_dyna_param.value_int64 = (__int64)(size_t)buf->Data();
 			else
 				this_dyna_param.value_int64 = TokenToInt64(this_param);
 
@@ -14248,6 +14720,8 @@ BIF_DECL(BIF_DllImport)
 				// LLONG_MAX (return values can be written out as unsigned since the script can specify
 				// signed to avoid this, since they don't need the incoming detection for ATOU()).
 				this_dyna_param.value_int64 = (__int64)ATOU64(TokenToString(this_param)); // Cast should not prevent called function from seeing it as an undamaged unsigned number.
+			else if (BufferObject *buf = TokenToBuffer(this_param)) // Ptr args may be given a Buffer rather than its address.
+				this_dyna_param.value_int64 = (__int64)(size_t)buf->Data();
 			else
 				this_dyna_param.value_int64 = TokenToInt64(this_param);
 
@@ -14545,11 +15019,28 @@ BIF_DECL(BIF_DllImport)
 	BIF_DllCall(aResult,aResultToken,func_param,param_count);
 }
 */
+static void DllCall(BIF_DECL_PARAMS, DllCallSite *aSite);
+
 BIF_DECL(BIF_DllCall)
+{
+	DllCall(aResult, aResultToken, aParam, aParamCount, NULL);
+}
+
+BIF_DECL(BIF_DllCallSite)
+// Called instead of BIF_DllCall by call sites whose types were parsed at load-time.
+{
+	DllCallSite *site = (DllCallSite *)aResultToken.marker; // marker is the ExprOpFunc's mName.
+	if ((aParamCount - 1) / 2 != site->arg_count) // Shouldn't happen, but if it does, the parsed types can't be used.
+		site = NULL;
+	DllCall(aResult, aResultToken, aParam, aParamCount, site);
+}
+
+static void DllCall(BIF_DECL_PARAMS, DllCallSite *aSite)
 // Stores a number or a SYM_STRING result in aResultToken.
 // Sets ErrorLevel to the error code appropriate to any problem that occurred.
 // Caller has set up aParam to be viewable as a left-to-right array of params rather than a stack.
 // It has also ensured that the array has exactly aParamCount items in it.
+// If aSite is non-NULL, it holds the already-parsed arg and return types.
 // Author: Marcus Sonntag (Ultra)
 {
 	// Set default result in case of early return; a blank value:
@@ -14600,7 +15091,16 @@ BIF_DECL(BIF_DllCall)
 #ifdef WIN32_PLATFORM
 	int dll_call_mode = DC_CALL_STD; // Set default.  Can be overridden to DC_CALL_CDECL and flags can be OR'd into it.
 #endif
-	if (aParamCount % 2) // Odd number of parameters indicates the return type has been omitted, so assume BOOL/INT.
+	if (aSite) // The types were parsed and validated at load-time.
+	{
+		return_attrib = aSite->return_attrib;
+#ifdef WIN32_PLATFORM
+		dll_call_mode = aSite->dll_call_mode;
+#endif
+		if (!(aParamCount % 2))
+			--aParamCount;  // Remove the return type from further consideration.
+	}
+	else if (aParamCount % 2) // Odd number of parameters indicates the return type has been omitted, so assume BOOL/INT.
 		return_attrib.type = DLL_ARG_INT;
 	else
 	{
@@ -14698,32 +15198,36 @@ has_valid_return_type:
 	// It has also verified that the dyna_param array is large enough to hold all of the args.
 	for (arg_count = 0, i = 1; i < aParamCount; ++arg_count, i += 2)  // Same loop as used later below, so maintain them together.
 	{
-		switch (aParam[i]->symbol)
-		{
-		case SYM_VAR: // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
-			arg_type_string[0] = aParam[i]->var->Contents(TRUE, TRUE);
-			arg_type_string[1] = aParam[i]->var->mName;
-			// v1.0.33.01: arg_type_string[1] improves convenience by falling back to the variable's name
-			// if the contents are not appropriate.  In other words, both Int and "Int" are treated the same.
-			// It's done this way to allow the variable named "Int" to actually contain some other legitimate
-			// type-name such as "Str" (in case anyone ever happens to do that).
-			break;
-		case SYM_STRING:
-		case SYM_OPERAND:
-			arg_type_string[0] = aParam[i]->marker;
-			arg_type_string[1] = NULL; // Added in 1.0.48.
-			break;
-		default:
-			arg_type_string[0] = _T(""); // It will be detected as invalid below.
-			arg_type_string[1] = NULL;
-			break;
-		}
-
 		ExprTokenType &this_param = *aParam[i + 1];         // Resolved for performance and convenience.
 		DYNAPARM &this_dyna_param = dyna_param[arg_count];  //
 
-		// Store the each arg into a dyna_param struct, using its arg type to determine how.
-		ConvertDllArgType(arg_type_string, this_dyna_param);
+		if (aSite)
+			this_dyna_param = aSite->arg[arg_count]; // Struct copy of the type parsed at load-time.
+		else
+		{
+			switch (aParam[i]->symbol)
+			{
+			case SYM_VAR: // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
+				arg_type_string[0] = aParam[i]->var->Contents(TRUE, TRUE);
+				arg_type_string[1] = aParam[i]->var->mName;
+				// v1.0.33.01: arg_type_string[1] improves convenience by falling back to the variable's name
+				// if the contents are not appropriate.  In other words, both Int and "Int" are treated the same.
+				// It's done this way to allow the variable named "Int" to actually contain some other legitimate
+				// type-name such as "Str" (in case anyone ever happens to do that).
+				break;
+			case SYM_STRING:
+			case SYM_OPERAND:
+				arg_type_string[0] = aParam[i]->marker;
+				arg_type_string[1] = NULL; // Added in 1.0.48.
+				break;
+			default:
+				arg_type_string[0] = _T(""); // It will be detected as invalid below.
+				arg_type_string[1] = NULL;
+				break;
+			}
+			// Store the each arg into a dyna_param struct, using its arg type to determine how.
+			ConvertDllArgType(arg_type_string, this_dyna_param);
+		}
 		switch (this_dyna_param.type)
 		{
 		case DLL_ARG_STR:
@@ -14819,6 +15323,8 @@ has_valid_return_type:
 				// LLONG_MAX (return values can be written out as unsigned since the script can specify
 				// signed to avoid this, since they don't need the incoming detection for ATOU()).
 				this_dyna_param.value_int64 = (__int64)ATOU64(TokenToString(this_param)); // Cast should not prevent called function from seeing it as an undamaged unsigned number.
+			else if (BufferObject *buf = TokenToBuffer(this_param)) // Ptr args may be given a Buffer rather than its address.
+				this_dyna_param.value_int64 = (__int64)(size_t)buf->Data();
 			else
 				this_dyna_param.value_int64 = TokenToInt64(this_param);
 
@@ -15092,10 +15598,17 @@ end:
 BIF_DECL(BIF_CriticalObject)
 {
 	IObject *obj = NULL;
-	// If 2 parameters are given and second parameter is 1 or 2,
-	// means we want to get the reference to obj(1) or crisec(2)
-	if (aParamCount == 2 && TokenToInt64(*aParam[1]) < 3) 
+	// If 2 parameters are given and second parameter is the integer 1, 2 or 3,
+	// means we want to get the reference to obj(1), crisec(2) or the contention statistics(3)
+	if (aParamCount == 2 && TokenIsPureNumeric(*aParam[1]) == PURE_INTEGER && TokenToInt64(*aParam[1]) < 4) 
 	{
+		if (TokenToInt64(*aParam[1]) < 1) // Too small to be a critical section address either.
+		{
+			aResultToken.symbol = SYM_STRING;
+			aResultToken.marker = _T("");
+			aResult = g_script.ScriptError(ERR_PARAM2_INVALID);
+			return;
+		}
 		aResultToken.symbol = PURE_INTEGER;
 		CriticalObject *criticalobj;
 		if (!(criticalobj = (CriticalObject *)TokenToObject(*aParam[0])))
@@ -15106,6 +15619,16 @@ BIF_DECL(BIF_CriticalObject)
 			aResultToken.value_int64 = criticalobj->GetObj();
 		else if (TokenToInt64(*aParam[1]) == 2) // Get critical section reference
 			aResultToken.value_int64 = criticalobj->GetCriSec();
+		else if (TokenToInt64(*aParam[1]) == 3) // Get contention statistics
+		{
+			if (obj = criticalobj->GetStats())
+			{
+				aResultToken.symbol = SYM_OBJECT;
+				aResultToken.object = obj;
+			}
+			else
+				aResultToken.value_int64 = 0;
+		}
 	} 
 	else if (obj = CriticalObject::Create(aParam,aParamCount))
 	{
@@ -15125,6 +15648,11 @@ CriticalObject *CriticalObject::Create(ExprTokenType *aParam[], int aParamCount)
 {
 	IObject *obj = NULL;
 	CriticalObject *criticalref = NULL;
+	// CriticalObject(obj, "RW") creates a reader-writer lock: enumeration and single-key gets on an Object
+	// without a base are performed under a shared lock, since they can't run script code.  Everything else,
+	// including gets which might call meta-functions or property getters, uses the exclusive lock.
+	bool reader_writer = aParamCount == 2 && !TokenIsPureNumeric(*aParam[1])
+		&& !_tcsicmp(TokenToString(*aParam[1]), _T("RW"));
 	if (aParamCount == 0) // No parameters given, create new object
 		obj = Object::Create(0,0);
 	else if (obj = TokenToObject(*aParam[0]))
@@ -15155,39 +15683,169 @@ CriticalObject *CriticalObject::Create(ExprTokenType *aParam[], int aParamCount)
 	criticalobj->object = obj;
 
 	if (criticalref)
+	{	// Share the lock (and therefore the reader count) of the existing wrapper.
 		criticalobj->lpCriticalSection = (LPCRITICAL_SECTION)criticalref->GetCriSec();
-	else if (aParamCount < 2)
+		criticalobj->mLock = criticalref->mLock;
+	}
+	else if (aParamCount < 2 || reader_writer)
 	{	// no Critical Section reference was given, create one
-		criticalobj->lpCriticalSection = (LPCRITICAL_SECTION)GlobalAlloc(0, sizeof(CRITICAL_SECTION));
-		InitializeCriticalSection(criticalobj->lpCriticalSection);
+		CriticalLock *lock = (CriticalLock *)GlobalAlloc(0, sizeof(CriticalLock));
+		InitializeCriticalSection(&lock->mCriSec);
+		lock->mReaders = 0;
+		criticalobj->lpCriticalSection = &lock->mCriSec;
+		if (reader_writer)
+			criticalobj->mLock = lock;
 	}
 	else
-		// An already initialized Critical Section reference was given, use it
+		// An already initialized Critical Section reference was given, use it.
+		// Since it can't be known who else uses it, only exclusive locking is possible.  Wrappers
+		// meant to share a reader-writer lock must be created from the CriticalObject itself.
 		criticalobj->lpCriticalSection = (LPCRITICAL_SECTION)TokenToInt64(*aParam[1]);
+	criticalobj->mPlainObject = dynamic_cast<Object *>(obj);
 	return criticalobj;
 }
 
 //
-// CriticalObject::Delete - Called immediately before the object is deleted.
-//					Returns false if object should not be deleted yet.
+// CriticalObject::Enter - Acquires the critical section exclusively.
 //
 
-bool CriticalObject::Delete()
+void CriticalObject::Enter()
 {
-	// Avoid deadlocking the process so messages can still be processed
-
+	if (!TryEnterCriticalSection(this->lpCriticalSection))
+	{
+		LARGE_INTEGER start, stop;
+		QueryPerformanceCounter(&start);
+		// Spin briefly first since the lock is usually held only for the duration of a single Invoke.
+		int spin_limit = mSpinCount, spins = 0; // mSpinCount is read without owning the lock, any recent value will do.
+		for (; spins < spin_limit; ++spins)
+		{
+			YieldProcessor();
+			if (TryEnterCriticalSection(this->lpCriticalSection))
+				break;
+		}
+		bool spin_acquired = spins < spin_limit;
+		if (!spin_acquired)
+		{
 #ifdef _WIN64
-	DWORD aThreadID = __readgsdword(0x48); // Used to identify if code is called from different thread (AutoHotkey.dll)
+			DWORD aThreadID = __readgsdword(0x48); // Used to identify if code is called from different thread (AutoHotkey.dll)
 #else
-	DWORD aThreadID = __readfsdword(0x24);
+			DWORD aThreadID = __readfsdword(0x24);
 #endif
+			if (g_MainThreadID == aThreadID)
+			{	// Avoid deadlocking the process so messages can still be processed
+				while (!TryEnterCriticalSection(this->lpCriticalSection))
+					MsgSleep(-1);
+			}
+			else
+				// No messages are processed by this thread anyway, so wait in the kernel
+				// rather than burning time slices with Sleep(0).
+				EnterCriticalSection(this->lpCriticalSection);
+		}
+		QueryPerformanceCounter(&stop);
+		// The lock is owned now, so the statistics can be updated safely.
+		++mContendedCount;
+		mWaitTime += stop.QuadPart - start.QuadPart;
+		if (spin_acquired)
+		{
+			++mSpinAcquiredCount;
+			// Move the limit towards twice the number of spins which were needed (as glibc's adaptive mutex does).
+			mSpinCount += (2 * spins - mSpinCount) / 8;
+			if (mSpinCount < CRITICAL_SPIN_MIN)
+				mSpinCount = CRITICAL_SPIN_MIN;
+		}
+		else
+		{
+			++mWaitCount;
+			// Spinning didn't pay off, so spin less next time.
+			mSpinCount -= mSpinCount / 8;
+			if (mSpinCount < CRITICAL_SPIN_MIN)
+				mSpinCount = CRITICAL_SPIN_MIN;
+		}
+		if (mSpinCount > CRITICAL_SPIN_MAX)
+			mSpinCount = CRITICAL_SPIN_MAX;
+	}
+	++mExclusiveCount;
+	if (mLock && mLock->mReaders)
+	{
+		// No new readers can register while the critical section is owned, so just wait for the
+		// current ones to finish.  Readers never run script code while holding the shared lock.
+		for (int spins = 0; mLock->mReaders; ++spins)
+			if (spins < mSpinCount)
+				YieldProcessor();
+			else
+				Sleep(0);
+	}
+}
+
+//
+// CriticalObject::EnterShared - Registers the calling thread as a reader.
+//
 
+void CriticalObject::EnterShared()
+{
+	// Owning the critical section while registering ensures no writer is active.
+	// Enter() also waits for readers, which is harmless since readers never block.
+	if (!TryEnterCriticalSection(this->lpCriticalSection))
+	{
+		Enter();
+		--mExclusiveCount;
+	}
+	InterlockedIncrement(&mLock->mReaders);
+	++mSharedCount;
+	LeaveCriticalSection(this->lpCriticalSection);
+}
+
+//
+// CriticalObject::Wrap - Wraps an object returned by the wrapped object (an enumerator) using the same lock.
+//
+
+CriticalObject *CriticalObject::Wrap(IObject *aObject)
+{
+	CriticalObject *new_object = new CriticalObject();
+	new_object->object = aObject;
+	new_object->lpCriticalSection = this->lpCriticalSection;
+	new_object->mLock = this->mLock;
+	new_object->mIsEnum = true;
+	return new_object;
+}
+
+//
+// CriticalObject::GetStats - Returns an object containing the contention statistics of this wrapper.
+//
+
+Object *CriticalObject::GetStats()
+{
+	Object *stats = Object::Create();
+	if (!stats)
+		return NULL;
+	Enter(); // Take a consistent snapshot.
+	__int64 exclusive_count = mExclusiveCount - 1; // Exclude the call above.
+	__int64 wait_time = mWaitTime;
+	stats->SetItem(_T("Shared"), (__int64)mSharedCount);
+	stats->SetItem(_T("Contended"), (__int64)mContendedCount);
+	stats->SetItem(_T("SpinAcquired"), (__int64)mSpinAcquiredCount);
+	stats->SetItem(_T("Waited"), (__int64)mWaitCount);
+	stats->SetItem(_T("SpinCount"), (__int64)mSpinCount);
+	stats->SetItem(_T("ReaderWriter"), (__int64)(mLock != NULL));
+	--mExclusiveCount;
+	LeaveCriticalSection(this->lpCriticalSection);
+	LARGE_INTEGER freq;
+	QueryPerformanceFrequency(&freq);
+	stats->SetItem(_T("Exclusive"), exclusive_count);
+	// Microseconds, split to avoid overflowing wait_time * 1000000 on long waits.
+	stats->SetItem(_T("WaitTime"), freq.QuadPart ? wait_time / freq.QuadPart * 1000000 + wait_time % freq.QuadPart * 1000000 / freq.QuadPart : 0);
+	return stats;
+}
+
+//
+// CriticalObject::Delete - Called immediately before the object is deleted.
+//					Returns false if object should not be deleted yet.
+//
+
+bool CriticalObject::Delete()
+{
 	// Check if we own the critical section and release it
-	while (!TryEnterCriticalSection(this->lpCriticalSection))
-		if (g_MainThreadID == aThreadID)
-			MsgSleep(-1);
-		else
-			Sleep(0); 
+	Enter();
 	this->object->Release();
 	LeaveCriticalSection(this->lpCriticalSection);
 	return ObjectBase::Delete();
@@ -15201,29 +15859,28 @@ ResultType STDMETHODCALLTYPE CriticalObject::Invoke(
                                             int aParamCount
                                             )
  {
-
-#ifdef _WIN64
-	 DWORD aThreadID = __readgsdword(0x48); // Used to identify if code is called from different thread (AutoHotkey.dll)
-#else
-	 DWORD aThreadID = __readfsdword(0x24);
-#endif
-
-	 // Avoid deadlocking the process so messages can still be processed
-	 while (!TryEnterCriticalSection(this->lpCriticalSection))
-		if (g_MainThreadID == aThreadID)
-			MsgSleep(-1);
-		else
-			Sleep(0); 
+	 ResultType r;
+	 // Enumerators and single-key gets on an Object without base don't modify the object nor
+	 // run script code, so they can be performed under the shared lock in reader-writer mode.
+	 if (mLock && (mIsEnum || mPlainObject && IS_INVOKE_GET && !IS_INVOKE_META && aParamCount == 1))
+	 {
+		 EnterShared();
+		 // Check Base() only now since it can't change while the shared lock is held.
+		 if (mIsEnum || !mPlainObject->Base())
+		 {
+			 r = this->object->Invoke(aResultToken,aThisToken,aFlags,aParam,aParamCount);
+			 LeaveShared();
+			 return r;
+		 }
+		 LeaveShared();
+	 }
+	 Enter();
 	 // Invoke original object as if it was called
-	 ResultType r = this->object->Invoke(aResultToken,aThisToken,aFlags,aParam,aParamCount);
+	 r = this->object->Invoke(aResultToken,aThisToken,aFlags,aParam,aParamCount);
 	 if (aResultToken.symbol == SYM_OBJECT && dynamic_cast<EnumBase *>(aResultToken.object))
-	 {	// Result is an enumerator object enwrap enumerator into critical object
+		// Result is an enumerator object enwrap enumerator into critical object
 		// using same LPCRITICAL_SECTION and update aResultToken
-		CriticalObject *new_object = new CriticalObject();
-		new_object->object = aResultToken.object;
-		new_object->lpCriticalSection = this->lpCriticalSection;
-		aResultToken.object = new_object;
-	 }
+		aResultToken.object = Wrap(aResultToken.object);
 	 LeaveCriticalSection(this->lpCriticalSection);
 	 return r;
 }
@@ -16956,11 +17613,126 @@ BIF_DECL(BIF_Chr)
 
 
 
+int ConvertNumType(LPTSTR aType)
+// Returns NUMTYPE_ flags for a NumGet/NumPut type name.  Since a leading "U" is checked for and then only
+// one or two more chars, this also accepts abbreviations such as "UI", for backward-compatibility.
+{
+	int num_type = 0;
+	if (ctoupper(*aType) == 'U') // Unsigned.
+	{
+		num_type = NUMTYPE_UNSIGNED;
+		++aType; // Remove the first character from further consideration.
+	}
+	switch(ctoupper(*aType)) // Note that the above has omitted the leading "U", if present, leaving type as "Int" vs. "Uint", etc.
+	{
+	case 'P': return num_type | NUMTYPE_PTR | sizeof(DWORD_PTR); // Ptr.
+	case 'I':
+		if (_tcschr(aType, '6')) // Int64. It's checked this way for performance, and to avoid access violation if string is bogus and too short such as "i64".
+			return num_type | 8;
+		return num_type | 4;
+	case 'S': return num_type | 2; // Short.
+	case 'C': return num_type | 1; // Char.
+	case 'D': return num_type | NUMTYPE_FLOAT | 8; // Double.
+	case 'F': return num_type | NUMTYPE_FLOAT | 4; // Float.
+	}
+	// For any unrecognized values, use the default size (for simplicity).
+	return num_type | NUMTYPE_UNKNOWN | sizeof(DWORD_PTR);
+}
+
+
+
+void ReadNum(int aNumType, void *aSource, ExprTokenType &aResultToken)
+// Stores the number of type aNumType at aSource in aResultToken.  Caller has validated aSource.
+{
+	aResultToken.symbol = (aNumType & NUMTYPE_FLOAT) ? SYM_FLOAT : SYM_INTEGER;
+	BOOL is_signed = !(aNumType & NUMTYPE_UNSIGNED); // Ignored for 64-bit types due to lack of support for UInt64.
+	switch(aNumType & NUMTYPE_SIZE_MASK)
+	{
+	case 4: // Listed first for performance.
+		if (aNumType & NUMTYPE_FLOAT)
+			aResultToken.value_double = *(float *)aSource;
+		else if (is_signed)
+			aResultToken.value_int64 = *(int *)aSource;
+		else
+			aResultToken.value_int64 = *(unsigned int *)aSource;
+		break;
+	case 8:
+		// The below correctly copies both DOUBLE and INT64 into the union.
+		// Unsigned 64-bit integers aren't supported because variables/expressions can't support them.
+		aResultToken.value_int64 = *(__int64 *)aSource;
+		break;
+	case 2:
+		if (is_signed) // Don't use ternary because that messes up type-casting.
+			aResultToken.value_int64 = *(short *)aSource;
+		else
+			aResultToken.value_int64 = *(unsigned short *)aSource;
+		break;
+	default: // size 1
+		if (is_signed) // Don't use ternary because that messes up type-casting.
+			aResultToken.value_int64 = *(char *)aSource;
+		else
+			aResultToken.value_int64 = *(unsigned char *)aSource;
+	}
+}
+
+
+
+void WriteNum(int aNumType, void *aTarget, ExprTokenType &aValue)
+// Stores aValue at aTarget as a number of type aNumType.  Caller has validated aTarget.
+{
+	switch(aNumType & NUMTYPE_SIZE_MASK)
+	{
+	case 4: // Listed first for performance.
+		if (aNumType & NUMTYPE_FLOAT)
+			*(float *)aTarget = (float)TokenToDouble(aValue);
+		else
+			*(unsigned int *)aTarget = (unsigned int)TokenToInt64(aValue);
+		break;
+	case 8:
+		if (aNumType & NUMTYPE_FLOAT)
+			*(double *)aTarget = TokenToDouble(aValue);
+		else
+			// v1.0.48: Support unsigned 64-bit integers like DllCall does.  This applies to Ptr and to
+			// an omitted type as well as to UInt64:
+			*(__int64 *)aTarget = ((aNumType & (NUMTYPE_UNSIGNED | NUMTYPE_PTR)) && !IS_NUMERIC(aValue.symbol)) // Must not be numeric because those are already signed values, so should be written out as signed so that whoever uses them can interpret negatives as large unsigned values.
+				? (__int64)ATOU64(TokenToString(aValue)) // For comments, search for ATOU64 in BIF_DllCall().
+				: TokenToInt64(aValue);
+		break;
+	case 2:
+		*(unsigned short *)aTarget = (unsigned short)TokenToInt64(aValue);
+		break;
+	default: // size 1
+		*(unsigned char *)aTarget = (unsigned char)TokenToInt64(aValue);
+	}
+}
+
+
+
+static void NumGet(BIF_DECL_PARAMS, int aNumType);
+
 BIF_DECL(BIF_NumGet)
+{
+	NumGet(aResult, aResultToken, aParam, aParamCount, 0);
+}
+
+BIF_DECL(BIF_NumGetType)
+// Called instead of BIF_NumGet when the Type param is a literal string, which was parsed at load-time.
+{
+	NumGet(aResult, aResultToken, aParam, aParamCount, (int)(INT_PTR)aResultToken.marker); // marker is the ExprOpFunc's mName.
+}
+
+static void NumGet(BIF_DECL_PARAMS, int aNumType)
+// aNumType is 0 if the Type param, if present, hasn't been parsed yet.
 {
 	size_t right_side_bound, target; // Don't make target a pointer-type because the integer offset might not be a multiple of 4 (i.e. the below increments "target" directly by "offset" and we don't want that to use pointer math).
 	ExprTokenType &target_token = *aParam[0];
-	if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
+	BufferObject *target_buf = TokenToBuffer(target_token);
+	if (target_buf)
+	{
+		target = (size_t)target_buf->Data();
+		right_side_bound = target + target_buf->Size();
+	}
+	else if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
 	{
 		target = (size_t)target_token.var->Contents(); // Although Contents(TRUE) will force an update of mContents if necessary, it very unlikely to be necessary here because we're about to fetch a binary number from inside mContents, not a normal/text number.
 		right_side_bound = target + target_token.var->ByteCapacity(); // This is first illegal address to the right of target.
@@ -16977,46 +17749,11 @@ BIF_DECL(BIF_NumGet)
 			++aParamCount, --aParam; // aParam[0] is no longer valid, but that's OK.
 	}
 
-	BOOL is_signed;
-	size_t size = sizeof(DWORD_PTR); // Set default.
-
-	if (aParamCount < 3) // The "type" parameter is absent (which is most often the case), so use defaults.
-	{
-#ifndef _WIN64 // is_signed is ignored on 64-bit builds due to lack of support for UInt64.  Explicitly disable this for maintainability.
-		is_signed = FALSE;
-#endif
-		// And keep "size" at its default set earlier.
-	}
-	else // An explicit "type" is present.
-	{
-		LPTSTR type = TokenToString(*aParam[2], aResultToken.buf);
-		if (ctoupper(*type) == 'U') // Unsigned.
-		{
-			++type; // Remove the first character from further consideration.
-			is_signed = FALSE;
-		}
-		else
-			is_signed = TRUE;
-
-		switch(ctoupper(*type)) // Override "size" and aResultToken.symbol if type warrants it. Note that the above has omitted the leading "U", if present, leaving type as "Int" vs. "Uint", etc.
-		{
-		//case 'P': // Nothing extra needed in this case.
-		case 'I':
-			if (_tcschr(type, '6')) // Int64. It's checked this way for performance, and to avoid access violation if string is bogus and too short such as "i64".
-				size = 8;
-			else
-				size = 4;
-			break;
-		case 'S': size = 2; break; // Short.
-		case 'C': size = 1; break; // Char.
-
-		case 'D': size = 8; aResultToken.symbol = SYM_FLOAT; break; // Double.
-		case 'F': size = 4; aResultToken.symbol = SYM_FLOAT; break; // Float.
-
-		// default: For any unrecognized values, keep "size" and aResultToken.symbol at their defaults set earlier
-		// (for simplicity).
-		}
-	}
+	if (!aNumType)
+		aNumType = (aParamCount < 3) // The "type" parameter is absent (which is most often the case), so use defaults.
+			? NUMTYPE_DEFAULT
+			: ConvertNumType(TokenToString(*aParam[2], aResultToken.buf));
+	size_t size = aNumType & NUMTYPE_SIZE_MASK;
 
 	// If the target is a variable, the following check ensures that the memory to be read lies within its capacity.
 	// This seems superior to an exception handler because exception handlers only catch illegal addresses,
@@ -17027,40 +17764,14 @@ BIF_DECL(BIF_NumGet)
 	// - Due to rarity of negative offsets, only the right-side boundary is checked, not the left.
 	// - Due to rarity and to simplify things, Float/Double (which "return" higher above) aren't checked.
 	if (target < 65536 // Basic sanity check to catch incoming raw addresses that are zero or blank.
-		|| target_token.symbol == SYM_VAR && target+size > right_side_bound) // i.e. it's ok if target+size==right_side_bound because the last byte to be read is actually at target+size-1. In other words, the position of the last possible terminator within the variable's capacity is considered an allowable address.
+		|| (target_buf || target_token.symbol == SYM_VAR) && target+size > right_side_bound) // i.e. it's ok if target+size==right_side_bound because the last byte to be read is actually at target+size-1. In other words, the position of the last possible terminator within the variable's capacity is considered an allowable address.
 	{
 		aResultToken.symbol = SYM_STRING;
 		aResultToken.marker = _T("");
 		return;
 	}
 
-	switch(size)
-	{
-	case 4: // Listed first for performance.
-		if (aResultToken.symbol == SYM_FLOAT)
-			aResultToken.value_double = *(float *)target;
-		else if (is_signed)
-			aResultToken.value_int64 = *(int *)target; // aResultToken.symbol was set to SYM_FLOAT or SYM_INTEGER higher above.
-		else
-			aResultToken.value_int64 = *(unsigned int *)target;
-		break;
-	case 8:
-		// The below correctly copies both DOUBLE and INT64 into the union.
-		// Unsigned 64-bit integers aren't supported because variables/expressions can't support them.
-		aResultToken.value_int64 = *(__int64 *)target;
-		break;
-	case 2:
-		if (is_signed) // Don't use ternary because that messes up type-casting.
-			aResultToken.value_int64 = *(short *)target;
-		else
-			aResultToken.value_int64 = *(unsigned short *)target;
-		break;
-	default: // size 1
-		if (is_signed) // Don't use ternary because that messes up type-casting.
-			aResultToken.value_int64 = *(char *)target;
-		else
-			aResultToken.value_int64 = *(unsigned char *)target;
-	}
+	ReadNum(aNumType, (void *)target, aResultToken);
 }
 
 
@@ -17221,14 +17932,34 @@ BIF_DECL(BIF_Format)
 
 
 
+static void NumPut(BIF_DECL_PARAMS, int aNumType);
+
 BIF_DECL(BIF_NumPut)
+{
+	NumPut(aResult, aResultToken, aParam, aParamCount, 0);
+}
+
+BIF_DECL(BIF_NumPutType)
+// Called instead of BIF_NumPut when the Type param is a literal string, which was parsed at load-time.
+{
+	NumPut(aResult, aResultToken, aParam, aParamCount, (int)(INT_PTR)aResultToken.marker); // marker is the ExprOpFunc's mName.
+}
+
+static void NumPut(BIF_DECL_PARAMS, int aNumType)
+// aNumType is 0 if the Type param, if present, hasn't been parsed yet.
 {
 	// Load-time validation has ensured that at least the first two parameters are present.
 	ExprTokenType &token_to_write = *aParam[0];
 
 	size_t right_side_bound, target; // Don't make target a pointer-type because the integer offset might not be a multiple of 4 (i.e. the below increments "target" directly by "offset" and we don't want that to use pointer math).
 	ExprTokenType &target_token = *aParam[1];
-	if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
+	BufferObject *target_buf = TokenToBuffer(target_token);
+	if (target_buf)
+	{
+		target = (size_t)target_buf->Data();
+		right_side_bound = target + target_buf->Size();
+	}
+	else if (target_token.symbol == SYM_VAR) // SYM_VAR's Type() is always VAR_NORMAL (except lvalues in expressions).
 	{
 		target = (size_t)target_token.var->Contents(FALSE); // Pass FALSE for performance because contents is about to be overwritten, followed by a call to Close(). If something goes wrong and we return early, Contents() won't have been changed, so nothing about it needs updating.
 		right_side_bound = target + target_token.var->ByteCapacity(); // This is the first illegal address to the right of target.
@@ -17245,47 +17976,19 @@ BIF_DECL(BIF_NumPut)
 			++aParamCount, --aParam; // aParam[0] is no longer valid, but that's OK.
 	}
 
-	size_t size = sizeof(DWORD_PTR); // Set defaults.
-	BOOL is_integer = TRUE;   //
-	BOOL is_unsigned = (aParamCount > 3) ? FALSE : TRUE; // This one was added v1.0.48 to support unsigned __int64 the way DllCall does.
-
-	if (aParamCount > 3) // The "type" parameter is present (which is somewhat unusual).
-	{
-		LPTSTR type = TokenToString(*aParam[3], aResultToken.buf);
-		if (ctoupper(*type) == 'U') // Unsigned; but in the case of NumPut, it matters only for UInt64.
-		{
-			is_unsigned = TRUE;
-			++type; // Remove the first character from further consideration.
-		}
-
-		switch(ctoupper(*type)) // Override "size" and is_integer if type warrants it. Note that the above has omitted the leading "U", if present, leaving type as "Int" vs. "Uint", etc.
-		{
-		case 'P': is_unsigned = TRUE; break; // Ptr.
-		case 'I':
-			if (_tcschr(type, '6')) // Int64. It's checked this way for performance, and to avoid access violation if string is bogus and too short such as "i64".
-				size = 8;
-			else
-				size = 4;
-			//else keep "size" at its default set earlier.
-			break;
-		case 'S': size = 2; break; // Short.
-		case 'C': size = 1; break; // Char.
-
-		case 'D': size = 8; is_integer = FALSE; break; // Double.
-		case 'F': size = 4; is_integer = FALSE; break; // Float.
-
-		// default: For any unrecognized values, keep "size" and is_integer at their defaults set earlier
-		// (for simplicity).
-		}
-	}
+	if (!aNumType)
+		aNumType = (aParamCount > 3) // The "type" parameter is present (which is somewhat unusual).
+			? ConvertNumType(TokenToString(*aParam[3], aResultToken.buf))
+			: NUMTYPE_DEFAULT; // v1.0.48: Unsigned by default to support unsigned __int64 the way DllCall does.
+	size_t size = aNumType & NUMTYPE_SIZE_MASK;
 
 	aResultToken.value_int64 = target + size; // This is used below and also as NumPut's return value. It's the address to the right of the item to be written.  aResultToken.symbol was set to SYM_INTEGER by our caller.
 
 	// See comments in NumGet about the following section:
 	if (target < 65536 // Basic sanity check to catch incoming raw addresses that are zero or blank.
-		|| target_token.symbol == SYM_VAR && aResultToken.value_int64 > (INT_PTR)right_side_bound) // i.e. it's ok if target+size==right_side_bound because the last byte to be read is actually at target+size-1. In other words, the position of the last possible terminator within the variable's capacity is considered an allowable address.
+		|| (target_buf || target_token.symbol == SYM_VAR) && aResultToken.value_int64 > (INT_PTR)right_side_bound) // i.e. it's ok if target+size==right_side_bound because the last byte to be read is actually at target+size-1. In other words, the position of the last possible terminator within the variable's capacity is considered an allowable address.
 	{
-		if (target_token.symbol == SYM_VAR)
+		if (!target_buf && target_token.symbol == SYM_VAR)
 		{
 			// Since target_token is a var, maybe the target is out of bounds because the var
 			// hasn't been initialized (i.e. it has zero capacity).  Note that if a local var
@@ -17301,30 +18004,8 @@ BIF_DECL(BIF_NumPut)
 		return;
 	}
 
-	switch(size)
-	{
-	case 4: // Listed first for performance.
-		if (is_integer)
-			*(unsigned int *)target = (unsigned int)TokenToInt64(token_to_write);
-		else // Float (32-bit).
-			*(float *)target = (float)TokenToDouble(token_to_write);
-		break;
-	case 8:
-		if (is_integer)
-			// v1.0.48: Support unsigned 64-bit integers like DllCall does:
-			*(__int64 *)target = (is_unsigned && !IS_NUMERIC(token_to_write.symbol)) // Must not be numeric because those are already signed values, so should be written out as signed so that whoever uses them can interpret negatives as large unsigned values.
-				? (__int64)ATOU64(TokenToString(token_to_write)) // For comments, search for ATOU64 in BIF_DllCall().
-				: TokenToInt64(token_to_write);
-		else // Double (64-bit).
-			*(double *)target = TokenToDouble(token_to_write);
-		break;
-	case 2:
-		*(unsigned short *)target = (unsigned short)TokenToInt64(token_to_write);
-		break;
-	default: // size 1
-		*(unsigned char *)target = (unsigned char)TokenToInt64(token_to_write);
-	}
-	if (target_token.symbol == SYM_VAR)
+	WriteNum(aNumType, (void *)target, token_to_write);
+	if (!target_buf && target_token.symbol == SYM_VAR)
 		target_token.var->Close(); // This updates various attributes of the variable.
 	//else the target was an raw address.  If that address is inside some variable's contents, the above
 	// attributes would already have been removed at the time the & operator was used on the variable.
@@ -17371,7 +18052,13 @@ BIF_DECL(BIF_StrGetPut)
 
 	const LPVOID FIRST_VALID_ADDRESS = (LPVOID)65536;
 
-	if (aParam < aParam_end && TokenIsPureNumeric(**aParam))
+	BufferObject *buf = aParam < aParam_end ? TokenToBuffer(**aParam) : NULL;
+	if (buf)
+	{
+		address = buf->Data();
+		++aParam;
+	}
+	else if (aParam < aParam_end && TokenIsPureNumeric(**aParam))
 	{
 		address = (LPVOID)TokenToInt64(**aParam);
 		++aParam;
@@ -17420,6 +18107,37 @@ BIF_DECL(BIF_StrGetPut)
 	}
 	// Note: CP_AHKNOBOM is not supported; "-RAW" must be omitted.
 
+	if (buf)
+	{
+		// Length defaults to, and must not exceed, the number of whole characters which fit in the buffer.
+		// StrGet still stops at a null-terminator, but never reads beyond the end of the buffer.
+		size_t char_size = encoding == CP_UTF16 ? sizeof(WCHAR) : sizeof(CHAR);
+		size_t max_length = buf->Size() / char_size;
+		if (max_length > INT_MAX)
+			max_length = INT_MAX;
+		if (length == -1)
+		{
+			if (source_string)
+				length = (int)max_length;
+			else if (encoding == CP_UTF16)
+				length = (int)wcsnlen((LPCWSTR)address, max_length);
+			else
+				length = (int)strnlen((LPCSTR)address, max_length);
+			if (!length)
+			{
+				if (source_string)
+					aResultToken.symbol = SYM_INTEGER, aResultToken.value_int64 = 0; // Buffer too small.
+				return;
+			}
+		}
+		else if ((size_t)length > max_length)
+		{
+			// Unlike an invalid address, this is reported since the Buffer's size is known.
+			g_script.ThrowRuntimeException(source_string ? ERR_PARAM3_INVALID : ERR_PARAM2_INVALID);
+			return;
+		}
+	}
+
 	// Check for obvious errors to prevent an Access Violation.
 	// Address can be zero for StrPut if length is also zero (see below).
 	if ( address < FIRST_VALID_ADDRESS
@@ -17480,7 +18198,7 @@ BIF_DECL(BIF_StrGetPut)
 				// See similar section below for comments.
 				if (length <= 0)
 				{
-					char_count = MultiByteToWideChar(CP_ACP, 0, (LPCSTR)source_string, source_length, NULL, 0) + 1;
+					char_count = FastMultiByteToWideChar(CP_ACP, 0, (LPCSTR)source_string, source_length, NULL, 0) + 1;
 					if (length == 0)
 					{
 						aResultToken.value_int64 = char_count;
@@ -17488,7 +18206,7 @@ BIF_DECL(BIF_StrGetPut)
 					}
 					length = char_count;
 				}
-				char_count = MultiByteToWideChar(CP_ACP, 0, (LPCSTR)source_string, source_length, (LPWSTR)address, length);
+				char_count = FastMultiByteToWideChar(CP_ACP, 0, (LPCSTR)source_string, source_length, (LPWSTR)address, length);
 				if (char_count && char_count < length)
 					((LPWSTR)address)[char_count++] = '\0';
 			}
@@ -17505,14 +18223,14 @@ BIF_DECL(BIF_StrGetPut)
 				if (length <= 0) // -1 or 0
 				{
 					// Determine required buffer size.
-					char_count = WideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, NULL, 0, NULL, NULL);
+					char_count = FastWideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, NULL, 0, NULL, NULL);
 					if (!char_count) // Above has ensured source is not empty, so this must be an error.
 					{
 						if (GetLastError() == ERROR_INVALID_FLAGS)
 						{
 							// Try again without flags.  MSDN lists a number of code pages for which flags must be 0, including UTF-7 and UTF-8 (but UTF-8 is handled above).
 							flags = 0; // Must be set for this call and the call further below.
-							char_count = WideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, NULL, 0, NULL, NULL);
+							char_count = FastWideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, NULL, 0, NULL, NULL);
 						}
 						if (!char_count)
 						{
@@ -17531,7 +18249,7 @@ BIF_DECL(BIF_StrGetPut)
 					length = char_count;
 				}
 				// Convert to target encoding.
-				char_count = WideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, (LPSTR)address, length, NULL, NULL);
+				char_count = FastWideCharToMultiByte(encoding, flags, (LPCWSTR)source_string, source_length, (LPSTR)address, length, NULL, NULL);
 				// Since above did not null-terminate, check for buffer space and null-terminate if there's room.
 				// It is tempting to always null-terminate (potentially replacing the last byte of data),
 				// but that would exclude this function as a means to copy a string into a fixed-length array.
@@ -17553,10 +18271,10 @@ BIF_DECL(BIF_StrGetPut)
 			int conv_length;
 #ifdef UNICODE
 			// Convert multi-byte encoded string to UTF-16.
-			conv_length = MultiByteToWideChar(encoding, 0, (LPCSTR)address, length, NULL, 0);
+			conv_length = FastMultiByteToWideChar(encoding, 0, (LPCSTR)address, length, NULL, 0);
 			if (!TokenSetResult(aResultToken, NULL, conv_length)) // DO NOT SUBTRACT 1, conv_length might not include a null-terminator.
 				return; // Out of memory.
-			conv_length = MultiByteToWideChar(encoding, 0, (LPCSTR)address, length, aResultToken.marker, conv_length);
+			conv_length = FastMultiByteToWideChar(encoding, 0, (LPCSTR)address, length, aResultToken.marker, conv_length);
 #else
 			CStringW wide_buf;
 			// If the target string is not UTF-16, convert it to that first.
@@ -17568,10 +18286,10 @@ BIF_DECL(BIF_StrGetPut)
 			}
 
 			// Now convert UTF-16 to ACP.
-			conv_length = WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, (LPCWSTR)address, length, NULL, 0, NULL, NULL);
+			conv_length = FastWideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, (LPCWSTR)address, length, NULL, 0, NULL, NULL);
 			if (!TokenSetResult(aResultToken, NULL, conv_length)) // DO NOT SUBTRACT 1, conv_length might not include a null-terminator.
 				return; // Out of memory.
-			conv_length = WideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, (LPCWSTR)address, length, aResultToken.marker, conv_length, NULL, NULL);
+			conv_length = FastWideCharToMultiByte(CP_ACP, WC_NO_BEST_FIT_CHARS, (LPCWSTR)address, length, aResultToken.marker, conv_length, NULL, NULL);
 #endif
 			if (conv_length && !aResultToken.marker[conv_length - 1])
 				--conv_length; // Exclude null-terminator.
@@ -18120,7 +18838,14 @@ BIF_DECL(BIF_ZipAddFolder)
 		g_script.ThrowRuntimeException(ERR_PARAM1_INVALID);
 		return;
 	}
-	if (aErrCode = ZipAddFolder((HZIP)TokenToInt64(*aParam[0]), TokenToString(*aParam[1])))
+	// With a source directory, its files are added beneath the folder (compressed by all processors).
+	// An empty SourceDir is an error rather than meaning the current directory.
+	if (aParamCount > 2)
+		aErrCode = ParamIndexIsOmittedOrEmpty(2) ? ZR_ARGS
+			: ZipAddTree((HZIP)TokenToInt64(*aParam[0]), TokenToString(*aParam[1]), TokenToString(*aParam[2]));
+	else
+		aErrCode = ZipAddFolder((HZIP)TokenToInt64(*aParam[0]), TokenToString(*aParam[1]));
+	if (aErrCode)
 	{
 		TCHAR	aMsg[100];
 		ZipFormatMessage(aErrCode, aMsg, _countof(aMsg));
@@ -18364,6 +19089,54 @@ BIF_DECL(BIF_UnZip)
 		if (aErrCode = UnzipItemToFile(huz, aTargetDir, &ze))
 			goto errorclose;
 	}
+	else if (aParamCount > 2 && (TokenToObject(*aParam[2]) || *TokenToString(*aParam[2])))
+	{
+		// Unzip the named item, or each item named in an array, skipping any not in the archive.
+		// UnzipFindItem() looks names up in an index of the archive, so this is one pass over
+		// the archive however many items are named, rather than one pass per item.
+		Object *obj = dynamic_cast<Object *>(TokenToObject(*aParam[2]));
+		int aItemCount = obj ? obj->GetNumericItemCount() : 1;
+		LPTSTR *aItemList = (LPTSTR *)malloc((aItemCount + 1) * sizeof(LPTSTR));
+		if (!aItemList)
+		{
+			aErrCode = ZR_NOALLOC;
+			goto errorclose;
+		}
+		if (obj)
+		{
+			if (!obj->ArrayToStrings(aItemList, aItemCount, aItemCount))
+			{
+				// Array contains something other than a string.
+				free(aItemList);
+				UnzipClose(huz);
+				g_script.ThrowRuntimeException(ERR_PARAM3_INVALID);
+				return;
+			}
+			aTargetName = NULL; // A TargetName can't apply to more than one item.
+		}
+		else
+		{
+			aItemList[0] = TokenToString(*aParam[2]);
+			aTargetName = aParamCount > 3 ? TokenToString(*aParam[3]) : NULL;
+		}
+		for (int i = 0; i < aItemCount; ++i)
+		{
+			tcslcpy(ze.Name, aItemList[i], _countof(ze.Name));
+			if ((aErrCode = UnzipFindItem(huz, &ze, FALSE)) == ZR_NOTFOUND)
+				continue;
+			if (!aErrCode)
+			{
+				_tcscpy(aTargetDir + aDirLen, aTargetName ? aTargetName : ze.Name + 1);
+				aErrCode = UnzipItemToFile(huz, aTargetDir, &ze);
+			}
+			if (aErrCode)
+			{
+				free(aItemList);
+				goto errorclose;
+			}
+		}
+		free(aItemList);
+	}
 	else
 	{
 		ULONGLONG	numitems;
@@ -18374,20 +19147,14 @@ BIF_DECL(BIF_UnZip)
 			goto errorclose;
 		numitems = ze.Index;
 
-		LPTSTR aOnlyOneItem = aParamCount > 2 ? TokenToString(*aParam[2]) : NULL;
-		aTargetName = aParamCount > 3 && *aOnlyOneItem ? TokenToString(*aParam[3]) : NULL;
-		// Unzip item(s), using the name stored (in the zip) for that item.
+		// Unzip all items, using the name stored (in the zip) for that item.
 		for (ze.Index = 0; ze.Index < numitems; ze.Index++)
 		{
 			if ((aErrCode = UnzipGetItem(huz, &ze)))
 				goto errorclose;
-			if (aOnlyOneItem && _tcscmp(aOnlyOneItem, ze.Name + 1))
-				continue;
-			_tcscpy(aTargetDir + aDirLen, aTargetName ? aTargetName : ze.Name + 1);
+			_tcscpy(aTargetDir + aDirLen, ze.Name + 1);
 			if (aErrCode = UnzipItemToFile(huz, aTargetDir, &ze))
 				goto errorclose;
-			if (aOnlyOneItem)
-				break;
 		}
 	}
 
@@ -18409,13 +19176,25 @@ BIF_DECL(BIF_UnZipBuffer)
 	HZIP huz;
 	TCHAR	aMsg[100];
 	char aPassword[1024] = { 0 };
+	BufferObject *source_buf, *out_buf;
 	if (aParamCount > 4)
 #ifndef _UNICODE
 		_tcscpy(aPassword, TokenToString(*aParam[4]));
 #else
 		WideCharToMultiByte(CP_ACP, 0, TokenToString(*aParam[4]), -1, aPassword, 1024, 0, 0);
 #endif
-	if (TokenIsPureNumeric(*aParam[0]))
+	if (source_buf = TokenToBuffer(*aParam[0]))
+	{
+		// Unlike an address, a Buffer is not followed by a Size parameter.
+		if (source_buf->Size() > MAXDWORD) // LiteZip's archive size is a DWORD.
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM1_INVALID);
+			return;
+		}
+		if (aErrCode = UnzipOpenBuffer(&huz, source_buf->Data(), (DWORD)source_buf->Size(), aPassword))
+			goto error;
+	}
+	else if (TokenIsPureNumeric(*aParam[0]))
 	{
 		if (!TokenIsPureNumeric(*aParam[1]))
 		{
@@ -18440,6 +19219,7 @@ BIF_DECL(BIF_UnZipBuffer)
 
 	ZIPENTRY	ze;
 	unsigned char *aBuffer;
+	out_buf = ParamIndexIsOmitted(2) ? NULL : TokenToBuffer(*aParam[2]);
 
 	if (ParamIndexIsOmitted(1) || TokenIsPureNumeric(*aParam[1]))
 	{
@@ -18447,22 +19227,13 @@ BIF_DECL(BIF_UnZipBuffer)
 		if ((aErrCode = UnzipGetItem(huz, &ze)))
 			goto errorclose;
 		aResultToken.value_int64 = ze.UncompressedSize;
-		if (aParamCount < 3 || aParam[2]->symbol != SYM_VAR)
+		if (!out_buf && (aParamCount < 3 || aParam[2]->symbol != SYM_VAR))
 		{
 			UnzipClose(huz);
 			aResultToken.symbol = SYM_INTEGER;
 			return;
 		}
-		aBuffer = (unsigned char *)malloc((DWORD)ze.UncompressedSize);
-		if (aErrCode = UnzipItemToBuffer(huz, aBuffer, (DWORD)ze.UncompressedSize, &ze))
-			goto errorclose;
-		aParam[2]->var->SetCapacity((VarSizeType)aResultToken.value_int64, true);
-		memcpy(aParam[2]->var->mCharContents, aBuffer, (SIZE_T)aResultToken.value_int64);
-		g_memset((char*)aParam[2]->var->mCharContents + aResultToken.value_int64, 0, 2);
-		free(aBuffer);
-		UnzipClose(huz);
-		aResultToken.symbol = SYM_INTEGER;
-		return;
+		goto unzipitem;
 	}
 	else
 	{
@@ -18481,22 +19252,13 @@ BIF_DECL(BIF_UnZipBuffer)
 			if (_tcscmp(aSource, ze.Name + 1))
 				continue;
 			aResultToken.value_int64 = ze.UncompressedSize;
-			if (aParam[2]->symbol != SYM_VAR)
+			if (!out_buf && aParam[2]->symbol != SYM_VAR)
 			{
 				UnzipClose(huz);
 				aResultToken.symbol = SYM_INTEGER;
 				return;
 			}
-			aBuffer = (unsigned char *)GlobalAlloc(GMEM_FIXED, (DWORD)ze.UncompressedSize);
-			if (aErrCode = UnzipItemToBuffer(huz, aBuffer, (DWORD)ze.UncompressedSize, &ze))
-				goto errorclose;
-			aParam[2]->var->SetCapacity((VarSizeType)aResultToken.value_int64, true);
-			memcpy(aParam[2]->var->mCharContents, aBuffer, (SIZE_T)aResultToken.value_int64);
-			g_memset((char*)aParam[2]->var->mCharContents + aResultToken.value_int64, 0, 2);
-			GlobalFree(aBuffer);
-			UnzipClose(huz);
-			aResultToken.symbol = SYM_INTEGER;
-			return;
+			goto unzipitem;
 		}
 	}
 
@@ -18505,6 +19267,33 @@ BIF_DECL(BIF_UnZipBuffer)
 	aResultToken.symbol = SYM_STRING;
 	aResultToken.marker = _T("");
 	return;
+unzipitem:
+	if (  ze.UncompressedSize > MAXDWORD // UnzipItemToBuffer's size is a DWORD.
+		|| !(aBuffer = (unsigned char *)malloc(ze.UncompressedSize ? (size_t)ze.UncompressedSize : 1))  )
+	{
+		UnzipClose(huz);
+		g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+		return;
+	}
+	if (aErrCode = UnzipItemToBuffer(huz, aBuffer, (DWORD)ze.UncompressedSize, &ze))
+	{
+		free(aBuffer);
+		goto errorclose;
+	}
+	UnzipClose(huz);
+	aResultToken.symbol = SYM_INTEGER;
+	if (out_buf)
+	{
+		// The Buffer takes ownership of the data, so it isn't copied.
+		if (!out_buf->SetData(aBuffer, (size_t)ze.UncompressedSize))
+			g_script.ThrowRuntimeException(ERR_BUFFER_NOT_RESIZABLE);
+		return;
+	}
+	aParam[2]->var->SetCapacity((VarSizeType)aResultToken.value_int64, true);
+	memcpy(aParam[2]->var->mCharContents, aBuffer, (SIZE_T)aResultToken.value_int64);
+	g_memset((char*)aParam[2]->var->mCharContents + aResultToken.value_int64, 0, 2);
+	free(aBuffer);
+	return;
 errorclose:
 	UnzipClose(huz);
 error:
@@ -18512,6 +19301,239 @@ error:
 	g_script.ThrowRuntimeException(aMsg);
 }
 
+#define UNZIP_STREAM_CHUNK (64 * 1024) // Bytes passed to the UnZipStream callback at a time.
+
+BIF_DECL(BIF_UnZipStream)
+// UnZipStream(ZipFile|Buffer|Address [, Size], Item [, Callback, Password, Encoding])
+// Decompresses a single item without allocating memory for all of it.  If Callback is omitted,
+// returns a read-only File object which decompresses the item as it is read.  Otherwise, calls
+// Callback(Address, Bytes) for each chunk of the item and returns the total number of bytes passed
+// to it; Callback can return true to stop early.
+{
+	DWORD aErrCode;
+	HZIP huz;
+	TCHAR	aMsg[100];
+	BufferObject *source_buf = TokenToBuffer(*aParam[0]);
+	LPVOID aArchive = NULL;
+	DWORD aArchiveSize = 0;
+	if (source_buf)
+	{
+		// Unlike an address, a Buffer is not followed by a Size parameter.
+		if (source_buf->Size() > MAXDWORD) // LiteZip's archive size is a DWORD.
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM1_INVALID);
+			return;
+		}
+		aArchive = source_buf->Data();
+		aArchiveSize = (DWORD)source_buf->Size();
+	}
+	else if (TokenIsPureNumeric(*aParam[0]))
+	{
+		if (!TokenIsPureNumeric(*aParam[1]))
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM2_INVALID);
+			return;
+		}
+		else if (aParamCount < 3)
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM3_REQUIRED);
+			return;
+		}
+		aArchive = (LPVOID)TokenToInt64(*aParam[0]);
+		aArchiveSize = (DWORD)TokenToInt64(*aParam[1]);
+		aParam++;
+		aParamCount--;
+	}
+
+	IObject *callback = NULL;
+	LPBYTE aChunk;
+	__int64 aTotal = 0;
+	if (!ParamIndexIsOmittedOrEmpty(2))
+	{
+		if (  !(callback = TokenToFunc(*aParam[2])) && !(callback = TokenToObject(*aParam[2]))  )
+		{
+			g_script.ThrowRuntimeException(ERR_INVALID_VALUE, TokenToString(*aParam[2], aResultToken.buf));
+			return;
+		}
+	}
+	UINT aEncoding = g->Encoding;
+	if (!ParamIndexIsOmittedOrEmpty(4))
+	{
+		if (TokenIsPureNumeric(*aParam[4]))
+			aEncoding = (UINT)TokenToInt64(*aParam[4]);
+		else if ((aEncoding = Line::ConvertFileEncoding(TokenToString(*aParam[4]))) == -1)
+		{
+			g_script.ThrowRuntimeException(ERR_INVALID_VALUE, TokenToString(*aParam[4]));
+			return;
+		}
+	}
+
+	CStringA aPassword = !ParamIndexIsOmittedOrEmpty(3) ? CStringCharFromTChar(TokenToString(*aParam[3])) : NULL;
+	if (aArchive)
+	{
+		if (aErrCode = UnzipOpenBuffer(&huz, aArchive, aArchiveSize, aPassword.IsEmpty() ? NULL : aPassword.GetString()))
+			goto error;
+	}
+	else if (aErrCode = UnzipOpenFile(&huz, TokenToString(*aParam[0]), aPassword.IsEmpty() ? NULL : aPassword.GetString()))
+	{
+		goto error;
+	}
+	UnzipSetBaseDir(huz, _T(""));
+
+	ZIPENTRY	ze;
+	if (TokenIsPureNumeric(*aParam[1]))
+	{
+		ze.Index = (ULONGLONG)TokenToInt64(*aParam[1]);
+		if ((aErrCode = UnzipGetItem(huz, &ze)))
+			goto errorclose;
+	}
+	else
+	{
+		ULONGLONG	numitems;
+		// Find out how many items are in the archive.
+		ze.Index = (ULONGLONG)-1;
+		if ((aErrCode = UnzipGetItem(huz, &ze)))
+			goto errorclose;
+		numitems = ze.Index;
+		LPTSTR aSource = TokenToString(*aParam[1]);
+		for (ze.Index = 0; ze.Index < numitems; ze.Index++)
+		{
+			if ((aErrCode = UnzipGetItem(huz, &ze)))
+				goto errorclose;
+			if (!_tcscmp(aSource, ze.Name + 1))
+				break;
+		}
+		if (ze.Index == numitems)
+		{
+			// Item not found, so close the ZIP archive.
+			UnzipClose(huz);
+			aResultToken.symbol = SYM_STRING;
+			aResultToken.marker = _T("");
+			return;
+		}
+	}
+
+	if (!callback)
+	{
+		// The File object takes ownership of huz.  A Buffer containing the archive is kept alive
+		// until the object is closed, whereas memory at an address must remain valid that long.
+		if (  !(aResultToken.object = UnzipFileObject(huz, ze.Index, source_buf, aEncoding & CP_AHKCP, aErrCode))  )
+			goto error; // huz was closed by UnzipFileObject.
+		aResultToken.symbol = SYM_OBJECT;
+		return;
+	}
+
+	// UnzipItemToBuffer returns ZR_MORE each time the chunk is filled, leaving the item selected so
+	// that the next call continues where it left off, so only one chunk is held in memory at a time.
+	if (  !(aChunk = (LPBYTE)malloc(UNZIP_STREAM_CHUNK))  )
+	{
+		UnzipClose(huz);
+		g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+		return;
+	}
+	if (source_buf)
+		source_buf->Pin(); // Prevent Callback from resizing the archive data while it is being decompressed.
+	do
+	{
+		aErrCode = UnzipItemToBuffer(huz, aChunk, UNZIP_STREAM_CHUNK, &ze);
+		if (aErrCode != ZR_OK && aErrCode != ZR_MORE)
+		{
+			free(aChunk);
+			if (source_buf)
+				source_buf->Unpin();
+			goto errorclose;
+		}
+		DWORD aChunkSize = (DWORD)ze.CompressedSize; // Set to the number of bytes decompressed.
+		if (!aChunkSize)
+			continue;
+		ExprTokenType args[2];
+		args[0].symbol = SYM_INTEGER;
+		args[0].value_int64 = (__int64)(size_t)aChunk;
+		args[1].symbol = SYM_INTEGER;
+		args[1].value_int64 = aChunkSize;
+		INT_PTR retval;
+		ResultType result = CallMethod(callback, callback, _T("call"), args, 2, &retval);
+		if (result == FAIL || result == EARLY_EXIT)
+		{
+			free(aChunk);
+			if (source_buf)
+				source_buf->Unpin();
+			UnzipClose(huz);
+			aResult = result;
+			return;
+		}
+		aTotal += aChunkSize;
+		if (retval) // Callback asked to stop.
+			break;
+	} while (aErrCode == ZR_MORE);
+	free(aChunk);
+	if (source_buf)
+		source_buf->Unpin();
+	UnzipClose(huz);
+	aResultToken.symbol = SYM_INTEGER;
+	aResultToken.value_int64 = aTotal;
+	return;
+errorclose:
+	UnzipClose(huz);
+error:
+	UnzipFormatMessage(aErrCode, aMsg, _countof(aMsg));
+	g_script.ThrowRuntimeException(aMsg);
+}
+
+BIF_DECL(BIF_CRC32)
+// CRC32(Buffer|VarOrAddress [, Bytes, PreviousCRC])
+// Returns the CRC-32 of the data, as stored in ZIP archives.  Bytes defaults to the size of the Buffer or
+// the length of the variable's contents.  Passing the result of a previous call as PreviousCRC continues
+// the checksum, so data can be checksummed in pieces.
+{
+	LPBYTE data;
+	size_t size, max_size; // max_size is the number of bytes which may be read, if known.
+	BufferObject *source_buf = TokenToBuffer(*aParam[0]);
+	if (source_buf)
+	{
+		data = (LPBYTE)source_buf->Data();
+		size = max_size = source_buf->Size();
+	}
+	else if (aParam[0]->symbol == SYM_VAR) // See BIF_NumGet for comments.
+	{
+		data = (LPBYTE)aParam[0]->var->Contents();
+		size = aParam[0]->var->ByteLength();
+		max_size = aParam[0]->var->ByteCapacity();
+	}
+	else
+	{
+		if (ParamIndexIsOmittedOrEmpty(1))
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM2_REQUIRED);
+			return;
+		}
+		data = (LPBYTE)TokenToInt64(*aParam[0]);
+		size = 0;
+		max_size = ~(size_t)0; // The caller is trusted to pass a valid size for a raw address.
+	}
+	if (!ParamIndexIsOmittedOrEmpty(1))
+	{
+		__int64 bytes = TokenToInt64(*aParam[1]);
+		if (bytes < 0 || (unsigned __int64)bytes > max_size)
+		{
+			g_script.ThrowRuntimeException(ERR_PARAM2_INVALID);
+			return;
+		}
+		size = (size_t)bytes;
+	}
+	if (size && data < (LPBYTE)65536) // Basic sanity check to catch incoming raw addresses that are zero or blank.
+	{
+		g_script.ThrowRuntimeException(ERR_PARAM1_INVALID);
+		return;
+	}
+	DWORD crc = ParamIndexIsOmittedOrEmpty(2) ? 0 : (DWORD)TokenToInt64(*aParam[2]);
+	// ZipCrc32 takes a DWORD length, so process very large blocks in pieces.
+	for (; size > 0x40000000; data += 0x40000000, size -= 0x40000000)
+		crc = ZipCrc32(crc, data, 0x40000000);
+	aResultToken.symbol = SYM_INTEGER;
+	aResultToken.value_int64 = ZipCrc32(crc, data, (DWORD)size);
+}
+
 BIF_DECL(BIF_CryptAES)
 {
 	TCHAR *pw[1024] = {};
@@ -18546,11 +19568,26 @@ BIF_DECL(BIF_ZipRawMemory)
 		for (size_t i = 0; i <= pwlen; i++)
 			pw[i] = &pwd[i];
 	}
-	aResultToken.value_int64 = CompressBuffer(aParam[0]->symbol == SYM_VAR ? (BYTE*)aParam[0]->var->mByteContents : (BYTE*)TokenToInt64(*aParam[0]), aDataBuf,
-											  (DWORD)TokenToInt64(*aParam[1]), pw);
+	BufferObject *source_buf = TokenToBuffer(*aParam[0]);
+	BufferObject *out_buf = ParamIndexIsOmitted(2) ? NULL : TokenToBuffer(*aParam[2]);
+	if (source_buf && ParamIndexIsOmittedOrEmpty(1) && source_buf->Size() > MAXDWORD) // Too large for CompressBuffer.
+	{
+		aResultToken.symbol = SYM_STRING;
+		aResultToken.marker = _T("");
+		return;
+	}
+	aResultToken.value_int64 = CompressBuffer(source_buf ? source_buf->Data() : aParam[0]->symbol == SYM_VAR ? (BYTE*)aParam[0]->var->mByteContents : (BYTE*)TokenToInt64(*aParam[0]), aDataBuf,
+											  (source_buf && ParamIndexIsOmittedOrEmpty(1)) ? (DWORD)source_buf->Size() : (DWORD)TokenToInt64(*aParam[1]), pw);
 	if (aResultToken.value_int64)
 	{
 		aResultToken.symbol = SYM_INTEGER;
+		if (out_buf)
+		{
+			// The Buffer takes ownership of the data, so it isn't copied.
+			if (!out_buf->SetData(aDataBuf, (size_t)aResultToken.value_int64))
+				g_script.ThrowRuntimeException(ERR_BUFFER_NOT_RESIZABLE);
+			return;
+		}
 		if (!ParamIndexIsOmitted(2))
 		{
 			if (aParam[2]->symbol == SYM_VAR)
@@ -18573,7 +19610,7 @@ BIF_DECL(BIF_ZipRawMemory)
 
 BIF_DECL(BIF_UnZipRawMemory)
 {
-	if (TokenToInt64(*aParam[0]))
+	if (TokenToBuffer(*aParam[0]) || TokenToInt64(*aParam[0]))
 	{
 		LPVOID aDataBuf = NULL;
 		TCHAR *pw[1024] = {};
@@ -18584,10 +19621,26 @@ BIF_DECL(BIF_UnZipRawMemory)
 			for(size_t i = 0;i <= pwlen;i++)
 				pw[i] = &pwd[i];
 		}
-		aResultToken.value_int64 = DecompressBuffer((void *)TokenToInt64(*aParam[0]), aDataBuf, (DWORD)TokenToInt64(*aParam[1]), pw);
+		BufferObject *source_buf = TokenToBuffer(*aParam[0]);
+		BufferObject *out_buf = ParamIndexIsOmitted(2) ? NULL : TokenToBuffer(*aParam[2]);
+		if (source_buf && ParamIndexIsOmittedOrEmpty(1) && source_buf->Size() > MAXDWORD) // Too large for DecompressBuffer.
+		{
+			aResultToken.symbol = SYM_STRING;
+			aResultToken.marker = _T("");
+			return;
+		}
+		aResultToken.value_int64 = DecompressBuffer(source_buf ? source_buf->Data() : (void *)TokenToInt64(*aParam[0]), aDataBuf,
+													(source_buf && ParamIndexIsOmittedOrEmpty(1)) ? (DWORD)source_buf->Size() : (DWORD)TokenToInt64(*aParam[1]), pw);
 		if (aResultToken.value_int64)
 		{
 			aResultToken.symbol = SYM_INTEGER;
+			if (out_buf)
+			{
+				// The Buffer takes ownership of the data, so it isn't copied.
+				if (!out_buf->SetData(aDataBuf, (size_t)aResultToken.value_int64))
+					g_script.ThrowRuntimeException(ERR_BUFFER_NOT_RESIZABLE);
+				return;
+			}
 			if (!ParamIndexIsOmitted(2))
 			{
 				if (aParam[2]->symbol == SYM_VAR)
@@ -19496,6 +20549,273 @@ BIF_DECL(BIF_MenuGet)
 
 
 
+BIF_DECL(BIF_HookStats)
+// HookStats([Command])
+// Returns an object containing the number of times the keyboard and mouse hooks were called and the time they
+// took, and the number of hotkey and hotstring events they posted and how long each waited before the script
+// received it.  Times are in microseconds.  Command "Reset" resets the counters.  Command "History" returns the
+// timing of the most recently received events as CSV text, with one line per event, for analysis elsewhere.
+{
+	LPTSTR command = ParamIndexToOptionalString(0, aResultToken.buf);
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+	if (!_tcsicmp(command, _T("Reset")))
+	{
+		ResetHookEventStats();
+		return;
+	}
+	HookEventStats stats;
+	GetHookEventStats(stats);
+	__int64 freq = stats.Frequency ? stats.Frequency : 1;
+	// Split into whole seconds and the remainder so that a large count (e.g. the uptime-based hook_time)
+	// can't overflow when multiplied.
+	#define QPC_TO_MICROSECONDS(t) ((t) / freq * 1000000 + (t) % freq * 1000000 / freq)
+	if (!_tcsicmp(command, _T("History")))
+	{
+		HookEventTiming *history = (HookEventTiming *)malloc(HOOK_EVENT_RING_SIZE * sizeof(HookEventTiming));
+		int count;
+		LPTSTR buf;
+		const size_t line_size = 128; // Enough for the longest line (five 64-bit integers and a word).
+		if (  !history || !(buf = tmalloc((count = GetHookEventHistory(history)) * line_size + line_size))  )
+		{
+			free(history);
+			g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+			return;
+		}
+		LPTSTR cp = buf + _stprintf(buf, _T("Type,ID,Time,HookToPost,PostToReceive\r\n"));
+		for (int i = 0; i < count; ++i)
+			cp += _stprintf(cp, _T("%s,%Iu,%I64d,%I64d,%I64d\r\n")
+				, history[i].message == AHK_HOTSTRING ? _T("Hotstring") : _T("Hotkey")
+				, history[i].wParam & HOTKEY_ID_MASK
+				, QPC_TO_MICROSECONDS(history[i].hook_time) // Allows events to be correlated with other QPC-based logs.
+				, QPC_TO_MICROSECONDS(history[i].post_time - history[i].hook_time)
+				, QPC_TO_MICROSECONDS(history[i].receive_time - history[i].post_time));
+		free(history);
+		aResultToken.marker = aResultToken.mem_to_free = buf;
+		aResultToken.marker_length = cp - buf;
+		return;
+	}
+	if (*command)
+	{
+		g_script.ThrowRuntimeException(ERR_PARAM1_INVALID, NULL, command);
+		return;
+	}
+	Object *obj = Object::Create();
+	if (!obj)
+	{
+		g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+		return;
+	}
+	obj->SetItem(_T("HookCalls"), stats.HookCalls);
+	obj->SetItem(_T("HookTime"), QPC_TO_MICROSECONDS(stats.HookTime));
+	obj->SetItem(_T("HookTimeMax"), QPC_TO_MICROSECONDS(stats.HookTimeMax));
+	obj->SetItem(_T("Posted"), stats.Posted);
+	obj->SetItem(_T("Dropped"), stats.Dropped);
+	obj->SetItem(_T("Received"), stats.Received);
+	obj->SetItem(_T("Unmatched"), stats.Unmatched);
+	obj->SetItem(_T("QueueTime"), QPC_TO_MICROSECONDS(stats.QueueTime));
+	obj->SetItem(_T("QueueTimeMax"), QPC_TO_MICROSECONDS(stats.QueueTimeMax));
+	#undef QPC_TO_MICROSECONDS
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = obj;
+}
+
+
+
+static int Int64Compare(const void *a, const void *b)
+{
+	__int64 x = *(__int64 *)a, y = *(__int64 *)b;
+	return x < y ? -1 : x > y;
+}
+
+BIF_DECL(BIF_HookReplay)
+// HookReplay(Events [, Repeat])
+// Passes a sequence of keyboard and mouse events through the hook as though they came from the OS, and returns
+// an object describing how long the hook took for each event, in nanoseconds.  Each line of Events is a key name
+// optionally followed by "Down" or "Up"; a key name alone means a press and release.  Hotkeys and hotstrings are
+// counted rather than fired, and the hook doesn't send any keys in response to the events.  The hook is reset
+// before and after the replay, and real input bypasses the hook until the replay is complete.
+{
+	LPTSTR events_text = ParamIndexToString(0, aResultToken.buf);
+	int repeat = ParamIndexIsOmittedOrEmpty(1) ? 1 : (int)ParamIndexToInt64(1);
+	if (repeat < 1)
+	{
+		g_script.ThrowRuntimeException(ERR_PARAM2_INVALID);
+		return;
+	}
+	HookReplayEvent *events = NULL, *new_events;
+	int event_count = 0, events_size = 0;
+	bool needs_keybd_hook = false, needs_mouse_hook = false;
+	TCHAR key_name[64];
+	for (LPTSTR line = events_text, line_end; *line; line = line_end)
+	{
+		line_end = line + _tcscspn(line, _T("\r\n"));
+		LPTSTR cp = omit_leading_whitespace(line);
+		size_t length = _tcscspn(cp, _T(" \t\r\n"));
+		for (; *line_end == '\r' || *line_end == '\n'; ++line_end);
+		if (!length) // Blank line.
+			continue;
+		tcslcpy(key_name, cp, min(length + 1, _countof(key_name)));
+		cp = omit_leading_whitespace(cp + length);
+		length = _tcscspn(cp, _T(" \t\r\n"));
+		bool down = true, up = true, valid = true;
+		if (length == 4 && !_tcsnicmp(cp, _T("Down"), 4))
+			up = false;
+		else if (length == 2 && !_tcsnicmp(cp, _T("Up"), 2))
+			down = false;
+		else if (length)
+			valid = false;
+		sc_type sc = TextToSC(key_name);
+		vk_type vk = sc ? sc_to_vk(sc) : TextToVK(key_name);
+		if (!valid || !vk && !sc)
+		{
+			free(events);
+			g_script.ThrowRuntimeException(ERR_PARAM1_INVALID, NULL, key_name);
+			return;
+		}
+		if (event_count + 2 > events_size)
+		{
+			events_size = events_size ? events_size * 2 : 64;
+			if (  !(new_events = (HookReplayEvent *)realloc(events, events_size * sizeof(HookReplayEvent)))  )
+			{
+				free(events);
+				g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+				return;
+			}
+			events = new_events;
+		}
+		for (int i = 0; i < 2; ++i)
+		{
+			bool key_up = i > 0;
+			if (key_up ? !up : !down)
+				continue;
+			HookReplayEvent &event = events[event_count++];
+			ZeroMemory(&event, sizeof(event));
+			event.is_mouse = IsMouseVK(vk);
+			if (event.is_mouse)
+			{
+				needs_mouse_hook = true;
+				GetCursorPos(&event.mouse.pt);
+				switch (vk)
+				{
+				case VK_LBUTTON: event.message = key_up ? WM_LBUTTONUP : WM_LBUTTONDOWN; break;
+				case VK_RBUTTON: event.message = key_up ? WM_RBUTTONUP : WM_RBUTTONDOWN; break;
+				case VK_MBUTTON: event.message = key_up ? WM_MBUTTONUP : WM_MBUTTONDOWN; break;
+				case VK_XBUTTON1:
+				case VK_XBUTTON2:
+					event.message = key_up ? WM_XBUTTONUP : WM_XBUTTONDOWN;
+					event.mouse.mouseData = MAKELONG(0, vk == VK_XBUTTON1 ? XBUTTON1 : XBUTTON2);
+					break;
+				default: // Wheel.  There's no up-event, so "Up" is treated the same as "Down".
+					if (key_up && down)
+					{
+						--event_count;
+						continue;
+					}
+					event.message = (vk == VK_WHEEL_UP || vk == VK_WHEEL_DOWN) ? WM_MOUSEWHEEL : WM_MOUSEHWHEEL;
+					event.mouse.mouseData = MAKELONG(0, (vk == VK_WHEEL_UP || vk == VK_WHEEL_RIGHT) ? WHEEL_DELTA : -WHEEL_DELTA);
+				}
+			}
+			else
+			{
+				needs_keybd_hook = true;
+				if (!sc)
+					sc = vk_to_sc(vk);
+				event.message = key_up ? WM_KEYUP : WM_KEYDOWN;
+				event.keybd.vkCode = vk;
+				event.keybd.scanCode = sc & 0xFF;
+				event.keybd.flags = (sc & 0x100 ? LLKHF_EXTENDED : 0) | (key_up ? LLKHF_UP : 0);
+			}
+		}
+	}
+	if (!event_count)
+	{
+		free(events);
+		g_script.ThrowRuntimeException(ERR_PARAM1_INVALID);
+		return;
+	}
+	if (needs_keybd_hook && !g_KeybdHook || needs_mouse_hook && !g_MouseHook)
+	{
+		free(events);
+		g_script.ThrowRuntimeException(needs_keybd_hook && !g_KeybdHook
+			? _T("The keyboard hook is not installed.") : _T("The mouse hook is not installed."));
+		return;
+	}
+
+	if (event_count > INT_MAX / repeat
+		|| (size_t)event_count * repeat > ~(size_t)0 / sizeof(HookReplayEvent)) // For 32-bit builds.
+	{
+		free(events);
+		g_script.ThrowRuntimeException(ERR_PARAM2_INVALID);
+		return;
+	}
+	HookReplayParams replay;
+	replay.event_count = event_count * repeat;
+	replay.next_event = 0;
+	replay.hotkeys = replay.hotstrings = 0;
+	replay.events = (HookReplayEvent *)malloc(replay.event_count * sizeof(HookReplayEvent));
+	replay.event_time = (__int64 *)malloc(replay.event_count * sizeof(__int64));
+	if (!replay.events || !replay.event_time)
+	{
+		free(events);
+		free(replay.events);
+		free(replay.event_time);
+		g_script.ThrowRuntimeException(ERR_OUTOFMEM);
+		return;
+	}
+	for (int i = 0; i < repeat; ++i)
+		memcpy(replay.events + i * event_count, events, event_count * sizeof(HookReplayEvent));
+	free(events);
+	bool replayed = false;
+	// Also wait on the hook thread, so that this doesn't hang if it exits before completing the replay.
+	HANDLE wait_for[2] = { CreateEvent(NULL, FALSE, FALSE, NULL), OpenThread(SYNCHRONIZE, FALSE, g_HookThreadID) };
+	replay.done = wait_for[0];
+	if (replay.done && wait_for[1] && PostThreadMessage(g_HookThreadID, AHK_HOOK_REPLAY, 0, (LPARAM)&replay))
+	{
+		// Process sent messages while waiting, since the hook might need the main thread to evaluate #If.
+		MSG msg;
+		DWORD wait_result;
+		while ((wait_result = MsgWaitForMultipleObjects(2, wait_for, FALSE, INFINITE, QS_SENDMESSAGE)) == WAIT_OBJECT_0 + 2)
+			PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+		replayed = (wait_result == WAIT_OBJECT_0);
+	}
+	for (int i = 0; i < 2; ++i)
+		if (wait_for[i])
+			CloseHandle(wait_for[i]);
+	free(replay.events);
+
+	Object *obj;
+	if (!replayed || !(obj = Object::Create()))
+	{
+		free(replay.event_time);
+		g_script.ThrowRuntimeException(replayed ? ERR_OUTOFMEM : _T("Replay failed."));
+		return;
+	}
+	__int64 freq, total = 0;
+	QueryPerformanceFrequency((LARGE_INTEGER *)&freq);
+	qsort(replay.event_time, replay.event_count, sizeof(__int64), Int64Compare);
+	for (int i = 0; i < replay.event_count; ++i)
+		total += replay.event_time[i];
+	#define QPC_TO_NANOSECONDS(t) (__int64)((double)(t) * 1e9 / freq)
+	#define PERCENTILE(p) QPC_TO_NANOSECONDS(replay.event_time[(replay.event_count - 1) * (p) / 100])
+	obj->SetItem(_T("Events"), (__int64)replay.event_count);
+	obj->SetItem(_T("Hotkeys"), (__int64)replay.hotkeys);
+	obj->SetItem(_T("Hotstrings"), (__int64)replay.hotstrings);
+	obj->SetItem(_T("Total"), QPC_TO_NANOSECONDS(total));
+	obj->SetItem(_T("Mean"), QPC_TO_NANOSECONDS(total) / replay.event_count);
+	obj->SetItem(_T("P50"), PERCENTILE(50));
+	obj->SetItem(_T("P90"), PERCENTILE(90));
+	obj->SetItem(_T("P99"), PERCENTILE(99));
+	obj->SetItem(_T("Max"), PERCENTILE(100));
+	#undef PERCENTILE
+	#undef QPC_TO_NANOSECONDS
+	free(replay.event_time);
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = obj;
+}
+
+
+
 BIF_DECL(BIF_StatusBar)
 {
 	TCHAR mode = ctoupper(aResultToken.marker[6]); // Union's marker initially contains the function name. SB_Set[T]ext.
@@ -1161,6 +1161,199 @@ HRESULT ComEvent::Connect(LPTSTR pfx, IObject *ahkObject)
 	return hr;
 }
 
+
+ComDispIdCache *ComDispIdCache::sShared = NULL;
+
+ComDispIdCache *ComDispIdCache::FindShared(IDispatch *aDispatch)
+// Returns the shared cache for the object's type, or NULL if it has no type info with a GUID or its
+// members may differ from those of other objects of the same type.
+{
+	// IDispatchEx objects may have members which other objects of the same type lack, or which have
+	// a different DISPID in each object.  This is checked for each object, since objects sharing an
+	// interface GUID don't necessarily all support IDispatchEx.
+	IDispatchEx *dispEx;
+	if (SUCCEEDED(aDispatch->QueryInterface<IDispatchEx>(&dispEx)))
+	{
+		dispEx->Release();
+		return NULL;
+	}
+	GUID type_guid = GUID_NULL;
+	ITypeInfo *ptinfo;
+	TYPEATTR *typeattr;
+	if (SUCCEEDED(aDispatch->GetTypeInfo(0, LOCALE_USER_DEFAULT, &ptinfo)))
+	{
+		if (SUCCEEDED(ptinfo->GetTypeAttr(&typeattr)))
+		{
+			type_guid = typeattr->guid;
+			ptinfo->ReleaseTypeAttr(typeattr);
+		}
+		ptinfo->Release();
+	}
+	if (IsEqualGUID(type_guid, GUID_NULL))
+		return NULL;
+	ComDispIdCache *cache;
+	for (cache = sShared; cache; cache = cache->mNextShared)
+		if (IsEqualGUID(cache->mTypeGuid, type_guid))
+			break;
+	if (!cache)
+	{
+		if (!(cache = new ComDispIdCache(type_guid)))
+			return NULL;
+		cache->mNextShared = sShared; // sShared holds the initial reference.
+		sShared = cache;
+	}
+	cache->AddRef();
+	return cache;
+}
+
+void ComDispIdCache::ReleaseShared()
+// Called when the script is destroyed.  Caches still used by a ComObject are deleted when it is.
+{
+	while (ComDispIdCache *cache = sShared)
+	{
+		sShared = cache->mNextShared;
+		cache->mNextShared = NULL;
+		cache->Release();
+	}
+}
+
+ComDispIdCache::~ComDispIdCache()
+{
+	for (int i = 0; i < mCount; ++i)
+		free(mEntry[i].name);
+	free(mEntry);
+}
+
+int ComDispIdCache::Find(LPCWSTR aName, bool &aFound)
+// Returns the index of aName, or where it should be inserted if !aFound.
+{
+	int left = 0, right = mCount - 1, mid, result;
+	while (left <= right)
+	{
+		mid = (left + right) / 2;
+		result = wcscmp(aName, mEntry[mid].name);
+		if (result > 0)
+			left = mid + 1;
+		else if (result < 0)
+			right = mid - 1;
+		else
+		{
+			aFound = true;
+			return mid;
+		}
+	}
+	aFound = false;
+	return left;
+}
+
+bool ComDispIdCache::Get(LPCWSTR aName, DISPID &aDispId)
+{
+	bool found;
+	int i = Find(aName, found);
+	if (found)
+		aDispId = mEntry[i].dispid;
+	return found;
+}
+
+void ComDispIdCache::Set(LPCWSTR aName, DISPID aDispId)
+{
+	bool found;
+	int i = Find(aName, found);
+	if (found)
+	{
+		mEntry[i].dispid = aDispId;
+		return;
+	}
+	if (mCount == mCapacity)
+	{
+		int new_capacity = mCapacity ? mCapacity * 2 : 8;
+		Entry *new_entry = (Entry *)realloc(mEntry, new_capacity * sizeof(Entry));
+		if (!new_entry)
+			return; // Caching is only an optimization.
+		mEntry = new_entry;
+		mCapacity = new_capacity;
+	}
+	LPWSTR name = _wcsdup(aName);
+	if (!name)
+		return;
+	memmove(mEntry + i + 1, mEntry + i, (mCount - i) * sizeof(Entry));
+	mEntry[i].name = name;
+	mEntry[i].dispid = aDispId;
+	++mCount;
+}
+
+void ComDispIdCache::CopyTo(ComDispIdCache *aOther)
+{
+	for (int i = 0; i < mCount; ++i)
+		aOther->Set(mEntry[i].name, mEntry[i].dispid);
+}
+
+void ComDispIdCache::Remove(LPCWSTR aName)
+{
+	bool found;
+	int i = Find(aName, found);
+	if (!found)
+		return;
+	free(mEntry[i].name);
+	memmove(mEntry + i, mEntry + i + 1, (mCount - i - 1) * sizeof(Entry));
+	--mCount;
+}
+
+
+HRESULT ComObject::GetDispId(LPOLESTR aName, DISPID &aDispId, bool &aCached)
+// Looks up aName in the cache first, then asks the object and caches the result.
+{
+	if (!mDispIds)
+		mDispIds = ComDispIdCache::CreatePrivate(); // If this fails, the name is just looked up each time.
+	if (aCached = mDispIds && mDispIds->Get(aName, aDispId))
+		return S_OK;
+	if (mDispIds && mDispIds->Count() && !(mFlags & F_TYPE_CHECKED))
+	{
+		// This is the second miss, so the object is likely to be used for more than one lookup.
+		// Only now is it worth the calls needed to find the type's shared cache.
+		mFlags |= F_TYPE_CHECKED;
+		if (ComDispIdCache *shared = ComDispIdCache::FindShared(mDispatch))
+		{
+			mDispIds->CopyTo(shared);
+			mDispIds->Release();
+			mDispIds = shared;
+			if (aCached = mDispIds->Get(aName, aDispId))
+				return S_OK;
+		}
+	}
+	HRESULT hr = mDispatch->GetIDsOfNames(IID_NULL, &aName, 1, LOCALE_USER_DEFAULT, &aDispId);
+	if (SUCCEEDED(hr) && mDispIds)
+		mDispIds->Set(aName, aDispId);
+	return hr;
+}
+
+HRESULT ComObject::RefreshDispId(LPOLESTR aName, DISPID &aDispId)
+// Called when Invoke failed with DISP_E_MEMBERNOTFOUND using a cached DISPID, which may be stale or
+// may belong to another object of the same type.  Returns S_OK if the object gave a different DISPID,
+// S_FALSE if it gave the same one, or the lookup's error (e.g. DISP_E_UNKNOWNNAME).
+{
+	DISPID dispid;
+	HRESULT hr = mDispatch->GetIDsOfNames(IID_NULL, &aName, 1, LOCALE_USER_DEFAULT, &dispid);
+	if (FAILED(hr))
+	{
+		mDispIds->Remove(aName);
+		return hr;
+	}
+	if (dispid == aDispId)
+		return S_FALSE; // The cached DISPID was correct, so the member really can't be invoked this way.
+	// Rather than changing a cache which may be shared with objects that have the other DISPID,
+	// give this object its own cache.
+	if (mDispIds->IsShared())
+	{
+		mDispIds->Release();
+		mDispIds = ComDispIdCache::CreatePrivate();
+	}
+	if (mDispIds)
+		mDispIds->Set(aName, dispid);
+	aDispId = dispid;
+	return S_OK;
+}
+
 ResultType STDMETHODCALLTYPE ComObject::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
 {
 	if (aParamCount < (IS_INVOKE_SET ? 2 : 1))
@@ -1205,6 +1398,11 @@ ResultType STDMETHODCALLTYPE ComObject::Invoke(ExprTokenType &aResultToken, Expr
 
 	DISPID dispid;
 	LPTSTR aName;
+	LPOLESTR wname = NULL;
+#ifndef UNICODE
+	CStringW wname_buf;
+#endif
+	bool dispid_cached = false;
 	HRESULT	hr;
 	if (aFlags & IF_NEWENUM)
 	{
@@ -1224,12 +1422,12 @@ ResultType STDMETHODCALLTYPE ComObject::Invoke(ExprTokenType &aResultToken, Expr
 	{
 		aName = TokenToString(*aParam[0], aResultToken.buf);
 #ifdef UNICODE
-		LPOLESTR wname = aName;
+		wname = aName;
 #else
-		CStringWCharFromChar cnvbuf(aName);
-		LPOLESTR wname = (LPOLESTR)(LPCWSTR)cnvbuf;
+		StringCharToWChar(aName, wname_buf);
+		wname = (LPOLESTR)(LPCWSTR)wname_buf;
 #endif
-		hr = mDispatch->GetIDsOfNames(IID_NULL, &wname, 1, LOCALE_USER_DEFAULT, &dispid);
+		hr = GetDispId(wname, dispid, dispid_cached);
 		if (hr == DISP_E_UNKNOWNNAME) // v1.1.18: Retry with IDispatchEx if supported, to allow creating new properties.
 		{
 			if (IS_INVOKE_SET)
@@ -1289,13 +1487,28 @@ ResultType STDMETHODCALLTYPE ComObject::Invoke(ExprTokenType &aResultToken, Expr
 		}
 	}
 
-	if (SUCCEEDED(hr)
-		// For obj.x:=y where y is a ComObject, invoke PROPERTYPUTREF first:
-		&& !(IS_INVOKE_SET && rgvarg[0].vt == VT_DISPATCH && SUCCEEDED(mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYPUTREF, &dispparams, NULL, NULL, NULL))
-		// For obj.x(), invoke METHOD first since PROPERTYGET|METHOD is ambiguous and gets undesirable results in some known cases; but re-invoke with PROPERTYGET only if DISP_E_MEMBERNOTFOUND is returned:
-		  || IS_INVOKE_CALL && !aParamCount && DISP_E_MEMBERNOTFOUND != (hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD, &dispparams, &varResult, &excepinfo, NULL))))
-		// Invoke PROPERTYPUT or PROPERTYGET|METHOD as appropriate:
-		hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, IS_INVOKE_SET ? DISPATCH_PROPERTYPUT : DISPATCH_PROPERTYGET | DISPATCH_METHOD, &dispparams, &varResult, &excepinfo, NULL);
+	for (;;)
+	{
+		if (SUCCEEDED(hr)
+			// For obj.x:=y where y is a ComObject, invoke PROPERTYPUTREF first:
+			&& !(IS_INVOKE_SET && rgvarg[0].vt == VT_DISPATCH && SUCCEEDED(mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_PROPERTYPUTREF, &dispparams, NULL, NULL, NULL))
+			// For obj.x(), invoke METHOD first since PROPERTYGET|METHOD is ambiguous and gets undesirable results in some known cases; but re-invoke with PROPERTYGET only if DISP_E_MEMBERNOTFOUND is returned:
+			  || IS_INVOKE_CALL && !aParamCount && DISP_E_MEMBERNOTFOUND != (hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, DISPATCH_METHOD, &dispparams, &varResult, &excepinfo, NULL))))
+			// Invoke PROPERTYPUT or PROPERTYGET|METHOD as appropriate:
+			hr = mDispatch->Invoke(dispid, IID_NULL, LOCALE_USER_DEFAULT, IS_INVOKE_SET ? DISPATCH_PROPERTYPUT : DISPATCH_PROPERTYGET | DISPATCH_METHOD, &dispparams, &varResult, &excepinfo, NULL);
+		// A cached DISPID may be stale, so look it up again and retry once if it has changed:
+		if (hr != DISP_E_MEMBERNOTFOUND || !dispid_cached)
+			break;
+		HRESULT refresh_hr = RefreshDispId(wname, dispid);
+		if (refresh_hr != S_OK)
+		{
+			if (FAILED(refresh_hr))
+				hr = refresh_hr; // Report the name as unknown, as an uncached lookup would.
+			break;
+		}
+		dispid_cached = false;
+		hr = S_OK;
+	}
 
 	for (int i = 0; i < aParamCount; i++)
 	{
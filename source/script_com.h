@@ -46,8 +46,54 @@ public:
 };
 
 
+// ComDispIdCache - Maps member names to DISPIDs so that ComObject::Invoke does not need to call
+// GetIDsOfNames each time.  Each ComObject starts with a private cache.  Once it has looked up a second
+// name, it switches to a cache shared by all objects with the same type GUID, so that each new ComObject
+// wrapping an object of that type benefits from previous lookups.  Objects which support IDispatchEx
+// always keep a private cache, since their members may differ from those of other objects of that type.
+class ComDispIdCache
+{
+	struct Entry
+	{
+		LPWSTR name;
+		DISPID dispid;
+	};
+	Entry *mEntry; // Sorted by name.  Names are case-sensitive since some objects (e.g. JScript) are.
+	int mCount, mCapacity;
+	ULONG mRefCount;
+	GUID mTypeGuid; // GUID_NULL if this cache is used by only one object.
+	ComDispIdCache *mNextShared;
+
+	static ComDispIdCache *sShared; // Caches of all types seen so far, each holding one reference.
+
+	ComDispIdCache(REFGUID aTypeGuid)
+		: mEntry(NULL), mCount(0), mCapacity(0), mRefCount(1), mTypeGuid(aTypeGuid), mNextShared(NULL) {}
+	~ComDispIdCache();
+	int Find(LPCWSTR aName, bool &aFound);
+
+public:
+	static ComDispIdCache *FindShared(IDispatch *aDispatch);
+	static ComDispIdCache *CreatePrivate() { return new ComDispIdCache(GUID_NULL); }
+	static void ReleaseShared();
+	bool IsShared() { return !IsEqualGUID(mTypeGuid, GUID_NULL); }
+	void AddRef() { ++mRefCount; }
+	void Release() { if (!--mRefCount) delete this; }
+
+	bool Get(LPCWSTR aName, DISPID &aDispId);
+	void Set(LPCWSTR aName, DISPID aDispId);
+	void Remove(LPCWSTR aName);
+	void CopyTo(ComDispIdCache *aOther);
+	int Count() { return mCount; }
+};
+
+
 class ComObject : public ObjectBase
 {
+	ComDispIdCache *mDispIds; // NULL until a member is invoked by name.
+
+	HRESULT GetDispId(LPOLESTR aName, DISPID &aDispId, bool &aCached);
+	HRESULT RefreshDispId(LPOLESTR aName, DISPID &aDispId);
+
 public:
 	union
 	{
@@ -59,7 +105,7 @@ public:
 	};
 	ComEvent *mEventSink;
 	VARTYPE mVarType;
-	enum { F_OWNVALUE = 1 };
+	enum { F_OWNVALUE = 1, F_TYPE_CHECKED = 2 };
 	USHORT mFlags;
 
 	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
@@ -76,11 +122,13 @@ public:
 	}
 
 	ComObject(IDispatch *pdisp)
-		: mVal64((__int64)pdisp), mVarType(VT_DISPATCH), mEventSink(NULL), mFlags(0) { }
+		: mVal64((__int64)pdisp), mVarType(VT_DISPATCH), mEventSink(NULL), mFlags(0), mDispIds(NULL) { }
 	ComObject(__int64 llVal, VARTYPE vt, USHORT flags = 0)
-		: mVal64(llVal), mVarType(vt), mEventSink(NULL), mFlags(flags) { }
+		: mVal64(llVal), mVarType(vt), mEventSink(NULL), mFlags(flags), mDispIds(NULL) { }
 	~ComObject()
 	{
+		if (mDispIds)
+			mDispIds->Release();
 		if ((VT_DISPATCH == mVarType || VT_UNKNOWN == mVarType) && mUnknown)
 		{
 			if (mEventSink)
@@ -151,14 +151,21 @@ Object *Object::CreateArray(ExprTokenType *aValue[], int aValueCount)
 
 Object *Object::Clone(BOOL aExcludeIntegerKeys)
 // Creates an object and copies to it the fields at and after the given offset.
+{
+	Object *objptr = new Object();
+	if (!objptr)
+		return NULL;
+	return CloneTo(*objptr, aExcludeIntegerKeys);
+}
+
+Object *Object::CloneTo(Object &obj, BOOL aExcludeIntegerKeys)
+// Copies the fields at and after the given offset to obj, which must be newly created (empty).
+// If an allocation fails, obj is released and NULL is returned.
 {
 	IndexType aStartOffset = aExcludeIntegerKeys ? mKeyOffsetObject : 0;
 
-	Object *objptr = new Object();
-	if (!objptr|| aStartOffset >= mFieldCount)
-		return objptr;
-	
-	Object &obj = *objptr;
+	if (aStartOffset >= mFieldCount)
+		return &obj;
 
 	// Allocate space in destination object.
 	IndexType field_count = mFieldCount - aStartOffset;
@@ -1783,6 +1790,846 @@ Object::FieldType *Object::Insert(SymbolType key_type, KeyType key, IndexType at
 }
 
 
+//
+// FrozenObject::Freeze - Creates an immutable deep copy of an Object.
+//
+
+struct FrozenObject::FreezeContext
+{
+	// Objects frozen so far, so that an object referenced more than once is frozen only once.
+	// mFrozen[i] is NULL while mSource[i] is still being frozen, which indicates a cycle.
+	Object **mSource;
+	FrozenObject **mFrozen;
+	int mCount, mCapacity;
+	LPTSTR mError;
+
+	FreezeContext() : mSource(NULL), mFrozen(NULL), mCount(0), mCapacity(0), mError(NULL) {}
+	~FreezeContext()
+	{
+		for (int i = 0; i < mCount; ++i)
+			if (mFrozen[i])
+				mFrozen[i]->Release();
+		free(mSource);
+		free(mFrozen);
+	}
+	int Find(Object *aObject)
+	{
+		for (int i = 0; i < mCount; ++i)
+			if (mSource[i] == aObject)
+				return i;
+		return -1;
+	}
+	bool Add(Object *aObject)
+	{
+		if (mCount == mCapacity)
+		{
+			int new_capacity = mCapacity ? mCapacity * 2 : 16;
+			Object **new_source = (Object **)realloc(mSource, new_capacity * sizeof(Object *));
+			if (!new_source)
+				return false;
+			mSource = new_source;
+			FrozenObject **new_frozen = (FrozenObject **)realloc(mFrozen, new_capacity * sizeof(FrozenObject *));
+			if (!new_frozen)
+				return false;
+			mFrozen = new_frozen;
+			mCapacity = new_capacity;
+		}
+		mSource[mCount] = aObject;
+		mFrozen[mCount++] = NULL;
+		return true;
+	}
+};
+
+FrozenObject *FrozenObject::Freeze(Object *aObject, LPTSTR &aError)
+// Returns a new reference to the frozen copy of aObject, or NULL with aError set.
+{
+	if (FrozenObject *frozen = dynamic_cast<FrozenObject *>(aObject))
+	{
+		frozen->AddRef();
+		return frozen;
+	}
+	FreezeContext context;
+	FrozenObject *frozen = Freeze(aObject, context);
+	if (frozen)
+		frozen->AddRef(); // The context's reference is released below.
+	else
+		aError = context.mError;
+	return frozen;
+}
+
+FrozenObject *FrozenObject::Freeze(Object *aObject, FreezeContext &aContext)
+// Returns a reference owned by aContext.
+{
+	int index = aContext.Find(aObject);
+	if (index >= 0)
+	{
+		if (!aContext.mFrozen[index])
+			aContext.mError = _T("Circular reference.");
+		return aContext.mFrozen[index];
+	}
+	if (!aContext.Add(aObject))
+	{
+		aContext.mError = ERR_OUTOFMEM;
+		return NULL;
+	}
+	index = aContext.mCount - 1;
+
+	// The base isn't copied since it would have to be frozen too, which isn't feasible for
+	// classes.  Only the data is of interest to readers in other threads anyway.
+	FrozenObject *frozen = new FrozenObject();
+	if (!frozen || !aObject->CloneTo(*frozen)) // CloneTo() releases frozen on failure.
+	{
+		aContext.mError = ERR_OUTOFMEM;
+		return NULL;
+	}
+	for (IndexType i = 0; i < frozen->mFieldCount; ++i)
+	{
+		FieldType &field = frozen->mFields[i];
+		if (field.symbol != SYM_OBJECT || dynamic_cast<FrozenObject *>(field.object))
+			continue;
+		Object *obj = dynamic_cast<Object *>(field.object);
+		FrozenObject *frozen_obj = NULL;
+		if (!obj)
+			aContext.mError = _T("Only Objects can be frozen.");
+		if (!obj || !(frozen_obj = Freeze(obj, aContext)))
+		{
+			frozen->Release();
+			return NULL;
+		}
+		field.object->Release();
+		(field.object = frozen_obj)->AddRef();
+	}
+	return aContext.mFrozen[index] = frozen;
+}
+
+ResultType STDMETHODCALLTYPE FrozenObject::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+{
+	if (IS_INVOKE_SET)
+		return g_script.ScriptError(ERR_OBJECT_FROZEN);
+	if (IS_INVOKE_CALL && aParamCount && !IS_INVOKE_META)
+	{
+		SymbolType key_type;
+		KeyType key;
+		IndexType insert_pos;
+		if (!FindField(*aParam[0], aResultToken.buf, key_type, key, insert_pos)
+			&& key_type == SYM_STRING && IsMutator(GetBuiltinID(key.s)))
+			return g_script.ScriptError(ERR_OBJECT_FROZEN, key.s);
+	}
+	return Object::Invoke(aResultToken, aThisToken, aFlags, aParam, aParamCount);
+}
+
+
+//
+// SnapshotSlot: Publishes successive versions of a FrozenObject to readers in any thread.
+//
+
+FrozenObject *SnapshotSlot::Get()
+// Returns a new reference to the current version, or NULL.
+{
+	Lock();
+	FrozenObject *value = mValue;
+	if (value)
+		value->AddRef();
+	Unlock();
+	return value;
+}
+
+FrozenObject *SnapshotSlot::Exchange(FrozenObject *aValue, FrozenObject *aComparand, bool aCompare)
+// Replaces the current version with aValue (if aCompare is false or the current version is aComparand).
+// Returns the previous version, whose reference is transferred to the caller.
+{
+	if (aValue)
+		aValue->AddRef();
+	Lock();
+	FrozenObject *prev = mValue;
+	if (aCompare && prev != aComparand)
+	{
+		if (prev)
+			prev->AddRef();
+		Unlock();
+		if (aValue)
+			aValue->Release();
+		return prev;
+	}
+	mValue = aValue;
+	InterlockedIncrement(&mVersion);
+	Unlock();
+	return prev;
+}
+
+ResultType STDMETHODCALLTYPE SnapshotSlot::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Value / Get(): The current version.
+// Version: The number of versions published so far.
+// Publish(NewValue), Exchange(NewValue): Replace the current version; Exchange returns the previous one.
+// CompareExchange(NewValue, Expected): Replace the current version only if it is Expected; returns the previous one.
+// NewValue may be an Object, in which case it is frozen first.
+{
+	if (!aParamCount || IS_INVOKE_SET)
+		return INVOKE_NOT_HANDLED;
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (!_tcsicmp(name, _T("Value")) || !_tcsicmp(name, _T("Get")))
+	{
+		if (FrozenObject *value = Get())
+		{
+			aResultToken.symbol = SYM_OBJECT;
+			aResultToken.object = value;
+		}
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Version")))
+	{
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = mVersion;
+		return OK;
+	}
+	if (!IS_INVOKE_CALL)
+		return INVOKE_NOT_HANDLED;
+
+	bool publish = !_tcsicmp(name, _T("Publish"));
+	bool compare = !_tcsicmp(name, _T("CompareExchange"));
+	if (!publish && !compare && _tcsicmp(name, _T("Exchange")))
+		return INVOKE_NOT_HANDLED;
+	if (aParamCount < (compare ? 2 : 1))
+		return g_script.ScriptError(ERR_TOO_FEW_PARAMS);
+
+	FrozenObject *value = NULL, *comparand = NULL;
+	IObject *obj = TokenToObject(*aParam[0]);
+	if (obj)
+	{
+		Object *source = dynamic_cast<Object *>(obj);
+		if (!source)
+			return g_script.ScriptError(ERR_PARAM1_INVALID);
+		LPTSTR error;
+		if (  !(value = FrozenObject::Freeze(source, error))  )
+			return g_script.ScriptError(error);
+	}
+	// else an empty value clears the slot.
+	if (compare && (obj = TokenToObject(*aParam[1])) && !(comparand = dynamic_cast<FrozenObject *>(obj)))
+	{
+		if (value)
+			value->Release();
+		return g_script.ScriptError(ERR_PARAM2_INVALID);
+	}
+
+	FrozenObject *prev = Exchange(value, comparand, compare);
+	if (value)
+		value->Release(); // Exchange() added its own reference if it was stored.
+	if (publish)
+	{
+		if (prev)
+			prev->Release();
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = mVersion;
+	}
+	else if (prev)
+	{
+		aResultToken.symbol = SYM_OBJECT;
+		aResultToken.object = prev;
+	}
+	return OK;
+}
+
+
+//
+// SharedQueue: Bounded FIFO queue which may be shared between threads (e.g. AutoHotkey.dll instances).
+//
+
+SharedQueue *SharedQueue::Create(int aCapacity)
+{
+	if (aCapacity < 1 || aCapacity > MAX_CAPACITY)
+		return NULL;
+	SharedQueue *queue = new SharedQueue();
+	if (!queue)
+		return NULL;
+	if (  !(queue->mItems = (Item *)malloc(aCapacity * sizeof(Item)))
+		|| !(queue->mNotFull = CreateEvent(NULL, FALSE, FALSE, NULL))
+		|| !(queue->mNotEmpty = CreateEvent(NULL, FALSE, FALSE, NULL))  )
+	{
+		queue->Release();
+		return NULL;
+	}
+	queue->mCapacity = aCapacity;
+	return queue;
+}
+
+SharedQueue::~SharedQueue()
+{
+	for (; mCount; --mCount, mHead = (mHead + 1) % mCapacity)
+	{
+		Item &item = mItems[mHead];
+		if (item.symbol == SYM_STRING)
+			free(item.marker);
+		else if (item.symbol == SYM_OBJECT)
+			item.object->Release();
+	}
+	free(mItems);
+	if (mNotFull)
+		CloseHandle(mNotFull);
+	if (mNotEmpty)
+		CloseHandle(mNotEmpty);
+	DeleteCriticalSection(&mCriSec);
+}
+
+bool MsgWaitForEvent(HANDLE aEvent, DWORD aStartTime, int aTimeout)
+// Waits until aEvent is signaled or some messages have been processed.
+// Returns false if the timeout has elapsed, in which case the caller gives up.
+{
+	DWORD wait = INFINITE;
+	if (aTimeout >= 0)
+	{
+		DWORD elapsed = GetTickCount() - aStartTime;
+		if (elapsed >= (DWORD)aTimeout)
+			return false;
+		wait = aTimeout - elapsed;
+	}
+	if (GetCurrentThreadId() != g_MainThreadID)
+		// Called by another thread (such as another dll instance using this queue via its address),
+		// whose messages can't be processed by this instance.
+		WaitForSingleObject(aEvent, wait);
+	else if (MsgWaitForMultipleObjects(1, &aEvent, FALSE, wait, QS_ALLINPUT) == WAIT_OBJECT_0 + 1)
+		// Keep hotkeys, timers and GUI events responsive while waiting; this might launch new threads.
+		MsgSleep(-1);
+	return true; // Let the caller try again even if the wait timed out, and check the time on the next call.
+}
+
+bool SharedQueue::Push(ExprTokenType &aValue, int aTimeout, bool &aOutOfMem)
+{
+	// Prepare the item before acquiring the lock to keep the lock's hold time to a minimum.
+	Item item;
+	ExprTokenType temp, *val = &aValue;
+	if (aValue.symbol == SYM_VAR)
+	{
+		aValue.var->TokenToContents(temp); // Preserves any cached binary number, and AddRefs an object.
+		val = &temp;
+	}
+	switch (item.symbol = val->symbol)
+	{
+	case SYM_OBJECT:
+		item.object = val->object;
+		if (val == &aValue)
+			item.object->AddRef();
+		// Otherwise, take ownership of the ref in temp.
+		break;
+	case SYM_INTEGER:
+	case SYM_FLOAT:
+		item.n_int64 = val->value_int64; // Union copy.
+		break;
+	case SYM_OPERAND:
+		if (val->buf) // Integer literal with a cached binary integer.
+		{
+			item.symbol = SYM_INTEGER;
+			item.n_int64 = *(__int64 *)val->buf;
+			break;
+		}
+		// FALL THROUGH to the next case.
+	default:
+		item.symbol = SYM_STRING;
+		item.length = _tcslen(val->marker);
+		if (  !(item.marker = tmalloc(item.length + 1))  )
+		{
+			aOutOfMem = true;
+			return false;
+		}
+		tmemcpy(item.marker, val->marker, item.length + 1);
+	}
+	aOutOfMem = false;
+
+	DWORD start_time = GetTickCount();
+	bool waiting = false;
+	for (;;)
+	{
+		EnterCriticalSection(&mCriSec);
+		if (waiting)
+			--mPushWaiters;
+		if (mClosed)
+		{
+			// Close set mNotFull only once, so pass on the wake-up to the next waiter.
+			if (mPushWaiters)
+				SetEvent(mNotFull);
+			break;
+		}
+		if (mCount < mCapacity)
+		{
+			mItems[(mHead + mCount++) % mCapacity] = item;
+			if (mPopWaiters)
+				SetEvent(mNotEmpty);
+			// Pass on the wake-up in case several pops completed while this thread was waking up.
+			if (mCount < mCapacity && mPushWaiters)
+				SetEvent(mNotFull);
+			LeaveCriticalSection(&mCriSec);
+			return true;
+		}
+		if (!aTimeout)
+			break;
+		++mPushWaiters;
+		waiting = true;
+		LeaveCriticalSection(&mCriSec);
+		if (!MsgWaitForEvent(mNotFull, start_time, aTimeout))
+		{
+			EnterCriticalSection(&mCriSec);
+			--mPushWaiters;
+			break;
+		}
+	}
+	LeaveCriticalSection(&mCriSec);
+	// Timed out or closed, so discard the item.
+	if (item.symbol == SYM_STRING)
+		free(item.marker);
+	else if (item.symbol == SYM_OBJECT)
+		item.object->Release();
+	return false;
+}
+
+bool SharedQueue::Pop(ExprTokenType &aResultToken, int aTimeout)
+// On success, the caller takes ownership of aResultToken.object or aResultToken.mem_to_free.
+{
+	DWORD start_time = GetTickCount();
+	bool waiting = false;
+	for (;;)
+	{
+		EnterCriticalSection(&mCriSec);
+		if (waiting)
+			--mPopWaiters;
+		if (mCount)
+		{
+			Item &item = mItems[mHead];
+			mHead = (mHead + 1) % mCapacity;
+			--mCount;
+			if (mPushWaiters)
+				SetEvent(mNotFull);
+			if (mCount && mPopWaiters)
+				SetEvent(mNotEmpty);
+			// Copy the item before leaving since its slot may be reused as soon as the lock is released.
+			Item result = item;
+			LeaveCriticalSection(&mCriSec);
+			if (result.symbol == SYM_STRING)
+			{
+				aResultToken.symbol = SYM_STRING;
+				aResultToken.marker = aResultToken.mem_to_free = result.marker;
+				aResultToken.marker_length = result.length;
+			}
+			else
+			{
+				aResultToken.symbol = result.symbol;
+				aResultToken.value_int64 = result.n_int64; // Union copy.
+			}
+			return true;
+		}
+		if (mClosed)
+		{
+			// Close set mNotEmpty only once, so pass on the wake-up to the next waiter.
+			if (mPopWaiters)
+				SetEvent(mNotEmpty);
+			break;
+		}
+		if (!aTimeout)
+			break;
+		++mPopWaiters;
+		waiting = true;
+		LeaveCriticalSection(&mCriSec);
+		if (!MsgWaitForEvent(mNotEmpty, start_time, aTimeout))
+		{
+			EnterCriticalSection(&mCriSec);
+			--mPopWaiters;
+			break;
+		}
+	}
+	LeaveCriticalSection(&mCriSec);
+	return false;
+}
+
+void SharedQueue::Close()
+// Causes all further pushes to fail and pops to fail once the queue is empty, waking all waiters.
+{
+	EnterCriticalSection(&mCriSec);
+	mClosed = true;
+	// Each waiter woken by this passes on the wake-up to the next one of its kind (see Push and Pop).
+	if (mPushWaiters)
+		SetEvent(mNotFull);
+	if (mPopWaiters)
+		SetEvent(mNotEmpty);
+	LeaveCriticalSection(&mCriSec);
+}
+
+ResultType STDMETHODCALLTYPE SharedQueue::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Push(Value [, Timeout := -1]), TryPush(Value): Returns true if Value was added, false on timeout or if closed.
+// Pop([Timeout := -1]): Returns the oldest value, or "" on timeout or if closed and empty.
+// TryPop(OutputVar [, Timeout := 0]): Stores the oldest value in OutputVar and returns true, or returns false.
+// Close(), Count, Capacity, Closed.
+{
+	if (!aParamCount || IS_INVOKE_SET)
+		return INVOKE_NOT_HANDLED;
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (!IS_INVOKE_CALL || !aParamCount && !_tcsicmp(name, _T("Count")))
+	{
+		aResultToken.symbol = SYM_INTEGER;
+		if (!_tcsicmp(name, _T("Count")))
+			aResultToken.value_int64 = mCount; // Only a snapshot anyway, so no need to lock.
+		else if (!_tcsicmp(name, _T("Capacity")))
+			aResultToken.value_int64 = mCapacity;
+		else if (!_tcsicmp(name, _T("Closed")))
+			aResultToken.value_int64 = mClosed;
+		else
+			return INVOKE_NOT_HANDLED;
+		return OK;
+	}
+
+	if (!_tcsicmp(name, _T("Push")) || !_tcsicmp(name, _T("TryPush")))
+	{
+		if (!aParamCount)
+			return g_script.ScriptError(ERR_TOO_FEW_PARAMS);
+		int timeout = (name[0] == 'T' || name[0] == 't') ? 0 : ParamIndexToOptionalInt(1, -1);
+		bool out_of_mem;
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = Push(*aParam[0], timeout, out_of_mem);
+		return out_of_mem ? g_script.ScriptError(ERR_OUTOFMEM) : OK;
+	}
+	if (!_tcsicmp(name, _T("Pop")))
+	{
+		Pop(aResultToken, ParamIndexToOptionalInt(0, -1)); // On failure, aResultToken is left at its default, "".
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("TryPop")))
+	{
+		Var *output_var = ParamIndexToOptionalVar(0);
+		if (!output_var)
+			return g_script.ScriptError(ERR_PARAM1_INVALID);
+		ExprTokenType value;
+		value.mem_to_free = NULL;
+		bool popped = Pop(value, ParamIndexToOptionalInt(1, 0));
+		if (popped)
+		{
+			if (value.symbol == SYM_STRING)
+			{
+				output_var->Assign(value.marker, value.marker_length);
+				free(value.mem_to_free);
+			}
+			else
+			{
+				output_var->Assign(value);
+				if (value.symbol == SYM_OBJECT)
+					value.object->Release(); // Assign() added its own reference.
+			}
+		}
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = popped;
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Close")))
+	{
+		Close();
+		return OK;
+	}
+	return INVOKE_NOT_HANDLED;
+}
+
+
+//
+// BufferObject: Reference-counted binary data with zero-copy slices.
+//
+
+BufferObject *BufferObject::Create(size_t aSize)
+{
+	BYTE *data = NULL;
+	if (aSize && !(data = (BYTE *)malloc(aSize)))
+		return NULL;
+	return new BufferObject(data, aSize, NULL);
+}
+
+BufferObject *BufferObject::Adopt(void *aData, size_t aSize)
+{
+	return new BufferObject((BYTE *)aData, aSize, NULL);
+}
+
+BufferObject *BufferObject::Slice(size_t aOffset, size_t aLength)
+// Caller has ensured aOffset + aLength <= mSize.
+{
+	// Slices of slices refer directly to the owner, so that only one level needs to be tracked.
+	BufferObject *owner = mOwner ? mOwner : this;
+	owner->AddRef();
+	InterlockedIncrement(&owner->mSliceCount);
+	return new BufferObject(mData + aOffset, aLength, owner);
+}
+
+BufferObject::~BufferObject()
+{
+	if (mOwner)
+	{
+		InterlockedDecrement(&mOwner->mSliceCount);
+		mOwner->Release();
+	}
+	else
+		free(mData);
+}
+
+bool BufferObject::Resize(size_t aSize)
+{
+	if (!CanResize())
+		return false;
+	if (aSize == mSize)
+		return true;
+	if (!aSize)
+	{
+		free(mData);
+		mData = NULL;
+		mSize = 0;
+		return true;
+	}
+	BYTE *new_data = (BYTE *)realloc(mData, aSize);
+	if (!new_data)
+		return false;
+	if (aSize > mSize)
+		memset(new_data + mSize, 0, aSize - mSize);
+	mData = new_data;
+	mSize = aSize;
+	return true;
+}
+
+bool BufferObject::SetData(void *aData, size_t aSize)
+{
+	if (!CanResize())
+	{
+		free(aData);
+		return false;
+	}
+	free(mData);
+	mData = (BYTE *)aData;
+	mSize = aSize;
+	return true;
+}
+
+ResultType STDMETHODCALLTYPE BufferObject::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Ptr: The address of the data, or 0 if Size is 0.
+// Size: The size of the data in bytes.  Can be set only if this isn't a slice and has no slices.
+// Slice(Offset [, Length]): Returns a Buffer which refers to part of this buffer's data, without copying it.
+// Owned: True if this isn't a slice.
+{
+	if (!aParamCount)
+		return INVOKE_NOT_HANDLED;
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (IS_INVOKE_SET)
+	{
+		if (aParamCount != 1 || _tcsicmp(name, _T("Size")))
+			return INVOKE_NOT_HANDLED;
+		__int64 size = ParamIndexToInt64(0);
+		if (size < 0 || (unsigned __int64)size > (size_t)-1)
+			return g_script.ScriptError(ERR_INVALID_VALUE);
+		if (!Resize((size_t)size))
+			return g_script.ScriptError(CanResize() ? ERR_OUTOFMEM : ERR_BUFFER_NOT_RESIZABLE);
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = size;
+		return OK;
+	}
+
+	if (!_tcsicmp(name, _T("Slice")))
+	{
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		__int64 offset = ParamIndexToOptionalInt64(0, 0);
+		if (offset < 0 || (unsigned __int64)offset > mSize)
+			return g_script.ScriptError(ERR_PARAM1_INVALID);
+		__int64 length = ParamIndexIsOmittedOrEmpty(1) ? (__int64)(mSize - (size_t)offset) : ParamIndexToInt64(1);
+		if (length < 0 || (unsigned __int64)length > mSize - (size_t)offset)
+			return g_script.ScriptError(ERR_PARAM2_INVALID);
+		aResultToken.symbol = SYM_OBJECT;
+		aResultToken.object = Slice((size_t)offset, (size_t)length);
+		return OK;
+	}
+
+	aResultToken.symbol = SYM_INTEGER;
+	if (!_tcsicmp(name, _T("Ptr")))
+		aResultToken.value_int64 = (__int64)(size_t)mData;
+	else if (!_tcsicmp(name, _T("Size")))
+		aResultToken.value_int64 = mSize;
+	else if (!_tcsicmp(name, _T("Owned")))
+		aResultToken.value_int64 = !mOwner;
+	else
+	{
+		aResultToken.symbol = SYM_STRING;
+		return INVOKE_NOT_HANDLED;
+	}
+	return OK;
+}
+
+BufferObject *TokenToBuffer(ExprTokenType &aToken)
+{
+	IObject *obj;
+	if (aToken.symbol == SYM_OBJECT)
+		obj = aToken.object;
+	else if (aToken.symbol == SYM_VAR && aToken.var->HasObject())
+		obj = aToken.var->Object();
+	else
+		return NULL;
+	return dynamic_cast<BufferObject *>(obj);
+}
+
+
+//
+// NumViewObject: Typed access to an array of numbers in a Buffer or at an address.
+//
+
+NumViewObject *NumViewObject::Create(int aNumType, IObject *aOwner, size_t aStart, size_t aCount, size_t aStride)
+{
+	return new NumViewObject(aNumType, aOwner, dynamic_cast<Struct *>(aOwner) != NULL, aStart, aCount
+		, aStride ? aStride : aNumType & NUMTYPE_SIZE_MASK);
+}
+
+BYTE *NumViewObject::Items(size_t aFirst, size_t aCount)
+{
+	if (aFirst > mCount || aCount > mCount - aFirst)
+		return NULL;
+	size_t item_size = mNumType & NUMTYPE_SIZE_MASK;
+	size_t offset = mStart + aFirst * mStride;
+	if (!mOwner)
+		return (BYTE *)offset;
+	BYTE *data;
+	size_t size;
+	if (mOwnerIsStruct)
+	{
+		Struct *owner = (Struct *)mOwner;
+		if (owner->mMemAllocated <= 0) // The memory was freed or replaced with an address.
+			return NULL;
+		data = (BYTE *)owner->mStructMem;
+		size = (size_t)owner->mMemAllocated;
+	}
+	else
+	{
+		BufferObject *owner = (BufferObject *)mOwner;
+		data = owner->Data();
+		size = owner->Size();
+	}
+	if (aCount && offset + (aCount - 1) * mStride + item_size > size) // The owner's memory has been made smaller.
+		return NULL;
+	return data + offset;
+}
+
+ResultType STDMETHODCALLTYPE NumViewObject::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// [Index]: Gets or sets an item, as NumGet or NumPut would.
+// Ptr: The address of the first item.
+// Length: The number of items.
+// Size: The size of the items in bytes.
+// Stride: The distance in bytes from one item to the next.
+// ToArray([Start, Count]): Returns an Object array containing the items.
+// FromArray(Array [, Start]): Stores the integer-keyed values of Array into the items, starting at Start.
+{
+	if (!aParamCount)
+		return INVOKE_NOT_HANDLED;
+
+	if (!IS_INVOKE_CALL && aParamCount == (IS_INVOKE_SET ? 2 : 1) && TokenIsPureNumeric(*aParam[0]) == PURE_INTEGER)
+	{
+		__int64 index = TokenToInt64(*aParam[0]);
+		BYTE *item = (index > 0 && (unsigned __int64)index <= mCount) ? Items((size_t)index - 1, 1) : NULL;
+		if (!item)
+			return g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+		if (IS_INVOKE_SET)
+			WriteNum(mNumType, item, *aParam[1]);
+		ReadNum(mNumType, item, aResultToken); // For an assignment, this yields the value as it was stored.
+		return OK;
+	}
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (IS_INVOKE_SET)
+		return INVOKE_NOT_HANDLED;
+
+	size_t item_size = mNumType & NUMTYPE_SIZE_MASK;
+
+	if (!_tcsicmp(name, _T("ToArray")))
+	{
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		__int64 start = ParamIndexToOptionalInt64(0, 1);
+		if (start < 1 || (unsigned __int64)start > (unsigned __int64)mCount + 1)
+			return g_script.ScriptError(ERR_PARAM1_INVALID);
+		size_t first = (size_t)start - 1;
+		__int64 count = ParamIndexIsOmittedOrEmpty(1) ? (__int64)(mCount - first) : ParamIndexToInt64(1);
+		if (count < 0 || (unsigned __int64)count > mCount - first || count > INT_MAX)
+			return g_script.ScriptError(ERR_PARAM2_INVALID);
+		BYTE *item = Items(first, (size_t)count);
+		if (!item)
+			return g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+		Object *arr;
+		if (count)
+		{
+			ExprTokenType *value = (ExprTokenType *)malloc((size_t)count * (sizeof(ExprTokenType) + sizeof(ExprTokenType *)));
+			if (!value)
+				return g_script.ScriptError(ERR_OUTOFMEM);
+			ExprTokenType **value_ptr = (ExprTokenType **)(value + count);
+			for (int i = 0; i < (int)count; ++i, item += mStride)
+			{
+				ReadNum(mNumType, item, value[i]);
+				value_ptr[i] = &value[i];
+			}
+			arr = Object::CreateArray(value_ptr, (int)count);
+			free(value);
+		}
+		else
+			arr = Object::CreateArray();
+		if (!arr)
+			return g_script.ScriptError(ERR_OUTOFMEM);
+		aResultToken.symbol = SYM_OBJECT;
+		aResultToken.object = arr;
+		return OK;
+	}
+
+	if (!_tcsicmp(name, _T("FromArray")))
+	{
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		Object *arr = aParamCount ? dynamic_cast<Object *>(TokenToObject(*aParam[0])) : NULL;
+		if (!arr)
+			return g_script.ScriptError(ERR_PARAM1_INVALID);
+		__int64 start = ParamIndexToOptionalInt64(1, 1);
+		if (start < 1 || (unsigned __int64)start > (unsigned __int64)mCount + 1)
+			return g_script.ScriptError(ERR_PARAM2_INVALID);
+		int max_index = arr->MaxIndex();
+		size_t count = max_index > 0 ? (size_t)max_index : 0; // Keys below 1 are ignored, as for variadic calls.
+		BYTE *item = Items((size_t)start - 1, count);
+		if (!item)
+			return g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+		// Items which have no corresponding value in the array are left unchanged.
+		ExprTokenType value;
+		INT_PTR offset = -1, key;
+		while (arr->GetNextItem(value, offset, key))
+			if (key > 0)
+				WriteNum(mNumType, item + (key - 1) * mStride, value);
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = count;
+		return OK;
+	}
+
+	aResultToken.symbol = SYM_INTEGER;
+	if (!_tcsicmp(name, _T("Ptr")))
+		aResultToken.value_int64 = (__int64)(size_t)Items(0, 0); // 0 if a Buffer has been made too small to contain the start of the view.
+	else if (!_tcsicmp(name, _T("Length")))
+		aResultToken.value_int64 = mCount;
+	else if (!_tcsicmp(name, _T("Size")))
+		aResultToken.value_int64 = mCount * item_size;
+	else if (!_tcsicmp(name, _T("Stride")))
+		aResultToken.value_int64 = mStride;
+	else
+	{
+		aResultToken.symbol = SYM_STRING;
+		return INVOKE_NOT_HANDLED;
+	}
+	return OK;
+}
+
+
 //
 // Property: Invoked when a derived object gets/sets the corresponding key.
 //
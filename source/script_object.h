@@ -176,6 +176,7 @@ protected:
 #ifdef CONFIG_DEBUGGER
 	friend class Debugger;
 #endif
+	friend class FrozenObject;
 
 	Object()
 		: mBase(NULL)
@@ -210,6 +211,7 @@ public:
 
 	// Used by Func::Call() for variadic functions/function-calls:
 	Object *Clone(BOOL aExcludeIntegerKeys = false);
+	Object *CloneTo(Object &aDest, BOOL aExcludeIntegerKeys = false);
 	void ArrayToParams(ExprTokenType *token, ExprTokenType **param_list, int extra_params, ExprTokenType **aParam, int aParamCount);
 	ResultType ArrayToStrings(LPTSTR *aStrings, int &aStringCount, int aStringsMax);
 	
@@ -469,19 +471,53 @@ public:
 // CriticalObject - Multithread save object wrapper
 //
 
+// Lock shared by all CriticalObjects wrapping the same object.  mCriSec must remain the first
+// member since CriticalObject(obj,2) hands out its address as a plain LPCRITICAL_SECTION.
+// Readers register in mReaders while briefly holding mCriSec, so a writer which owns mCriSec
+// only has to wait for mReaders to drain to gain exclusive access.
+struct CriticalLock
+{
+	CRITICAL_SECTION mCriSec;
+	volatile LONG mReaders;
+};
+
+#define CRITICAL_SPIN_MIN		16
+#define CRITICAL_SPIN_MAX		4096
+#define CRITICAL_SPIN_DEFAULT	256
+
 class CriticalObject : public ObjectBase
 {
 protected:
 	IObject *object;
 	LPCRITICAL_SECTION lpCriticalSection;
+	CriticalLock *mLock; // NULL unless created in reader-writer mode, i.e. exclusive locking only.
+	Object *mPlainObject; // object if it is an Object, for deciding whether a get can be shared.
+	bool mIsEnum; // Wraps an enumerator of the object, whose Next() only reads the object.
+	// The members below are only modified while lpCriticalSection is owned.
+	int mSpinCount; // Adapted after each contended acquisition.
+	// Contention statistics, see CriticalObject(obj, 3).
+	UINT mExclusiveCount, mSharedCount, mContendedCount, mSpinAcquiredCount, mWaitCount;
+	__int64 mWaitTime; // Total time spent waiting, in QueryPerformanceCounter ticks.
+
 	CriticalObject()
 			: lpCriticalSection(0)
 			, object(0)
+			, mLock(NULL)
+			, mPlainObject(NULL)
+			, mIsEnum(false)
+			, mSpinCount(CRITICAL_SPIN_DEFAULT)
+			, mExclusiveCount(0), mSharedCount(0), mContendedCount(0), mSpinAcquiredCount(0), mWaitCount(0)
+			, mWaitTime(0)
 	{}
 
 	bool Delete();
 	~CriticalObject(){}
 
+	void Enter();
+	void EnterShared();
+	void LeaveShared() { InterlockedDecrement(&mLock->mReaders); }
+	CriticalObject *Wrap(IObject *aObject);
+
 public:
 	__int64 GetObj()
 	{
@@ -491,11 +527,328 @@ public:
 	{
 		return (__int64) this->lpCriticalSection;
 	}
+	Object *GetStats();
 	static CriticalObject *Create(ExprTokenType *aParam[], int aParamCount);
 	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
 	IObject_Type_Impl("CriticalObject")
 };
 
+//
+// FrozenObject - Immutable deep copy of an Object, safe to read from any thread without locking.
+//
+
+class FrozenObject : public Object
+{
+	struct FreezeContext;
+	static FrozenObject *Freeze(Object *aObject, FreezeContext &aContext);
+
+	FrozenObject() {}
+
+public:
+	static FrozenObject *Freeze(Object *aObject, LPTSTR &aError);
+	static bool IsMutator(int aID)
+	{
+		switch (aID)
+		{
+		case FID_ObjInsertAt: case FID_ObjDelete: case FID_ObjRemoveAt: case FID_ObjPush: case FID_ObjPop:
+		case FID_ObjSetCapacity: case FID_ObjRemove: case FID_ObjInsert:
+			return true;
+		}
+		return false;
+	}
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("FrozenObject")
+};
+
+//
+// SnapshotSlot - Holds the current version of a FrozenObject; replaced atomically by Publish().
+//
+
+class SnapshotSlot : public ObjectBase
+{
+	FrozenObject *mValue;
+	volatile LONG mLock; // Guards only the load+AddRef or swap of mValue, never any script code.
+	volatile LONG mVersion;
+
+	SnapshotSlot() : mValue(NULL), mLock(0), mVersion(0) {}
+	~SnapshotSlot()
+	{
+		if (mValue)
+			mValue->Release();
+	}
+
+	void Lock()
+	{
+		for (int spins = 0; InterlockedExchange(&mLock, 1); ++spins)
+			if (spins < 64)
+				YieldProcessor();
+			else
+				Sleep(0);
+	}
+	void Unlock() { InterlockedExchange(&mLock, 0); }
+
+public:
+	static SnapshotSlot *Create() { return new SnapshotSlot(); }
+	FrozenObject *Get();
+	FrozenObject *Exchange(FrozenObject *aValue, FrozenObject *aComparand, bool aCompare);
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("SnapshotSlot")
+};
+
+//
+// BufferObject - Reference-counted block of binary data.  A slice shares the memory of the buffer
+// it was taken from and keeps that buffer alive; while any slices exist, the buffer can't be resized.
+//
+
+class BufferObject : public ObjectBase
+{
+	BufferObject *mOwner; // The buffer which owns mData if this is a slice, otherwise NULL.
+	BYTE *mData;
+	size_t mSize;
+	volatile LONG mSliceCount; // Number of slices and pending operations referring to this buffer's memory.
+
+	BufferObject(BYTE *aData, size_t aSize, BufferObject *aOwner)
+		: mOwner(aOwner), mData(aData), mSize(aSize), mSliceCount(0) {}
+	~BufferObject();
+
+public:
+	static BufferObject *Create(size_t aSize); // Contents are uninitialized.
+	static BufferObject *Adopt(void *aData, size_t aSize); // Takes ownership of a malloc'd block.
+	BufferObject *Slice(size_t aOffset, size_t aLength);
+
+	BYTE *Data() { return mData; }
+	size_t Size() { return mSize; }
+	bool CanResize() { return !mOwner && !mSliceCount; }
+	// Prevents the memory from being resized or replaced while something other than the script,
+	// such as an async operation, is using it.  The caller must also hold a reference.
+	void Pin() { InterlockedIncrement(&mSliceCount); }
+	void Unpin() { InterlockedDecrement(&mSliceCount); }
+	bool Resize(size_t aSize); // Any new bytes are zeroed.
+	// Replaces the contents with a malloc'd block, taking ownership of it.  If the buffer can't
+	// be resized, aData is freed and false is returned.
+	bool SetData(void *aData, size_t aSize);
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("Buffer")
+};
+
+// Returns the Buffer contained by aToken, or NULL.  Unlike TokenToObject, this never warns about uninitialized vars.
+BufferObject *TokenToBuffer(ExprTokenType &aToken);
+
+//
+// NumViewObject - An array of numbers of one NumGet/NumPut type, over part of a Buffer or Struct or at an address.
+// Items are numbered from 1 like those of an Object array.  A view of a Buffer or Struct keeps its owner alive
+// and checks the owner's current size on each access, since it may have been resized after the view was created.
+// Items are normally adjacent, but a view of one field in an array of structures has a larger stride.
+//
+
+class NumViewObject : public ObjectBase
+{
+	IObject *mOwner; // The BufferObject or Struct holding the items, or NULL if this is a view of an address.
+	size_t mStart; // The offset of the first item in mOwner's memory, or its address.
+	size_t mCount;
+	size_t mStride; // The distance in bytes from one item to the next.
+	int mNumType; // NUMTYPE_ flags.
+	bool mOwnerIsStruct;
+
+	NumViewObject(int aNumType, IObject *aOwner, bool aOwnerIsStruct, size_t aStart, size_t aCount, size_t aStride)
+		: mOwner(aOwner), mStart(aStart), mCount(aCount), mStride(aStride), mNumType(aNumType), mOwnerIsStruct(aOwnerIsStruct)
+	{
+		if (mOwner)
+			mOwner->AddRef();
+	}
+	~NumViewObject()
+	{
+		if (mOwner)
+			mOwner->Release();
+	}
+
+	BYTE *Items(size_t aFirst, size_t aCount); // aFirst is 0-based.  Returns NULL if any of the items are out of bounds.
+
+public:
+	// aOwner must be a BufferObject, a Struct which allocated its own memory, or NULL.
+	// aStride defaults to the size of aNumType.
+	static NumViewObject *Create(int aNumType, IObject *aOwner, size_t aStart, size_t aCount, size_t aStride = 0);
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("NumView")
+};
+
+// Waits for aEvent, processing messages if called on the script's thread.  See SharedQueue.
+bool MsgWaitForEvent(HANDLE aEvent, DWORD aStartTime, int aTimeout);
+
+//
+// SharedQueue - Bounded thread-safe FIFO queue (ring buffer) for producers/consumers in any thread.
+//
+
+class SharedQueue : public ObjectBase
+{
+	struct Item
+	{
+		union {
+			__int64 n_int64;	// for SYM_INTEGER
+			double n_double;	// for SYM_FLOAT
+			IObject *object;	// for SYM_OBJECT
+			LPTSTR marker;		// for SYM_STRING; owned by the item.
+		};
+		size_t length;			// for SYM_STRING
+		SymbolType symbol;
+	};
+
+	Item *mItems;
+	int mCapacity, mHead, mCount; // mHead is the index of the oldest item.
+	int mPushWaiters, mPopWaiters;
+	bool mClosed;
+	CRITICAL_SECTION mCriSec; // Held only while the ring buffer itself is accessed.
+	HANDLE mNotFull, mNotEmpty; // Auto-reset events, set only while there are waiters.
+
+	SharedQueue() : mItems(NULL), mCapacity(0), mHead(0), mCount(0), mPushWaiters(0), mPopWaiters(0)
+		, mClosed(false), mNotFull(NULL), mNotEmpty(NULL)
+	{
+		InitializeCriticalSection(&mCriSec);
+	}
+	~SharedQueue();
+
+public:
+	enum { MAX_CAPACITY = 0x1000000 }; // Keeps the size of mItems well within range of size_t.
+	static SharedQueue *Create(int aCapacity);
+	// aTimeout: 0 to fail immediately, -1 to wait indefinitely, otherwise milliseconds.
+	bool Push(ExprTokenType &aValue, int aTimeout, bool &aOutOfMem);
+	bool Pop(ExprTokenType &aResultToken, int aTimeout);
+	void Close();
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("SharedQueue")
+};
+
+//
+// AsyncResult - Result of a call which completes in another thread (a "future").
+//
+
+typedef void (CALLBACK *AsyncCallbackType)(UINT_PTR aHandle, void *aParam);
+
+class AsyncResult : public ObjectBase
+{
+	HANDLE mDone; // Manual-reset event, set once the result is available.
+	volatile LONG mState; // One of the values below.
+	enum { PENDING, COMPLETING, DONE };
+	SymbolType mSymbol; // SYM_STRING, SYM_INTEGER or SYM_FLOAT.
+	union {
+		__int64 mInt64;
+		double mDouble;
+		LPTSTR mString; // Owned by this object.
+	};
+	LPTSTR mError; // Owned by this object.
+	bool mFailed;
+	AsyncCallbackType volatile mCallback; // Called once by whichever of EndComplete and SetCallback sees it last.
+	void *mCallbackParam;
+	LabelRef mScriptCallback; // See SetScriptCallback.
+	AsyncResult *mNextPending; // Next in the list of script callbacks waiting for the script to be interruptible.
+	static AsyncResult *sFirstPending, *sLastPending;
+
+	AsyncResult() : mDone(NULL), mState(PENDING), mSymbol(SYM_STRING), mString(NULL), mError(NULL), mFailed(false)
+		, mCallback(NULL), mCallbackParam(NULL) {}
+	~AsyncResult();
+	bool BeginComplete() { return InterlockedCompareExchange(&mState, COMPLETING, PENDING) == PENDING; }
+	void EndComplete();
+	void CallCallback();
+	static void CALLBACK PostScriptCallback(UINT_PTR aHandle, void *aParam);
+	static void CALLBACK RetryScriptCallbacks(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime);
+	void ExecuteScriptCallback();
+
+public:
+	static AsyncResult *Create();
+	// Each of these may be called from any thread, but only the first call has any effect.
+	void Complete(ExprTokenType &aValue);
+	void Complete(LPCTSTR aValue);
+	void CompleteOwned(LPTSTR aValue); // Takes ownership of a malloc'd string; frees it if already complete.
+	bool Fail(LPCTSTR aError); // Returns false if the result was already available.
+	bool Cancel() { return Fail(_T("Cancelled.")); }
+
+	bool IsDone() { return mState == DONE; }
+	bool Wait(int aTimeout);
+	HANDLE DoneEvent() { return mDone; }
+	void SetCallback(AsyncCallbackType aCallback, void *aParam);
+	// Calls aCallback(this) in a new script thread once the result is available.  Must be called on the script's thread.
+	void SetScriptCallback(IObject *aCallback);
+	void CallScriptCallback();
+	static void FreePendingCallbacks(); // Called when the script is destroyed.
+	void GetValue(ExprTokenType &aResultToken);
+	void PeekValue(ExprTokenType &aToken); // aToken is valid only while this object exists.
+	bool Failed() { return mFailed; }
+	LPCTSTR GetError() { return mFailed ? (mError ? mError : ERR_OUTOFMEM) : NULL; }
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("AsyncResult")
+};
+
+//
+// InstancePool - Runs function calls in a number of AutoHotkey.dll instances loaded from one image.
+//
+
+#define POOL_MAX_PARAMS 10 // Limited by ahkPostFunctionAsync.
+#define POOL_WAIT_SLICE 100 // How often a worker waiting for a call checks whether the pool is closing, in milliseconds.
+
+class InstancePool : public ObjectBase
+{
+	typedef UINT_PTR (*ahkPostFunctionAsyncType)(LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR, LPTSTR);
+	typedef int (*ahkAsyncWaitType)(UINT_PTR, int);
+	typedef int (*ahkAsyncResultType)(UINT_PTR, VARIANT *);
+	typedef void (*ahkAsyncFreeType)(UINT_PTR);
+	typedef UINT_PTR (*ahktextdllType)(LPTSTR, LPTSTR, LPTSTR);
+	typedef int (*ahkTerminateType)(int);
+
+	struct Task
+	{
+		Task *mNext, *mPrev;
+		AsyncResult *mResult;
+		int mParamCount;
+		LPTSTR mFunc;
+		LPTSTR mParam[POOL_MAX_PARAMS];
+	};
+
+	struct Worker
+	{
+		InstancePool *mPool;
+		HMEMORYMODULE mModule;
+		ahkPostFunctionAsyncType mPost;
+		ahkAsyncWaitType mWait;
+		ahkAsyncResultType mResult;
+		ahkAsyncFreeType mFree;
+		HANDLE mThread;
+		HANDLE mWake; // Auto-reset event set when work may be available for this worker.
+		Task *mHead, *mTail; // This worker's own queue; others steal from the tail.
+		int mQueued;
+		bool mIdle;
+	};
+
+	Worker *mWorkers;
+	int mWorkerCount;
+	CRITICAL_SECTION mCriSec; // Guards the queues, never held during a call.
+	bool mStopping;
+	HANDLE mStop; // Manual-reset event set when workers must abandon calls in progress.
+
+	InstancePool() : mWorkers(NULL), mWorkerCount(0), mStopping(false), mStop(NULL)
+	{
+		InitializeCriticalSection(&mCriSec);
+	}
+	~InstancePool();
+
+	static unsigned __stdcall WorkerProc(void *aWorker);
+	Task *TakeTask(Worker &aWorker);
+	static void Unlink(Worker &aWorker, Task *aTask);
+	static void FreeTask(Task *aTask);
+
+public:
+	static InstancePool *Create(LPTSTR aScript, int aCount, LPTSTR aDllFile, LPTSTR &aError);
+	AsyncResult *Submit(LPTSTR aFunc, ExprTokenType *aParam[], int aParamCount);
+
+	ResultType STDMETHODCALLTYPE Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount);
+	IObject_Type_Impl("InstancePool")
+};
+
 //
 // Struct - Scriptable associative array.
 //
@@ -520,9 +873,22 @@ protected:
 		Var *mVarRef;			// Reference to a variable containing the definition
 		LPTSTR key;				// Name of field
 	};
+
+	// Immutable part of a parsed definition, shared by a structure and all of its clones.
+	// It owns the field names and a hash index of them so FindField does not need to scan.
+	struct Layout
+	{
+		ULONG mRefCount;
+		IndexType mKeyCount;	// Number of keys owned by the layout
+		IndexType mMask;		// Number of hash slots - 1, slot count is a power of 2
+		IndexType *mSlot;		// Field index + 1 for each slot, 0 if empty
+		LPTSTR *mKey;			// Field names
+	};
 	
 	FieldType *mFields;
 	IndexType mFieldCount, mFieldCountMax; // Current/max number of fields.
+	Layout *mLayout;			// NULL until the definition was parsed completely
+	IndexType mLastField;		// Index of field found by last FindField call or -1
 
 	// for loop enumerator
 	class Enumerator : public EnumBase
@@ -541,7 +907,7 @@ protected:
 #endif
 
 	Struct()
-		: mFields(NULL), mFieldCount(0), mFieldCountMax(0), mTypeOnly(false)
+		: mFields(NULL), mFieldCount(0), mFieldCountMax(0), mLayout(NULL), mLastField(-1), mTypeOnly(false)
 		, mStructMem(0), mSize(0), mIsPointer(0), mIsInteger(true), mIsUnsigned(true)
 		, mEncoding(-1), mArraySize(0), mMemAllocated(false), mVarRef(NULL)
 	{}
@@ -550,6 +916,12 @@ protected:
 	~Struct();
 
 	FieldType *FindField(LPTSTR val);
+	static UINT HashField(LPCTSTR aKey);
+	bool BuildLayout();
+	static void ReleaseLayout(Layout *aLayout);
+	Struct *ItemType(size_t &aItemSize);
+	BYTE *ItemsAddress() { return (BYTE *)(mIsPointer ? *mStructMem : (UINT_PTR)mStructMem); }
+	ResultType InvokeItems(LPTSTR aName, FieldType *aField, ExprTokenType &aResultToken, ExprTokenType *aParam[], int aParamCount);
 	FieldType *Insert(LPTSTR key, IndexType &at,USHORT aIspointer,int aOffset,int aArrsize,Var *variableref,int aFieldsize,bool aIsinteger,bool aIsunsigned,USHORT aEncoding, BYTE aBitSize, BYTE aBitField);
 	bool SetInternalCapacity(IndexType new_capacity);
 	bool Expand()
@@ -571,6 +943,7 @@ public:
 	Var *mVarRef;				// Reference to a variable containing the definition
 
 	static Struct *Create(ExprTokenType *aParam[] = NULL, int aParamCount = 0);
+	static void FreeLayoutCache();
 	
 	Struct *Clone(bool aIsDynamic = false);
 	Struct *CloneField(FieldType *field,bool aIsDynamic = false);
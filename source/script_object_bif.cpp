@@ -951,7 +951,8 @@ BIF_DECL(BIF_ObjDump)
 {
 	aResultToken.symbol = SYM_INTEGER;
 	IObject *aObject;
-	if (!(aObject = TokenToObject(*aParam[1])) && !(aObject = TokenToObject(*aParam[0])))
+	BufferObject *out_buf = TokenToBuffer(*aParam[1]); // ObjDump(obj, Buffer [, ...]) rather than ObjDump(path, obj) or ObjDump(obj, OutVar).
+	if ((out_buf || !(aObject = TokenToObject(*aParam[1]))) && !(aObject = TokenToObject(*aParam[0])))
 	{
 		aResultToken.symbol = SYM_STRING;
 		aResultToken.marker = _T("");
@@ -995,21 +996,23 @@ BIF_DECL(BIF_ObjDump)
 		DWORD aCompressedSize = CompressBuffer((BYTE*)aBuffer, aDataBuf, aSize, pw);
 		if (aCompressedSize)
 		{
+			// CompressBuffer's output is malloc'd, so it can be used directly.
 			free(aBuffer);
-			aBuffer = (char*)malloc(aCompressedSize);
-			if (!aBuffer)
-			{
-				g_script.ScriptError(ERR_OUTOFMEM);
-				aResultToken.symbol = SYM_STRING;
-				aResultToken.marker = _T("");
-				return;
-			}
-			memcpy(aBuffer, aDataBuf, aSize = aCompressedSize);
-			VirtualFree(aDataBuf, 0, MEM_RELEASE);
+			aBuffer = (char*)aDataBuf;
+			aSize = aCompressedSize;
 		}
 	}
 	aResultToken.value_int64 = aSize;
-	if (TokenToObject(*aParam[1]))
+	if (out_buf)
+	{ // The Buffer takes ownership of the data.
+		if (!out_buf->SetData(aBuffer, aSize))
+		{
+			g_script.ScriptError(ERR_BUFFER_NOT_RESIZABLE);
+			aResultToken.symbol = SYM_STRING;
+			aResultToken.marker = _T("");
+		}
+	}
+	else if (TokenToObject(*aParam[1]))
 	{ // FileWrite mode
 		FILE *hFile = _tfopen(TokenToString(*aParam[0]), _T("wb"));
 		if (!hFile)
@@ -1261,7 +1264,19 @@ BIF_DECL(BIF_ObjLoad)
 	DWORD aSize = aParamCount > 1 ? (DWORD)TokenToInt64(*aParam[1]) : 0;
 	LPTSTR aPath = TokenToString(*aParam[0]);
 	char *aBuffer = (char *)TokenToInt64(*aParam[0]);
-	if (!aBuffer)
+	if (BufferObject *source_buf = TokenToBuffer(*aParam[0]))
+	{
+		aBuffer = (char *)source_buf->Data();
+		if (ParamIndexIsOmittedOrEmpty(1))
+			aSize = (DWORD)source_buf->Size();
+		if (!aBuffer || source_buf->Size() > MAXDWORD) // Too large for the DWORD sizes used below.
+		{
+			aResultToken.symbol = SYM_STRING;
+			aResultToken.marker = _T("");
+			return;
+		}
+	}
+	else if (!aBuffer)
 	{ // FileRead Mode
 		if (GetFileAttributes(aPath) == 0xFFFFFFFF)
 		{
@@ -1314,7 +1329,7 @@ BIF_DECL(BIF_ObjLoad)
 	IObject **aObjects = (IObject**)malloc(aObjSize * sizeof(IObject**));
 	if (!aObjects || !(aResultToken.object = ObjRawLoad(aBuffer, aObjects, aObjCount, aObjSize)))
 	{
-		if (!TokenToInt64(*aParam[0]))
+		if (aFreeBuffer)
 			free(aBuffer);
 		free(aObjects);
 		aResultToken.symbol = SYM_STRING;
@@ -1382,6 +1397,187 @@ BIF_DECL(BIF_ObjArray)
 }
 	
 
+//
+// BIF_ObjFreeze - ObjFreeze(obj): Returns an immutable deep copy of obj which any thread may read without locking.
+//
+
+BIF_DECL(BIF_ObjFreeze)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	Object *obj = dynamic_cast<Object*>(TokenToObject(*aParam[0]));
+	if (!obj)
+	{
+		aResult = g_script.ScriptError(ERR_PARAM1_INVALID);
+		return;
+	}
+	LPTSTR error;
+	FrozenObject *frozen = FrozenObject::Freeze(obj, error);
+	if (!frozen)
+	{
+		aResult = g_script.ScriptError(error);
+		return;
+	}
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = frozen;
+}
+
+
+//
+// BIF_SnapshotSlot - SnapshotSlot([obj]): Creates a slot for publishing versions of a frozen object.
+//
+
+BIF_DECL(BIF_SnapshotSlot)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	FrozenObject *value = NULL;
+	if (aParamCount)
+	{
+		Object *obj = dynamic_cast<Object*>(TokenToObject(*aParam[0]));
+		LPTSTR error = ERR_PARAM1_INVALID;
+		if (!obj || !(value = FrozenObject::Freeze(obj, error)))
+		{
+			aResult = g_script.ScriptError(error);
+			return;
+		}
+	}
+	SnapshotSlot *slot = SnapshotSlot::Create();
+	if (!slot)
+	{
+		if (value)
+			value->Release();
+		aResult = g_script.ScriptError(ERR_OUTOFMEM);
+		return;
+	}
+	if (value)
+	{
+		slot->Exchange(value, NULL, false); // Returns NULL since the slot is new.
+		value->Release();
+	}
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = slot;
+}
+
+
+//
+// BIF_SharedQueue - SharedQueue([Capacity := 1024]): Creates a bounded queue which may be shared between threads.
+//
+
+BIF_DECL(BIF_SharedQueue)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	__int64 capacity = ParamIndexToOptionalInt64(0, 1024);
+	if (capacity < 1 || capacity > SharedQueue::MAX_CAPACITY)
+	{
+		aResult = g_script.ScriptError(ERR_PARAM1_INVALID);
+		return;
+	}
+	SharedQueue *queue = SharedQueue::Create((int)capacity);
+	if (!queue)
+	{
+		aResult = g_script.ScriptError(ERR_OUTOFMEM);
+		return;
+	}
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = queue;
+}
+
+
+//
+// BIF_Buffer - Buffer([Size := 0, FillByte]): Creates a block of binary data.
+//
+
+BIF_DECL(BIF_Buffer)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	__int64 size = ParamIndexToOptionalInt64(0, 0);
+	if (size < 0 || (unsigned __int64)size > (size_t)-1)
+	{
+		aResult = g_script.ScriptError(ERR_PARAM1_INVALID);
+		return;
+	}
+	BufferObject *buffer = BufferObject::Create((size_t)size);
+	if (!buffer)
+	{
+		aResult = g_script.ScriptError(ERR_OUTOFMEM);
+		return;
+	}
+	if (!ParamIndexIsOmittedOrEmpty(1))
+		memset(buffer->Data(), (int)(char)ParamIndexToInt64(1), (size_t)size);
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = buffer;
+}
+
+
+//
+// BIF_NumView - NumView(Type, Target [, Offset := 0, Length]): Creates a view of an array of numbers.
+// Target is a Buffer or an address.  Length defaults to as many items as fit in the rest of the Buffer,
+// but is required for an address.
+//
+
+BIF_DECL(BIF_NumView)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	int num_type = ConvertNumType(ParamIndexToString(0, aResultToken.buf));
+	if (num_type & NUMTYPE_UNKNOWN)
+	{
+		aResult = g_script.ScriptError(ERR_PARAM1_INVALID);
+		return;
+	}
+	size_t item_size = num_type & NUMTYPE_SIZE_MASK;
+	__int64 offset = ParamIndexToOptionalInt64(2, 0);
+	__int64 length = ParamIndexIsOmittedOrEmpty(3) ? -1 : ParamIndexToInt64(3);
+	size_t start, max_count;
+
+	BufferObject *buffer = TokenToBuffer(*aParam[1]);
+	if (buffer)
+	{
+		if (offset < 0 || (unsigned __int64)offset > buffer->Size())
+		{
+			aResult = g_script.ScriptError(ERR_PARAM3_INVALID);
+			return;
+		}
+		start = (size_t)offset;
+		max_count = (buffer->Size() - start) / item_size;
+		if (length == -1)
+			length = max_count;
+	}
+	else
+	{
+		start = (size_t)ParamIndexToInt64(1) + (ptrdiff_t)offset;
+		if (start < 65536) // Basic sanity check, as in NumGet.
+		{
+			aResult = g_script.ScriptError(ERR_PARAM2_INVALID);
+			return;
+		}
+		max_count = ((size_t)-1 - start) / item_size;
+	}
+	if (length < 0 || (unsigned __int64)length > max_count)
+	{
+		aResult = g_script.ScriptError(ERR_PARAM4_INVALID);
+		return;
+	}
+
+	NumViewObject *view = NumViewObject::Create(num_type, buffer, start, (size_t)length);
+	if (!view)
+	{
+		aResult = g_script.ScriptError(ERR_OUTOFMEM);
+		return;
+	}
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = view;
+}
+
+
 //
 // BIF_IsObject - IsObject(obj)
 //
@@ -1687,6 +1883,8 @@ ResultType BIF_ObjMethod(int aID, ExprTokenType &aResultToken, ExprTokenType *aP
 	Object *obj = dynamic_cast<Object*>(TokenToObject(*aParam[0]));
 	if (!obj)
 		return OK; // Return "".
+	if (FrozenObject::IsMutator(aID) && dynamic_cast<FrozenObject*>(obj))
+		return g_script.ScriptError(ERR_OBJECT_FROZEN);
 	return obj->CallBuiltin(aID, aResultToken, aParam + 1, aParamCount - 1);
 }
 
@@ -1764,6 +1962,11 @@ BIF_DECL(BIF_ObjRawSet)
 		aResult = g_script.ScriptError(ERR_PARAM1_INVALID);
 		return;
 	}
+	if (dynamic_cast<FrozenObject*>(obj))
+	{
+		aResult = g_script.ScriptError(ERR_OBJECT_FROZEN);
+		return;
+	}
 	if (!obj->SetItem(*aParam[1], *aParam[2]))
 		aResult = g_script.ScriptError(ERR_OUTOFMEM);
 	
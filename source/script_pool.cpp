@@ -0,0 +1,690 @@
+#include "stdafx.h" // pre-compiled headers
+#include "defines.h"
+#include "application.h"
+#include "globaldata.h"
+#include "script.h"
+#include <process.h>
+
+#include "script_object.h"
+#include "script_func_impl.h"
+
+
+//
+// AsyncResult
+//
+
+AsyncResult *AsyncResult::Create()
+{
+	AsyncResult *result = new AsyncResult;
+	if (  !(result->mDone = CreateEvent(NULL, TRUE, FALSE, NULL))  )
+	{
+		delete result;
+		return NULL;
+	}
+	return result;
+}
+
+AsyncResult::~AsyncResult()
+{
+	if (mSymbol == SYM_STRING)
+		free(mString);
+	free(mError);
+	if (mDone)
+		CloseHandle(mDone);
+}
+
+void AsyncResult::EndComplete()
+{
+	mState = DONE;
+	SetEvent(mDone); // Full barrier, so the value is visible to whichever thread sees the event.
+	CallCallback();
+}
+
+void AsyncResult::CallCallback()
+{
+	// The exchange ensures the callback is called only once even if SetCallback races with EndComplete.
+	AsyncCallbackType callback = (AsyncCallbackType)InterlockedExchangePointer((PVOID volatile *)&mCallback, NULL);
+	if (callback)
+		callback((UINT_PTR)this, mCallbackParam);
+}
+
+void AsyncResult::SetCallback(AsyncCallbackType aCallback, void *aParam)
+// Calls aCallback when the result becomes available: immediately on this thread if it already is,
+// otherwise on the thread which completes it.
+{
+	mCallbackParam = aParam;
+	InterlockedExchangePointer((PVOID volatile *)&mCallback, aCallback);
+	if (IsDone())
+		CallCallback();
+}
+
+void AsyncResult::Complete(ExprTokenType &aValue)
+// Objects can't be passed between instances, so are stored as "".
+{
+	if (!BeginComplete())
+		return;
+	ExprTokenType temp, *value = &aValue;
+	if (aValue.symbol == SYM_VAR)
+	{
+		aValue.var->TokenToContents(temp);
+		value = &temp;
+	}
+	switch (value->symbol)
+	{
+	case SYM_INTEGER:
+	case SYM_FLOAT:
+		mSymbol = value->symbol;
+		mInt64 = value->value_int64; // Union copy.
+		break;
+	case SYM_OBJECT:
+		mSymbol = SYM_STRING;
+		mString = _tcsdup(_T(""));
+		if (value == &temp)
+			temp.object->Release();
+		break;
+	default:
+		mSymbol = SYM_STRING;
+		mString = _tcsdup(TokenToString(*value));
+	}
+	EndComplete();
+}
+
+void AsyncResult::Complete(LPCTSTR aValue)
+{
+	if (!BeginComplete())
+		return;
+	mString = aValue ? _tcsdup(aValue) : NULL;
+	EndComplete();
+}
+
+void AsyncResult::CompleteOwned(LPTSTR aValue)
+// Avoids copying large strings, such as the result of File.ReadAsync().
+{
+	if (!BeginComplete())
+	{
+		free(aValue);
+		return;
+	}
+	mString = aValue;
+	EndComplete();
+}
+
+bool AsyncResult::Fail(LPCTSTR aError)
+{
+	if (!BeginComplete())
+		return false;
+	mFailed = true;
+	mError = _tcsdup(aError); // If out of memory, mFailed still reports the failure.
+	EndComplete();
+	return true;
+}
+
+void AsyncResult::SetScriptCallback(IObject *aCallback)
+{
+	mScriptCallback = aCallback;
+	SetCallback(PostScriptCallback, NULL);
+}
+
+void CALLBACK AsyncResult::PostScriptCallback(UINT_PTR aHandle, void *aParam)
+// Called on whichever thread completes the result.  The message keeps the result alive until it is handled.
+{
+	AsyncResult *result = (AsyncResult *)aHandle;
+	result->AddRef();
+	if (!PostMessage(g_hWnd, AHK_ASYNC_CALLBACK, (WPARAM)result, 0))
+		result->Release(); // The script is probably exiting.
+}
+
+AsyncResult *AsyncResult::sFirstPending = NULL;
+AsyncResult *AsyncResult::sLastPending = NULL;
+
+static inline bool CanCallScriptCallback()
+{
+	return INTERRUPTIBLE_IN_EMERGENCY && g_nThreads < g_MaxThreadsTotal;
+}
+
+void AsyncResult::CallScriptCallback()
+// Called by MainWindowProc on the script's thread.
+{
+	if (!CanCallScriptCallback() || sFirstPending) // sFirstPending: Keep the callbacks in order.
+	{
+		// Try again later rather than losing the callback.  Re-posting the message would make the message
+		// loop spin while the script is busy, so instead queue it for a timer to retry periodically.
+		mNextPending = NULL;
+		if (sLastPending)
+			sLastPending->mNextPending = this;
+		else
+			sFirstPending = this;
+		sLastPending = this;
+		SetTimer(g_hWnd, TIMER_ID_ASYNC_CALLBACK, SLEEP_INTERVAL, RetryScriptCallbacks);
+		return;
+	}
+	ExecuteScriptCallback();
+}
+
+VOID CALLBACK AsyncResult::RetryScriptCallbacks(HWND hWnd, UINT uMsg, UINT_PTR idEvent, DWORD dwTime)
+{
+	while (sFirstPending && CanCallScriptCallback())
+	{
+		AsyncResult *result = sFirstPending;
+		if (  !(sFirstPending = result->mNextPending)  )
+			sLastPending = NULL;
+		result->ExecuteScriptCallback();
+	}
+	if (!sFirstPending)
+		KillTimer(g_hWnd, TIMER_ID_ASYNC_CALLBACK);
+}
+
+void AsyncResult::FreePendingCallbacks()
+{
+	KillTimer(g_hWnd, TIMER_ID_ASYNC_CALLBACK);
+	while (sFirstPending)
+	{
+		AsyncResult *result = sFirstPending;
+		sFirstPending = result->mNextPending;
+		result->Release();
+	}
+	sLastPending = NULL;
+}
+
+void AsyncResult::ExecuteScriptCallback()
+{
+	// See MsgSleep() for comments about the following section.
+	TCHAR ErrorLevel_saved[ERRORLEVEL_SAVED_SIZE];
+	tcslcpy(ErrorLevel_saved, g_ErrorLevel->Contents(), _countof(ErrorLevel_saved));
+	InitNewThread(0, false, true, mScriptCallback->TypeOfFirstLine());
+	g_script.mLastScriptRest = g_script.mLastPeekTime = GetTickCount();
+	ExprTokenType param;
+	param.symbol = SYM_OBJECT;
+	param.object = this;
+	mScriptCallback->ExecuteInNewThread(_T("AsyncResult"), &param, 1);
+	ResumeUnderlyingThread(ErrorLevel_saved);
+	Release(); // Balances the AddRef in PostScriptCallback.
+}
+
+bool AsyncResult::Wait(int aTimeout)
+// Returns true if the result is available.  aTimeout < 0 means wait indefinitely.
+{
+	DWORD start_time = GetTickCount();
+	while (!IsDone())
+		if (!MsgWaitForEvent(mDone, start_time, aTimeout))
+			return false;
+	return true;
+}
+
+void AsyncResult::GetValue(ExprTokenType &aResultToken)
+// Caller has ensured the result is available and the call did not fail.
+{
+	if (mSymbol != SYM_STRING)
+	{
+		aResultToken.symbol = mSymbol;
+		aResultToken.value_int64 = mInt64; // Union copy.
+	}
+	else if (mString)
+		TokenSetResult(aResultToken, mString);
+}
+
+void AsyncResult::PeekValue(ExprTokenType &aToken)
+{
+	aToken.symbol = mSymbol;
+	if (mSymbol != SYM_STRING)
+		aToken.value_int64 = mInt64; // Union copy.
+	else
+		aToken.marker = mString ? mString : _T("");
+}
+
+ResultType STDMETHODCALLTYPE AsyncResult::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Wait([Timeout := -1]): Returns true if the call has completed, or false on timeout.
+// Value: Waits for the call to complete and returns its result, or throws if it failed.
+// Cancel(): Marks the call as failed if it hasn't completed.  Returns true if it was cancelled.
+// Ready, Error.
+{
+	if (!aParamCount || IS_INVOKE_SET)
+		return INVOKE_NOT_HANDLED;
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (!_tcsicmp(name, _T("Wait")))
+	{
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = Wait(ParamIndexToOptionalInt(0, -1));
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Cancel")))
+	{
+		// Causes Value to throw and Error to return "Cancelled." unless the result was already
+		// available.  Whether any work in progress stops early depends on what produces the result.
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = Cancel();
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Ready")))
+	{
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = IsDone();
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Error")))
+	{
+		if (IsDone() && mFailed)
+			TokenSetResult(aResultToken, mError ? mError : ERR_OUTOFMEM);
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Value")))
+	{
+		Wait(-1);
+		if (mFailed)
+			return g_script.ThrowRuntimeException(mError ? mError : ERR_OUTOFMEM, _T("AsyncResult.Value"));
+		GetValue(aResultToken);
+		return OK;
+	}
+	return INVOKE_NOT_HANDLED;
+}
+
+
+//
+// InstancePool
+//
+
+InstancePool *InstancePool::Create(LPTSTR aScript, int aCount, LPTSTR aDllFile, LPTSTR &aError)
+{
+	FILE *fp = _tfopen(aDllFile, _T("rb"));
+	if (!fp)
+	{
+		aError = _T("Could not open the dll.");
+		return NULL;
+	}
+	fseek(fp, 0, SEEK_END);
+	size_t size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	// The image is read only once; each instance is mapped from the same copy.
+	unsigned char *image = (unsigned char *)malloc(size);
+	if (image && fread(image, 1, size, fp) != size)
+	{
+		free(image);
+		image = NULL;
+	}
+	fclose(fp);
+	if (!image)
+	{
+		aError = _T("Could not read the dll.");
+		return NULL;
+	}
+
+	InstancePool *pool = new InstancePool;
+	if (   !(pool->mWorkers = (Worker *)calloc(aCount, sizeof(Worker)))
+		|| !(pool->mStop = CreateEvent(NULL, TRUE, FALSE, NULL))   )
+	{
+		free(image);
+		pool->Release();
+		aError = ERR_OUTOFMEM;
+		return NULL;
+	}
+	aError = NULL;
+	for (int i = 0; i < aCount; ++i)
+	{
+		Worker &worker = pool->mWorkers[i];
+		worker.mPool = pool;
+		worker.mIdle = true;
+		if (  !(worker.mModule = MemoryLoadLibrary(image, size))  )
+		{
+			aError = _T("Could not load the dll.");
+			break;
+		}
+		++pool->mWorkerCount; // Include it in clean-up from here on.
+		ahktextdllType ahktextdll = (ahktextdllType)MemoryGetProcAddress(worker.mModule, "ahktextdll");
+		worker.mPost = (ahkPostFunctionAsyncType)MemoryGetProcAddress(worker.mModule, "ahkPostFunctionAsync");
+		worker.mWait = (ahkAsyncWaitType)MemoryGetProcAddress(worker.mModule, "ahkAsyncWait");
+		worker.mResult = (ahkAsyncResultType)MemoryGetProcAddress(worker.mModule, "ahkAsyncResult");
+		worker.mFree = (ahkAsyncFreeType)MemoryGetProcAddress(worker.mModule, "ahkAsyncFree");
+		if (!ahktextdll || !worker.mPost || !worker.mWait || !worker.mResult || !worker.mFree)
+		{
+			aError = _T("The dll does not export the required functions.");
+			break;
+		}
+		if (!ahktextdll(aScript, _T(""), _T("")))
+		{
+			aError = _T("Could not start the script.");
+			break;
+		}
+		if (   !(worker.mWake = CreateEvent(NULL, FALSE, FALSE, NULL))
+			|| !(worker.mThread = (HANDLE)_beginthreadex(NULL, 0, &WorkerProc, &worker, 0, NULL))   )
+		{
+			aError = _T("Could not start the worker thread.");
+			break;
+		}
+	}
+	free(image);
+	if (aError)
+	{
+		pool->Release();
+		return NULL;
+	}
+	return pool;
+}
+
+InstancePool::~InstancePool()
+{
+	EnterCriticalSection(&mCriSec);
+	mStopping = true;
+	for (int i = 0; i < mWorkerCount; ++i)
+	{
+		Worker &worker = mWorkers[i];
+		while (Task *task = worker.mHead)
+		{
+			Unlink(worker, task);
+			task->mResult->Fail(_T("Pool closed."));
+			FreeTask(task);
+		}
+		if (worker.mWake)
+			SetEvent(worker.mWake);
+	}
+	LeaveCriticalSection(&mCriSec);
+
+	// Give any calls in progress a chance to finish, then make the workers fail the calls which haven't.
+	// A call may never complete if its instance is busy, so the workers don't wait for it indefinitely.
+	// Messages are processed while waiting, as in AsyncResult::Wait.
+	DWORD start_time = GetTickCount();
+	for (int i = 0; i < mWorkerCount; ++i)
+		if (HANDLE thread = mWorkers[i].mThread)
+			while (WaitForSingleObject(thread, 0) == WAIT_TIMEOUT && MsgWaitForEvent(thread, start_time, 5000));
+	if (mStop)
+		SetEvent(mStop);
+	// Each worker abandons its call within POOL_WAIT_SLICE, but the instances mustn't be terminated
+	// until the workers have stopped using them.
+	for (int i = 0; i < mWorkerCount; ++i)
+		if (HANDLE thread = mWorkers[i].mThread)
+			while (WaitForSingleObject(thread, 0) == WAIT_TIMEOUT)
+				MsgWaitForEvent(thread, start_time, -1);
+	for (int i = 0; i < mWorkerCount; ++i)
+	{
+		ahkTerminateType ahkTerminate = (ahkTerminateType)MemoryGetProcAddress(mWorkers[i].mModule, "ahkTerminate");
+		if (ahkTerminate)
+			ahkTerminate(0);
+	}
+	for (int i = 0; i < mWorkerCount; ++i)
+	{
+		Worker &worker = mWorkers[i];
+		if (worker.mThread)
+			CloseHandle(worker.mThread);
+		if (worker.mWake)
+			CloseHandle(worker.mWake);
+		MemoryFreeLibrary(worker.mModule);
+	}
+	free(mWorkers);
+	if (mStop)
+		CloseHandle(mStop);
+	DeleteCriticalSection(&mCriSec);
+}
+
+void InstancePool::Unlink(Worker &aWorker, Task *aTask)
+// Caller must own mCriSec.
+{
+	if (aTask->mPrev)
+		aTask->mPrev->mNext = aTask->mNext;
+	else
+		aWorker.mHead = aTask->mNext;
+	if (aTask->mNext)
+		aTask->mNext->mPrev = aTask->mPrev;
+	else
+		aWorker.mTail = aTask->mPrev;
+	--aWorker.mQueued;
+}
+
+void InstancePool::FreeTask(Task *aTask)
+{
+	for (int i = 0; i < aTask->mParamCount; ++i)
+		free(aTask->mParam[i]);
+	free(aTask->mFunc);
+	aTask->mResult->Release();
+	free(aTask);
+}
+
+InstancePool::Task *InstancePool::TakeTask(Worker &aWorker)
+// Takes the oldest task from aWorker's own queue, or steals the newest task from the longest
+// queue of another worker.  Caller must own mCriSec.
+{
+	Task *task = aWorker.mHead;
+	Worker *from = &aWorker;
+	if (!task)
+	{
+		int longest = 0;
+		for (int i = 0; i < mWorkerCount; ++i)
+			if (mWorkers[i].mQueued > longest)
+			{
+				longest = mWorkers[i].mQueued;
+				from = &mWorkers[i];
+			}
+		if (!longest)
+			return NULL;
+		task = from->mTail;
+	}
+	Unlink(*from, task);
+	return task;
+}
+
+unsigned __stdcall InstancePool::WorkerProc(void *aWorker)
+{
+	Worker &worker = *(Worker *)aWorker;
+	InstancePool &pool = *worker.mPool;
+	for (;;)
+	{
+		EnterCriticalSection(&pool.mCriSec);
+		if (pool.mStopping)
+		{
+			LeaveCriticalSection(&pool.mCriSec);
+			break;
+		}
+		Task *task = pool.TakeTask(worker);
+		worker.mIdle = !task;
+		LeaveCriticalSection(&pool.mCriSec);
+		if (!task)
+		{
+			WaitForSingleObject(worker.mWake, INFINITE);
+			continue;
+		}
+		if (task->mResult->IsDone()) // Cancelled by the script before it started.
+		{
+			FreeTask(task);
+			continue;
+		}
+		LPTSTR param[POOL_MAX_PARAMS] = {0}; // Unused parameters must be NULL.
+		for (int i = 0; i < task->mParamCount; ++i)
+			param[i] = task->mParam[i];
+		UINT_PTR call = worker.mPost(task->mFunc, param[0], param[1], param[2], param[3], param[4]
+			, param[5], param[6], param[7], param[8], param[9]);
+		if (!call)
+			task->mResult->Fail(ERR_NONEXISTENT_FUNCTION);
+		else
+		{
+			// Keep this worker busy until the instance has finished, so that any further tasks
+			// queued for it can be stolen by idle workers in the meantime.  Wait in slices so
+			// that the call can be abandoned if the pool is closed before the instance runs it.
+			while (!worker.mWait(call, POOL_WAIT_SLICE))
+				if (WaitForSingleObject(pool.mStop, 0) == WAIT_OBJECT_0)
+					break;
+			VARIANT value;
+			VariantInit(&value);
+			int status = worker.mResult(call, &value);
+			worker.mFree(call);
+			if (!status) // Not completed, so the pool is closing.
+			{
+				task->mResult->Fail(_T("Pool closed."));
+				FreeTask(task);
+				break;
+			}
+			if (value.vt != VT_I8 && value.vt != VT_R8 && value.vt != VT_EMPTY)
+				VariantChangeType(&value, &value, 0, VT_BSTR);
+			if (status < 0)
+				task->mResult->Fail(value.vt == VT_BSTR ? (LPCTSTR)CStringTCharFromWCharIfNeeded(value.bstrVal) : _T(""));
+			else if (value.vt == VT_BSTR)
+				task->mResult->Complete((LPCTSTR)CStringTCharFromWCharIfNeeded(value.bstrVal));
+			else
+			{
+				ExprTokenType token;
+				if (value.vt == VT_I8)
+				{
+					token.symbol = SYM_INTEGER;
+					token.value_int64 = value.llVal;
+				}
+				else if (value.vt == VT_R8)
+				{
+					token.symbol = SYM_FLOAT;
+					token.value_double = value.dblVal;
+				}
+				else
+				{
+					token.symbol = SYM_STRING;
+					token.marker = _T("");
+				}
+				task->mResult->Complete(token);
+			}
+			VariantClear(&value);
+		}
+		FreeTask(task);
+	}
+	return 0;
+}
+
+AsyncResult *InstancePool::Submit(LPTSTR aFunc, ExprTokenType *aParam[], int aParamCount)
+// Returns NULL if out of memory.
+{
+	AsyncResult *result = AsyncResult::Create();
+	if (!result)
+		return NULL;
+	Task *task = (Task *)calloc(1, sizeof(Task));
+	if (!task)
+	{
+		result->Release();
+		return NULL;
+	}
+	task->mResult = result;
+	result->AddRef(); // One reference for the task, one for the caller.
+	task->mFunc = _tcsdup(aFunc);
+	// Copy the parameters now since the worker may not get to them until after the caller returns.
+	for (int i = 0; i < aParamCount; ++i, ++task->mParamCount)
+		if (  !(task->mParam[i] = _tcsdup(TokenToString(*aParam[i])))  )
+			break;
+	if (!task->mFunc || task->mParamCount < aParamCount)
+	{
+		FreeTask(task);
+		result->Release();
+		return NULL;
+	}
+
+	EnterCriticalSection(&mCriSec);
+	// Give the task to the worker with the least work; others may steal it if they become free first.
+	Worker *target = mWorkers;
+	int least = INT_MAX;
+	for (int i = 0; i < mWorkerCount; ++i)
+	{
+		int load = mWorkers[i].mQueued + !mWorkers[i].mIdle;
+		if (load < least)
+		{
+			least = load;
+			target = &mWorkers[i];
+		}
+	}
+	task->mNext = NULL;
+	task->mPrev = target->mTail;
+	if (target->mTail)
+		target->mTail->mNext = task;
+	else
+		target->mHead = task;
+	target->mTail = task;
+	++target->mQueued;
+	LeaveCriticalSection(&mCriSec);
+	SetEvent(target->mWake);
+	return result;
+}
+
+ResultType STDMETHODCALLTYPE InstancePool::Invoke(ExprTokenType &aResultToken, ExprTokenType &aThisToken, int aFlags, ExprTokenType *aParam[], int aParamCount)
+// Submit(FuncName, Params*): Queues a call and returns an AsyncResult.
+// Count, Pending.
+{
+	if (!aParamCount || IS_INVOKE_SET)
+		return INVOKE_NOT_HANDLED;
+
+	LPTSTR name = TokenToString(*aParam[0]);
+	--aParamCount;
+	++aParam;
+
+	if (!_tcsicmp(name, _T("Submit")))
+	{
+		if (!IS_INVOKE_CALL)
+			return INVOKE_NOT_HANDLED;
+		if (!aParamCount)
+			return g_script.ScriptError(ERR_TOO_FEW_PARAMS);
+		if (aParamCount - 1 > POOL_MAX_PARAMS)
+			return g_script.ScriptError(ERR_TOO_MANY_PARAMS);
+		for (int i = 0; i < aParamCount; ++i)
+			if (TokenToObject(*aParam[i]))
+				return g_script.ScriptError(ERR_INVALID_VALUE, _T("Objects can't be passed to another instance."));
+		AsyncResult *result = Submit(TokenToString(*aParam[0]), aParam + 1, aParamCount - 1);
+		if (!result)
+			return g_script.ScriptError(ERR_OUTOFMEM);
+		aResultToken.symbol = SYM_OBJECT;
+		aResultToken.object = result;
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Count")))
+	{
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = mWorkerCount;
+		return OK;
+	}
+	if (!_tcsicmp(name, _T("Pending")))
+	{
+		EnterCriticalSection(&mCriSec);
+		int pending = 0;
+		for (int i = 0; i < mWorkerCount; ++i)
+			pending += mWorkers[i].mQueued + !mWorkers[i].mIdle;
+		LeaveCriticalSection(&mCriSec);
+		aResultToken.symbol = SYM_INTEGER;
+		aResultToken.value_int64 = pending;
+		return OK;
+	}
+	return INVOKE_NOT_HANDLED;
+}
+
+
+//
+// BIF_InstancePool - InstancePool(Script [, Count, DllFile])
+//
+
+BIF_DECL(BIF_InstancePool)
+{
+	aResultToken.symbol = SYM_STRING;
+	aResultToken.marker = _T("");
+
+	int count = ParamIndexToOptionalInt(1, 0);
+	if (count <= 0)
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		count = si.dwNumberOfProcessors;
+	}
+	if (count > MAXIMUM_WAIT_OBJECTS)
+		count = MAXIMUM_WAIT_OBJECTS;
+
+	TCHAR dll_file[MAX_PATH];
+	if (ParamIndexIsOmittedOrEmpty(2))
+		sntprintf(dll_file, _countof(dll_file), _T("%s\\AutoHotkey.dll"), g_script.mOurEXEDir);
+	else
+		tcslcpy(dll_file, TokenToString(*aParam[2]), _countof(dll_file));
+
+	LPTSTR error;
+	InstancePool *pool = InstancePool::Create(TokenToString(*aParam[0]), count, dll_file, error);
+	if (!pool)
+	{
+		aResult = g_script.ScriptError(error, dll_file);
+		return;
+	}
+	aResultToken.symbol = SYM_OBJECT;
+	aResultToken.object = pool;
+}
@@ -6,6 +6,59 @@
 #include "TextIO.h"
 
 #include "script_object.h"
+#include "script_func_impl.h"
+
+// Parsed definitions which depend only on built-in types are kept here, keyed by their text,
+// so that creating another structure from the same definition only needs to clone the prototype.
+#define STRUCT_LAYOUT_CACHE_SIZE 256 // Must be a power of 2.
+static struct
+{
+	LPTSTR mDefinition;
+	Struct *mPrototype;
+} sLayoutCache[STRUCT_LAYOUT_CACHE_SIZE];
+
+//
+// StructAttachMemory - Assign given pointer or allocate memory for a new structure and initialize it.
+//
+
+static Struct *StructAttachMemory(Struct *obj, ExprTokenType *aParam[], int aParamCount)
+{
+	if (aParamCount > 1 && TokenIsPureNumeric(*aParam[1]))
+	{	// second parameter exist and it is digit assumme this is new pointer for our structure
+		obj->mStructMem = (UINT_PTR *)TokenToInt64(*aParam[1]);
+		obj->mMemAllocated = 0;
+	}
+	else // no pointer given so allocate memory and fill memory with 0
+	{	// setting the memory after parsing definition saves a call to BIF_sizeof
+		obj->mStructMem = (UINT_PTR *)malloc(obj->mSize);
+		obj->mMemAllocated = obj->mSize;
+		g_memset(obj->mStructMem, NULL, obj->mSize);
+	}
+
+	// an object was passed to initialize fields
+	// enumerate trough object and assign values
+	if ((aParamCount > 1 && !TokenIsPureNumeric(*aParam[1])) || aParamCount > 2 )
+		obj->ObjectToStruct(TokenToObject(*aParam[aParamCount - 1]));
+	return obj;
+}
+
+//
+// Struct::FreeLayoutCache - Release all cached prototypes, called when the script is destroyed.
+//
+
+void Struct::FreeLayoutCache()
+{
+	for (int i = 0; i < STRUCT_LAYOUT_CACHE_SIZE; i++)
+	{
+		if (sLayoutCache[i].mPrototype)
+		{
+			free(sLayoutCache[i].mDefinition);
+			sLayoutCache[i].mPrototype->Release();
+			sLayoutCache[i].mDefinition = NULL;
+			sLayoutCache[i].mPrototype = NULL;
+		}
+	}
+}
 
 //
 // Struct::Create - Called by BIF_ObjCreate to create a new object, optionally passing key/value pairs to set.
@@ -62,6 +115,9 @@ Struct *Struct::Create(ExprTokenType *aParam[], int aParamCount)
 	BYTE bitsizetotal = 0;
 	LPTSTR isBit;
 
+	UINT cache_slot;				// slot in sLayoutCache for this definition
+	bool cacheable = true;			// false if definition refers to a structure in a variable
+
 	FieldType *field;				// used to define a field
 	// Structure object is saved in fixed order
 	// insert_pos is simply increased each time
@@ -103,6 +159,19 @@ Struct *Struct::Create(ExprTokenType *aParam[], int aParamCount)
 	
 	// Set buf to beginning of structure definition
 	buf = TokenToString(*aParam[0]);
+
+	// Same definition was parsed before, clone the prototype instead of parsing it again
+	cache_slot = HashField(buf) & (STRUCT_LAYOUT_CACHE_SIZE - 1);
+	if (sLayoutCache[cache_slot].mPrototype && !_tcscmp(sLayoutCache[cache_slot].mDefinition, buf))
+	{
+		obj->Release();
+		if (!(obj = sLayoutCache[cache_slot].mPrototype->Clone()))
+		{
+			g_script.ScriptError(ERR_OUTOFMEM);
+			return NULL;
+		}
+		return StructAttachMemory(obj, aParam, aParamCount);
+	}
 	
 	// continue as long as we did not reach end of string / structure definition
 	while (*buf)
@@ -319,6 +388,7 @@ Struct *Struct::Create(ExprTokenType *aParam[], int aParamCount)
 		}
 		else // type was not found, check for user defined type in variables
 		{
+			cacheable = false;			// variable content can change so definition must be parsed each time
 			Var1.var = NULL;			// init to not found
 			Func *bkpfunc = NULL;
 			// check if we have a local/static declaration and resolve to function
@@ -499,23 +569,30 @@ Struct *Struct::Create(ExprTokenType *aParam[], int aParamCount)
 	}
 	
 	obj->mSize = offset;
-	if (aParamCount > 1 && TokenIsPureNumeric(*aParam[1]))
-	{	// second parameter exist and it is digit assumme this is new pointer for our structure
-		obj->mStructMem = (UINT_PTR *)TokenToInt64(*aParam[1]);
-		obj->mMemAllocated = 0;
-	}
-	else // no pointer given so allocate memory and fill memory with 0
-	{	// setting the memory after parsing definition saves a call to BIF_sizeof
-		obj->mStructMem = (UINT_PTR *)malloc(offset);
-		obj->mMemAllocated = offset;
-		g_memset(obj->mStructMem, NULL, offset);
+	// hand the field names over to a shared layout, if this fails FindField falls back to a linear search
+	obj->BuildLayout();
+	if (cacheable)
+	{	// keep a prototype without memory, it replaces any other definition that hashed to the same slot
+		Struct *prototype = obj->Clone();
+		LPTSTR definition = _tcsdup(TokenToString(*aParam[0]));
+		if (prototype && definition)
+		{
+			if (sLayoutCache[cache_slot].mPrototype)
+			{
+				free(sLayoutCache[cache_slot].mDefinition);
+				sLayoutCache[cache_slot].mPrototype->Release();
+			}
+			sLayoutCache[cache_slot].mDefinition = definition;
+			sLayoutCache[cache_slot].mPrototype = prototype;
+		}
+		else
+		{
+			if (prototype)
+				prototype->Release();
+			free(definition);
+		}
 	}
-
-	// an object was passed to initialize fields
-	// enumerate trough object and assign values
-	if ((aParamCount > 1 && !TokenIsPureNumeric(*aParam[1])) || aParamCount > 2 )
-		obj->ObjectToStruct(TokenToObject(*aParam[aParamCount - 1]));
-	return obj;
+	return StructAttachMemory(obj, aParam, aParamCount);
 }
 
 //
@@ -634,12 +711,15 @@ Struct::~Struct()
 			{
 				if (mFields[i].mMemAllocated > 0)
 					free(mFields[i].mStructMem);
-				free(mFields[i].key);
+				if (!mLayout) // otherwise keys are owned by the layout
+					free(mFields[i].key);
 			}
 		}
 		// Free fields array.
 		free(mFields);
 	}
+	if (mLayout)
+		ReleaseLayout(mLayout);
 }
 
 
@@ -720,13 +800,17 @@ Struct *Struct::Clone(bool aIsDynamic)
 	IndexType i;
 
 	obj.mFieldCount = mFieldCount;
+	if (obj.mLayout = mLayout)
+		++mLayout->mRefCount;
 	
 	for (i = 0; i < mFieldCount; ++i)
 	{
 		FieldType &dst = fields[i];
 		FieldType &src = mFields[i];
 
-		if ( !(dst.key = _tcsdup(src.key)) )
+		if (mLayout) // names are shared with the layout
+			dst.key = src.key;
+		else if ( !(dst.key = _tcsdup(src.key)) )
 		{
 			// Key allocation failed.
 			// Rather than trying to set up the object so that what we have
@@ -1302,6 +1386,8 @@ ResultType STDMETHODCALLTYPE Struct::Invoke(
 				objclone->Release();
 			return OK;
 		}
+		if (!releaseobj && (Result = InvokeItems(name, field, aResultToken, aParam, aParamCount)) != INVOKE_NOT_HANDLED)
+			return Result; // Column, CopyItems or FillItems
 		if (!_tcsicmp(name, _T("Clone")) || !_tcsicmp(name, _T("_New")))
 		{
 			if (!field)
@@ -1923,21 +2009,320 @@ ResultType STDMETHODCALLTYPE Struct::Invoke(
 	return INVOKE_NOT_HANDLED;
 }
 
+//
+// Struct::InvokeItems - Methods which operate on a range of items when the structure is an array.
+//
+
+// Returns the number of items which fit in the structure's array and the memory it allocated, or -1 if unknown.
+// It is unknown only if the structure is not an array and its memory is external (a pointer or an address
+// assigned by the script), since the size of that memory can't be determined.
+static __int64 StructItemCount(Struct &aStruct, size_t aItemSize)
+{
+	__int64 count = -1;
+	if (aStruct.mMemAllocated > 0 && !aStruct.mIsPointer) // The items are in memory the structure allocated.
+		count = (__int64)((size_t)aStruct.mMemAllocated / aItemSize);
+	if (aStruct.mArraySize && (count == -1 || count > aStruct.mArraySize))
+		count = aStruct.mArraySize;
+	return count;
+}
+
+// Validates 1-based aStart and sets aCount to the number of remaining items if it was omitted (-1).
+// If aItemCount is unknown (-1), aCount must be given and the range can't be checked.
+static bool StructItemRange(__int64 aItemCount, __int64 aStart, __int64 &aCount)
+{
+	if (aStart < 1 || (aItemCount != -1 && aStart > aItemCount + 1))
+		return false;
+	if (aCount == -1)
+	{
+		if (aItemCount == -1)
+			return false;
+		aCount = aItemCount - aStart + 1;
+	}
+	return aCount >= 0 && (aItemCount == -1 || aCount <= aItemCount - aStart + 1);
+}
+
+ResultType Struct::InvokeItems(LPTSTR aName, FieldType *aField, ExprTokenType &aResultToken, ExprTokenType *aParam[], int aParamCount)
+// Column([Field, Start := 1, Count]): Returns a NumView of Field in each item, which reads and writes the items directly.
+//    Field is omitted for an array of numbers, e.g. Struct("Int[10]").
+// CopyItems(Dest, Source [, Count := 1, SourceStruct]): Copies items within this array or from an array of items of the same size.
+// FillItems([Value := 0, Start := 1, Count]): Initializes the first item from object Value and copies it to the other items,
+//    or sets all bytes of the items to Value.
+// Count defaults to the remaining items.  If the structure is not an array and its memory is external (a pointer
+//    or an address assigned by the script), Count must be given and is not checked since the memory's size is unknown.
+{
+	enum { ITEMS_COLUMN, ITEMS_COPY, ITEMS_FILL } method;
+	if (!_tcsicmp(aName, _T("Column")))
+		method = ITEMS_COLUMN;
+	else if (!_tcsicmp(aName, _T("CopyItems")))
+		method = ITEMS_COPY;
+	else if (!_tcsicmp(aName, _T("FillItems")))
+		method = ITEMS_FILL;
+	else
+		return INVOKE_NOT_HANDLED;
+
+	if (mIsPointer > 1)
+		return g_script.ScriptError(ERR_STRUCT_ITEMS_ARE_POINTERS, aName);
+	if (!mStructMem || !ItemsAddress())
+		return g_script.ScriptError(ERR_MUST_INIT_STRUCT);
+	size_t item_size;
+	Struct *item_type = ItemType(item_size);
+	if (!item_type)
+		return FAIL; // Error was already displayed.
+	if (!item_size)
+	{
+		item_type->Release();
+		return g_script.ScriptError(ERR_INVALID_STRUCT, aName);
+	}
+
+	BYTE *items = ItemsAddress();
+	__int64 item_count = StructItemCount(*this, item_size);
+	ResultType result = OK;
+	__int64 start, count;
+	aResultToken.symbol = SYM_INTEGER;
+
+	if (method == ITEMS_COLUMN)
+	{
+		FieldType *field = aField, item_field;
+		if (!field) // else Invoke has found the field and excluded it from aParam
+		{
+			if (!ParamIndexIsOmittedOrEmpty(0))
+			{	// field of a structure defined in a variable
+				if (item_type != this && !item_type->mTypeOnly)
+					field = item_type->FindField(TokenToString(*aParam[0]));
+				if (!field)
+				{
+					item_type->Release();
+					return g_script.ScriptError(ERR_PARAM1_INVALID, TokenToString(*aParam[0]));
+				}
+			}
+			else if (item_type->mTypeOnly)
+			{	// array of numbers, the item itself is the field
+				field = &item_field;
+				item_field.mSize = (int)item_size;
+				item_field.mOffset = 0;
+				item_field.mBitSize = 0;
+				item_field.mIsInteger = item_type->mIsInteger;
+				item_field.mIsUnsigned = item_type->mIsUnsigned;
+				item_field.mEncoding = item_type->mEncoding;
+				item_field.mIsPointer = item_type == this ? 0 : item_type->mIsPointer; // this->mIsPointer was resolved by ItemsAddress
+				item_field.mArraySize = item_type == this ? 0 : item_type->mArraySize;
+				item_field.mVarRef = item_type == this ? NULL : item_type->mVarRef;
+			}
+			if (aParamCount) // exclude Field
+				++aParam, --aParamCount;
+		}
+		if (!field || field->mIsPointer || field->mArraySize || field->mVarRef || field->mBitSize || field->mEncoding != 65535
+			|| (field->mSize != 1 && field->mSize != 2 && field->mSize != 4 && field->mSize != 8))
+		{
+			item_type->Release();
+			return g_script.ScriptError(ERR_STRUCT_FIELD_NOT_NUMERIC, aName);
+		}
+		start = ParamIndexToOptionalInt64(0, 1);
+		count = ParamIndexIsOmittedOrEmpty(1) ? -1 : ParamIndexToInt64(1);
+		if (!StructItemRange(item_count, start, count))
+			result = g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+		else
+		{
+			int num_type = field->mSize | (field->mIsInteger ? 0 : NUMTYPE_FLOAT) | (field->mIsUnsigned ? NUMTYPE_UNSIGNED : 0);
+			size_t offset = (size_t)(start - 1) * item_size + field->mOffset;
+			// If the structure owns its memory, the view refers to it so it can check the current size on each access.
+			bool owned = mMemAllocated > 0 && !mIsPointer;
+			NumViewObject *view = NumViewObject::Create(num_type, owned ? this : NULL, owned ? offset : (size_t)items + offset, (size_t)count, item_size);
+			if (!view)
+				result = g_script.ScriptError(ERR_OUTOFMEM);
+			else
+			{
+				aResultToken.symbol = SYM_OBJECT;
+				aResultToken.object = view;
+			}
+		}
+	}
+	else if (method == ITEMS_COPY)
+	{
+		Struct *source = this;
+		if (!ParamIndexIsOmitted(3) && !(source = dynamic_cast<Struct *>(TokenToObject(*aParam[3]))))
+			result = g_script.ScriptError(ERR_PARAM4_INVALID);
+		else if (source != this && (source->mIsPointer > 1 || !source->mStructMem || !source->ItemsAddress()))
+			result = g_script.ScriptError(ERR_PARAM4_INVALID);
+		else
+		{
+			size_t source_item_size = item_size;
+			Struct *source_type = source == this ? NULL : source->ItemType(source_item_size);
+			__int64 dest = aParamCount ? ParamIndexToInt64(0) : 0;
+			__int64 from = aParamCount > 1 ? ParamIndexToInt64(1) : 0;
+			__int64 source_count;
+			count = ParamIndexToOptionalInt64(2, 1);
+			source_count = count;
+			if (source != this && !source_type)
+				result = FAIL; // Error was already displayed.
+			else if (source_item_size != item_size)
+				result = g_script.ScriptError(ERR_PARAM4_INVALID);
+			else if (count < 0 || !StructItemRange(item_count, dest, count) || !StructItemRange(StructItemCount(*source, item_size), from, source_count))
+				result = g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+			else
+			{	// memmove because the ranges may overlap when copying within this array
+				memmove(items + (size_t)(dest - 1) * item_size, source->ItemsAddress() + (size_t)(from - 1) * item_size, (size_t)count * item_size);
+				aResultToken.value_int64 = count;
+			}
+			if (source_type)
+				source_type->Release();
+		}
+	}
+	else // ITEMS_FILL
+	{
+		IObject *init = ParamIndexIsOmitted(0) ? NULL : TokenToObject(*aParam[0]);
+		start = ParamIndexToOptionalInt64(1, 1);
+		count = ParamIndexIsOmittedOrEmpty(2) ? -1 : ParamIndexToInt64(2);
+		if (!StructItemRange(item_count, start, count))
+			result = g_script.ScriptError(ERR_INDEX_OUT_OF_RANGE);
+		else if (init && item_type->mTypeOnly)
+			result = g_script.ScriptError(ERR_PARAM1_INVALID);
+		else if (count)
+		{
+			BYTE *first = items + (size_t)(start - 1) * item_size;
+			if (init)
+			{	// initialize first item as struct[start] := init would, then copy it to the other items
+				Struct *item = item_type->Clone(true);
+				if (!item)
+				{
+					item_type->Release();
+					return g_script.ScriptError(ERR_OUTOFMEM);
+				}
+				item->mStructMem = (UINT_PTR *)first;
+				item->mArraySize = 0;
+				item->mIsPointer = 0;
+				item->mSize = (int)item_size;
+				item->ObjectToStruct(init);
+				item->Release();
+				// each pass doubles the number of initialized items
+				for (size_t done = 1, todo; done < (size_t)count; done += todo)
+				{
+					todo = (size_t)count - done < done ? (size_t)count - done : done;
+					memcpy(first + done * item_size, first, todo * item_size);
+				}
+			}
+			else
+			{
+				int value = 0;
+				if (!ParamIndexIsOmitted(0))
+					value = TokenIsPureNumeric(*aParam[0]) ? (int)ParamIndexToInt64(0) : *ParamIndexToString(0, aResultToken.buf);
+				g_memset(first, value, (size_t)count * item_size);
+			}
+			aResultToken.value_int64 = count;
+		}
+	}
+	item_type->Release();
+	return result;
+}
+
+Struct *Struct::ItemType(size_t &aItemSize)
+// Returns a structure describing one item of this array, which the caller must release.
+// This is the structure itself unless its items are defined by a variable.
+{
+	if (!mVarRef)
+	{
+		aItemSize = mSize / (mArraySize ? mArraySize : 1);
+		AddRef();
+		return this;
+	}
+	ExprTokenType Var1, Var2;
+	ExprTokenType *param[] = { &Var1, &Var2 };
+	Struct *item_type;
+	Var2.symbol = SYM_VAR;
+	Var2.var = mVarRef;
+	if (item_type = (Struct *)TokenToObject(Var2))
+		item_type->AddRef(); // variable is a structure object
+	else
+	{	// create structure from definition in variable without allocating memory
+		Var1.symbol = SYM_STRING;
+		Var1.marker = TokenToString(Var2);
+		Var2.symbol = SYM_INTEGER;
+		Var2.value_int64 = 0;
+		if (!(item_type = Struct::Create(param, 2)))
+			return NULL;
+	}
+	aItemSize = item_type->mSize;
+	return item_type;
+}
+
 //
 // Struct:: Internal Methods
 //
 
 Struct::FieldType *Struct::FindField(LPTSTR val)
 {
+	// Scripts usually access the same field repeatedly, e.g. in a loop, so check last found field first
+	if (mLastField >= 0 && mLastField < mFieldCount && !_tcsicmp(mFields[mLastField].key, val))
+		return &mFields[mLastField];
+	if (mLayout)
+	{
+		IndexType i, slot;
+		for (slot = HashField(val) & mLayout->mMask; i = mLayout->mSlot[slot]; slot = (slot + 1) & mLayout->mMask)
+		{
+			if (!_tcsicmp(mFields[--i].key, val))
+			{
+				mLastField = i;
+				return &mFields[i];
+			}
+		}
+		return NULL;
+	}
 	for (int i = 0;i < mFieldCount;i++)
 	{
 		FieldType &field = mFields[i];
 		if (!_tcsicmp(field.key,val))
+		{
+			mLastField = i;
 			return &field;
+		}
 	}
 	return NULL;
 }
 
+UINT Struct::HashField(LPCTSTR aKey)
+// FNV-1a hash of the key, case is ignored the same way as _tcsicmp in FindField.
+{
+	UINT hash = 2166136261U;
+	for ( ; *aKey; ++aKey)
+		hash = (hash ^ (UINT)ctolower(*aKey)) * 16777619U;
+	return hash;
+}
+
+bool Struct::BuildLayout()
+// Moves ownership of field names to a new layout and indexes them.
+// Must be called only once after all fields were inserted.
+{
+	IndexType slot_count = 8, i, slot;
+	while (slot_count < mFieldCount * 2) // keep load factor below 50%
+		slot_count *= 2;
+	Layout *layout = (Layout *)malloc(sizeof(Layout) + slot_count * sizeof(IndexType) + mFieldCount * sizeof(LPTSTR));
+	if (!layout)
+		return false;
+	layout->mRefCount = 1;
+	layout->mKeyCount = mFieldCount;
+	layout->mMask = slot_count - 1;
+	layout->mSlot = (IndexType *)(layout + 1);
+	layout->mKey = (LPTSTR *)(layout->mSlot + slot_count);
+	g_memset(layout->mSlot, NULL, slot_count * sizeof(IndexType));
+	for (i = 0; i < mFieldCount; ++i)
+	{
+		layout->mKey[i] = mFields[i].key;
+		for (slot = HashField(mFields[i].key) & layout->mMask; layout->mSlot[slot]; slot = (slot + 1) & layout->mMask);
+		layout->mSlot[slot] = i + 1;
+	}
+	mLayout = layout;
+	return true;
+}
+
+void Struct::ReleaseLayout(Layout *aLayout)
+{
+	if (--aLayout->mRefCount)
+		return;
+	for (IndexType i = 0; i < aLayout->mKeyCount; ++i)
+		free(aLayout->mKey[i]);
+	free(aLayout);
+}
+
 bool Struct::SetInternalCapacity(IndexType new_capacity)
 // Expands mFields to the specified number if fields.
 // Caller *must* ensure new_capacity >= 1 && new_capacity >= mFieldCount.
@@ -35,6 +35,7 @@ EXTERN_G;  // For ITOA() and related functions' use of g->FormatIntAsHex
 #define tmemmove		wmemmove
 #define tmemset			wmemset
 #define tmemcmp			wmemcmp
+#define tmemchr			wmemchr
 #define tmalloc(c)		((LPTSTR) malloc((c) << 1))
 #define trealloc(p, c)	((LPTSTR) realloc((p), (c) << 1))
 #define talloca(c)		((LPTSTR) _alloca((c) << 1))
@@ -43,6 +44,7 @@ EXTERN_G;  // For ITOA() and related functions' use of g->FormatIntAsHex
 #define tmemmove		memmove
 #define tmemset			memset
 #define tmemcmp			memcmp
+#define tmemchr			(char*)memchr
 #define tmalloc(c)		((LPTSTR) malloc(c))
 #define trealloc(p, c)	((LPTSTR) realloc((p), (c)))
 #define talloca(c)		((LPTSTR) _alloca(c))
@@ -1336,12 +1336,12 @@ ResultType Var::AssignStringFromCodePage(LPCSTR aBuf, int aLength, UINT aCodePag
 	// then back to the active codepage:
 	return AssignStringToCodePage(wide_buf, wide_buf.GetLength(), CP_ACP);
 #else
-	int iLen = MultiByteToWideChar(aCodePage, 0, aBuf, aLength, NULL, 0);
+	int iLen = FastMultiByteToWideChar(aCodePage, 0, aBuf, aLength, NULL, 0);
 	if (iLen > 0) {
 		if (!AssignString(NULL, iLen, true, false))
 			return FAIL;
 		LPWSTR aContents = Contents(TRUE, TRUE);
-		iLen = MultiByteToWideChar(aCodePage, 0, aBuf, aLength, (LPWSTR) aContents, iLen);
+		iLen = FastMultiByteToWideChar(aCodePage, 0, aBuf, aLength, (LPWSTR) aContents, iLen);
 		aContents[iLen] = 0;
 		if (!iLen)
 			return FAIL;
@@ -1362,12 +1362,12 @@ ResultType Var::AssignStringToCodePage(LPCWSTR aBuf, int aLength, UINT aCodePage
 	}
 	else
 		pDefChar = &aDefChar;
-	int iLen = WideCharToMultiByte(aCodePage, aFlags, aBuf, aLength, NULL, 0, pDefChar, NULL);
+	int iLen = FastWideCharToMultiByte(aCodePage, aFlags, aBuf, aLength, NULL, 0, pDefChar, NULL);
 	if (iLen > 0) {
 		if (!SetCapacity(iLen, true, false))
 			return FAIL;
 		LPSTR aContents = (LPSTR) Contents(TRUE, TRUE);
-		iLen = WideCharToMultiByte(aCodePage, aFlags, aBuf, aLength, aContents, iLen, pDefChar, NULL);
+		iLen = FastWideCharToMultiByte(aCodePage, aFlags, aBuf, aLength, aContents, iLen, pDefChar, NULL);
 		aContents[iLen] = 0;
 		if (!iLen)
 			return FAIL;